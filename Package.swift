@@ -444,6 +444,7 @@ let package = Package(
         "connections/implementation/base_pcp_handler_test.cc",
         "connections/implementation/injected_bluetooth_device_store_test.cc",
         "connections/implementation/internal_payload_factory_test.cc",
+        "connections/implementation/keep_alive_scheduler_test.cc",
         "connections/implementation/client_proxy_test.cc",
         "connections/implementation/payload_manager_test.cc",
         "connections/implementation/offline_frames_validator_test.cc",
@@ -453,6 +454,7 @@ let package = Package(
         "connections/implementation/wifi_hotspot_bwu_test.cc",
         "connections/implementation/analytics/analytics_recorder_test.cc",
         "connections/implementation/analytics/throughput_recorder_test.cc",
+        "connections/implementation/analytics/trace_recorder_test.cc",
         "connections/implementation/mediums/ble_v2_test.cc",
         "connections/implementation/mediums/ble_v2/bloom_filter_test.cc",
         "connections/implementation/mediums/ble_v2/ble_packet_test.cc",
@@ -482,6 +484,8 @@ let package = Package(
         "connections/implementation/endpoint_manager_test.cc",
         "connections/implementation/bluetooth_device_name_test.cc",
         "connections/implementation/wifi_lan_service_info_test.cc",
+        "connections/implementation/write_behind_file_test.cc",
+        "connections/implementation/memory_accountant_test.cc",
         "connections/implementation/pcp_manager_test.cc",
         "connections/implementation/ble_advertisement_test.cc",
         "connections/implementation/base_endpoint_channel_test.cc",
@@ -539,7 +543,10 @@ let package = Package(
         "internal/platform/ble_connection_info_test.cc",
         "internal/platform/ble_test.cc",
         "internal/platform/ble_v2_test.cc",
+        "internal/platform/ble_v2_crowd_test.cc",
         "internal/platform/prng_test.cc",
+        "internal/platform/pending_job_registry_test.cc",
+        "internal/platform/array_blocking_queue_test.cc",
         "internal/platform/implementation/apple/count_down_latch_test.cc",
         "internal/platform/implementation/apple/condition_variable_test.cc",
         "internal/platform/implementation/apple/mutex_test.cc",
@@ -568,6 +575,7 @@ let package = Package(
         "internal/test/fake_clock_test.cc",
         "internal/test/fake_webrtc.cc",
         "internal/test/fake_timer_test.cc",
+        "internal/test/virtual_time_test.cc",
         "internal/test/fake_device_info_test.cc",
         "internal/test/fake_task_runner_test.cc",
         "internal/test/fake_data_set_test.cc",
@@ -15,21 +15,22 @@
 #include "connections/c/nc.h"
 
 #include <stddef.h>
-#include <sys/stat.h>
 
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/base/no_destructor.h"
 #include "absl/container/flat_hash_map.h"
-#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "connections/advertising_options.h"
+#include "connections/c/nc_endpoint_handles.h"
+#include "connections/c/nc_payload.h"
 #include "connections/c/nc_types.h"
 #include "connections/connection_options.h"
 #include "connections/core.h"
@@ -45,7 +46,6 @@
 #include "internal/flags/nearby_flags.h"
 #include "internal/platform/bluetooth_utils.h"
 #include "internal/platform/byte_array.h"
-#include "internal/platform/file.h"
 #include "internal/platform/logging.h"
 
 namespace nearby::connections {
@@ -58,37 +58,13 @@ class OfflineServiceController;
 typedef struct NcContext {
   ::nearby::connections::ServiceControllerRouter* router = nullptr;
   ::nearby::connections::Core* core = nullptr;
+  // Shared with the callbacks, which may outlive the context.
+  std::shared_ptr<::nearby::connections::EndpointHandles> endpoint_handles =
+      std::make_shared<::nearby::connections::EndpointHandles>();
 } NcContext;
 
 absl::NoDestructor<absl::flat_hash_map<NC_INSTANCE, NcContext>> kNcContextMap;
 
-int64_t getFileSize(const char* filename) {
-  struct stat file_status;
-  if (stat(filename, &file_status) < 0) {
-    return -1;
-  }
-
-  return file_status.st_size;
-}
-
-int convertStringToInt(absl::string_view data) {
-  if (data.size() != 4) {
-    return 0;
-  }
-
-  return (data[0]) | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
-}
-
-std::string convertIntToString(int input) {
-  std::string result;
-  result.resize(4);
-  result[0] = input & 0xff;
-  result[1] = (input >> 8) & 0xff;
-  result[2] = (input >> 16) & 0xff;
-  result[3] = (input >> 24) & 0xff;
-  return result;
-}
-
 NcContext* GetContext(NC_INSTANCE instance) {
   auto it = kNcContextMap->find(instance);
   if (it == kNcContextMap->end()) {
@@ -99,6 +75,7 @@ NcContext* GetContext(NC_INSTANCE instance) {
 
 ::nearby::connections::ConnectionRequestInfo GetCppConnectionRequestInfo(
     NC_INSTANCE instance,
+    std::shared_ptr<::nearby::connections::EndpointHandles> endpoint_handles,
     const NC_CONNECTION_REQUEST_INFO& connection_request_info,
     CALLER_CONTEXT context) {
   ::nearby::connections::ConnectionRequestInfo cpp_connection_request_info;
@@ -108,19 +85,19 @@ NcContext* GetContext(NC_INSTANCE instance) {
   ::nearby::connections::ConnectionListener cpp_connection_listener;
   cpp_connection_listener.accepted_cb = [=](const std::string& endpoint_id) {
     connection_request_info.accepted_callback(
-        instance, convertStringToInt(endpoint_id), context);
+        instance, endpoint_handles->GetHandle(endpoint_id), context);
   };
   cpp_connection_listener.bandwidth_changed_cb =
       [=](const std::string& endpoint_id,
           ::nearby::connections::Medium medium) {
         connection_request_info.bandwidth_changed_callback(
-            instance, convertStringToInt(endpoint_id),
+            instance, endpoint_handles->GetHandle(endpoint_id),
             static_cast<NC_MEDIUM>(medium), context);
       };
   cpp_connection_listener.disconnected_cb =
       [=](const std::string& endpoint_id) {
         connection_request_info.disconnected_callback(
-            instance, convertStringToInt(endpoint_id), context);
+            instance, endpoint_handles->GetHandle(endpoint_id), context);
       };
   cpp_connection_listener.initiated_cb =
       [=](const std::string& endpoint_id,
@@ -144,7 +121,7 @@ NcContext* GetContext(NC_INSTANCE instance) {
             info.raw_authentication_token.size();
 
         connection_request_info.initiated_callback(
-            instance, convertStringToInt(endpoint_id),
+            instance, endpoint_handles->GetHandle(endpoint_id),
             &connection_response_info, context);
       };
 
@@ -152,7 +129,7 @@ NcContext* GetContext(NC_INSTANCE instance) {
       [=](const std::string& endpoint_id,
           ::nearby::connections::Status status) {
         connection_request_info.rejected_callback(
-            instance, convertStringToInt(endpoint_id),
+            instance, endpoint_handles->GetHandle(endpoint_id),
             static_cast<NC_STATUS>(status.value), context);
       };
 
@@ -198,7 +175,8 @@ void NcStartAdvertising(
   }
 
   ::nearby::connections::ConnectionRequestInfo cpp_connection_request_info =
-      GetCppConnectionRequestInfo(instance, *connection_request_info, context);
+      GetCppConnectionRequestInfo(instance, nc_context->endpoint_handles,
+                                  *connection_request_info, context);
 
   ::nearby::connections::AdvertisingOptions cpp_advertising_options;
   cpp_advertising_options.allowed.ble =
@@ -321,12 +299,14 @@ void NcStartDiscovery(NC_INSTANCE instance, const NC_DATA* service_id,
       discovery_options->common_options.allowed_mediums[NC_MEDIUM_WEB_RTC];
 
   NC_DISCOVERY_LISTENER discovery_listener_copy = *discovery_listener;
+  std::shared_ptr<::nearby::connections::EndpointHandles> endpoint_handles =
+      nc_context->endpoint_handles;
   ::nearby::connections::DiscoveryListener listener;
   listener.endpoint_distance_changed_cb =
       [=](const std::string& endpoint_id,
           ::nearby::connections::DistanceInfo info) {
         discovery_listener_copy.endpoint_distance_changed_callback(
-            instance, convertStringToInt(endpoint_id),
+            instance, endpoint_handles->GetHandle(endpoint_id),
             static_cast<NC_DISTANCE_INFO>(info), context);
       };
   listener.endpoint_found_cb = [=](const std::string& endpoint_id,
@@ -338,13 +318,13 @@ void NcStartDiscovery(NC_INSTANCE instance, const NC_DATA* service_id,
     NC_DATA service_id_data = {.size = static_cast<int64_t>(service_id.size()),
                                .data = (char*)service_id.data()};
     discovery_listener_copy.endpoint_found_callback(
-        instance, convertStringToInt(endpoint_id), &endpoint_info_data,
-        &service_id_data, context);
+        instance, endpoint_handles->GetHandle(endpoint_id),
+        &endpoint_info_data, &service_id_data, context);
   };
 
   listener.endpoint_lost_cb = [=](const std::string& endpoint_id) {
     discovery_listener_copy.endpoint_lost_callback(
-        instance, convertStringToInt(endpoint_id), context);
+        instance, endpoint_handles->GetHandle(endpoint_id), context);
   };
   nc_context->core->StartDiscovery(
       std::string(service_id->data, service_id->size),
@@ -410,7 +390,8 @@ void NcRequestConnection(
   }
 
   ::nearby::connections::ConnectionRequestInfo cpp_connection_request_info =
-      GetCppConnectionRequestInfo(instance, *connection_request_info, context);
+      GetCppConnectionRequestInfo(instance, nc_context->endpoint_handles,
+                                  *connection_request_info, context);
 
   ::nearby::connections::ConnectionOptions cpp_connection_options;
   cpp_connection_options.allowed.ble =
@@ -458,8 +439,8 @@ void NcRequestConnection(
     cpp_connection_options.strategy = ::nearby::connections::Strategy::kP2pStar;
 
   nc_context->core->RequestConnection(
-      convertIntToString(endpoint_id), std::move(cpp_connection_request_info),
-      std::move(cpp_connection_options),
+      nc_context->endpoint_handles->GetEndpointId(endpoint_id),
+      std::move(cpp_connection_request_info), std::move(cpp_connection_options),
       [=](::nearby::connections::Status status) {
         result_callback(static_cast<NC_STATUS>(status.value), context);
       });
@@ -475,31 +456,16 @@ void NcAcceptConnection(NC_INSTANCE instance, int endpoint_id,
     return;
   }
 
+  std::shared_ptr<::nearby::connections::EndpointHandles> endpoint_handles =
+      nc_context->endpoint_handles;
   ::nearby::connections::PayloadListener cpp_payload_listener;
   cpp_payload_listener.payload_cb =
       [=](absl::string_view endpoint_id,
           ::nearby::connections::Payload payload) {
-        NC_PAYLOAD nc_payload;
-        nc_payload.id = payload.GetId();
-        nc_payload.direction = NC_PAYLOAD_DIRECTION_INCOMING;
-        nc_payload.type = static_cast<NC_PAYLOAD_TYPE>(payload.GetType());
-        if (nc_payload.type == NC_PAYLOAD_TYPE_BYTES) {
-          const nearby::ByteArray& bytes = payload.AsBytes();
-          nc_payload.content.bytes.content.data =
-              const_cast<char*>(bytes.data());
-          nc_payload.content.bytes.content.size = bytes.size();
-        } else if (nc_payload.type == NC_PAYLOAD_TYPE_FILE) {
-          nc_payload.content.file.file_name =
-              (char*)payload.GetFileName().c_str();
-          nc_payload.content.file.parent_folder =
-              (char*)payload.GetParentFolder().c_str();
-          nc_payload.content.file.offset = payload.GetOffset();
-        } else if (nc_payload.type == NC_PAYLOAD_TYPE_STREAM) {
-          // TODO(guogang): support stream later.
-        }
-
+        NC_PAYLOAD nc_payload = ::nearby::connections::ToNcPayload(payload);
         payload_listener.received_callback(
-            instance, convertStringToInt(endpoint_id), &nc_payload, context);
+            instance, endpoint_handles->GetHandle(endpoint_id), &nc_payload,
+            context);
       };
 
   cpp_payload_listener.payload_progress_cb =
@@ -512,12 +478,13 @@ void NcAcceptConnection(NC_INSTANCE instance, int endpoint_id,
         nc_payload_progress_info.status =
             static_cast<NC_PAYLOAD_PROGRESS_INFO_STATUS>(progress.status);
         payload_listener.progress_updated_callback(
-            instance, convertStringToInt(endpoint_id),
+            instance, endpoint_handles->GetHandle(endpoint_id),
             &nc_payload_progress_info, context);
       };
 
   nc_context->core->AcceptConnection(
-      convertIntToString(endpoint_id), std::move(cpp_payload_listener),
+      nc_context->endpoint_handles->GetEndpointId(endpoint_id),
+      std::move(cpp_payload_listener),
       [=](::nearby::connections::Status status) {
         result_callback(static_cast<NC_STATUS>(status.value), context);
       });
@@ -533,7 +500,7 @@ void NcRejectConnection(NC_INSTANCE instance, int endpoint_id,
   }
 
   nc_context->core->RejectConnection(
-      convertIntToString(endpoint_id),
+      nc_context->endpoint_handles->GetEndpointId(endpoint_id),
       [=](::nearby::connections::Status status) {
         result_callback(static_cast<NC_STATUS>(status.value), context);
       });
@@ -549,34 +516,16 @@ void NcSendPayload(NC_INSTANCE instance, size_t endpoint_ids_size,
   }
 
   std::vector<std::string> endpoint_ids_vector;
+  endpoint_ids_vector.reserve(endpoint_ids_size);
   for (size_t i = 0; i < endpoint_ids_size; ++i) {
-    endpoint_ids_vector.push_back(convertIntToString(endpoint_ids[i]));
+    endpoint_ids_vector.push_back(
+        nc_context->endpoint_handles->GetEndpointId(endpoint_ids[i]));
   }
 
   absl::Span<const std::string> endpoint_ids_span(endpoint_ids_vector.data(),
                                                   endpoint_ids_size);
-  ::nearby::connections::Payload cpp_payload;
-  if (payload->type == NC_PAYLOAD_TYPE_BYTES) {
-    cpp_payload = ::nearby::connections::Payload(
-        payload->id, nearby::ByteArray(payload->content.bytes.content.data,
-                                       payload->content.bytes.content.size));
-  } else if (payload->type == NC_PAYLOAD_TYPE_FILE) {
-    // get file size
-    std::string full_file_name = "";
-    if (payload->content.file.parent_folder == nullptr) {
-      full_file_name = payload->content.file.file_name;
-    } else {
-      full_file_name = absl::StrCat(payload->content.file.parent_folder, "/",
-                                    payload->content.file.file_name);
-    }
-
-    nearby::InputFile input_file(full_file_name,
-                                 getFileSize(full_file_name.c_str()));
-    cpp_payload =
-        ::nearby::connections::Payload(payload->id, std::move(input_file));
-  } else if (payload->type == NC_PAYLOAD_TYPE_STREAM) {
-    // TODO(guogang): support stream later.
-  }
+  ::nearby::connections::Payload cpp_payload =
+      ::nearby::connections::ToCppPayload(*payload, context);
 
   nc_context->core->SendPayload(
       endpoint_ids_span, std::move(cpp_payload),
@@ -585,6 +534,20 @@ void NcSendPayload(NC_INSTANCE instance, size_t endpoint_ids_size,
       });
 }
 
+char* NcAllocatePayloadBytes(int64_t size) {
+  if (size < 0) {
+    NEARBY_LOGS(WARNING) << "Allocating " << size << " payload bytes";
+    return nullptr;
+  }
+  return ::nearby::connections::AllocatePayloadBytes(size);
+}
+
+void NcReleasePayloadBytes(char* data) {
+  if (!::nearby::connections::ReleasePayloadBytes(data)) {
+    NEARBY_LOGS(WARNING) << "Releasing unknown payload bytes";
+  }
+}
+
 void NcCancelPayload(NC_INSTANCE instance, NC_PAYLOAD_ID payload_id,
                      NcCallbackResult result_callback, CALLER_CONTEXT context) {
   NcContext* nc_context = GetContext(instance);
@@ -609,7 +572,7 @@ void NcDisconnectFromEndpoint(NC_INSTANCE instance, int endpoint_id,
   }
 
   nc_context->core->DisconnectFromEndpoint(
-      convertIntToString(endpoint_id),
+      nc_context->endpoint_handles->GetEndpointId(endpoint_id),
       [=](::nearby::connections::Status status) {
         result_callback(static_cast<NC_STATUS>(status.value), context);
       });
@@ -638,7 +601,7 @@ void NcInitiateBandwidthUpgrade(NC_INSTANCE instance, int endpoint_id,
   }
 
   nc_context->core->InitiateBandwidthUpgrade(
-      convertIntToString(endpoint_id),
+      nc_context->endpoint_handles->GetEndpointId(endpoint_id),
       [=](::nearby::connections::Status status) {
         result_callback(static_cast<NC_STATUS>(status.value), context);
       });
@@ -651,7 +614,7 @@ int NcGetLocalEndpointId(NC_INSTANCE instance) {
   }
 
   std::string endpoint_id = nc_context->core->GetLocalEndpointId();
-  return convertStringToInt(endpoint_id);
+  return nc_context->endpoint_handles->GetHandle(endpoint_id);
 }
 
 void NcEnableBleV2(NC_INSTANCE instance, bool enable,
@@ -24,6 +24,10 @@
 extern "C" {
 #endif  // __cplusplus
 
+// Endpoints are identified by int handles. A service hands out a handle the
+// first time it reports an endpoint, and the handle stays the same for the
+// lifetime of the service.
+
 // Creates a new Nearby Connections service.
 NC_API NC_INSTANCE NcCreateService();
 NC_API void NcCloseService(NC_INSTANCE instance);
@@ -122,7 +126,10 @@ NC_API void NcRejectConnection(NC_INSTANCE instance, int endpoint_id,
                                NcCallbackResult result_callback,
                                CALLER_CONTEXT context);
 
-// Sends a Payload to a remote endpoint.
+// Sends a Payload to a remote endpoint. The content of a BYTES payload is
+// copied, unless it was allocated with NcAllocatePayloadBytes(). A STREAM
+// payload is read through its callbacks, which are called with |context|, from
+// a thread of Nearby Connections until the stream ends.
 //
 // instance - The returned instance by NcOpenService.
 // endpoint_ids_size - The endpoint number to receive the payload.
@@ -134,6 +141,16 @@ NC_API void NcSendPayload(NC_INSTANCE instance, size_t endpoint_ids_size,
                           NcCallbackResult result_callback,
                           CALLER_CONTEXT context);
 
+// Allocates a buffer of |size| bytes for the content of a BYTES payload. When
+// the buffer is sent with NcSendPayload(), Nearby Connections takes it over
+// without copying it, and frees it once the payload is done. The caller must
+// not touch the buffer after sending it. A buffer that isn't sent must be freed
+// with NcReleasePayloadBytes(). Returns NULL if |size| is negative.
+NC_API char* NcAllocatePayloadBytes(int64_t size);
+
+// Frees a buffer from NcAllocatePayloadBytes() that wasn't sent.
+NC_API void NcReleasePayloadBytes(char* data);
+
 // Cancels a Payload currently in-flight to or from remote endpoint(s).
 //
 // instance - The Nearby Connections instance is called by NcSendPayload.
@@ -0,0 +1,49 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/c/nc_endpoint_handles.h"
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+
+namespace nearby::connections {
+
+int EndpointHandles::GetHandle(absl::string_view endpoint_id) {
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    auto it = handles_.find(endpoint_id);
+    if (it != handles_.end()) {
+      return it->second;
+    }
+  }
+  absl::MutexLock lock(&mutex_);
+  auto [it, inserted] =
+      handles_.emplace(endpoint_id, static_cast<int>(endpoint_ids_.size()) + 1);
+  if (inserted) {
+    endpoint_ids_.emplace_back(endpoint_id);
+  }
+  return it->second;
+}
+
+std::string EndpointHandles::GetEndpointId(int handle) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  if (handle <= 0 || handle > static_cast<int>(endpoint_ids_.size())) {
+    return "";
+  }
+  return endpoint_ids_[handle - 1];
+}
+
+}  // namespace nearby::connections
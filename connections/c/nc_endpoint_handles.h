@@ -0,0 +1,51 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_NEARBY_CONNECTIONS_C_NC_ENDPOINT_HANDLES_H_
+#define THIRD_PARTY_NEARBY_CONNECTIONS_C_NC_ENDPOINT_HANDLES_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+
+namespace nearby::connections {
+
+// The int handles that stand for endpoint IDs in the C API.
+//
+// An endpoint gets a handle the first time it is reported to the client, and
+// keeps it for the lifetime of the service. Handles start at 1, so 0 is never a
+// valid handle.
+class EndpointHandles {
+ public:
+  // Returns the handle of |endpoint_id|, assigning one if it has none yet.
+  int GetHandle(absl::string_view endpoint_id) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the endpoint ID of |handle|, or an empty string if |handle| wasn't
+  // handed out.
+  std::string GetEndpointId(int handle) const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, int> handles_ ABSL_GUARDED_BY(mutex_);
+  // The endpoint ID of handle i + 1.
+  std::vector<std::string> endpoint_ids_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace nearby::connections
+
+#endif  // THIRD_PARTY_NEARBY_CONNECTIONS_C_NC_ENDPOINT_HANDLES_H_
@@ -0,0 +1,46 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/c/nc_endpoint_handles.h"
+
+#include "gtest/gtest.h"
+
+namespace nearby::connections {
+namespace {
+
+TEST(NcEndpointHandlesTest, KeepsHandlePerEndpoint) {
+  EndpointHandles handles;
+
+  int a = handles.GetHandle("ABCD");
+  int b = handles.GetHandle("EFGH");
+
+  EXPECT_NE(a, 0);
+  EXPECT_NE(b, 0);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(handles.GetHandle("ABCD"), a);
+  EXPECT_EQ(handles.GetEndpointId(a), "ABCD");
+  EXPECT_EQ(handles.GetEndpointId(b), "EFGH");
+}
+
+TEST(NcEndpointHandlesTest, UnknownHandleHasNoEndpoint) {
+  EndpointHandles handles;
+  int a = handles.GetHandle("ABCD");
+
+  EXPECT_EQ(handles.GetEndpointId(0), "");
+  EXPECT_EQ(handles.GetEndpointId(-1), "");
+  EXPECT_EQ(handles.GetEndpointId(a + 1), "");
+}
+
+}  // namespace
+}  // namespace nearby::connections
@@ -0,0 +1,227 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/c/nc_payload.h"
+
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/no_destructor.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "connections/c/nc_types.h"
+#include "connections/payload.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/file.h"
+#include "internal/platform/input_stream.h"
+#include "internal/platform/logging.h"
+
+namespace nearby::connections {
+namespace {
+
+absl::Mutex payload_bytes_mutex(absl::kConstInit);
+
+// Buffers from AllocatePayloadBytes() that weren't sent yet, by their data.
+// The strings are boxed so that short strings keep their data in place.
+absl::flat_hash_map<const char*, std::unique_ptr<std::string>>&
+PendingPayloadBytes() ABSL_EXCLUSIVE_LOCKS_REQUIRED(payload_bytes_mutex) {
+  static absl::NoDestructor<
+      absl::flat_hash_map<const char*, std::unique_ptr<std::string>>>
+      buffers;
+  return *buffers;
+}
+
+// Returns the buffer from AllocatePayloadBytes() holding |data|, if any.
+std::unique_ptr<std::string> TakePayloadBytes(const char* data) {
+  absl::MutexLock lock(&payload_bytes_mutex);
+  auto node = PendingPayloadBytes().extract(data);
+  if (node.empty()) {
+    return nullptr;
+  }
+  return std::move(node.mapped());
+}
+
+int64_t GetFileSize(const char* filename) {
+  struct stat file_status;
+  if (stat(filename, &file_status) < 0) {
+    return -1;
+  }
+
+  return file_status.st_size;
+}
+
+// Reads an outgoing STREAM payload through the callbacks of the C client.
+class NcInputStream : public InputStream {
+ public:
+  NcInputStream(const NC_STREAM_PAYLOAD& stream, CALLER_CONTEXT context)
+      : stream_(stream), context_(context) {}
+
+  ExceptionOr<ByteArray> Read(std::int64_t size) override {
+    // The client reads straight into the storage of the returned ByteArray.
+    std::string buffer(size, 0);
+    int read =
+        stream_.read_callback(stream_.stream, buffer.data(), size, context_);
+    if (read < 0 || read > size) {
+      return {Exception::kIo};
+    }
+    buffer.resize(read);
+    return ExceptionOr<ByteArray>(ByteArray(std::move(buffer)));
+  }
+
+  ExceptionOr<size_t> Skip(size_t offset) override {
+    if (stream_.skip_callback == nullptr) {
+      return InputStream::Skip(offset);
+    }
+    int skipped = stream_.skip_callback(stream_.stream, offset, context_);
+    if (skipped < 0) {
+      return {Exception::kIo};
+    }
+    return ExceptionOr<size_t>(skipped);
+  }
+
+  Exception Close() override {
+    if (stream_.close_callback != nullptr &&
+        stream_.close_callback(stream_.stream, context_) != 0) {
+      return {Exception::kIo};
+    }
+    return {Exception::kSuccess};
+  }
+
+ private:
+  const NC_STREAM_PAYLOAD stream_;
+  const CALLER_CONTEXT context_;
+};
+
+// Handle of a received STREAM payload, which owns the payload until the client
+// closes the stream.
+struct IncomingStream {
+  Payload payload;
+};
+
+int ReadIncomingStream(NC_INSTANCE stream, char* buffer, int64_t size,
+                       CALLER_CONTEXT context) {
+  auto* incoming = static_cast<IncomingStream*>(stream);
+  ExceptionOr<ByteArray> read = incoming->payload.AsStream()->Read(size);
+  if (!read.ok()) {
+    return -1;
+  }
+  std::memcpy(buffer, read.result().data(), read.result().size());
+  return read.result().size();
+}
+
+int SkipIncomingStream(NC_INSTANCE stream, int64_t skip,
+                       CALLER_CONTEXT context) {
+  auto* incoming = static_cast<IncomingStream*>(stream);
+  ExceptionOr<size_t> skipped = incoming->payload.AsStream()->Skip(skip);
+  if (!skipped.ok()) {
+    return -1;
+  }
+  return skipped.result();
+}
+
+int CloseIncomingStream(NC_INSTANCE stream, CALLER_CONTEXT context) {
+  auto* incoming = static_cast<IncomingStream*>(stream);
+  Exception exception = incoming->payload.AsStream()->Close();
+  delete incoming;
+  return exception.Ok() ? 0 : -1;
+}
+
+}  // namespace
+
+char* AllocatePayloadBytes(int64_t size) {
+  if (size < 0) {
+    return nullptr;
+  }
+  auto buffer = std::make_unique<std::string>(size, 0);
+  char* data = buffer->data();
+  absl::MutexLock lock(&payload_bytes_mutex);
+  PendingPayloadBytes().emplace(data, std::move(buffer));
+  return data;
+}
+
+bool ReleasePayloadBytes(const char* data) {
+  return TakePayloadBytes(data) != nullptr;
+}
+
+Payload ToCppPayload(const NC_PAYLOAD& payload, CALLER_CONTEXT context) {
+  switch (payload.type) {
+    case NC_PAYLOAD_TYPE_BYTES: {
+      const NC_DATA& content = payload.content.bytes.content;
+      std::unique_ptr<std::string> buffer = TakePayloadBytes(content.data);
+      if (buffer == nullptr) {
+        return Payload(payload.id, ByteArray(content.data, content.size));
+      }
+      if (buffer->size() != content.size) {
+        NEARBY_LOGS(WARNING) << "Sending " << content.size << " of "
+                             << buffer->size() << " allocated payload bytes";
+        buffer->resize(content.size);
+      }
+      return Payload(payload.id, ByteArray(std::move(*buffer)));
+    }
+    case NC_PAYLOAD_TYPE_FILE: {
+      std::string full_file_name;
+      if (payload.content.file.parent_folder == nullptr) {
+        full_file_name = payload.content.file.file_name;
+      } else {
+        full_file_name = absl::StrCat(payload.content.file.parent_folder, "/",
+                                      payload.content.file.file_name);
+      }
+      InputFile input_file(full_file_name,
+                           GetFileSize(full_file_name.c_str()));
+      return Payload(payload.id, std::move(input_file));
+    }
+    case NC_PAYLOAD_TYPE_STREAM:
+      return Payload(payload.id, std::make_unique<NcInputStream>(
+                                     payload.content.stream, context));
+    default:
+      NEARBY_LOGS(WARNING) << "Unknown payload type " << payload.type;
+      return Payload();
+  }
+}
+
+NC_PAYLOAD ToNcPayload(Payload& payload) {
+  NC_PAYLOAD nc_payload = {};
+  nc_payload.id = payload.GetId();
+  nc_payload.direction = NC_PAYLOAD_DIRECTION_INCOMING;
+  nc_payload.type = static_cast<NC_PAYLOAD_TYPE>(payload.GetType());
+  if (nc_payload.type == NC_PAYLOAD_TYPE_BYTES) {
+    const ByteArray& bytes = payload.AsBytes();
+    nc_payload.content.bytes.content.data = const_cast<char*>(bytes.data());
+    nc_payload.content.bytes.content.size = bytes.size();
+  } else if (nc_payload.type == NC_PAYLOAD_TYPE_FILE) {
+    nc_payload.content.file.file_name =
+        const_cast<char*>(payload.GetFileName().c_str());
+    nc_payload.content.file.parent_folder =
+        const_cast<char*>(payload.GetParentFolder().c_str());
+    nc_payload.content.file.offset = payload.GetOffset();
+  } else if (nc_payload.type == NC_PAYLOAD_TYPE_STREAM) {
+    nc_payload.content.stream.stream =
+        new IncomingStream{.payload = std::move(payload)};
+    nc_payload.content.stream.read_callback = ReadIncomingStream;
+    nc_payload.content.stream.skip_callback = SkipIncomingStream;
+    nc_payload.content.stream.close_callback = CloseIncomingStream;
+  }
+  return nc_payload;
+}
+
+}  // namespace nearby::connections
@@ -0,0 +1,48 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_NEARBY_CONNECTIONS_C_NC_PAYLOAD_H_
+#define THIRD_PARTY_NEARBY_CONNECTIONS_C_NC_PAYLOAD_H_
+
+#include <cstdint>
+
+#include "connections/c/nc_types.h"
+#include "connections/payload.h"
+
+namespace nearby::connections {
+
+// Allocates a buffer for the content of a BYTES payload. The buffer is the
+// storage of the ByteArray the payload is sent from, so sending it doesn't copy
+// the content. Returns nullptr if |size| is negative.
+char* AllocatePayloadBytes(int64_t size);
+
+// Frees a buffer from AllocatePayloadBytes() that wasn't sent. Returns false if
+// |data| isn't such a buffer.
+bool ReleasePayloadBytes(const char* data);
+
+// Converts a payload passed to NcSendPayload(). A BYTES payload takes over its
+// content if it was allocated by AllocatePayloadBytes(), and copies it
+// otherwise. A STREAM payload reads through the callbacks of |payload|, which
+// are called with |context|.
+Payload ToCppPayload(const NC_PAYLOAD& payload, CALLER_CONTEXT context);
+
+// Converts a received payload for the payload listener. BYTES and FILE payloads
+// point into |payload|. A STREAM payload is moved out of |payload| into the
+// handle of the returned stream, which stays valid until its close callback is
+// called.
+NC_PAYLOAD ToNcPayload(Payload& payload);
+
+}  // namespace nearby::connections
+
+#endif  // THIRD_PARTY_NEARBY_CONNECTIONS_C_NC_PAYLOAD_H_
@@ -0,0 +1,175 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/c/nc_payload.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "connections/c/nc_types.h"
+#include "connections/payload.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/input_stream.h"
+#include "internal/platform/output_stream.h"
+#include "internal/platform/pipe.h"
+
+namespace nearby::connections {
+namespace {
+
+constexpr NC_PAYLOAD_ID kPayloadId = 1234;
+
+NC_PAYLOAD BytesPayload(char* data, int64_t size) {
+  NC_PAYLOAD payload = {};
+  payload.id = kPayloadId;
+  payload.type = NC_PAYLOAD_TYPE_BYTES;
+  payload.direction = NC_PAYLOAD_DIRECTION_OUTGOING;
+  payload.content.bytes.content.data = data;
+  payload.content.bytes.content.size = size;
+  return payload;
+}
+
+TEST(NcPayloadTest, RejectsNegativeAllocation) {
+  EXPECT_EQ(AllocatePayloadBytes(-1), nullptr);
+}
+
+TEST(NcPayloadTest, SendsAllocatedBytesWithoutCopy) {
+  constexpr int64_t kSize = 8 * 1024 * 1024;
+  char* data = AllocatePayloadBytes(kSize);
+  std::memset(data, 'a', kSize);
+
+  Payload payload = ToCppPayload(BytesPayload(data, kSize), nullptr);
+
+  EXPECT_EQ(payload.GetId(), kPayloadId);
+  EXPECT_EQ(payload.GetType(), PayloadType::kBytes);
+  EXPECT_EQ(payload.AsBytes().size(), kSize);
+  // The payload owns the allocated buffer now.
+  EXPECT_EQ(payload.AsBytes().data(), data);
+  EXPECT_FALSE(ReleasePayloadBytes(data));
+}
+
+TEST(NcPayloadTest, CopiesOtherBytes) {
+  std::string content = "bytes";
+
+  Payload payload =
+      ToCppPayload(BytesPayload(content.data(), content.size()), nullptr);
+
+  EXPECT_NE(payload.AsBytes().data(), content.data());
+  EXPECT_EQ(std::string(payload.AsBytes()), content);
+}
+
+TEST(NcPayloadTest, SendsPartOfAllocatedBytes) {
+  char* data = AllocatePayloadBytes(100);
+  std::memcpy(data, "bytes", 5);
+
+  Payload payload = ToCppPayload(BytesPayload(data, 5), nullptr);
+
+  EXPECT_EQ(std::string(payload.AsBytes()), "bytes");
+}
+
+TEST(NcPayloadTest, ReleasesAllocatedBytes) {
+  char* data = AllocatePayloadBytes(100);
+
+  EXPECT_TRUE(ReleasePayloadBytes(data));
+  EXPECT_FALSE(ReleasePayloadBytes(data));
+}
+
+// A C stream over a string, read in chunks.
+struct TestStream {
+  std::string content;
+  size_t offset = 0;
+  bool closed = false;
+};
+
+int ReadTestStream(NC_INSTANCE stream, char* buffer, int64_t size,
+                   CALLER_CONTEXT context) {
+  auto* test_stream = static_cast<TestStream*>(stream);
+  size_t read = std::min<size_t>(
+      size, test_stream->content.size() - test_stream->offset);
+  std::memcpy(buffer, test_stream->content.data() + test_stream->offset, read);
+  test_stream->offset += read;
+  return read;
+}
+
+int CloseTestStream(NC_INSTANCE stream, CALLER_CONTEXT context) {
+  static_cast<TestStream*>(stream)->closed = true;
+  return 0;
+}
+
+TEST(NcPayloadTest, SendsStream) {
+  TestStream test_stream{.content = "stream content"};
+  NC_PAYLOAD nc_payload = {};
+  nc_payload.id = kPayloadId;
+  nc_payload.type = NC_PAYLOAD_TYPE_STREAM;
+  nc_payload.content.stream.stream = &test_stream;
+  nc_payload.content.stream.read_callback = ReadTestStream;
+  nc_payload.content.stream.close_callback = CloseTestStream;
+
+  Payload payload = ToCppPayload(nc_payload, nullptr);
+  ASSERT_EQ(payload.GetType(), PayloadType::kStream);
+  InputStream* stream = payload.AsStream();
+  ExceptionOr<ByteArray> first = stream->Read(6);
+  ExceptionOr<size_t> skipped = stream->Skip(1);
+  ExceptionOr<ByteArray> rest = stream->Read(100);
+  ExceptionOr<ByteArray> end = stream->Read(100);
+  EXPECT_TRUE(stream->Close().Ok());
+
+  ASSERT_TRUE(first.ok());
+  EXPECT_EQ(std::string(first.result()), "stream");
+  ASSERT_TRUE(skipped.ok());
+  EXPECT_EQ(skipped.result(), 1);
+  ASSERT_TRUE(rest.ok());
+  EXPECT_EQ(std::string(rest.result()), "content");
+  ASSERT_TRUE(end.ok());
+  EXPECT_TRUE(end.result().Empty());
+  EXPECT_TRUE(test_stream.closed);
+}
+
+TEST(NcPayloadTest, ReceivesStream) {
+  auto [input, output] = CreatePipe();
+  Payload payload(kPayloadId, std::move(input));
+  ASSERT_TRUE(output->Write(ByteArray("stream content")).Ok());
+  ASSERT_TRUE(output->Close().Ok());
+
+  NC_PAYLOAD nc_payload = ToNcPayload(payload);
+  ASSERT_EQ(nc_payload.type, NC_PAYLOAD_TYPE_STREAM);
+  const NC_STREAM_PAYLOAD& stream = nc_payload.content.stream;
+  char buffer[100];
+  int read = stream.read_callback(stream.stream, buffer, 6, nullptr);
+  int skipped = stream.skip_callback(stream.stream, 1, nullptr);
+  int rest = stream.read_callback(stream.stream, buffer + read, 100, nullptr);
+
+  EXPECT_EQ(read, 6);
+  EXPECT_EQ(skipped, 1);
+  EXPECT_EQ(std::string(buffer, read + rest), "streamcontent");
+  EXPECT_EQ(stream.close_callback(stream.stream, nullptr), 0);
+}
+
+TEST(NcPayloadTest, ReceivedBytesPointIntoPayload) {
+  Payload payload(kPayloadId, ByteArray("bytes"));
+
+  NC_PAYLOAD nc_payload = ToNcPayload(payload);
+
+  EXPECT_EQ(nc_payload.id, kPayloadId);
+  EXPECT_EQ(nc_payload.type, NC_PAYLOAD_TYPE_BYTES);
+  EXPECT_EQ(nc_payload.content.bytes.content.data, payload.AsBytes().data());
+  EXPECT_EQ(nc_payload.content.bytes.content.size, 5);
+}
+
+}  // namespace
+}  // namespace nearby::connections
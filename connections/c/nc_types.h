@@ -232,6 +232,13 @@ typedef struct NC_BYTES_PAYLOAD {
   NC_DATA content;
 } NC_BYTES_PAYLOAD;
 
+// Stream callbacks return a negative value on error. The read callback returns
+// the number of bytes read into |buffer|, at most |size|, and 0 at the end of
+// the stream; it blocks until data is available. The skip callback returns the
+// number of bytes skipped.
+//
+// The stream of a received STREAM payload comes with these callbacks, and stays
+// valid until its close callback is called.
 typedef int (*NcCallbackStreamRead)(NC_INSTANCE stream, char* buffer,
                                     int64_t size, CALLER_CONTEXT context);
 typedef int (*NcCallbackStreamClose)(NC_INSTANCE stream,
@@ -15,6 +15,7 @@
 #define CORE_DISCOVERY_OPTIONS_H_
 #include <string>
 
+#include "absl/time/time.h"
 #include "connections/medium_selector.h"
 #include "connections/options_base.h"
 #include "connections/power_level.h"
@@ -45,6 +46,12 @@ struct DiscoveryOptions : OptionsBase {
 
   // If true, only low power mediums (like BLE) will be used for discovery.
   bool low_power = false;
+
+  // When positive, endpoint found and lost events are held for this long and
+  // then delivered together. Duplicate events for an endpoint are merged, and
+  // an endpoint that is found and lost again (or lost and found again) within
+  // the window isn't reported at all.
+  absl::Duration endpoint_events_coalescing_window = absl::ZeroDuration();
 };
 
 }  // namespace connections
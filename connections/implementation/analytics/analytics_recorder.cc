@@ -28,6 +28,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "connections/implementation/analytics/connection_attempt_metadata_params.h"
+#include "connections/implementation/analytics/trace_recorder.h"
 #include "connections/payload_type.h"
 #include "connections/strategy.h"
 #include "internal/analytics/event_logger.h"
@@ -619,6 +620,8 @@ void AnalyticsRecorder::OnOutgoingPayloadDone(const std::string &endpoint_id,
 void AnalyticsRecorder::OnBandwidthUpgradeStarted(
     const std::string &endpoint_id, Medium from_medium, Medium to_medium,
     ConnectionAttemptDirection direction, const std::string &connection_token) {
+  // The upgrade is traced whether or not analytics are recorded for it.
+  TraceRecorder::GetInstance().BeginSpan(kTraceBandwidthUpgrade, endpoint_id);
   MutexLock lock(&mutex_);
   if (!CanRecordAnalyticsLocked("OnBandwidthUpgradeStarted")) {
     return;
@@ -638,6 +641,7 @@ void AnalyticsRecorder::OnBandwidthUpgradeStarted(
 void AnalyticsRecorder::OnBandwidthUpgradeError(
     const std::string &endpoint_id, BandwidthUpgradeResult result,
     BandwidthUpgradeErrorStage error_stage) {
+  TraceRecorder::GetInstance().EndSpan(kTraceBandwidthUpgrade, endpoint_id);
   MutexLock lock(&mutex_);
   if (!CanRecordAnalyticsLocked("OnBandwidthUpgradeError")) {
     return;
@@ -647,6 +651,7 @@ void AnalyticsRecorder::OnBandwidthUpgradeError(
 
 void AnalyticsRecorder::OnBandwidthUpgradeSuccess(
     const std::string &endpoint_id) {
+  TraceRecorder::GetInstance().EndSpan(kTraceBandwidthUpgrade, endpoint_id);
   MutexLock lock(&mutex_);
   if (!CanRecordAnalyticsLocked("OnBandwidthUpgradeSuccess")) {
     return;
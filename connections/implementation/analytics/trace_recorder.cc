@@ -0,0 +1,185 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/implementation/analytics/trace_recorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/file.h"
+#include "internal/platform/logging.h"
+#include "internal/platform/mutex_lock.h"
+
+namespace nearby {
+namespace analytics {
+
+namespace {
+
+constexpr std::size_t kMaxEndpointIdLength = sizeof(std::uint64_t);
+
+// Threads are numbered in the order they record their first event, which
+// keeps the rows of the trace viewer short.
+std::uint64_t GetTraceThreadId() {
+  static std::atomic<std::uint64_t> next_thread_id{1};
+  thread_local const std::uint64_t thread_id =
+      next_thread_id.fetch_add(1, std::memory_order_relaxed);
+  return thread_id;
+}
+
+// Packs an endpoint id into a word, so that a slot can be written with atomic
+// stores only.
+std::uint64_t PackEndpointId(absl::string_view endpoint_id) {
+  std::uint64_t packed = 0;
+  std::size_t length = std::min(endpoint_id.size(), kMaxEndpointIdLength);
+  for (std::size_t i = 0; i < length; ++i) {
+    unsigned char c = endpoint_id[i];
+    // Endpoint ids are alphanumeric; anything else would need JSON escaping.
+    if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') c = '?';
+    packed |= static_cast<std::uint64_t>(c) << (8 * i);
+  }
+  return packed;
+}
+
+std::string UnpackEndpointId(std::uint64_t packed) {
+  std::string endpoint_id;
+  for (; packed != 0; packed >>= 8) {
+    endpoint_id.push_back(static_cast<char>(packed & 0xff));
+  }
+  return endpoint_id;
+}
+
+}  // namespace
+
+TraceRecorder& TraceRecorder::GetInstance() {
+  static std::aligned_storage_t<sizeof(TraceRecorder), alignof(TraceRecorder)>
+      storage;
+  static TraceRecorder* recorder = new (&storage) TraceRecorder();
+  return *recorder;
+}
+
+void TraceRecorder::Start() {
+  MutexLock lock(&mutex_);
+  if (slots_ == nullptr) {
+    slots_ = std::make_unique<Slot[]>(kCapacity);
+  }
+  first_index_.store(next_index_.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+  enabled_.store(true, std::memory_order_release);
+}
+
+void TraceRecorder::Stop() {
+  MutexLock lock(&mutex_);
+  enabled_.store(false, std::memory_order_release);
+}
+
+void TraceRecorder::Record(const char* name, bool begin,
+                           absl::string_view endpoint_id,
+                           std::int64_t payload_id) {
+  std::uint64_t index = next_index_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[index % kCapacity];
+  // A seqlock: readers skip the slot until its sequence is published again.
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.begin.store(begin, std::memory_order_relaxed);
+  slot.timestamp_micros.store(absl::ToUnixMicros(absl::Now()),
+                              std::memory_order_relaxed);
+  slot.thread_id.store(GetTraceThreadId(), std::memory_order_relaxed);
+  slot.endpoint_id.store(PackEndpointId(endpoint_id),
+                         std::memory_order_relaxed);
+  slot.payload_id.store(payload_id, std::memory_order_relaxed);
+  slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> TraceRecorder::GetEvents() const {
+  const Slot* slots;
+  {
+    MutexLock lock(&mutex_);
+    slots = slots_.get();
+  }
+  std::vector<TraceEvent> events;
+  if (slots == nullptr) return events;
+
+  std::uint64_t end = next_index_.load(std::memory_order_acquire);
+  std::uint64_t begin = first_index_.load(std::memory_order_relaxed);
+  if (end - begin > kCapacity) begin = end - kCapacity;
+  events.reserve(end - begin);
+  for (std::uint64_t index = begin; index < end; ++index) {
+    const Slot& slot = slots[index % kCapacity];
+    if (slot.sequence.load(std::memory_order_acquire) != index + 1) continue;
+    TraceEvent event;
+    event.name = slot.name.load(std::memory_order_relaxed);
+    event.begin = slot.begin.load(std::memory_order_relaxed);
+    event.timestamp = absl::FromUnixMicros(
+        slot.timestamp_micros.load(std::memory_order_relaxed));
+    event.thread_id = slot.thread_id.load(std::memory_order_relaxed);
+    std::uint64_t packed_endpoint_id =
+        slot.endpoint_id.load(std::memory_order_relaxed);
+    event.payload_id = slot.payload_id.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // The slot was overwritten while it was read.
+    if (slot.sequence.load(std::memory_order_relaxed) != index + 1) continue;
+    event.endpoint_id = UnpackEndpointId(packed_endpoint_id);
+    events.push_back(std::move(event));
+  }
+  return events;
+}
+
+std::string TraceRecorder::ToChromeTraceJson() const {
+  // Spans are async events, which may begin and end on different threads. The
+  // viewer pairs them by category, name and id.
+  std::string json = "{\"traceEvents\":[";
+  bool first = true;
+  for (const TraceEvent& event : GetEvents()) {
+    if (!first) json.push_back(',');
+    first = false;
+    absl::StrAppend(
+        &json, "{\"name\":\"", event.name, "\",\"cat\":\"nearby\",\"ph\":\"",
+        event.begin ? "b" : "e", "\",\"id\":\"", event.endpoint_id, "/",
+        event.payload_id, "\",\"ts\":", absl::ToUnixMicros(event.timestamp),
+        ",\"pid\":1,\"tid\":", event.thread_id,
+        ",\"args\":{\"endpoint_id\":\"", event.endpoint_id,
+        "\",\"payload_id\":", event.payload_id, "}}");
+  }
+  json.append("]}");
+  return json;
+}
+
+Exception TraceRecorder::WriteChromeTrace(const std::string& path) const {
+  OutputFile file(path);
+  Exception exception = file.Write(ByteArray(ToChromeTraceJson()));
+  if (exception.Raised()) {
+    NEARBY_LOGS(WARNING) << "TraceRecorder: failed to write the trace to "
+                         << path;
+    file.Close();
+    return exception;
+  }
+  return file.Close();
+}
+
+}  // namespace analytics
+}  // namespace nearby
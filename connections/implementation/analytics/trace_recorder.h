@@ -0,0 +1,161 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NEARBY_CONNECTIONS_IMPLEMENTATION_ANALYTICS_TRACE_RECORDER_H_
+#define NEARBY_CONNECTIONS_IMPLEMENTATION_ANALYTICS_TRACE_RECORDER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/mutex.h"
+
+namespace nearby {
+namespace analytics {
+
+// The traced phases of a session.
+inline constexpr char kTraceDiscovery[] = "Discovery";
+inline constexpr char kTraceRequestConnection[] = "RequestConnection";
+inline constexpr char kTraceUkey2Handshake[] = "Ukey2Handshake";
+inline constexpr char kTraceAcceptConnection[] = "AcceptConnection";
+inline constexpr char kTraceBandwidthUpgrade[] = "BandwidthUpgrade";
+inline constexpr char kTracePayloadFirstChunk[] = "PayloadFirstChunk";
+inline constexpr char kTracePayloadLastAck[] = "PayloadLastAck";
+
+struct TraceEvent {
+  // One of the kTrace* names.
+  const char* name = nullptr;
+  bool begin = false;
+  absl::Time timestamp;
+  std::uint64_t thread_id = 0;
+  std::string endpoint_id;
+  std::int64_t payload_id = 0;
+};
+
+// Records the beginning and the end of the phases of connections and payload
+// transfers, to see where the time of a session goes.
+//
+// Events go to a fixed-size ring buffer that writers claim slots of without
+// locking; once it is full, the oldest events are overwritten. While tracing
+// is stopped, recording an event costs a single atomic load.
+//
+// A span is identified by its name, endpoint id and payload id, so its
+// beginning and end may be recorded on different threads. Trace viewers ignore
+// an end without a beginning, so a span may be ended on every path that
+// finishes its phase.
+class TraceRecorder {
+ public:
+  static constexpr std::size_t kCapacity = 16 * 1024;
+
+  TraceRecorder(const TraceRecorder&) = delete;
+  TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+  static TraceRecorder& GetInstance();
+
+  // Drops the recorded events and starts recording.
+  void Start() ABSL_LOCKS_EXCLUDED(mutex_);
+  void Stop() ABSL_LOCKS_EXCLUDED(mutex_);
+  bool IsEnabled() const {
+    return enabled_.load(std::memory_order_acquire);
+  }
+
+  // `name` must be one of the kTrace* names, or otherwise outlive the
+  // recorder. Only the first 8 characters of `endpoint_id` are kept.
+  void BeginSpan(const char* name, absl::string_view endpoint_id,
+                 std::int64_t payload_id = 0) {
+    if (IsEnabled()) Record(name, /*begin=*/true, endpoint_id, payload_id);
+  }
+  void EndSpan(const char* name, absl::string_view endpoint_id,
+               std::int64_t payload_id = 0) {
+    if (IsEnabled()) Record(name, /*begin=*/false, endpoint_id, payload_id);
+  }
+
+  // Returns the recorded events, oldest first. Events that are being written
+  // concurrently are left out.
+  std::vector<TraceEvent> GetEvents() const;
+
+  // Returns the recorded events in the Chrome trace event format, which
+  // chrome://tracing and Perfetto open.
+  std::string ToChromeTraceJson() const;
+  Exception WriteChromeTrace(const std::string& path) const;
+
+ private:
+  struct Slot {
+    // The index of the event in the slot plus one, or 0 while it is written.
+    std::atomic<std::uint64_t> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<bool> begin{false};
+    std::atomic<std::int64_t> timestamp_micros{0};
+    std::atomic<std::uint64_t> thread_id{0};
+    std::atomic<std::uint64_t> endpoint_id{0};
+    std::atomic<std::int64_t> payload_id{0};
+  };
+
+  // This is a singleton object, for which destructor will never be called.
+  TraceRecorder() = default;
+  ~TraceRecorder() = default;
+
+  void Record(const char* name, bool begin, absl::string_view endpoint_id,
+              std::int64_t payload_id);
+
+  mutable Mutex mutex_;
+  std::atomic<bool> enabled_{false};
+  // Allocated by the first Start(), and never freed.
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<std::uint64_t> next_index_{0};
+  // The index of the first event recorded since Start().
+  std::atomic<std::uint64_t> first_index_{0};
+};
+
+// Records a span for the scope of the object, or until End() is called. A span
+// that began while tracing was stopped doesn't end either.
+class TraceSpan {
+ public:
+  TraceSpan(const char* name, absl::string_view endpoint_id,
+            std::int64_t payload_id = 0)
+      : name_(name),
+        payload_id_(payload_id),
+        recording_(TraceRecorder::GetInstance().IsEnabled()) {
+    if (!recording_) return;
+    endpoint_id_ = std::string(endpoint_id);
+    TraceRecorder::GetInstance().BeginSpan(name_, endpoint_id_, payload_id_);
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+  ~TraceSpan() { End(); }
+
+  void End() {
+    if (!recording_) return;
+    recording_ = false;
+    TraceRecorder::GetInstance().EndSpan(name_, endpoint_id_, payload_id_);
+  }
+
+ private:
+  const char* const name_;
+  std::string endpoint_id_;
+  const std::int64_t payload_id_;
+  bool recording_;
+};
+
+}  // namespace analytics
+}  // namespace nearby
+
+#endif  // NEARBY_CONNECTIONS_IMPLEMENTATION_ANALYTICS_TRACE_RECORDER_H_
@@ -0,0 +1,152 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/implementation/analytics/trace_recorder.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace nearby {
+namespace analytics {
+namespace {
+
+constexpr char kEndpointId[] = "ABCD";
+constexpr std::int64_t kPayloadId = 1234;
+
+class TraceRecorderTest : public testing::Test {
+ protected:
+  TraceRecorderTest() { recorder_.Start(); }
+  ~TraceRecorderTest() override { recorder_.Stop(); }
+
+  TraceRecorder& recorder_ = TraceRecorder::GetInstance();
+};
+
+TEST_F(TraceRecorderTest, RecordsSpansInOrder) {
+  recorder_.BeginSpan(kTraceRequestConnection, kEndpointId);
+  recorder_.BeginSpan(kTraceUkey2Handshake, kEndpointId);
+  recorder_.EndSpan(kTraceUkey2Handshake, kEndpointId);
+  recorder_.EndSpan(kTraceRequestConnection, kEndpointId);
+  recorder_.BeginSpan(kTracePayloadFirstChunk, kEndpointId, kPayloadId);
+
+  std::vector<TraceEvent> events = recorder_.GetEvents();
+
+  ASSERT_EQ(events.size(), 5);
+  EXPECT_EQ(events[0].name, kTraceRequestConnection);
+  EXPECT_TRUE(events[0].begin);
+  EXPECT_EQ(events[1].name, kTraceUkey2Handshake);
+  EXPECT_TRUE(events[1].begin);
+  EXPECT_EQ(events[2].name, kTraceUkey2Handshake);
+  EXPECT_FALSE(events[2].begin);
+  EXPECT_EQ(events[3].name, kTraceRequestConnection);
+  EXPECT_FALSE(events[3].begin);
+  EXPECT_EQ(events[4].name, kTracePayloadFirstChunk);
+  EXPECT_EQ(events[4].endpoint_id, kEndpointId);
+  EXPECT_EQ(events[4].payload_id, kPayloadId);
+  EXPECT_LE(events[0].timestamp, events[4].timestamp);
+}
+
+TEST_F(TraceRecorderTest, RecordsNothingWhileStopped) {
+  recorder_.Stop();
+  recorder_.BeginSpan(kTraceDiscovery, kEndpointId);
+  { TraceSpan span(kTraceRequestConnection, kEndpointId); }
+
+  EXPECT_FALSE(recorder_.IsEnabled());
+  EXPECT_TRUE(recorder_.GetEvents().empty());
+}
+
+TEST_F(TraceRecorderTest, StartDropsEarlierEvents) {
+  recorder_.BeginSpan(kTraceDiscovery, kEndpointId);
+
+  recorder_.Start();
+  recorder_.EndSpan(kTraceDiscovery, kEndpointId);
+
+  std::vector<TraceEvent> events = recorder_.GetEvents();
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_FALSE(events[0].begin);
+}
+
+TEST_F(TraceRecorderTest, KeepsNewestEventsWhenFull) {
+  for (std::int64_t i = 0; i < TraceRecorder::kCapacity + 10; ++i) {
+    recorder_.BeginSpan(kTracePayloadFirstChunk, kEndpointId, i);
+  }
+
+  std::vector<TraceEvent> events = recorder_.GetEvents();
+
+  ASSERT_EQ(events.size(), TraceRecorder::kCapacity);
+  EXPECT_EQ(events.front().payload_id, 10);
+  EXPECT_EQ(events.back().payload_id, TraceRecorder::kCapacity + 9);
+}
+
+TEST_F(TraceRecorderTest, TraceSpanEndsOnce) {
+  {
+    TraceSpan span(kTraceUkey2Handshake, kEndpointId);
+    span.End();
+  }
+
+  std::vector<TraceEvent> events = recorder_.GetEvents();
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_TRUE(events[0].begin);
+  EXPECT_FALSE(events[1].begin);
+  EXPECT_EQ(events[1].endpoint_id, kEndpointId);
+}
+
+TEST_F(TraceRecorderTest, RecordsFromManyThreads) {
+  constexpr int kThreads = 8;
+  constexpr int kSpansPerThread = 100;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([i]() {
+      for (int j = 0; j < kSpansPerThread; ++j) {
+        TraceSpan span(kTracePayloadFirstChunk, kEndpointId,
+                       i * kSpansPerThread + j);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  std::vector<TraceEvent> events = recorder_.GetEvents();
+
+  ASSERT_EQ(events.size(), 2 * kThreads * kSpansPerThread);
+  std::vector<int> begins(kThreads * kSpansPerThread, 0);
+  for (const TraceEvent& event : events) {
+    ASSERT_GE(event.payload_id, 0);
+    ASSERT_LT(event.payload_id, begins.size());
+    // Each span begins before it ends.
+    begins[event.payload_id] += event.begin ? 1 : -1;
+    EXPECT_GE(begins[event.payload_id], 0);
+  }
+}
+
+TEST_F(TraceRecorderTest, ExportsChromeTrace) {
+  recorder_.BeginSpan(kTraceBandwidthUpgrade, kEndpointId);
+  recorder_.EndSpan(kTraceBandwidthUpgrade, kEndpointId);
+
+  std::string json = recorder_.ToChromeTraceJson();
+
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[{\"name\":\"BandwidthUpgrade\"", 0),
+            0);
+  EXPECT_NE(json.find("\"ph\":\"b\",\"id\":\"ABCD/0\""), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"e\",\"id\":\"ABCD/0\""), std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"endpoint_id\":\"ABCD\",\"payload_id\":0}"),
+            std::string::npos);
+  EXPECT_EQ(json.substr(json.size() - 3), "}]}");
+}
+
+}  // namespace
+}  // namespace analytics
+}  // namespace nearby
@@ -19,6 +19,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -210,13 +211,34 @@ Exception BaseEndpointChannel::Write(const ByteArray& data) {
 
 Exception BaseEndpointChannel::Write(const ByteArray& data,
                                      PacketMetaData& packet_meta_data) {
+  pending_writes_.fetch_add(1);
   {
     MutexLock pause_lock(&is_paused_mutex_);
     if (is_paused_) {
       BlockUntilUnpaused();
     }
   }
+  Exception exception = WriteFrame(data, packet_meta_data);
+  pending_writes_.fetch_sub(1);
+  return exception;
+}
+
+std::optional<Exception> BaseEndpointChannel::TryWrite(const ByteArray& data) {
+  if (IsPaused()) {
+    return std::nullopt;
+  }
+  int idle = 0;
+  if (!pending_writes_.compare_exchange_strong(idle, 1)) {
+    return std::nullopt;
+  }
+  PacketMetaData packet_meta_data;
+  Exception exception = WriteFrame(data, packet_meta_data);
+  pending_writes_.fetch_sub(1);
+  return exception;
+}
 
+Exception BaseEndpointChannel::WriteFrame(const ByteArray& data,
+                                          PacketMetaData& packet_meta_data) {
   ByteArray encrypted_data;
   const ByteArray* data_to_write = &data;
   {
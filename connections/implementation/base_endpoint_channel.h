@@ -15,7 +15,9 @@
 #ifndef CORE_INTERNAL_BASE_ENDPOINT_CHANNEL_H_
 #define CORE_INTERNAL_BASE_ENDPOINT_CHANNEL_H_
 
+#include <atomic>
 #include <memory>
+#include <optional>
 #include <string>
 
 #include "absl/base/thread_annotations.h"
@@ -56,6 +58,9 @@ class BaseEndpointChannel : public EndpointChannel {
   Exception Write(const ByteArray& data) override;
   Exception Write(const ByteArray& data, PacketMetaData& packet_meta_data)
       ABSL_LOCKS_EXCLUDED(writer_mutex_, crypto_mutex_) override;
+  std::optional<Exception> TryWrite(const ByteArray& data)
+      ABSL_LOCKS_EXCLUDED(is_paused_mutex_, writer_mutex_,
+                          crypto_mutex_) override;
   void Close() ABSL_LOCKS_EXCLUDED(is_paused_mutex_) override;
   void Close(location::nearby::proto::connections::DisconnectionReason reason)
       override;
@@ -99,6 +104,10 @@ class BaseEndpointChannel : public EndpointChannel {
   // Gets the default maximum transmit unit/packet size.
   int GetDefaultMaxTransmitPacketSize() const;
 
+  // Writes a single frame, without waiting for the channel to be resumed.
+  Exception WriteFrame(const ByteArray& data, PacketMetaData& packet_meta_data)
+      ABSL_LOCKS_EXCLUDED(writer_mutex_, crypto_mutex_);
+
   bool IsEncryptionEnabledLocked() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(crypto_mutex_);
   void UnblockPausedWriter() ABSL_EXCLUSIVE_LOCKS_REQUIRED(is_paused_mutex_);
@@ -129,6 +138,9 @@ class BaseEndpointChannel : public EndpointChannel {
   InputStream* reader_ ABSL_PT_GUARDED_BY(reader_mutex_);
 
   Mutex writer_mutex_;
+  // The number of Write() calls that are waiting for or holding
+  // |writer_mutex_|.
+  std::atomic<int> pending_writes_ = 0;
   OutputStream* writer_ ABSL_PT_GUARDED_BY(writer_mutex_);
 
   // An encryptor/decryptor. May be null.
@@ -17,6 +17,7 @@
 #include <cstddef>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -346,6 +347,25 @@ TEST(BaseEndpointChannelTest, EncryptedReadWriteCanNotBeIntercepted) {
   channel_b.Close(DisconnectionReason::REMOTE_DISCONNECTION);
 }
 
+TEST(BaseEndpointChannelTest, TryWriteSkipsPausedChannel) {
+  auto pipe_a = CreatePipe();  // channel_a writes to pipe_a, reads from pipe_b.
+  auto pipe_b = CreatePipe();  // channel_b writes to pipe_b, reads from pipe_a.
+  TestEndpointChannel channel_a(pipe_b.first.get(), pipe_a.second.get());
+  TestEndpointChannel channel_b(pipe_a.first.get(), pipe_b.second.get());
+  ByteArray skipped_message{"skipped message"};
+  ByteArray tx_message{"data message"};
+
+  channel_a.Pause();
+  EXPECT_FALSE(channel_a.TryWrite(skipped_message).has_value());
+  channel_a.Resume();
+  std::optional<Exception> write_exception = channel_a.TryWrite(tx_message);
+  ASSERT_TRUE(write_exception.has_value());
+  EXPECT_TRUE(write_exception->Ok());
+
+  ByteArray rx_message = std::move(channel_b.Read().result());
+  EXPECT_EQ(rx_message, tx_message);
+}
+
 TEST(BaseEndpointChannelTest, CanBesuspendedAndResumed) {
   // Setup test communication environment.
   auto pipe_a = CreatePipe();  // channel_a writes to pipe_a, reads from pipe_b.
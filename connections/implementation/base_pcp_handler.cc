@@ -35,6 +35,7 @@
 #include "connections/connection_options.h"
 #include "connections/discovery_options.h"
 #include "connections/implementation/analytics/connection_attempt_metadata_params.h"
+#include "connections/implementation/analytics/trace_recorder.h"
 #include "connections/implementation/bwu_manager.h"
 #include "connections/implementation/client_proxy.h"
 #include "connections/implementation/connections_authentication_transport.h"
@@ -810,6 +811,8 @@ Status BasePcpHandler::RequestConnection(
     ClientProxy* client, const std::string& endpoint_id,
     const ConnectionRequestInfo& info,
     const ConnectionOptions& connection_options) {
+  analytics::TraceSpan trace_span(analytics::kTraceRequestConnection,
+                                  endpoint_id);
   auto result = std::make_shared<Future<Status>>();
   RunOnPcpHandlerThread(
       "request-connection",
@@ -941,6 +944,8 @@ Status BasePcpHandler::RequestConnectionV3(
     const ConnectionOptions& connection_options) {
   auto result = std::make_shared<Future<Status>>();
   std::string endpoint_id = remote_device.GetEndpointId();
+  analytics::TraceSpan trace_span(analytics::kTraceRequestConnection,
+                                  endpoint_id);
   RunOnPcpHandlerThread(
       "request-connection-v3",
       [this, client, &info, connection_options, &remote_device,
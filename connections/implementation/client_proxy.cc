@@ -14,9 +14,11 @@
 
 #include "connections/implementation/client_proxy.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <ios>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <ostream>
@@ -36,6 +38,7 @@
 #include "connections/connection_options.h"
 #include "connections/discovery_options.h"
 #include "connections/implementation/analytics/analytics_recorder.h"
+#include "connections/implementation/analytics/trace_recorder.h"
 #include "connections/implementation/flags/nearby_connections_feature_flags.h"
 #include "connections/listeners.h"
 #include "connections/medium_selector.h"
@@ -149,15 +152,17 @@ const NearbyDevice* ClientProxy::GetLocalDevice() {
 }
 
 std::string ClientProxy::GetConnectionToken(const std::string& endpoint_id) {
-  ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.connection_token;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.connection_token;
   }
   return {};
 }
 
 std::optional<std::string> ClientProxy::GetBluetoothMacAddress(
     const std::string& endpoint_id) {
+  MutexLock lock(&endpoints_mutex_);
   auto item = bluetooth_mac_addresses_.find(endpoint_id);
   if (item != bluetooth_mac_addresses_.end()) return item->second;
   return std::nullopt;
@@ -165,6 +170,7 @@ std::optional<std::string> ClientProxy::GetBluetoothMacAddress(
 
 void ClientProxy::SetBluetoothMacAddress(
     const std::string& endpoint_id, const std::string& bluetooth_mac_address) {
+  MutexLock lock(&endpoints_mutex_);
   bluetooth_mac_addresses_[endpoint_id] = bluetooth_mac_address;
 }
 
@@ -200,11 +206,12 @@ std::string ClientProxy::GenerateLocalEndpointId() {
 }
 
 void ClientProxy::Reset() {
-  MutexLock lock(&mutex_);
-
+  // Each step takes the locks of its own domain. Holding `mutex_` across all
+  // of them would invert the lock order with discovery.
   StoppedAdvertising();
   StoppedDiscovery();
   RemoveAllEndpoints();
+  MutexLock lock(&mutex_);
   if (IsFeatureUseStableEndpointIdEnabled()) {
     ExitStableEndpointIdMode();
   } else {
@@ -311,6 +318,7 @@ std::string ClientProxy::GetListeningForIncomingConnectionsServiceId() const {
 }
 
 ConnectionListener ClientProxy::GetAdvertisingOrIncomingConnectionListener() {
+  MutexLock lock(&mutex_);
   if (IsListeningForIncomingConnections()) {
     ConnectionListener listener = {
         .initiated_cb =
@@ -364,41 +372,62 @@ void ClientProxy::StartedDiscovery(
     DiscoveryListener listener,
     absl::Span<location::nearby::proto::connections::Medium> mediums,
     const DiscoveryOptions& discovery_options) {
-  MutexLock lock(&mutex_);
+  MutexLock lock(&discovery_mutex_);
   discovery_info_ = DiscoveryInfo{service_id, std::move(listener)};
   discovery_options_ = discovery_options;
 
   const std::vector<location::nearby::proto::connections::Medium> medium_vector(
       mediums.begin(), mediums.end());
   analytics_recorder_->OnStartDiscovery(strategy, medium_vector, false, 0);
+  // Discovery isn't tied to a remote endpoint, so it's traced for the service.
+  // The local endpoint id isn't used, since reading it would generate one.
+  if (analytics::TraceRecorder::GetInstance().IsEnabled()) {
+    analytics::TraceRecorder::GetInstance().BeginSpan(
+        analytics::kTraceDiscovery, service_id);
+  }
 }
 
 void ClientProxy::StoppedDiscovery() {
-  MutexLock lock(&mutex_);
-
-  if (IsDiscovering()) {
-    discovered_endpoint_ids_.clear();
-    discovery_info_.Clear();
-    analytics_recorder_->OnStopDiscovery();
+  std::unique_ptr<CancelableAlarm> discovery_events_alarm;
+  {
+    MutexLock lock(&discovery_mutex_);
+
+    // The alarm is canceled once the lock is released: canceling waits for a
+    // running delivery, which needs the lock.
+    discovery_events_alarm = std::move(discovery_events_alarm_);
+    discovery_events_scheduled_ = false;
+    pending_discovery_events_.clear();
+    if (IsDiscovering()) {
+      discovered_endpoint_ids_.clear();
+      if (analytics::TraceRecorder::GetInstance().IsEnabled()) {
+        analytics::TraceRecorder::GetInstance().EndSpan(
+            analytics::kTraceDiscovery, discovery_info_.service_id);
+      }
+      discovery_info_.Clear();
+      analytics_recorder_->OnStopDiscovery();
+    }
+    // discovery_options_ is purposefully not cleared here.
+    OnSessionComplete();
+  }
+  if (discovery_events_alarm != nullptr) {
+    discovery_events_alarm->Cancel();
   }
-  // discovery_options_ is purposefully not cleared here.
-  OnSessionComplete();
 }
 
 bool ClientProxy::IsDiscoveringServiceId(const std::string& service_id) const {
-  MutexLock lock(&mutex_);
+  MutexLock lock(&discovery_mutex_);
 
   return IsDiscovering() && service_id == discovery_info_.service_id;
 }
 
 bool ClientProxy::IsDiscovering() const {
-  MutexLock lock(&mutex_);
+  MutexLock lock(&discovery_mutex_);
 
   return !discovery_info_.IsEmpty();
 }
 
 std::string ClientProxy::GetDiscoveryServiceId() const {
-  MutexLock lock(&mutex_);
+  MutexLock lock(&discovery_mutex_);
 
   return discovery_info_.service_id;
 }
@@ -407,7 +436,7 @@ void ClientProxy::OnEndpointFound(
     const std::string& service_id, const std::string& endpoint_id,
     const ByteArray& endpoint_info,
     location::nearby::proto::connections::Medium medium) {
-  MutexLock lock(&mutex_);
+  MutexLock lock(&discovery_mutex_);
 
   NEARBY_LOGS(INFO) << "ClientProxy [Endpoint Found]: [enter] id="
                     << endpoint_id << "; service=" << service_id
@@ -422,6 +451,12 @@ void ClientProxy::OnEndpointFound(
     return;
   }
 
+  if (discovery_options_.endpoint_events_coalescing_window >
+      absl::ZeroDuration()) {
+    CoalesceEndpointFound(endpoint_id, endpoint_info, medium);
+    return;
+  }
+
   if (discovered_endpoint_ids_.count(endpoint_id)) {
     NEARBY_LOGS(WARNING)
         << "ClientProxy [Endpoint Found]: Ignoring event for id=" << endpoint_id
@@ -429,15 +464,12 @@ void ClientProxy::OnEndpointFound(
     return;
   }
 
-  discovered_endpoint_ids_.insert(endpoint_id);
-  discovery_info_.listener.endpoint_found_cb(endpoint_id, endpoint_info,
-                                             service_id);
-  analytics_recorder_->OnEndpointFound(medium);
+  ReportEndpointFound(endpoint_id, endpoint_info, medium);
 }
 
 void ClientProxy::OnEndpointLost(const std::string& service_id,
                                  const std::string& endpoint_id) {
-  MutexLock lock(&mutex_);
+  MutexLock lock(&discovery_mutex_);
 
   NEARBY_LOGS(INFO) << "ClientProxy [Endpoint Lost]: [enter] id=" << endpoint_id
                     << "; service=" << service_id;
@@ -448,18 +480,117 @@ void ClientProxy::OnEndpointLost(const std::string& service_id,
     return;
   }
 
-  const auto it = discovered_endpoint_ids_.find(endpoint_id);
-  if (it == discovered_endpoint_ids_.end()) {
+  if (discovery_options_.endpoint_events_coalescing_window >
+      absl::ZeroDuration()) {
+    CoalesceEndpointLost(endpoint_id);
+    return;
+  }
+
+  if (!discovered_endpoint_ids_.contains(endpoint_id)) {
     NEARBY_LOGS(WARNING)
         << "ClientProxy [Endpoint Lost]: Ignoring event for id=" << endpoint_id
         << " because this client has not yet reported this endpoint as found";
     return;
   }
 
-  discovered_endpoint_ids_.erase(it);
+  ReportEndpointLost(endpoint_id);
+}
+
+void ClientProxy::ReportEndpointFound(
+    const std::string& endpoint_id, const ByteArray& endpoint_info,
+    location::nearby::proto::connections::Medium medium) {
+  discovered_endpoint_ids_.insert(endpoint_id);
+  discovery_info_.listener.endpoint_found_cb(endpoint_id, endpoint_info,
+                                             discovery_info_.service_id);
+  analytics_recorder_->OnEndpointFound(medium);
+}
+
+void ClientProxy::ReportEndpointLost(const std::string& endpoint_id) {
+  discovered_endpoint_ids_.erase(endpoint_id);
   discovery_info_.listener.endpoint_lost_cb(endpoint_id);
 }
 
+void ClientProxy::CoalesceEndpointFound(
+    const std::string& endpoint_id, const ByteArray& endpoint_info,
+    location::nearby::proto::connections::Medium medium) {
+  const auto it = pending_discovery_events_.find(endpoint_id);
+  if (it != pending_discovery_events_.end()) {
+    if (!it->second.found) {
+      // Lost and found again: the client still has the endpoint as found.
+      NEARBY_VLOG(1) << "ClientProxy [Endpoint Found]: Dropping flapping "
+                        "lost event for id="
+                     << endpoint_id;
+      pending_discovery_events_.erase(it);
+    }
+    return;
+  }
+  if (discovered_endpoint_ids_.contains(endpoint_id)) {
+    return;
+  }
+  AddPendingDiscoveryEvent(endpoint_id, {.found = true,
+                                         .endpoint_info = endpoint_info,
+                                         .medium = medium});
+}
+
+void ClientProxy::CoalesceEndpointLost(const std::string& endpoint_id) {
+  const auto it = pending_discovery_events_.find(endpoint_id);
+  if (it != pending_discovery_events_.end()) {
+    if (it->second.found) {
+      // Found and lost again: the client never heard of the endpoint.
+      NEARBY_VLOG(1) << "ClientProxy [Endpoint Lost]: Dropping flapping "
+                        "found event for id="
+                     << endpoint_id;
+      pending_discovery_events_.erase(it);
+    }
+    return;
+  }
+  if (!discovered_endpoint_ids_.contains(endpoint_id)) {
+    return;
+  }
+  AddPendingDiscoveryEvent(endpoint_id, {.found = false});
+}
+
+void ClientProxy::AddPendingDiscoveryEvent(const std::string& endpoint_id,
+                                           PendingDiscoveryEvent event) {
+  event.sequence = next_discovery_event_sequence_++;
+  pending_discovery_events_[endpoint_id] = std::move(event);
+  if (discovery_events_scheduled_) {
+    return;
+  }
+  discovery_events_scheduled_ = true;
+  discovery_events_alarm_ = std::make_unique<CancelableAlarm>(
+      "deliver_discovery_events",
+      [this]() {
+        MutexLock lock(&discovery_mutex_);
+        DeliverPendingDiscoveryEvents();
+      },
+      discovery_options_.endpoint_events_coalescing_window,
+      &single_thread_executor_);
+}
+
+void ClientProxy::DeliverPendingDiscoveryEvents() {
+  discovery_events_scheduled_ = false;
+  std::vector<std::pair<std::string, PendingDiscoveryEvent>> events(
+      std::make_move_iterator(pending_discovery_events_.begin()),
+      std::make_move_iterator(pending_discovery_events_.end()));
+  pending_discovery_events_.clear();
+  if (!IsDiscovering()) {
+    return;
+  }
+  std::sort(events.begin(), events.end(), [](const auto& a, const auto& b) {
+    return a.second.sequence < b.second.sequence;
+  });
+  NEARBY_LOGS(INFO) << "ClientProxy [Endpoint Events]: Delivering "
+                    << events.size() << " coalesced events";
+  for (const auto& [endpoint_id, event] : events) {
+    if (event.found) {
+      ReportEndpointFound(endpoint_id, event.endpoint_info, event.medium);
+    } else {
+      ReportEndpointLost(endpoint_id);
+    }
+  }
+}
+
 void ClientProxy::OnRequestConnection(
     const Strategy& strategy, const std::string& endpoint_id,
     const ConnectionOptions& connection_options) {
@@ -471,39 +602,47 @@ void ClientProxy::OnConnectionInitiated(
     const std::string& endpoint_id, const ConnectionResponseInfo& info,
     const ConnectionOptions& connection_options,
     const ConnectionListener& listener, const std::string& connection_token) {
-  MutexLock lock(&mutex_);
-
   // Whether this is incoming or outgoing, the local and remote endpoints both
   // still need to accept this connection, so set its establishment status to
   // PENDING.
-  auto result = connections_.emplace(
-      endpoint_id, std::make_pair(
-                       Connection{
-                           .is_incoming = info.is_incoming_connection,
-                           .connection_listener = listener,
-                           .connection_options = connection_options,
-                           .connection_token = connection_token,
-                       },
-                       PayloadListener{
-                           .payload_cb = [](absl::string_view, Payload) {},
-                           .payload_progress_cb = [](absl::string_view,
-                                                     PayloadProgressInfo) {},
-                       }));
-  // Instead of using structured binding which is nice, but banned
-  // (can not use c++17 features, until chromium does) we unpack manually.
-  auto& pair_iter = result.first;
-  bool inserted = result.second;
+  auto new_state = std::make_shared<EndpointState>();
+  new_state->connection = Connection{
+      .is_incoming = info.is_incoming_connection,
+      .connection_listener = listener,
+      .connection_options = connection_options,
+      .connection_token = connection_token,
+  };
+  new_state->payload_listener = PayloadListener{
+      .payload_cb = [](absl::string_view, Payload) {},
+      .payload_progress_cb = [](absl::string_view, PayloadProgressInfo) {},
+  };
+  // Hold the endpoint's lock until the client has been told about it, so no
+  // other callback for this endpoint can overtake initiated_cb.
+  MutexLock new_state_lock(&new_state->mutex);
+  std::shared_ptr<EndpointState> state;
+  bool inserted;
+  {
+    MutexLock lock(&endpoints_mutex_);
+    auto result = connections_.emplace(endpoint_id, new_state);
+    state = result.first->second;
+    inserted = result.second;
+  }
   NEARBY_LOGS(INFO)
       << "ClientProxy [Connection Initiated]: add Connection: client="
       << GetClientId() << "; endpoint_id=" << endpoint_id
       << "; inserted=" << inserted;
   DCHECK(inserted);
-  const ConnectionPair& item = pair_iter->second;
+  // Both sides accepting the connection is the next phase.
+  analytics::TraceRecorder::GetInstance().BeginSpan(
+      analytics::kTraceAcceptConnection, endpoint_id);
   // Notify the client.
   //
   // Note: we allow devices to connect to an advertiser even after it stops
   // advertising, so no need to check IsAdvertising() here.
-  item.first.connection_listener.initiated_cb(endpoint_id, info);
+  {
+    MutexLock lock(&state->mutex);
+    state->connection.connection_listener.initiated_cb(endpoint_id, info);
+  }
 
   if (info.is_incoming_connection) {
     // Add CancellationFlag for advertisers once encryption succeeds.
@@ -516,29 +655,40 @@ void ClientProxy::OnConnectionInitiated(
 
 void ClientProxy::OnConnectionAccepted(const std::string& endpoint_id) {
   NEARBY_LOGS(INFO) << "ClientProxy [ConnectionAccepted]: id=" << endpoint_id;
-  MutexLock lock(&mutex_);
-
-  if (!HasPendingConnectionToEndpoint(endpoint_id)) {
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state == nullptr) {
+    NEARBY_LOGS(INFO) << "ClientProxy [Connection Accepted]: no pending "
+                         "connection; endpoint_id="
+                      << endpoint_id;
+    return;
+  }
+  MutexLock lock(&state->mutex);
+  if (state->status.load() == Connection::kConnected) {
     NEARBY_LOGS(INFO) << "ClientProxy [Connection Accepted]: no pending "
                          "connection; endpoint_id="
                       << endpoint_id;
     return;
   }
 
+  analytics::TraceRecorder::GetInstance().EndSpan(
+      analytics::kTraceAcceptConnection, endpoint_id);
   // Notify the client.
-  ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->first.connection_listener.accepted_cb(endpoint_id);
-    item->first.status = Connection::kConnected;
-  }
+  state->connection.connection_listener.accepted_cb(endpoint_id);
+  state->status.store(Connection::kConnected);
 }
 
 void ClientProxy::OnConnectionRejected(const std::string& endpoint_id,
                                        const Status& status) {
   NEARBY_LOGS(INFO) << "ClientProxy [ConnectionRejected]: id=" << endpoint_id;
-  MutexLock lock(&mutex_);
-
-  if (!HasPendingConnectionToEndpoint(endpoint_id)) {
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state == nullptr) {
+    NEARBY_LOGS(INFO) << "ClientProxy [Connection Rejected]: no pending "
+                         "connection; endpoint_id="
+                      << endpoint_id;
+    return;
+  }
+  MutexLock lock(&state->mutex);
+  if (state->status.load() == Connection::kConnected) {
     NEARBY_LOGS(INFO) << "ClientProxy [Connection Rejected]: no pending "
                          "connection; endpoint_id="
                       << endpoint_id;
@@ -546,22 +696,18 @@ void ClientProxy::OnConnectionRejected(const std::string& endpoint_id,
   }
 
   // Notify the client.
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->first.connection_listener.rejected_cb(endpoint_id, status);
-    OnDisconnected(endpoint_id, false /* notify */);
-  }
+  state->connection.connection_listener.rejected_cb(endpoint_id, status);
+  OnDisconnected(endpoint_id, false /* notify */);
 }
 
 void ClientProxy::OnBandwidthChanged(const std::string& endpoint_id,
                                      Medium new_medium) {
   NEARBY_LOGS(INFO) << "ClientProxy [BandwidthChanged]: id=" << endpoint_id;
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->first.connection_listener.bandwidth_changed_cb(endpoint_id,
-                                                         new_medium);
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    state->connection.connection_listener.bandwidth_changed_cb(endpoint_id,
+                                                               new_medium);
     NEARBY_LOGS(INFO) << "ClientProxy [reporting onBandwidthChanged]: client="
                       << GetClientId() << "; endpoint_id=" << endpoint_id;
   }
@@ -569,20 +715,37 @@ void ClientProxy::OnBandwidthChanged(const std::string& endpoint_id,
 
 void ClientProxy::OnDisconnected(const std::string& endpoint_id, bool notify) {
   NEARBY_LOGS(INFO) << "ClientProxy [OnDisconnected]: id=" << endpoint_id;
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    // Progress collected before the disconnection is reported before it.
+    FlushPendingProgress(endpoint_id, *state);
     if (notify) {
-      item->first.connection_listener.disconnected_cb({endpoint_id});
+      state->connection.connection_listener.disconnected_cb({endpoint_id});
+    }
+    // A connection that was rejected, or lost before it was accepted.
+    if (state->status.load() != Connection::kConnected) {
+      analytics::TraceRecorder::GetInstance().EndSpan(
+          analytics::kTraceAcceptConnection, endpoint_id);
+    }
+    // Callbacks that already hold a reference to `state` must not report
+    // anything for this endpoint once it has been removed.
+    state->status.store(Connection::kPending);
+    {
+      MutexLock endpoints_lock(&endpoints_mutex_);
+      auto item = connections_.find(endpoint_id);
+      if (item != connections_.end() && item->second == state) {
+        connections_.erase(item);
+      }
     }
-    connections_.erase(endpoint_id);
     OnSessionComplete();
   }
 
   CancelEndpoint(endpoint_id);
+  memory_accountant_->RemoveEndpoint(endpoint_id);
 
   if (IsFeatureUseStableEndpointIdEnabled()) {
+    MutexLock lock(&mutex_);
     if (!stable_endpoint_id_mode_ && !HasOngoingConnection()) {
       ScheduleClearCachedEndpointIdAlarm();
     }
@@ -591,62 +754,55 @@ void ClientProxy::OnDisconnected(const std::string& endpoint_id, bool notify) {
 
 bool ClientProxy::ConnectionStatusMatches(const std::string& endpoint_id,
                                           Connection::Status status) const {
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.status == status;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    return state->status.load() == status;
   }
   return false;
 }
 
 BooleanMediumSelector ClientProxy::GetUpgradeMediums(
     const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.connection_options.allowed;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.connection_options.allowed;
   }
   return {};
 }
 
 bool ClientProxy::Is5GHzSupported(const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.connection_options.connection_info.supports_5_ghz;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.connection_options.connection_info.supports_5_ghz;
   }
   return false;
 }
 
 std::string ClientProxy::GetBssid(const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.connection_options.connection_info.bssid;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.connection_options.connection_info.bssid;
   }
   return {};
 }
 
 std::int32_t ClientProxy::GetApFrequency(const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.connection_options.connection_info.ap_frequency;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.connection_options.connection_info.ap_frequency;
   }
   return -1;
 }
 
 std::string ClientProxy::GetIPAddress(const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.connection_options.connection_info.ip_address;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.connection_options.connection_info.ip_address;
   }
   return {};
 }
@@ -656,15 +812,15 @@ bool ClientProxy::IsConnectedToEndpoint(const std::string& endpoint_id) const {
 }
 
 std::vector<std::string> ClientProxy::GetMatchingEndpoints(
-    absl::AnyInvocable<bool(const Connection&)> pred) const {
-  MutexLock lock(&mutex_);
+    absl::AnyInvocable<bool(const EndpointState&)> pred) const {
+  MutexLock lock(&endpoints_mutex_);
 
   std::vector<std::string> connected_endpoints;
 
   for (const auto& pair : connections_) {
     const auto& endpoint_id = pair.first;
-    const auto& connection_pair = pair.second;
-    if (pred(connection_pair.first)) {
+    const auto& state = pair.second;
+    if (pred(*state)) {
       connected_endpoints.push_back(endpoint_id);
     }
   }
@@ -672,71 +828,65 @@ std::vector<std::string> ClientProxy::GetMatchingEndpoints(
 }
 
 std::vector<std::string> ClientProxy::GetPendingConnectedEndpoints() const {
-  return GetMatchingEndpoints([](const Connection& connection) {
-    return connection.status != Connection::kConnected;
+  return GetMatchingEndpoints([](const EndpointState& state) {
+    return state.status.load() != Connection::kConnected;
   });
 }
 
 std::vector<std::string> ClientProxy::GetConnectedEndpoints() const {
-  return GetMatchingEndpoints([](const Connection& connection) {
-    return connection.status == Connection::kConnected;
+  return GetMatchingEndpoints([](const EndpointState& state) {
+    return state.status.load() == Connection::kConnected;
   });
 }
 
 bool ClientProxy::HasOngoingConnection() const {
-  return !GetPendingConnectedEndpoints().empty() ||
-         !GetConnectedEndpoints().empty();
+  MutexLock lock(&endpoints_mutex_);
+  return !connections_.empty();
 }
 
 std::int32_t ClientProxy::GetNumOutgoingConnections() const {
-  return GetMatchingEndpoints([](const Connection& connection) {
-           return connection.status == Connection::kConnected &&
-                  !connection.is_incoming;
+  return GetMatchingEndpoints([](const EndpointState& state) {
+           return state.status.load() == Connection::kConnected &&
+                  !state.connection.is_incoming;
          })
       .size();
 }
 
 std::int32_t ClientProxy::GetNumIncomingConnections() const {
-  return GetMatchingEndpoints([](const Connection& connection) {
-           return connection.status == Connection::kConnected &&
-                  connection.is_incoming;
+  return GetMatchingEndpoints([](const EndpointState& state) {
+           return state.status.load() == Connection::kConnected &&
+                  state.connection.is_incoming;
          })
       .size();
 }
 
 bool ClientProxy::IsIncomingConnection(const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr && item->first.status == Connection::kConnected) {
-    return item->first.is_incoming;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr && state->status.load() == Connection::kConnected) {
+    return state->connection.is_incoming;
   }
   return false;
 }
 
 bool ClientProxy::IsOutgoingConnection(const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr && item->first.status == Connection::kConnected) {
-    return !item->first.is_incoming;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr && state->status.load() == Connection::kConnected) {
+    return !state->connection.is_incoming;
   }
   return false;
 }
 
 bool ClientProxy::HasPendingConnectionToEndpoint(
     const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.status != Connection::kConnected;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    return state->status.load() != Connection::kConnected;
   }
   return false;
 }
 
 bool ClientProxy::HasLocalEndpointResponded(
     const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
   return ConnectionStatusesContains(
       endpoint_id,
       static_cast<Connection::Status>(Connection::kLocalEndpointAccepted |
@@ -745,8 +895,6 @@ bool ClientProxy::HasLocalEndpointResponded(
 
 bool ClientProxy::HasRemoteEndpointResponded(
     const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
   return ConnectionStatusesContains(
       endpoint_id,
       static_cast<Connection::Status>(Connection::kRemoteEndpointAccepted |
@@ -755,70 +903,71 @@ bool ClientProxy::HasRemoteEndpointResponded(
 
 void ClientProxy::LocalEndpointAcceptedConnection(
     const std::string& endpoint_id, PayloadListener listener) {
-  MutexLock lock(&mutex_);
-  if (HasLocalEndpointResponded(endpoint_id)) {
-    NEARBY_LOGS(INFO)
-        << "ClientProxy [Local Accepted]: local endpoint has responded; id="
-        << endpoint_id;
-    return;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    if (HasLocalEndpointResponded(endpoint_id)) {
+      NEARBY_LOGS(INFO)
+          << "ClientProxy [Local Accepted]: local endpoint has responded; id="
+          << endpoint_id;
+      return;
+    }
+    AppendConnectionStatus(*state, Connection::kLocalEndpointAccepted);
+    state->payload_listener = std::move(listener);
   }
-  AppendConnectionStatus(endpoint_id, Connection::kLocalEndpointAccepted);
   NEARBY_LOGS(INFO) << "ClientProxy [Local Accepted]: id=" << endpoint_id;
-  ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->second = std::move(listener);
-  }
   analytics_recorder_->OnLocalEndpointAccepted(endpoint_id);
 }
 
 void ClientProxy::LocalEndpointRejectedConnection(
     const std::string& endpoint_id) {
-  MutexLock lock(&mutex_);
-
-  if (HasLocalEndpointResponded(endpoint_id)) {
-    NEARBY_LOGS(INFO)
-        << "ClientProxy [Local Rejected]: local endpoint has responded; id="
-        << endpoint_id;
-    return;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    if (HasLocalEndpointResponded(endpoint_id)) {
+      NEARBY_LOGS(INFO)
+          << "ClientProxy [Local Rejected]: local endpoint has responded; id="
+          << endpoint_id;
+      return;
+    }
+    AppendConnectionStatus(*state, Connection::kLocalEndpointRejected);
   }
-
-  AppendConnectionStatus(endpoint_id, Connection::kLocalEndpointRejected);
   analytics_recorder_->OnLocalEndpointRejected(endpoint_id);
 }
 
 void ClientProxy::RemoteEndpointAcceptedConnection(
     const std::string& endpoint_id) {
-  MutexLock lock(&mutex_);
-
-  if (HasRemoteEndpointResponded(endpoint_id)) {
-    NEARBY_LOGS(INFO)
-        << "ClientProxy [Remote Accepted]: remote endpoint has responded; id="
-        << endpoint_id;
-    return;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    if (HasRemoteEndpointResponded(endpoint_id)) {
+      NEARBY_LOGS(INFO)
+          << "ClientProxy [Remote Accepted]: remote endpoint has responded; id="
+          << endpoint_id;
+      return;
+    }
+    AppendConnectionStatus(*state, Connection::kRemoteEndpointAccepted);
   }
-
-  AppendConnectionStatus(endpoint_id, Connection::kRemoteEndpointAccepted);
   analytics_recorder_->OnRemoteEndpointAccepted(endpoint_id);
 }
 
 void ClientProxy::RemoteEndpointRejectedConnection(
     const std::string& endpoint_id) {
-  MutexLock lock(&mutex_);
-
-  if (HasRemoteEndpointResponded(endpoint_id)) {
-    NEARBY_LOGS(INFO)
-        << "ClientProxy [Remote Rejected]: remote endpoint has responded; id="
-        << endpoint_id;
-    return;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    if (HasRemoteEndpointResponded(endpoint_id)) {
+      NEARBY_LOGS(INFO)
+          << "ClientProxy [Remote Rejected]: remote endpoint has responded; id="
+          << endpoint_id;
+      return;
+    }
+    AppendConnectionStatus(*state, Connection::kRemoteEndpointRejected);
   }
-
-  AppendConnectionStatus(endpoint_id, Connection::kRemoteEndpointRejected);
   analytics_recorder_->OnRemoteEndpointRejected(endpoint_id);
 }
 
 bool ClientProxy::IsConnectionAccepted(const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
   return ConnectionStatusesContains(endpoint_id,
                                     Connection::kLocalEndpointAccepted) &&
          ConnectionStatusesContains(endpoint_id,
@@ -826,8 +975,6 @@ bool ClientProxy::IsConnectionAccepted(const std::string& endpoint_id) const {
 }
 
 bool ClientProxy::IsConnectionRejected(const std::string& endpoint_id) const {
-  MutexLock lock(&mutex_);
-
   return ConnectionStatusesContains(
       endpoint_id,
       static_cast<Connection::Status>(Connection::kLocalEndpointRejected |
@@ -879,6 +1026,7 @@ void ClientProxy::AddCancellationFlag(const std::string& endpoint_id) {
     return;
   }
 
+  MutexLock lock(&endpoints_mutex_);
   auto item = cancellation_flags_.find(endpoint_id);
   if (item != cancellation_flags_.end()) {
     // A new flag may be added to the map with the same endpoint, even if a
@@ -898,6 +1046,7 @@ void ClientProxy::AddCancellationFlag(const std::string& endpoint_id) {
 
 CancellationFlag* ClientProxy::GetCancellationFlag(
     const std::string& endpoint_id) {
+  MutexLock lock(&endpoints_mutex_);
   const auto item = cancellation_flags_.find(endpoint_id);
   if (item == cancellation_flags_.end()) {
     return default_cancellation_flag_.get();
@@ -906,6 +1055,7 @@ CancellationFlag* ClientProxy::GetCancellationFlag(
 }
 
 void ClientProxy::CancelEndpoint(const std::string& endpoint_id) {
+  MutexLock lock(&endpoints_mutex_);
   const auto item = cancellation_flags_.find(endpoint_id);
   if (item != cancellation_flags_.end()) {
     item->second->Cancel();
@@ -916,27 +1066,29 @@ const OsInfo& ClientProxy::GetLocalOsInfo() const { return local_os_info_; }
 
 std::optional<OsInfo> ClientProxy::GetRemoteOsInfo(
     absl::string_view endpoint_id) const {
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.os_info;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.os_info;
   }
   return std::nullopt;
 }
 
 void ClientProxy::SetRemoteOsInfo(absl::string_view endpoint_id,
                                   const OsInfo& remote_os_info) {
-  ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->first.os_info.emplace(remote_os_info);
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    state->connection.os_info.emplace(remote_os_info);
   }
 }
 
 std::optional<std::int32_t> ClientProxy::GetRemoteSafeToDisconnectVersion(
     absl::string_view endpoint_id) const {
-  MutexLock lock(&mutex_);
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.safe_to_disconnect_version;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.safe_to_disconnect_version;
   }
   return std::nullopt;
 }
@@ -944,10 +1096,10 @@ std::optional<std::int32_t> ClientProxy::GetRemoteSafeToDisconnectVersion(
 void ClientProxy::SetRemoteSafeToDisconnectVersion(
     absl::string_view endpoint_id,
     const std::int32_t& safe_to_disconnect_version) {
-  MutexLock lock(&mutex_);
-  ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->first.safe_to_disconnect_version = safe_to_disconnect_version;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    state->connection.safe_to_disconnect_version = safe_to_disconnect_version;
   }
 }
 
@@ -979,6 +1131,7 @@ bool ClientProxy::IsPayloadReceivedAckEnabled(absl::string_view endpoint_id) {
 }
 
 void ClientProxy::CancelAllEndpoints() {
+  MutexLock lock(&endpoints_mutex_);
   for (const auto& item : cancellation_flags_) {
     CancellationFlag* cancellation_flag = item.second.get();
     if (cancellation_flag->Cancelled()) {
@@ -989,41 +1142,37 @@ void ClientProxy::CancelAllEndpoints() {
 }
 
 void ClientProxy::OnPayload(const std::string& endpoint_id, Payload payload) {
-  MutexLock lock(&mutex_);
-
-  if (IsConnectedToEndpoint(endpoint_id)) {
-    const std::pair<ClientProxy::Connection, PayloadListener>* item =
-        LookupConnection(endpoint_id);
-    if (item != nullptr) {
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    if (state->status.load() == Connection::kConnected) {
       NEARBY_LOGS(INFO) << "ClientProxy [reporting onPayloadReceived]: client="
                         << GetClientId() << "; endpoint_id=" << endpoint_id
                         << " ; payload_id=" << payload.GetId();
-      item->second.payload_cb(endpoint_id, std::move(payload));
+      state->payload_listener.payload_cb(endpoint_id, std::move(payload));
     }
   }
 }
 
-const ClientProxy::ConnectionPair* ClientProxy::LookupConnection(
+std::shared_ptr<ClientProxy::EndpointState> ClientProxy::LookupEndpoint(
     absl::string_view endpoint_id) const {
+  MutexLock lock(&endpoints_mutex_);
   auto item = connections_.find(endpoint_id);
-  return item != connections_.end() ? &item->second : nullptr;
-}
-
-ClientProxy::ConnectionPair* ClientProxy::LookupConnection(
-    absl::string_view endpoint_id) {
-  auto item = connections_.find(endpoint_id);
-  return item != connections_.end() ? &item->second : nullptr;
+  return item != connections_.end() ? item->second : nullptr;
 }
 
 void ClientProxy::OnPayloadProgress(const std::string& endpoint_id,
                                     const PayloadProgressInfo& info) {
-  MutexLock lock(&mutex_);
-
-  if (IsConnectedToEndpoint(endpoint_id)) {
-    std::pair<ClientProxy::Connection, PayloadListener>* item =
-        LookupConnection(endpoint_id);
-    if (item != nullptr) {
-      item->second.payload_progress_cb(endpoint_id, info);
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    if (state->status.load() == Connection::kConnected) {
+      if (state->payload_listener.progress_batch_interval >
+          absl::ZeroDuration()) {
+        AddPendingProgress(endpoint_id, state, info);
+      } else {
+        state->payload_listener.payload_progress_cb(endpoint_id, info);
+      }
 
       if (info.status == PayloadProgressInfo::Status::kInProgress) {
         NEARBY_VLOG(1) << "ClientProxy [reporting onPayloadProgress]: client="
@@ -1041,22 +1190,64 @@ void ClientProxy::OnPayloadProgress(const std::string& endpoint_id,
   }
 }
 
-void ClientProxy::RemoveAllEndpoints() {
-  MutexLock lock(&mutex_);
+void ClientProxy::AddPendingProgress(
+    const std::string& endpoint_id, const std::shared_ptr<EndpointState>& state,
+    const PayloadProgressInfo& info) {
+  auto [it, inserted] = state->pending_progress_index.emplace(
+      info.payload_id, state->pending_progress.size());
+  if (!inserted) {
+    state->pending_progress[it->second] = info;
+    return;
+  }
+  state->pending_progress.push_back(info);
+  if (state->pending_progress.size() > 1) {
+    return;
+  }
+  // The task doesn't keep the endpoint alive; an endpoint removed in the
+  // meantime has nothing to report.
+  single_thread_executor_.Schedule(
+      [endpoint_id, weak_state = std::weak_ptr<EndpointState>(state)]() {
+        std::shared_ptr<EndpointState> state = weak_state.lock();
+        if (state == nullptr) return;
+        MutexLock lock(&state->mutex);
+        FlushPendingProgress(endpoint_id, *state);
+      },
+      state->payload_listener.progress_batch_interval);
+}
+
+void ClientProxy::FlushPendingProgress(absl::string_view endpoint_id,
+                                       EndpointState& state) {
+  if (state.pending_progress.empty()) {
+    return;
+  }
+  std::vector<PayloadProgressInfo> batch;
+  batch.swap(state.pending_progress);
+  state.pending_progress_index.clear();
+  if (state.status.load() == Connection::kConnected) {
+    state.payload_listener.payload_progress_batch_cb(endpoint_id, batch);
+  }
+}
 
-  // Note: we may want to notify the client of onDisconnected() for each
-  // endpoint, in the case when this is called from stopAllEndpoints(). For now,
-  // just remove without notifying.
-  connections_.clear();
-  cancellation_flags_.clear();
-  bluetooth_mac_addresses_.clear();
+void ClientProxy::RemoveAllEndpoints() {
+  {
+    MutexLock lock(&endpoints_mutex_);
+    // Note: we may want to notify the client of onDisconnected() for each
+    // endpoint, in the case when this is called from stopAllEndpoints(). For
+    // now, just remove without notifying.
+    for (auto& item : connections_) {
+      item.second->status.store(Connection::kPending);
+    }
+    connections_.clear();
+    cancellation_flags_.clear();
+    bluetooth_mac_addresses_.clear();
+  }
 
   OnSessionComplete();
 }
 
 void ClientProxy::OnSessionComplete() {
   MutexLock lock(&mutex_);
-  if (connections_.empty() && !IsAdvertising()) {
+  if (!HasOngoingConnection() && !IsAdvertising()) {
     local_endpoint_id_.clear();
 
     analytics_recorder_->LogSession();
@@ -1066,31 +1257,30 @@ void ClientProxy::OnSessionComplete() {
 
 bool ClientProxy::ConnectionStatusesContains(
     const std::string& endpoint_id, Connection::Status status_to_match) const {
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return (item->first.status & status_to_match) != 0;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    return (state->status.load() & status_to_match) != 0;
   }
   return false;
 }
 
-void ClientProxy::AppendConnectionStatus(const std::string& endpoint_id,
+void ClientProxy::AppendConnectionStatus(EndpointState& state,
                                          Connection::Status status_to_append) {
-  ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->first.status =
-        static_cast<Connection::Status>(item->first.status | status_to_append);
-  }
+  state.status.fetch_or(status_to_append);
 }
 
 AdvertisingOptions ClientProxy::GetAdvertisingOptions() const {
+  MutexLock lock(&mutex_);
   return advertising_options_;
 }
 
 DiscoveryOptions ClientProxy::GetDiscoveryOptions() const {
+  MutexLock lock(&discovery_mutex_);
   return discovery_options_;
 }
 
 v3::ConnectionListeningOptions ClientProxy::GetListeningOptions() const {
+  MutexLock lock(&mutex_);
   return listening_options_;
 }
 
@@ -1204,9 +1394,10 @@ std::int32_t ClientProxy::GetLocalMultiplexSocketBitmask() const {
 
 void ClientProxy::SetRemoteMultiplexSocketBitmask(
     absl::string_view endpoint_id, int remote_multiplex_socket_bitmask) {
-  ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    item->first.remote_multiplex_socket_bitmask =
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    state->connection.remote_multiplex_socket_bitmask =
         remote_multiplex_socket_bitmask;
     NEARBY_LOGS(INFO) << "ClientProxy [SetRemoteMultiplexSocketBitmask]: "
                       << remote_multiplex_socket_bitmask;
@@ -1229,21 +1420,22 @@ bool ClientProxy::IsLocalMultiplexSocketSupported(Medium medium) {
 
 std::optional<std::int32_t> ClientProxy::GetRemoteMultiplexSocketBitmask(
     absl::string_view endpoint_id) const {
-  const ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item != nullptr) {
-    return item->first.remote_multiplex_socket_bitmask;
+  std::shared_ptr<EndpointState> state = LookupEndpoint(endpoint_id);
+  if (state != nullptr) {
+    MutexLock lock(&state->mutex);
+    return state->connection.remote_multiplex_socket_bitmask;
   }
   return std::nullopt;
 }
 
 bool ClientProxy::IsMultiplexSocketSupported(absl::string_view endpoint_id,
                                              Medium medium) {
-  ConnectionPair* item = LookupConnection(endpoint_id);
-  if (item == nullptr) {
+  std::optional<std::int32_t> remote_bitmask =
+      GetRemoteMultiplexSocketBitmask(endpoint_id);
+  if (!remote_bitmask.has_value()) {
     return false;
   }
-  int combined_result = GetLocalMultiplexSocketBitmask() &
-                        item->first.remote_multiplex_socket_bitmask;
+  int combined_result = GetLocalMultiplexSocketBitmask() & *remote_bitmask;
 
   switch (medium) {
     case Medium::BLUETOOTH:
@@ -1284,7 +1476,10 @@ std::string ClientProxy::Dump() {
   sstream << "  Client ID: " << GetClientId() << std::endl;
   sstream << "  Local Endpoint ID: " << GetLocalEndpointId() << std::endl;
   sstream << std::boolalpha;
-  sstream << "  High Visibility Mode: " << high_vis_mode_ << std::endl;
+  {
+    MutexLock lock(&mutex_);
+    sstream << "  High Visibility Mode: " << high_vis_mode_ << std::endl;
+  }
   sstream << "  Is Advertising: " << IsAdvertising() << std::endl;
   sstream << "  Is Discovering: " << IsDiscovering() << std::endl;
   sstream << std::noboolalpha;
@@ -1292,18 +1487,25 @@ std::string ClientProxy::Dump() {
           << std::endl;
   sstream << "  Discovery Service ID: " << GetDiscoveryServiceId() << std::endl;
   sstream << "  Connections: " << std::endl;
-  for (auto it = connections_.begin(); it != connections_.end(); ++it) {
+  std::vector<std::pair<std::string, std::shared_ptr<EndpointState>>> states;
+  {
+    MutexLock lock(&endpoints_mutex_);
+    states.assign(connections_.begin(), connections_.end());
+  }
+  for (const auto& [endpoint_id, state] : states) {
+    MutexLock lock(&state->mutex);
     // TODO(deling): write Connection.ToString()
-    sstream << "    " << it->first << " :(connection token) "
-            << it->second.first.connection_token << ", (remote os type) "
-            << (it->second.first.os_info.has_value()
+    sstream << "    " << endpoint_id << " :(connection token) "
+            << state->connection.connection_token << ", (remote os type) "
+            << (state->connection.os_info.has_value()
                     ? location::nearby::connections::OsInfo::OsType_Name(
-                          it->second.first.os_info->type())
+                          state->connection.os_info->type())
                     : "unknown")
             << std::endl;
   }
 
   sstream << "  Discovered endpoint IDs: " << std::endl;
+  MutexLock lock(&discovery_mutex_);
   for (auto it = discovered_endpoint_ids_.begin();
        it != discovered_endpoint_ids_.end(); ++it) {
     sstream << "    " << *it << std::endl;
@@ -15,6 +15,7 @@
 #ifndef CORE_INTERNAL_CLIENT_PROXY_H_
 #define CORE_INTERNAL_CLIENT_PROXY_H_
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <optional>
@@ -22,6 +23,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
@@ -29,6 +31,7 @@
 #include "connections/connection_options.h"
 #include "connections/discovery_options.h"
 #include "connections/implementation/analytics/analytics_recorder.h"
+#include "connections/implementation/memory_accountant.h"
 #include "connections/implementation/proto/offline_wire_formats.pb.h"
 #include "connections/listeners.h"
 #include "connections/medium_selector.h"
@@ -59,6 +62,17 @@ namespace connections {
 
 // ClientProxy is tracking state of client's connection, and serves as
 // a proxy for notifications sent to this client.
+//
+// State is split into independently locked domains, so that payload traffic
+// on one endpoint doesn't wait for discovery, advertising or other endpoints:
+// - Advertising, listening and local endpoint id state, guarded by `mutex_`.
+// - Discovery state, guarded by `discovery_mutex_`.
+// - The endpoint index, guarded by `endpoints_mutex_`. It is only held for
+//   lookups and updates of the index, never while calling out.
+// - Per-endpoint connection state, guarded by the endpoint's own mutex.
+//   Listener callbacks for an endpoint are serialized on that mutex.
+// Locks are only ever acquired in this order: endpoint mutex,
+// `discovery_mutex_`, `mutex_`, `endpoints_mutex_`.
 class ClientProxy final {
  public:
   static constexpr int kEndpointIdLength = 4;
@@ -68,8 +82,8 @@ class ClientProxy final {
   explicit ClientProxy(
       ::nearby::analytics::EventLogger* event_logger = nullptr);
   ~ClientProxy();
-  ClientProxy(ClientProxy&&) = default;
-  ClientProxy& operator=(ClientProxy&&) = default;
+  ClientProxy(ClientProxy&&) = delete;
+  ClientProxy& operator=(ClientProxy&&) = delete;
 
   std::int64_t GetClientId() const;
 
@@ -80,6 +94,12 @@ class ClientProxy final {
     return *analytics_recorder_;
   }
 
+  // Accounts for the memory that data received from this client's endpoints
+  // holds. Shared with the streams that hold such data.
+  std::shared_ptr<MemoryAccountant> GetMemoryAccountant() const {
+    return memory_accountant_;
+  }
+
   std::string GetConnectionToken(const std::string& endpoint_id);
   std::optional<std::string> GetBluetoothMacAddress(
       const std::string& endpoint_id);
@@ -141,7 +161,7 @@ class ClientProxy final {
   }
 
   void UpdateDiscoveryOptions(const DiscoveryOptions& discovery_options) {
-    MutexLock lock(&mutex_);
+    MutexLock lock(&discovery_mutex_);
     discovery_options_ = discovery_options;
   }
 
@@ -362,8 +382,8 @@ class ClientProxy final {
       kRemoteEndpointRejected = 1 << 3,
       kConnected = 1 << 4,
     };
+    // Set on creation and never changed, so it may be read without a lock.
     bool is_incoming{false};
-    Status status{kPending};
     ConnectionListener connection_listener;
     ConnectionOptions connection_options;
     DiscoveryOptions discovery_options;
@@ -373,7 +393,23 @@ class ClientProxy final {
     std::int32_t safe_to_disconnect_version;
     std::int32_t remote_multiplex_socket_bitmask;
   };
-  using ConnectionPair = std::pair<Connection, PayloadListener>;
+
+  struct EndpointState {
+    // Guards `connection` and `payload_listener`, and serializes callbacks
+    // to the client for this endpoint. Recursive because callbacks may call
+    // back into ClientProxy for the same endpoint.
+    RecursiveMutex mutex;
+    // Connection::Status bits. Only modified with `mutex` held, but read
+    // without it so that status checks on the payload path stay lock-free.
+    std::atomic<std::uint8_t> status{Connection::kPending};
+    Connection connection;
+    PayloadListener payload_listener;
+    // Progress waiting for the next batch, when `payload_listener` batches
+    // progress: the latest update of each payload, and where each payload is
+    // in the batch. A flush is scheduled while the batch isn't empty.
+    std::vector<PayloadProgressInfo> pending_progress;
+    absl::flat_hash_map<std::int64_t, size_t> pending_progress_index;
+  };
 
   struct AdvertisingInfo {
     std::string service_id;
@@ -389,6 +425,17 @@ class ClientProxy final {
     bool IsEmpty() const { return service_id.empty(); }
   };
 
+  // An endpoint found or lost event held until the end of the coalescing
+  // window. Only endpoints found or lost since the last delivery have one.
+  struct PendingDiscoveryEvent {
+    // Orders the events of a window by when they arrived.
+    std::uint64_t sequence = 0;
+    bool found = false;
+    ByteArray endpoint_info;
+    location::nearby::proto::connections::Medium medium =
+        location::nearby::proto::connections::UNKNOWN_MEDIUM;
+  };
+
   struct ListeningInfo {
     std::string service_id;
     v3::ConnectionListener listener;
@@ -406,26 +453,61 @@ class ClientProxy final {
   void OnSessionComplete();
   bool ConnectionStatusesContains(const std::string& endpoint_id,
                                   Connection::Status status_to_match) const;
-  void AppendConnectionStatus(const std::string& endpoint_id,
+  void AppendConnectionStatus(EndpointState& state,
                               Connection::Status status_to_append);
 
-  const ConnectionPair* LookupConnection(absl::string_view endpoint_id) const;
-  ConnectionPair* LookupConnection(absl::string_view endpoint_id);
+  // Returns the endpoint's state, or nullptr. The returned state stays valid
+  // even if the endpoint is removed concurrently.
+  std::shared_ptr<EndpointState> LookupEndpoint(
+      absl::string_view endpoint_id) const
+      ABSL_LOCKS_EXCLUDED(endpoints_mutex_);
   bool ConnectionStatusMatches(const std::string& endpoint_id,
                                Connection::Status status) const;
   std::vector<std::string> GetMatchingEndpoints(
-      absl::AnyInvocable<bool(const Connection&)> pred) const;
+      absl::AnyInvocable<bool(const EndpointState&)> pred) const
+      ABSL_LOCKS_EXCLUDED(endpoints_mutex_);
   std::string GenerateLocalEndpointId();
 
   void ScheduleClearCachedEndpointIdAlarm();
   void CancelClearCachedEndpointIdAlarm();
 
+  // Report an endpoint as found or lost to the discovery listener. Require
+  // `discovery_mutex_`.
+  void ReportEndpointFound(const std::string& endpoint_id,
+                           const ByteArray& endpoint_info,
+                           location::nearby::proto::connections::Medium medium);
+  void ReportEndpointLost(const std::string& endpoint_id);
+  // Merge a found or lost event into the events of the current coalescing
+  // window. Require `discovery_mutex_`.
+  void CoalesceEndpointFound(
+      const std::string& endpoint_id, const ByteArray& endpoint_info,
+      location::nearby::proto::connections::Medium medium);
+  void CoalesceEndpointLost(const std::string& endpoint_id);
+  // Adds an event to the current coalescing window, and schedules its delivery
+  // if the window just started. Requires `discovery_mutex_`.
+  void AddPendingDiscoveryEvent(const std::string& endpoint_id,
+                                PendingDiscoveryEvent event);
+  // Delivers the events of the current coalescing window, in the order they
+  // arrived. Requires `discovery_mutex_`.
+  void DeliverPendingDiscoveryEvents();
+
+  // Adds `info` to the progress batch of the endpoint, and schedules the batch
+  // to be reported if it was empty. Requires `state->mutex`.
+  void AddPendingProgress(const std::string& endpoint_id,
+                          const std::shared_ptr<EndpointState>& state,
+                          const PayloadProgressInfo& info);
+  // Reports the progress batch of the endpoint, if any. Requires `state.mutex`.
+  static void FlushPendingProgress(absl::string_view endpoint_id,
+                                   EndpointState& state);
+
   location::nearby::connections::OsInfo::OsType OSNameToOsInfoType(
       api::OSName osName);
 
   std::string ToString(PayloadProgressInfo::Status status) const;
 
   mutable RecursiveMutex mutex_;
+  mutable RecursiveMutex discovery_mutex_;
+  mutable Mutex endpoints_mutex_;
   std::int64_t client_id_;
   std::string local_endpoint_id_;
   std::string local_endpoint_info_;
@@ -473,10 +555,12 @@ class ClientProxy final {
   v3::ConnectionListeningOptions listening_options_;
 
   // Maps endpoint_id to endpoint connection state.
-  absl::flat_hash_map<std::string, ConnectionPair> connections_;
+  absl::flat_hash_map<std::string, std::shared_ptr<EndpointState>> connections_
+      ABSL_GUARDED_BY(endpoints_mutex_);
 
   // Maps endpoint_id to Bluetooth Mac Addresses.
-  absl::flat_hash_map<std::string, std::string> bluetooth_mac_addresses_;
+  absl::flat_hash_map<std::string, std::string> bluetooth_mac_addresses_
+      ABSL_GUARDED_BY(endpoints_mutex_);
 
   // A cache of endpoint ids that we've already notified the discoverer of. We
   // check this cache before calling onEndpointFound() so that we don't notify
@@ -485,11 +569,20 @@ class ClientProxy final {
   // endpoints after each scan.
   absl::flat_hash_set<std::string> discovered_endpoint_ids_;
 
+  // Events waiting for the end of the coalescing window, by endpoint id, when
+  // `discovery_options_` coalesces endpoint events. An alarm delivers them
+  // while `discovery_events_scheduled_` is set.
+  absl::flat_hash_map<std::string, PendingDiscoveryEvent>
+      pending_discovery_events_;
+  std::uint64_t next_discovery_event_sequence_ = 0;
+  bool discovery_events_scheduled_ = false;
+  std::unique_ptr<CancelableAlarm> discovery_events_alarm_;
+
   // Maps endpoint_id to CancellationFlag. CancellationFlags are passed around
   // as raw pointers to other classes in Nearby Connections, so it is important
   // that objects in this map are not cleared, even if they are cancelled.
   absl::flat_hash_map<std::string, std::unique_ptr<CancellationFlag>>
-      cancellation_flags_;
+      cancellation_flags_ ABSL_GUARDED_BY(endpoints_mutex_);
   // A default cancellation flag with isCancelled set be true.
   std::unique_ptr<CancellationFlag> default_cancellation_flag_ =
       std::make_unique<CancellationFlag>(true);
@@ -498,6 +591,8 @@ class ClientProxy final {
   // nullptr as no-op.
   std::unique_ptr<analytics::AnalyticsRecorder> analytics_recorder_;
   std::unique_ptr<ErrorCodeRecorder> error_code_recorder_;
+  std::shared_ptr<MemoryAccountant> memory_accountant_ =
+      std::make_shared<MemoryAccountant>();
   // Local device OS information.
   location::nearby::connections::OsInfo local_os_info_;
   // For device providers not owned by Nearby connections (e.g. Nearby
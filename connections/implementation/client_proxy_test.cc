@@ -18,6 +18,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
@@ -65,6 +66,9 @@ using ::location::nearby::connections::OsInfo;
 using ::location::nearby::proto::connections::CLIENT_SESSION;
 using ::location::nearby::proto::connections::START_CLIENT_SESSION;
 using ::location::nearby::proto::connections::STOP_CLIENT_SESSION;
+using ::testing::AnyNumber;
+using ::testing::InSequence;
+using ::testing::Mock;
 using ::testing::MockFunction;
 using ::testing::StrictMock;
 
@@ -639,6 +643,80 @@ TEST_F(ClientProxyTest, OnEndpointLostFiresNotificationInDiscovery) {
   OnDiscoveryEndpointLost(client2(), advertising_endpoint);
 }
 
+TEST_F(ClientProxyTest, CoalescesFlappingEndpointEvents) {
+  DiscoveryOptions discovery_options;
+  discovery_options.endpoint_events_coalescing_window = absl::Seconds(1);
+  client2()->StartedDiscovery(service_id_, strategy_, GetDiscoveryListener(),
+                              absl::MakeSpan(mediums_), discovery_options);
+  Endpoint stable{.info = ByteArray{"stable"}, .id = "STBL"};
+  Endpoint flapping{.info = ByteArray{"flapping"}, .id = "FLAP"};
+  Endpoint leaving{.info = ByteArray{"leaving"}, .id = "LEAV"};
+
+  // Scan results repeat the stable endpoint, and the flapping endpoint comes
+  // and goes within the window.
+  for (int i = 0; i < 3; ++i) {
+    client2()->OnEndpointFound(service_id_, stable.id, stable.info, medium_);
+  }
+  for (int i = 0; i < 3; ++i) {
+    client2()->OnEndpointFound(service_id_, flapping.id, flapping.info,
+                               medium_);
+    client2()->OnEndpointLost(service_id_, flapping.id);
+  }
+  client2()->OnEndpointFound(service_id_, leaving.id, leaving.info, medium_);
+  {
+    InSequence sequence;
+    EXPECT_CALL(mock_discovery_.endpoint_found_cb,
+                Call(stable.id, stable.info, service_id_));
+    EXPECT_CALL(mock_discovery_.endpoint_found_cb,
+                Call(leaving.id, leaving.info, service_id_));
+  }
+  FastForward(absl::Seconds(1));
+  Mock::VerifyAndClearExpectations(&mock_discovery_.endpoint_found_cb);
+
+  // Only the endpoint that is lost at the end of the window is reported.
+  client2()->OnEndpointLost(service_id_, stable.id);
+  client2()->OnEndpointFound(service_id_, stable.id, stable.info, medium_);
+  client2()->OnEndpointLost(service_id_, leaving.id);
+  client2()->OnEndpointFound(service_id_, leaving.id, leaving.info, medium_);
+  client2()->OnEndpointLost(service_id_, leaving.id);
+  client2()->OnEndpointFound(service_id_, flapping.id, flapping.info, medium_);
+  client2()->OnEndpointLost(service_id_, flapping.id);
+  EXPECT_CALL(mock_discovery_.endpoint_lost_cb, Call(leaving.id));
+  FastForward(absl::Seconds(1));
+}
+
+TEST_F(ClientProxyTest, StoppingDiscoveryDropsCoalescedEndpointEvents) {
+  DiscoveryOptions discovery_options;
+  discovery_options.endpoint_events_coalescing_window = absl::Seconds(1);
+  client2()->StartedDiscovery(service_id_, strategy_, GetDiscoveryListener(),
+                              absl::MakeSpan(mediums_), discovery_options);
+  Endpoint endpoint{.info = ByteArray{"endpoint"}, .id = "ABCD"};
+  client2()->OnEndpointFound(service_id_, endpoint.id, endpoint.info, medium_);
+
+  StopDiscovery(client2());
+  FastForward(absl::Seconds(1));
+}
+
+TEST_F(ClientProxyTest, StoppingDiscoveryAsCoalescingWindowEndsCompletes) {
+  DiscoveryOptions discovery_options;
+  discovery_options.endpoint_events_coalescing_window = absl::Seconds(1);
+  Endpoint endpoint{.info = ByteArray{"endpoint"}, .id = "ABCD"};
+  EXPECT_CALL(mock_discovery_.endpoint_found_cb, Call).Times(AnyNumber());
+  // The window ends on the executor while the stop holds the discovery lock;
+  // neither may wait for the other.
+  for (int i = 0; i < 20; ++i) {
+    client2()->StartedDiscovery(service_id_, strategy_, GetDiscoveryListener(),
+                                absl::MakeSpan(mediums_), discovery_options);
+    client2()->OnEndpointFound(service_id_, endpoint.id, endpoint.info,
+                               medium_);
+    std::thread window_end([this]() {
+      (*env_.GetSimulatedClock())->FastForward(absl::Seconds(1));
+    });
+    StopDiscovery(client2());
+    window_end.join();
+  }
+}
+
 TEST_F(ClientProxyTest, OnConnectionInitiatedFiresNotificationInDiscovery) {
   Endpoint advertising_endpoint =
       StartAdvertising(client1(), advertising_connection_listener_);
@@ -728,6 +806,172 @@ TEST_F(ClientProxyTest, OnPayloadProgressChangesState) {
   OnPayloadProgress(client2(), advertising_endpoint);
 }
 
+TEST_F(ClientProxyTest, ConcurrentPayloadsOnManyEndpointsAreAllDelivered) {
+  constexpr int kEndpoints = 16;
+  constexpr int kPayloadsPerEndpoint = 200;
+  std::vector<Endpoint> endpoints;
+  for (int i = 0; i < kEndpoints; ++i) {
+    Endpoint endpoint{
+        .info = ByteArray{"advertising endpoint name"},
+        .id = absl::StrFormat("E%03d", i),
+    };
+    OnDiscoveryConnectionInitiated(client2(), endpoint);
+    OnDiscoveryConnectionLocalAccepted(client2(), endpoint);
+    OnDiscoveryConnectionRemoteAccepted(client2(), endpoint);
+    OnDiscoveryConnectionAccepted(client2(), endpoint);
+    endpoints.push_back(endpoint);
+  }
+  EXPECT_CALL(mock_discovery_payload_.payload_cb, Call)
+      .Times(kEndpoints * kPayloadsPerEndpoint);
+  EXPECT_CALL(mock_discovery_payload_.payload_progress_cb, Call)
+      .Times(kEndpoints * kPayloadsPerEndpoint);
+
+  std::vector<std::thread> threads;
+  for (const Endpoint& endpoint : endpoints) {
+    threads.emplace_back([this, &endpoint]() {
+      for (int i = 0; i < kPayloadsPerEndpoint; ++i) {
+        client2()->OnPayload(endpoint.id, Payload(payload_bytes_));
+        client2()->OnPayloadProgress(endpoint.id, {});
+        EXPECT_TRUE(client2()->IsConnectedToEndpoint(endpoint.id));
+      }
+    });
+  }
+  // Discovery and bookkeeping run alongside the payload traffic.
+  threads.emplace_back([this]() {
+    for (int i = 0; i < kPayloadsPerEndpoint; ++i) {
+      StartDiscovery(client2(), GetDiscoveryListener());
+      EXPECT_EQ(client2()->GetConnectedEndpoints().size(),
+                static_cast<size_t>(kEndpoints));
+      client2()->Dump();
+      client2()->StoppedDiscovery();
+    }
+  });
+  for (auto& thread : threads) thread.join();
+}
+
+TEST_F(ClientProxyTest, NoPayloadIsDeliveredAfterDisconnect) {
+  Endpoint endpoint{
+      .info = ByteArray{"advertising endpoint name"},
+      .id = "ABCD",
+  };
+  OnDiscoveryConnectionInitiated(client2(), endpoint);
+  OnDiscoveryConnectionLocalAccepted(client2(), endpoint);
+  OnDiscoveryConnectionRemoteAccepted(client2(), endpoint);
+  OnDiscoveryConnectionAccepted(client2(), endpoint);
+  OnDiscoveryConnectionDisconnected(client2(), endpoint);
+
+  // payload_cb is a StrictMock, so any delivery fails the test.
+  client2()->OnPayload(endpoint.id, Payload(payload_bytes_));
+  client2()->OnPayloadProgress(endpoint.id, {});
+  EXPECT_FALSE(client2()->IsConnectedToEndpoint(endpoint.id));
+}
+
+TEST_F(ClientProxyTest, BatchesProgressOfConcurrentPayloads) {
+  constexpr int kThreads = 4;
+  constexpr int kPayloadsPerThread = 50;
+  constexpr int kUpdatesPerPayload = 20;
+  Endpoint endpoint{
+      .info = ByteArray{"advertising endpoint name"},
+      .id = "ABCD",
+  };
+  Mutex mutex;
+  int batches = 0;
+  std::vector<PayloadProgressInfo> reported;
+  OnDiscoveryConnectionInitiated(client2(), endpoint);
+  client2()->LocalEndpointAcceptedConnection(
+      endpoint.id,
+      {
+          .progress_batch_interval = absl::Milliseconds(100),
+          .payload_progress_batch_cb =
+              [&](absl::string_view endpoint_id,
+                  absl::Span<const PayloadProgressInfo> infos) {
+                MutexLock lock(&mutex);
+                ++batches;
+                reported.insert(reported.end(), infos.begin(), infos.end());
+              },
+      });
+  OnDiscoveryConnectionRemoteAccepted(client2(), endpoint);
+  OnDiscoveryConnectionAccepted(client2(), endpoint);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([this, &endpoint, t]() {
+      for (int i = 0; i < kPayloadsPerThread; ++i) {
+        std::int64_t payload_id = t * kPayloadsPerThread + i;
+        for (int update = 1; update <= kUpdatesPerPayload; ++update) {
+          client2()->OnPayloadProgress(
+              endpoint.id,
+              {.payload_id = payload_id,
+               .status = PayloadProgressInfo::Status::kInProgress,
+               .total_bytes = kUpdatesPerPayload,
+               .bytes_transferred = update});
+        }
+        client2()->OnPayloadProgress(
+            endpoint.id, {.payload_id = payload_id,
+                          .status = PayloadProgressInfo::Status::kSuccess,
+                          .total_bytes = kUpdatesPerPayload,
+                          .bytes_transferred = kUpdatesPerPayload});
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  FastForward(absl::Milliseconds(100));
+
+  MutexLock lock(&mutex);
+  // All the updates arrived within one interval, and only the terminal one of
+  // each payload is left.
+  EXPECT_EQ(batches, 1);
+  ASSERT_EQ(reported.size(), kThreads * kPayloadsPerThread);
+  for (const PayloadProgressInfo& info : reported) {
+    EXPECT_EQ(info.status, PayloadProgressInfo::Status::kSuccess);
+    EXPECT_EQ(info.bytes_transferred, kUpdatesPerPayload);
+  }
+}
+
+TEST_F(ClientProxyTest, ReportsProgressBatchBeforeDisconnect) {
+  Endpoint endpoint{
+      .info = ByteArray{"advertising endpoint name"},
+      .id = "ABCD",
+  };
+  StrictMock<MockFunction<void(absl::string_view endpoint_id,
+                               absl::Span<const PayloadProgressInfo> infos)>>
+      payload_progress_batch_cb;
+  OnDiscoveryConnectionInitiated(client2(), endpoint);
+  client2()->LocalEndpointAcceptedConnection(
+      endpoint.id,
+      {
+          .progress_batch_interval = absl::Seconds(10),
+          .payload_progress_batch_cb =
+              payload_progress_batch_cb.AsStdFunction(),
+      });
+  OnDiscoveryConnectionRemoteAccepted(client2(), endpoint);
+  OnDiscoveryConnectionAccepted(client2(), endpoint);
+  client2()->OnPayloadProgress(
+      endpoint.id, {.payload_id = 1,
+                    .status = PayloadProgressInfo::Status::kInProgress});
+  client2()->OnPayloadProgress(
+      endpoint.id,
+      {.payload_id = 2, .status = PayloadProgressInfo::Status::kSuccess});
+  client2()->OnPayloadProgress(
+      endpoint.id,
+      {.payload_id = 1, .status = PayloadProgressInfo::Status::kFailure});
+
+  {
+    InSequence sequence;
+    EXPECT_CALL(payload_progress_batch_cb, Call)
+        .WillOnce([](absl::string_view endpoint_id,
+                     absl::Span<const PayloadProgressInfo> infos) {
+          ASSERT_EQ(infos.size(), 2);
+          EXPECT_EQ(infos[0].payload_id, 1);
+          EXPECT_EQ(infos[0].status, PayloadProgressInfo::Status::kFailure);
+          EXPECT_EQ(infos[1].payload_id, 2);
+          EXPECT_EQ(infos[1].status, PayloadProgressInfo::Status::kSuccess);
+        });
+    EXPECT_CALL(mock_discovery_connection_.disconnected_cb, Call);
+  }
+  client2()->OnDisconnected(endpoint.id, true);
+}
+
 TEST_F(ClientProxyTest,
        EndpointIdCacheWhenHighVizAdvertisementAgainImmediately) {
   BooleanMediumSelector booleanMediumSelector;
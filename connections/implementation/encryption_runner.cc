@@ -24,6 +24,7 @@
 #include "absl/strings/ascii.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "connections/implementation/analytics/trace_recorder.h"
 #include "connections/implementation/client_proxy.h"
 #include "connections/implementation/endpoint_channel.h"
 #include "internal/platform/base64_utils.h"
@@ -92,6 +93,8 @@ class ServerRunnable final {
         listener_(std::move(listener)) {}
 
   void operator()() {
+    analytics::TraceSpan trace_span(analytics::kTraceUkey2Handshake,
+                                    endpoint_id_);
     CancelableAlarm timeout_alarm(
         "EncryptionRunner.StartServer() timeout",
         [this]() { CancelableAlarmRunnable(client_, endpoint_id_, channel_); },
@@ -180,6 +183,8 @@ class ServerRunnable final {
         << endpoint_id_ << ").";
 
     timeout_alarm.Cancel();
+    // The handshake is done; what the listener does is not part of it.
+    trace_span.End();
 
     if (!HandleEncryptionSuccess(endpoint_id_, std::move(server), listener_)) {
       LogException();
@@ -230,6 +235,8 @@ class ClientRunnable final {
         listener_(std::move(listener)) {}
 
   void operator()() {
+    analytics::TraceSpan trace_span(analytics::kTraceUkey2Handshake,
+                                    endpoint_id_);
     CancelableAlarm timeout_alarm(
         "EncryptionRunner.StartClient() timeout",
         [this]() { CancelableAlarmRunnable(client_, endpoint_id_, channel_); },
@@ -317,6 +324,7 @@ class ClientRunnable final {
         << endpoint_id_ << ").";
 
     timeout_alarm.Cancel();
+    trace_span.End();
 
     if (!HandleEncryptionSuccess(endpoint_id_, std::move(crypto), listener_)) {
       LogException();
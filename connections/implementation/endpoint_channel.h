@@ -15,6 +15,7 @@
 #ifndef CORE_INTERNAL_ENDPOINT_CHANNEL_H_
 #define CORE_INTERNAL_ENDPOINT_CHANNEL_H_
 
+#include <optional>
 #include <string>
 
 #include "securegcm/d2d_connection_context_v1.h"
@@ -44,6 +45,12 @@ class EndpointChannel {
   virtual Exception Write(
       const ByteArray& data,
       PacketMetaData& packet_meta_data) = 0;  // throws Exception::IO
+
+  // Writes |data| unless the channel is paused or another write is in
+  // progress, in which case nothing is written and std::nullopt is returned.
+  virtual std::optional<Exception> TryWrite(const ByteArray& data) {
+    return Write(data);
+  }
   // Closes this EndpointChannel, without tracking the closure in analytics.
 
   virtual void Close() = 0;
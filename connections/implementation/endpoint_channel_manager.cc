@@ -18,6 +18,7 @@
 #include <string>
 #include <utility>
 
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "connections/implementation/client_proxy.h"
 #include "connections/implementation/endpoint_channel.h"
@@ -39,6 +40,10 @@ const absl::Duration kDataTransferDelay = absl::Milliseconds(500);
 EndpointChannelManager::~EndpointChannelManager() {
   LOG(INFO) << "Initiating shutdown of EndpointChannelManager.";
   MutexLock lock(&mutex_);
+  {
+    absl::MutexLock active_channels_lock(&active_channels_mutex_);
+    active_channels_.clear();
+  }
   channel_state_.DestroyAll();
   LOG(INFO) << "EndpointChannelManager has shut down.";
 }
@@ -92,15 +97,26 @@ bool EndpointChannelManager::EncryptChannelForEndpoint(
 
 std::shared_ptr<EndpointChannel> EndpointChannelManager::GetChannelForEndpoint(
     const std::string& endpoint_id) {
-  MutexLock lock(&mutex_);
+  {
+    absl::ReaderMutexLock lock(&active_channels_mutex_);
+    auto item = active_channels_.find(endpoint_id);
+    if (item != active_channels_.end()) {
+      return item->second;
+    }
+  }
+  LOG(INFO) << "No channel info for endpoint " << endpoint_id;
+  return {};
+}
 
+void EndpointChannelManager::PublishChannelForEndpoint(
+    const std::string& endpoint_id) {
   auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
-  if (endpoint == nullptr) {
-    LOG(INFO) << "No channel info for endpoint " << endpoint_id;
-    return {};
+  absl::MutexLock lock(&active_channels_mutex_);
+  if (endpoint == nullptr || endpoint->channel == nullptr) {
+    active_channels_.erase(endpoint_id);
+  } else {
+    active_channels_[endpoint_id] = endpoint->channel;
   }
-
-  return endpoint->channel;
 }
 
 void EndpointChannelManager::SetActiveEndpointChannel(
@@ -115,6 +131,8 @@ void EndpointChannelManager::SetActiveEndpointChannel(
   auto* endpoint = channel_state_.LookupEndpointData(endpoint_id);
   if (endpoint->IsEncrypted() && enable_encryption)
     channel_state_.EncryptChannel(endpoint);
+  // Readers only see the new channel once it is fully set up.
+  PublishChannelForEndpoint(endpoint_id);
 }
 
 int EndpointChannelManager::GetConnectedEndpointsCount() const {
@@ -359,6 +377,12 @@ bool EndpointChannelManager::UnregisterChannelForEndpoint(
     SafeDisconnectionResult result) {
   MutexLock lock(&mutex_);
 
+  // Withdraw the channel before the DISCONNECTION frame is flushed, so no
+  // writer picks it up to send frames after that one.
+  {
+    absl::MutexLock active_channels_lock(&active_channels_mutex_);
+    active_channels_.erase(endpoint_id);
+  }
   auto safe_to_disconnect_enabled =
       channel_state_.GetSafeToDisconnectForEndpoint(endpoint_id);
   if (!channel_state_.RemoveEndpoint(endpoint_id, reason,
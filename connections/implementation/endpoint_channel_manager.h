@@ -20,6 +20,7 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "connections/implementation/client_proxy.h"
 #include "connections/implementation/endpoint_channel.h"
@@ -92,8 +93,14 @@ class EndpointChannelManager final {
   // If EndpointChannelManager replaces the current channel, and any (or both)
   // EndpointManager methods that use a channel are running, it is better to
   // have a shared ownership.
+  //
+  // This is called for every frame sent or read, so it never takes `mutex_`
+  // and never waits for registration, replacement or removal of a channel
+  // (removal may block for a while to flush the DISCONNECTION frame). A
+  // replaced channel stays alive until its last caller drops it.
   std::shared_ptr<EndpointChannel> GetChannelForEndpoint(
-      const std::string& endpoint_id) ABSL_LOCKS_EXCLUDED(mutex_);
+      const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_, active_channels_mutex_);
 
   // Returns true if 'endpoint_id' actually had a registered EndpointChannel.
   // IOW, a return of false signifies a no-op.
@@ -211,8 +218,21 @@ class EndpointChannelManager final {
                                 bool enable_encryption)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Publishes the current channel of `endpoint_id` to GetChannelForEndpoint(),
+  // or withdraws it if there is none.
+  void PublishChannelForEndpoint(const std::string& endpoint_id)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_)
+          ABSL_LOCKS_EXCLUDED(active_channels_mutex_);
+
+  // Serializes registration, replacement and removal of channels.
   mutable Mutex mutex_;
   ChannelState channel_state_;
+
+  // Read-mostly copy of the channel of every endpoint, maintained by the
+  // writers above. Only held for a hash lookup and a reference count bump.
+  mutable absl::Mutex active_channels_mutex_ ABSL_ACQUIRED_AFTER(mutex_);
+  absl::flat_hash_map<std::string, std::shared_ptr<EndpointChannel>>
+      active_channels_ ABSL_GUARDED_BY(active_channels_mutex_);
 };
 
 }  // namespace connections
@@ -18,14 +18,19 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
+#include <vector>
 
 #include "securegcm/ukey2_handshake.h"
 #include "gmock/gmock.h"
 #include "protobuf-matchers/protocol-buffer-matchers.h"
 #include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "connections/implementation/base_endpoint_channel.h"
 #include "connections/implementation/client_proxy.h"
@@ -317,6 +322,178 @@ TEST(BaseEndpointChannelManagerTest, ReplaceChannelNoEncrypted) {
         std::string(kEndpointId), DisconnectionReason::REMOTE_DISCONNECTION,
         ConnectionsLog::EstablishedConnection::SAFE_DISCONNECTION);}
 
+// Holds every write until `release` is notified.
+class BlockingWriteChannel : public MockEndpointChannel {
+ public:
+  BlockingWriteChannel(InputStream* input, OutputStream* output,
+                       absl::Notification* write_started,
+                       absl::Notification* release)
+      : MockEndpointChannel(input, output),
+        write_started_(write_started),
+        release_(release) {}
+
+  using MockEndpointChannel::Write;
+  Exception Write(const ByteArray& data) override {
+    if (!write_started_->HasBeenNotified()) write_started_->Notify();
+    release_->WaitForNotification();
+    return MockEndpointChannel::Write(data);
+  }
+
+ private:
+  absl::Notification* const write_started_;
+  absl::Notification* const release_;
+};
+
+// An unconnected channel, only used as a handle.
+class ChannelWithPipes {
+ public:
+  ChannelWithPipes() : ChannelWithPipes(nullptr, nullptr) {}
+
+  // Creates a channel whose writes wait for `release`.
+  ChannelWithPipes(absl::Notification* write_started,
+                   absl::Notification* release)
+      : input_(CreatePipe()), output_(CreatePipe()) {
+    if (release == nullptr) {
+      channel_ = std::make_unique<MockEndpointChannel>(input_.first.get(),
+                                                       output_.second.get());
+    } else {
+      channel_ = std::make_unique<BlockingWriteChannel>(
+          input_.first.get(), output_.second.get(), write_started, release);
+    }
+    ON_CALL(*channel_, GetMedium).WillByDefault([]() {
+      return Medium::BLUETOOTH;
+    });
+  }
+
+  EndpointChannel* get() const { return channel_.get(); }
+  std::unique_ptr<EndpointChannel> Release() { return std::move(channel_); }
+
+ private:
+  std::pair<std::unique_ptr<InputStream>, std::unique_ptr<OutputStream>>
+      input_;
+  std::pair<std::unique_ptr<InputStream>, std::unique_ptr<OutputStream>>
+      output_;
+  std::unique_ptr<MockEndpointChannel> channel_;
+};
+
+TEST(BaseEndpointChannelManagerTest, ConcurrentLookupsDuringReplacement) {
+  constexpr int kEndpoints = 32;
+  constexpr int kReaders = 8;
+  constexpr int kLookupsPerReader = 1000;
+  constexpr int kReplacements = 200;
+  // Declared before `ecm`, so the pipes outlive every channel it holds.
+  std::vector<std::unique_ptr<ChannelWithPipes>> channels;
+  ClientProxy proxy;
+  EndpointChannelManager ecm;
+  std::vector<std::string> endpoint_ids;
+  for (int i = 0; i < kEndpoints; ++i) {
+    endpoint_ids.push_back(absl::StrCat("Endpoint", i));
+    channels.push_back(std::make_unique<ChannelWithPipes>());
+    ecm.RegisterChannelForEndpoint(&proxy, endpoint_ids.back(),
+                                   channels.back()->Release());
+  }
+  for (int i = 0; i < kReplacements; ++i) {
+    channels.push_back(std::make_unique<ChannelWithPipes>());
+  }
+  // The last replacement of each endpoint is the channel it ends up with.
+  std::vector<EndpointChannel*> final_channels(kEndpoints);
+  for (int i = 0; i < kReplacements; ++i) {
+    final_channels[i % kEndpoints] = channels[kEndpoints + i]->get();
+  }
+
+  std::vector<std::thread> threads;
+  for (int r = 0; r < kReaders; ++r) {
+    threads.emplace_back([&ecm, &endpoint_ids, r]() {
+      for (int i = 0; i < kLookupsPerReader; ++i) {
+        const std::string& endpoint_id =
+            endpoint_ids[(r + i) % endpoint_ids.size()];
+        EXPECT_NE(ecm.GetChannelForEndpoint(endpoint_id), nullptr);
+      }
+    });
+  }
+  threads.emplace_back([&]() {
+    for (int i = 0; i < kReplacements; ++i) {
+      ecm.ReplaceChannelForEndpoint(&proxy, endpoint_ids[i % kEndpoints],
+                                    channels[kEndpoints + i]->Release(),
+                                    /*enable_encryption=*/false);
+    }
+  });
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(ecm.GetConnectedEndpointsCount(), kEndpoints);
+  for (int i = 0; i < kEndpoints; ++i) {
+    EXPECT_EQ(ecm.GetChannelForEndpoint(endpoint_ids[i]).get(),
+              final_channels[i]);
+  }
+}
+
+TEST(BaseEndpointChannelManagerTest, LookupDoesNotWaitForUnregister) {
+  absl::Notification write_started;
+  absl::Notification release_write;
+  ChannelWithPipes channel_a(&write_started, &release_write);
+  ChannelWithPipes channel_b;
+  ClientProxy proxy;
+  EndpointChannelManager ecm;
+  ecm.RegisterChannelForEndpoint(&proxy, "A", channel_a.Release());
+  ecm.RegisterChannelForEndpoint(&proxy, "B", channel_b.Release());
+
+  // Unregistering an open channel writes a DISCONNECTION frame while holding
+  // the manager's lock; the write is held until the lookup is done.
+  std::thread unregister([&]() {
+    EXPECT_TRUE(ecm.UnregisterChannelForEndpoint(
+        "A", DisconnectionReason::LOCAL_DISCONNECTION,
+        ConnectionsLog::EstablishedConnection::SAFE_DISCONNECTION));
+  });
+  write_started.WaitForNotification();
+
+  // A lookup that took the manager's lock could only finish after the write
+  // is released.
+  absl::Notification looked_up;
+  std::thread lookup([&]() {
+    EXPECT_NE(ecm.GetChannelForEndpoint("B"), nullptr);
+    looked_up.Notify();
+  });
+  EXPECT_TRUE(looked_up.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  release_write.Notify();
+  lookup.join();
+  unregister.join();
+  EXPECT_EQ(ecm.GetChannelForEndpoint("A"), nullptr);
+  EXPECT_NE(ecm.GetChannelForEndpoint("B"), nullptr);
+}
+
+TEST(BaseEndpointChannelManagerTest, WritersDoNotSeeChannelDuringUnregister) {
+  absl::Notification write_started;
+  absl::Notification release_write;
+  ChannelWithPipes channel(&write_started, &release_write);
+  ClientProxy proxy;
+  EndpointChannelManager ecm;
+  ecm.RegisterChannelForEndpoint(&proxy, "A", channel.Release());
+
+  std::thread unregister([&]() {
+    EXPECT_TRUE(ecm.UnregisterChannelForEndpoint(
+        "A", DisconnectionReason::LOCAL_DISCONNECTION,
+        ConnectionsLog::EstablishedConnection::SAFE_DISCONNECTION));
+  });
+  write_started.WaitForNotification();
+
+  // The DISCONNECTION frame is being written; a writer sending a frame now
+  // must not find the channel to send it after that one.
+  absl::Notification written;
+  std::thread writer([&]() {
+    std::shared_ptr<EndpointChannel> writer_channel =
+        ecm.GetChannelForEndpoint("A");
+    EXPECT_EQ(writer_channel, nullptr);
+    if (writer_channel != nullptr) {
+      writer_channel->Write(ByteArray("late frame"));
+    }
+    written.Notify();
+  });
+  EXPECT_TRUE(written.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  release_write.Notify();
+  writer.join();
+  unregister.join();
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -29,6 +30,7 @@
 #include "connections/implementation/client_proxy.h"
 #include "connections/implementation/endpoint_channel.h"
 #include "connections/implementation/endpoint_channel_manager.h"
+#include "connections/implementation/keep_alive_scheduler.h"
 #include "connections/implementation/offline_frames.h"
 #include "connections/implementation/payload_manager.h"
 #include "connections/implementation/proto/offline_wire_formats.pb.h"
@@ -69,6 +71,9 @@ constexpr absl::Time kInvalidTimestamp = absl::InfinitePast();
 // The maximum time we will wait for the encryption setup during negotiating a
 // connection.
 constexpr absl::Duration kDecryptRetryTimeout = absl::Seconds(3);
+// How long to wait before retrying a KeepAlive frame on a paused or busy
+// channel.
+constexpr absl::Duration kBusyChannelKeepAliveRetryDelay = absl::Seconds(1);
 }  // namespace
 
 class EndpointManager::LockedFrameProcessor {
@@ -234,6 +239,12 @@ ExceptionOr<bool> EndpointManager::HandleData(
   // a replacement for this endpoint since we last checked with the
   // EndpointChannelManager.
   while (true) {
+    // Hold off reading while the client holds too much data from this
+    // endpoint, so that the transport slows the remote side down.
+    if (!client->GetMemoryAccountant()->WaitForCapacity(endpoint_id)) {
+      NEARBY_LOGS(WARNING) << "Reading from endpoint " << endpoint_id
+                           << " over its memory soft limit";
+    }
     PacketMetaData packet_meta_data;
     ExceptionOr<ByteArray> bytes = endpoint_channel->Read(packet_meta_data);
     if (!bytes.ok()) {
@@ -357,8 +368,8 @@ void EndpointManager::ProcessDisconnectionFrame(
 
 ExceptionOr<bool> EndpointManager::HandleKeepAlive(
     EndpointChannel* endpoint_channel, absl::Duration keep_alive_interval,
-    absl::Duration keep_alive_timeout, Mutex* keep_alive_waiter_mutex,
-    ConditionVariable* keep_alive_waiter) {
+    absl::Duration keep_alive_timeout, absl::Duration write_slack,
+    absl::Duration* next_check) {
   // Check if it has been too long since we received a frame from our endpoint.
   absl::Time last_read_time = endpoint_channel->GetLastReadTimestamp();
   absl::Duration duration_until_timeout =
@@ -372,33 +383,81 @@ ExceptionOr<bool> EndpointManager::HandleKeepAlive(
 
   // If we haven't written anything to the endpoint for a while, attempt to
   // send the KeepAlive frame over the endpoint channel. If the write fails,
-  // our super class will loop back around and try our luck again in case
-  // there's been a replacement for this endpoint.
+  // RunKeepAliveCheck() will try our luck again in case there's been a
+  // replacement for this endpoint. A frame that would be due shortly is sent
+  // early, so that it goes out together with those of other endpoints.
   absl::Time last_write_time = endpoint_channel->GetLastWriteTimestamp();
   absl::Duration duration_until_write_keep_alive =
       last_write_time == kInvalidTimestamp
           ? keep_alive_interval
           : last_write_time + keep_alive_interval -
                 SystemClock::ElapsedRealtime();
-  if (duration_until_write_keep_alive <= absl::ZeroDuration()) {
-    Exception write_exception = endpoint_channel->Write(parser::ForKeepAlive());
-    if (!write_exception.Ok()) {
-      return ExceptionOr<bool>(write_exception);
+  write_slack = std::min(write_slack, keep_alive_interval / 2);
+  if (duration_until_write_keep_alive <= write_slack) {
+    // A blocking write would stall the KeepAlive checks of every other
+    // endpoint, so back off while the channel is paused or busy writing.
+    std::optional<Exception> write_exception =
+        endpoint_channel->TryWrite(parser::ForKeepAlive());
+    if (!write_exception.has_value()) {
+      duration_until_write_keep_alive = kBusyChannelKeepAliveRetryDelay;
+    } else if (!write_exception->Ok()) {
+      return ExceptionOr<bool>(*write_exception);
+    } else {
+      duration_until_write_keep_alive = keep_alive_interval;
     }
-    duration_until_write_keep_alive = keep_alive_interval;
   }
 
-  absl::Duration wait_for =
+  *next_check =
       std::min(duration_until_timeout, duration_until_write_keep_alive);
-  {
-    MutexLock lock(keep_alive_waiter_mutex);
-    Exception wait_exception = keep_alive_waiter->Wait(wait_for);
-    if (!wait_exception.Ok()) {
-      return ExceptionOr<bool>(wait_exception);
+  return ExceptionOr<bool>(true);
+}
+
+std::optional<absl::Duration> EndpointManager::RunKeepAliveCheck(
+    ClientProxy* client, const std::string& endpoint_id,
+    absl::Duration keep_alive_interval, absl::Duration keep_alive_timeout,
+    absl::Duration write_slack, Medium* last_failed_medium) {
+  while (true) {
+    std::shared_ptr<EndpointChannel> channel =
+        channel_manager_->GetChannelForEndpoint(endpoint_id);
+    if (channel == nullptr) {
+      NEARBY_LOGS(INFO) << "Endpoint channel is nullptr, bail out.";
+      break;
+    }
+    if ((*last_failed_medium != Medium::UNKNOWN_MEDIUM) &&
+        (channel->GetMedium() == *last_failed_medium)) {
+      NEARBY_LOGS(INFO)
+          << "No new endpoint channel is found after a failure, exit loop.";
+      break;
     }
-  }
 
-  return ExceptionOr<bool>(true);
+    absl::Duration next_check;
+    ExceptionOr<bool> keep_using_channel =
+        HandleKeepAlive(channel.get(), keep_alive_interval, keep_alive_timeout,
+                        write_slack, &next_check);
+    if (keep_using_channel.ok()) {
+      return next_check;
+    }
+    if (keep_using_channel.GetException().Raised(Exception::kIo)) {
+      *last_failed_medium = channel->GetMedium();
+      NEARBY_LOGS(INFO)
+          << "Endpoint channel IO exception; last_failed_medium="
+          << location::nearby::proto::connections::Medium_Name(
+                 *last_failed_medium);
+      continue;
+    }
+    NEARBY_LOGS(INFO) << "Dropping current channel: last medium="
+                      << location::nearby::proto::connections::Medium_Name(
+                             *last_failed_medium);
+    if (client->IsSafeToDisconnectEnabled(endpoint_id)) {
+      channel_manager_->MarkEndpointStopWaitToDisconnect(
+          endpoint_id, /* is_safe_to_disconnect */ false,
+          /* notify_stop_waiting */ true);
+    }
+    break;
+  }
+  NEARBY_LOGS(INFO) << "KeepAlive going down; endpoint_id=" << endpoint_id;
+  DiscardEndpoint(client, endpoint_id, DisconnectionReason::IO_ERROR);
+  return std::nullopt;
 }
 
 bool operator==(const EndpointManager::FrameProcessor& lhs,
@@ -560,7 +619,9 @@ void EndpointManager::RegisterEndpoint(
 
     EndpointState& endpoint_state =
         endpoints_
-            .emplace(endpoint_id, EndpointState(endpoint_id, channel_manager_))
+            .emplace(endpoint_id,
+                     EndpointState(endpoint_id, channel_manager_,
+                                   &keep_alive_scheduler_))
             .first->second;
 
     NEARBY_LOGS(INFO) << "Starting workers: endpoint " << endpoint_id;
@@ -579,10 +640,10 @@ void EndpointManager::RegisterEndpoint(
           });
     });
 
-    // For every endpoint, there's only one KeepAliveManager instance
-    // running on a dedicated thread. This instance will periodically send
-    // out a ping* to the endpoint while listening for an incoming pong**.
-    // If it fails to send the ping, or if no pong is heard within
+    // For every endpoint, there's only one KeepAlive check scheduled on
+    // the thread shared by all endpoints. It will periodically send out a
+    // ping* to the endpoint while listening for an incoming pong**. If it
+    // fails to send the ping, or if no pong is heard within
     // keep_alive_timeout, it initiates a disconnection.
     //
     // (*) Bluetooth requires a constant outgoing stream of messages. If
@@ -594,18 +655,12 @@ void EndpointManager::RegisterEndpoint(
     NEARBY_VLOG(1) << "EndpointManager enabling KeepAlive for endpoint "
                    << endpoint_id;
     endpoint_state.StartEndpointKeepAliveManager(
-        [this, client, endpoint_id, keep_alive_interval, keep_alive_timeout](
-            Mutex* keep_alive_waiter_mutex,
-            ConditionVariable* keep_alive_waiter) {
-          EndpointChannelLoopRunnable(
-              "KeepAliveManager", client, endpoint_id,
-              [this, keep_alive_interval, keep_alive_timeout,
-               keep_alive_waiter_mutex,
-               keep_alive_waiter](EndpointChannel* channel) {
-                return HandleKeepAlive(
-                    channel, keep_alive_interval, keep_alive_timeout,
-                    keep_alive_waiter_mutex, keep_alive_waiter);
-              });
+        [this, client, endpoint_id, keep_alive_interval, keep_alive_timeout,
+         last_failed_medium = Medium::UNKNOWN_MEDIUM](
+            absl::Duration write_slack) mutable {
+          return RunKeepAliveCheck(client, endpoint_id, keep_alive_interval,
+                                   keep_alive_timeout, write_slack,
+                                   &last_failed_medium);
         });
     NEARBY_LOGS(INFO) << "Registering endpoint " << endpoint_id
                       << ", workers started and notifying client.";
@@ -973,10 +1028,9 @@ EndpointManager::EndpointState::~EndpointState() {
         ConnectionsLog::EstablishedConnection::SAFE_DISCONNECTION);
   }
 
-  // Make sure the KeepAlive thread isn't blocking shutdown.
-  if (keep_alive_waiter_mutex_ && keep_alive_waiter_) {
-    MutexLock lock(keep_alive_waiter_mutex_.get());
-    keep_alive_waiter_->Notify();
+  // Stop the KeepAlive check; this waits for it if it is running.
+  if (keep_alive_scheduler_) {
+    keep_alive_scheduler_->RemoveEndpoint(endpoint_id_);
   }
 }
 
@@ -985,13 +1039,8 @@ void EndpointManager::EndpointState::StartEndpointReader(Runnable&& runnable) {
 }
 
 void EndpointManager::EndpointState::StartEndpointKeepAliveManager(
-    absl::AnyInvocable<void(Mutex*, ConditionVariable*)> runnable) {
-  keep_alive_thread_.Execute(
-      "keep-alive", [runnable = std::move(runnable),
-                     keep_alive_waiter_mutex = keep_alive_waiter_mutex_.get(),
-                     keep_alive_waiter = keep_alive_waiter_.get()]() mutable {
-        runnable(keep_alive_waiter_mutex, keep_alive_waiter);
-      });
+    KeepAliveScheduler::Check check) {
+  keep_alive_scheduler_->AddEndpoint(endpoint_id_, std::move(check));
 }
 
 void EndpointManager::RunOnEndpointManagerThread(const std::string& name,
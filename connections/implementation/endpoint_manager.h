@@ -18,6 +18,7 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -31,6 +32,7 @@
 #include "connections/implementation/client_proxy.h"
 #include "connections/implementation/endpoint_channel.h"
 #include "connections/implementation/endpoint_channel_manager.h"
+#include "connections/implementation/keep_alive_scheduler.h"
 #include "connections/implementation/proto/offline_wire_formats.pb.h"
 #include "connections/listeners.h"
 #include "internal/platform/byte_array.h"
@@ -150,7 +152,7 @@ class EndpointManager {
   //    a) We failed to read from the endpoint in its dedicated reader thread.
   //    b) We failed to write to the endpoint in PayloadManager.
   //    c) The connection was rejected in PCPHandler.
-  //    d) The dedicated KeepAlive thread exceeded its period of inactivity.
+  //    d) The endpoint's KeepAlive check exceeded its period of inactivity.
   // Or in the numerous other cases where a failure occurred and we no longer
   // believe the endpoint is in a healthy state.
   //
@@ -170,12 +172,11 @@ class EndpointManager {
   class EndpointState {
    public:
     EndpointState(const std::string& endpoint_id,
-                  EndpointChannelManager* channel_manager)
+                  EndpointChannelManager* channel_manager,
+                  KeepAliveScheduler* keep_alive_scheduler)
         : endpoint_id_{endpoint_id},
           channel_manager_{channel_manager},
-          keep_alive_waiter_mutex_{std::make_unique<Mutex>()},
-          keep_alive_waiter_{std::make_unique<ConditionVariable>(
-              keep_alive_waiter_mutex_.get())} {}
+          keep_alive_scheduler_{keep_alive_scheduler} {}
 
     EndpointState(const EndpointState&) = delete;
     // The default move constructor would not reset |channel_manager_|, for
@@ -184,32 +185,21 @@ class EndpointManager {
     EndpointState(EndpointState&& other)
         : endpoint_id_{std::move(other.endpoint_id_)},
           channel_manager_{std::exchange(other.channel_manager_, nullptr)},
-          reader_thread_{std::move(other.reader_thread_)},
-          keep_alive_waiter_mutex_{
-              std::exchange(other.keep_alive_waiter_mutex_, nullptr)},
-          keep_alive_waiter_{std::exchange(other.keep_alive_waiter_, nullptr)},
-          keep_alive_thread_{std::move(other.keep_alive_thread_)} {}
+          keep_alive_scheduler_{
+              std::exchange(other.keep_alive_scheduler_, nullptr)},
+          reader_thread_{std::move(other.reader_thread_)} {}
     EndpointState& operator=(const EndpointState&) = delete;
     EndpointState&& operator=(EndpointState&&) = delete;
     ~EndpointState();
 
     void StartEndpointReader(Runnable&& runnable);
-    void StartEndpointKeepAliveManager(
-        absl::AnyInvocable<void(Mutex*, ConditionVariable*)> runnable);
+    void StartEndpointKeepAliveManager(KeepAliveScheduler::Check check);
 
    private:
     const std::string endpoint_id_;
     EndpointChannelManager* channel_manager_;
+    KeepAliveScheduler* keep_alive_scheduler_;
     SingleThreadExecutor reader_thread_;
-
-    // Use a condition variable so we can wait on the thread but still be able
-    // to wake it up before shutting down. We don't want to just sleep and risk
-    // blocking shutdown. Note: Create the mutex/condition variable on the heap
-    // so raw pointers sent to HandleKeepAlive() aren't invalidated during
-    // std::move operations.
-    mutable std::unique_ptr<Mutex> keep_alive_waiter_mutex_;
-    std::unique_ptr<ConditionVariable> keep_alive_waiter_;
-    SingleThreadExecutor keep_alive_thread_;
   };
 
   // RAII accessor for FrameProcessor
@@ -235,11 +225,26 @@ class EndpointManager {
                                ClientProxy* client_proxy,
                                EndpointChannel* endpoint_channel);
 
+  // Sends a KeepAlive frame if one is due within `write_slack` and sets
+  // `next_check` to the time until the next frame or timeout is due. Returns
+  // false if the endpoint has been silent for longer than
+  // `keep_alive_timeout`. Never blocks, since it runs on the thread shared by
+  // all endpoints.
   ExceptionOr<bool> HandleKeepAlive(EndpointChannel* endpoint_channel,
                                     absl::Duration keep_alive_interval,
                                     absl::Duration keep_alive_timeout,
-                                    Mutex* keep_alive_waiter_mutex,
-                                    ConditionVariable* keep_alive_waiter);
+                                    absl::Duration write_slack,
+                                    absl::Duration* next_check);
+
+  // One round of the KeepAlive check for `endpoint_id`, run by
+  // `keep_alive_scheduler_`. Mirrors EndpointChannelLoopRunnable(): retries
+  // on a replacement channel after an IO error, and discards the endpoint
+  // when there is none. Returns std::nullopt once the endpoint is discarded.
+  std::optional<absl::Duration> RunKeepAliveCheck(
+      ClientProxy* client, const std::string& endpoint_id,
+      absl::Duration keep_alive_interval, absl::Duration keep_alive_timeout,
+      absl::Duration write_slack,
+      location::nearby::proto::connections::Medium* last_failed_medium);
 
   // Waits for a given endpoint EndpointChannelLoopRunnable() workers to
   // terminate.
@@ -299,6 +304,10 @@ class EndpointManager {
                       FrameProcessorWithMutex>
       frame_processors_ ABSL_GUARDED_BY(frame_processors_lock_);
 
+  // Runs the KeepAlive checks of all endpoints on one thread. Must outlive
+  // `endpoints_`.
+  KeepAliveScheduler keep_alive_scheduler_;
+
   // We keep track of all registered channel endpoints here.
   absl::flat_hash_map<std::string, EndpointState> endpoints_;
 
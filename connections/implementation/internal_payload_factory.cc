@@ -22,7 +22,9 @@
 
 #include "absl/strings/str_cat.h"
 #include "connections/implementation/internal_payload.h"
+#include "connections/implementation/memory_accountant.h"
 #include "connections/implementation/proto/offline_wire_formats.pb.h"
+#include "connections/implementation/write_behind_file.h"
 #include "connections/payload.h"
 #include "connections/payload_type.h"
 #include "internal/platform/byte_array.h"
@@ -267,7 +269,7 @@ class IncomingFileInternalPayload : public InternalPayload {
   IncomingFileInternalPayload(Payload payload, OutputFile output_file,
                               std::int64_t total_size)
       : InternalPayload(std::move(payload)),
-        output_file_(std::move(output_file)),
+        output_file_(std::move(output_file), total_size),
         total_size_(total_size) {}
 
   location::nearby::connections::PayloadTransferFrame::PayloadHeader::
@@ -283,9 +285,9 @@ class IncomingFileInternalPayload : public InternalPayload {
 
   Exception AttachNextChunk(const ByteArray& chunk) override {
     if (chunk.Empty()) {
-      // Received null last chunk for incoming payload.
-      output_file_.Close();
-      return {Exception::kSuccess};
+      // Received null last chunk for incoming payload. Closing waits for the
+      // queued writes, so a failure to write them fails the payload.
+      return output_file_.Close();
     }
 
     return output_file_.Write(chunk);
@@ -297,10 +299,12 @@ class IncomingFileInternalPayload : public InternalPayload {
     return {Exception::kIo};
   }
 
-  void Close() override { output_file_.Close(); }
+  // Called on completion as well as on cancellation or failure; only the
+  // latter has anything left to drop.
+  void Close() override { output_file_.Abort(); }
 
  private:
-  OutputFile output_file_;
+  WriteBehindFile output_file_;
   const std::int64_t total_size_;
 };
 
@@ -352,7 +356,9 @@ std::string make_path(const std::string& custom_save_path,
 
 std::unique_ptr<InternalPayload> CreateIncomingInternalPayload(
     const location::nearby::connections::PayloadTransferFrame& frame,
-    const std::string& custom_save_path) {
+    const std::string& custom_save_path,
+    std::shared_ptr<MemoryAccountant> memory_accountant,
+    const std::string& endpoint_id) {
   if (frame.packet_type() !=
       location::nearby::connections::PayloadTransferFrame::DATA) {
     return {};
@@ -366,7 +372,10 @@ std::unique_ptr<InternalPayload> CreateIncomingInternalPayload(
     }
 
     case PayloadTransferFrame::PayloadHeader::STREAM: {
-      auto [input, output] = CreatePipe();
+      auto [input, output] =
+          memory_accountant != nullptr
+              ? CreateAccountedPipe(std::move(memory_accountant), endpoint_id)
+              : CreatePipe();
 
       return std::make_unique<IncomingStreamInternalPayload>(
           Payload(payload_id, std::move(input)), std::move(output));
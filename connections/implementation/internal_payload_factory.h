@@ -20,6 +20,7 @@
 #include <memory>
 
 #include "connections/implementation/internal_payload.h"
+#include "connections/implementation/memory_accountant.h"
 #include "connections/payload.h"
 
 namespace nearby {
@@ -29,10 +30,13 @@ namespace connections {
 std::unique_ptr<InternalPayload> CreateOutgoingInternalPayload(Payload payload);
 
 // Creates an InternalPayload representing an incoming Payload from a remote
-// endpoint.
+// endpoint. If `memory_accountant` is set, the data that a STREAM payload
+// buffers is charged to `endpoint_id`.
 std::unique_ptr<InternalPayload> CreateIncomingInternalPayload(
     const location::nearby::connections::PayloadTransferFrame& frame,
-    const std::string& custom_save_path);
+    const std::string& custom_save_path,
+    std::shared_ptr<MemoryAccountant> memory_accountant = nullptr,
+    const std::string& endpoint_id = "");
 
 }  // namespace connections
 }  // namespace nearby
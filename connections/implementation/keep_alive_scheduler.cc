@@ -0,0 +1,139 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/implementation/keep_alive_scheduler.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "internal/platform/implementation/system_clock.h"
+#include "internal/platform/logging.h"
+#include "internal/platform/mutex_lock.h"
+
+namespace nearby {
+namespace connections {
+
+KeepAliveScheduler::KeepAliveScheduler(absl::Duration batch_window)
+    : batch_window_(batch_window) {
+  executor_.Execute("keep-alive", [this]() { Loop(); });
+}
+
+KeepAliveScheduler::~KeepAliveScheduler() {
+  Shutdown();
+  executor_.Shutdown();
+}
+
+void KeepAliveScheduler::AddEndpoint(const std::string& endpoint_id,
+                                     Check check) {
+  MutexLock lock(&mutex_);
+  if (shutdown_) return;
+  while (running_.has_value() && *running_ == endpoint_id) {
+    check_done_.Wait();
+  }
+  RemoveEntryLocked(endpoint_id);
+  absl::Time deadline = SystemClock::ElapsedRealtime();
+  entries_.emplace(endpoint_id, std::make_unique<Entry>(Entry{
+                                    .check = std::move(check),
+                                    .deadline = deadline,
+                                }));
+  queue_.emplace(deadline, endpoint_id);
+  wake_up_.Notify();
+}
+
+void KeepAliveScheduler::RemoveEndpoint(const std::string& endpoint_id) {
+  MutexLock lock(&mutex_);
+  while (running_.has_value() && *running_ == endpoint_id) {
+    check_done_.Wait();
+  }
+  RemoveEntryLocked(endpoint_id);
+}
+
+void KeepAliveScheduler::Shutdown() {
+  MutexLock lock(&mutex_);
+  shutdown_ = true;
+  wake_up_.Notify();
+}
+
+KeepAliveScheduler::Stats KeepAliveScheduler::GetStats() const {
+  MutexLock lock(&mutex_);
+  return stats_;
+}
+
+void KeepAliveScheduler::RemoveEntryLocked(const std::string& endpoint_id) {
+  auto item = entries_.find(endpoint_id);
+  if (item == entries_.end()) return;
+  queue_.erase({item->second->deadline, endpoint_id});
+  entries_.erase(item);
+}
+
+void KeepAliveScheduler::Loop() {
+  MutexLock lock(&mutex_);
+  while (!shutdown_) {
+    absl::Time now = SystemClock::ElapsedRealtime();
+    if (queue_.empty() || queue_.begin()->first > now) {
+      if (queue_.empty()) {
+        wake_up_.Wait();
+      } else {
+        wake_up_.Wait(queue_.begin()->first - now);
+      }
+      ++stats_.wakeups;
+      continue;
+    }
+
+    // Take everything that falls due within the batch window.
+    std::vector<std::pair<absl::Time, std::string>> batch;
+    while (!queue_.empty() && queue_.begin()->first <= now + batch_window_) {
+      batch.push_back(std::move(queue_.extract(queue_.begin()).value()));
+    }
+    NEARBY_VLOG(1) << "Running " << batch.size() << " keep-alive checks";
+
+    for (const auto& [deadline, endpoint_id] : batch) {
+      if (shutdown_) break;
+      auto item = entries_.find(endpoint_id);
+      if (item == entries_.end()) continue;
+      Entry* entry = item->second.get();
+      // The endpoint was added again after it was taken into the batch. A new
+      // entry due later waits for its own turn; one due now runs here, so
+      // drop its queued copy.
+      if (entry->deadline != deadline) continue;
+      queue_.erase({deadline, endpoint_id});
+      running_ = endpoint_id;
+      std::optional<absl::Duration> next_check;
+      {
+        // RemoveEndpoint() waits for `running_` to clear, so `entry` stays
+        // valid while unlocked.
+        mutex_.Unlock();
+        next_check = entry->check(batch_window_);
+        mutex_.Lock();
+      }
+      running_.reset();
+      ++stats_.checks;
+      check_done_.Notify();
+
+      if (!next_check.has_value()) {
+        entries_.erase(endpoint_id);
+        continue;
+      }
+      entry->deadline = SystemClock::ElapsedRealtime() + *next_check;
+      queue_.emplace(entry->deadline, endpoint_id);
+    }
+  }
+}
+
+}  // namespace connections
+}  // namespace nearby
@@ -0,0 +1,117 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_KEEP_ALIVE_SCHEDULER_H_
+#define CORE_INTERNAL_KEEP_ALIVE_SCHEDULER_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/btree_set.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/time/time.h"
+#include "internal/platform/condition_variable.h"
+#include "internal/platform/mutex.h"
+#include "internal/platform/single_thread_executor.h"
+
+namespace nearby {
+namespace connections {
+
+// Runs the keep-alive checks of all endpoints of an EndpointManager on a
+// single thread.
+//
+// Each endpoint is kept in a deadline-ordered queue. When the earliest check
+// falls due, every other check due within the batch window runs with it, so
+// keep-alive frames that would go out close together are written in one
+// burst instead of waking the radio several times.
+class KeepAliveScheduler {
+ public:
+  // Keep-alive writes due within `write_slack` should be sent right away.
+  // Returns the delay until the endpoint wants to be checked again, or
+  // std::nullopt to stop checking it.
+  using Check =
+      absl::AnyInvocable<std::optional<absl::Duration>(absl::Duration)>;
+
+  struct Stats {
+    // Number of times the scheduler thread woke up.
+    std::int64_t wakeups = 0;
+    // Number of checks run.
+    std::int64_t checks = 0;
+  };
+
+  static constexpr absl::Duration kDefaultBatchWindow = absl::Seconds(1);
+
+  explicit KeepAliveScheduler(
+      absl::Duration batch_window = kDefaultBatchWindow);
+  ~KeepAliveScheduler();
+
+  KeepAliveScheduler(const KeepAliveScheduler&) = delete;
+  KeepAliveScheduler& operator=(const KeepAliveScheduler&) = delete;
+
+  // Starts checking `endpoint_id`; the first check runs right away. Replaces
+  // the check of an endpoint that is already tracked, waiting for it to
+  // return if it is running. Must not be called from a Check.
+  void AddEndpoint(const std::string& endpoint_id, Check check)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Stops checking `endpoint_id`. If its check is running, waits for it to
+  // return. Must not be called from a Check.
+  void RemoveEndpoint(const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Stops the scheduler thread. Endpoints still tracked are dropped.
+  void Shutdown() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  Stats GetStats() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    Check check;
+    absl::Time deadline;
+  };
+
+  void Loop() ABSL_LOCKS_EXCLUDED(mutex_);
+  void RemoveEntryLocked(const std::string& endpoint_id)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const absl::Duration batch_window_;
+
+  mutable Mutex mutex_;
+  // Wakes the scheduler thread when the earliest deadline moves up.
+  ConditionVariable wake_up_{&mutex_};
+  // Signalled when a check returns.
+  ConditionVariable check_done_{&mutex_};
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+  // Entries are boxed so their checks can run without `mutex_` held while
+  // other endpoints are added.
+  absl::flat_hash_map<std::string, std::unique_ptr<Entry>> entries_
+      ABSL_GUARDED_BY(mutex_);
+  absl::btree_set<std::pair<absl::Time, std::string>> queue_
+      ABSL_GUARDED_BY(mutex_);
+  // The endpoint whose check is running, if any.
+  std::optional<std::string> running_ ABSL_GUARDED_BY(mutex_);
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+
+  SingleThreadExecutor executor_;
+};
+
+}  // namespace connections
+}  // namespace nearby
+
+#endif  // CORE_INTERNAL_KEEP_ALIVE_SCHEDULER_H_
@@ -0,0 +1,277 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/implementation/keep_alive_scheduler.h"
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "internal/platform/count_down_latch.h"
+#include "internal/platform/medium_environment.h"
+#include "internal/platform/system_clock.h"
+#include "internal/test/fake_clock.h"
+
+namespace nearby {
+namespace connections {
+namespace {
+
+// The scheduler runs in virtual time: the clock only moves while the
+// scheduler thread waits, and then jumps straight to its next deadline.
+class KeepAliveSchedulerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    MediumEnvironment::Instance().Start({.use_virtual_time = true});
+    clock_ = MediumEnvironment::Instance().GetSimulatedClock().value();
+  }
+  void TearDown() override { MediumEnvironment::Instance().Stop(); }
+
+  // Keeps the scheduler thread busy, and so the clock still, until `release`
+  // is notified. Endpoints added meanwhile all start at the same time.
+  static void Hold(KeepAliveScheduler& scheduler, absl::Notification& release) {
+    absl::Notification held;
+    scheduler.AddEndpoint(
+        "hold", [&held, &release](
+                    absl::Duration) -> std::optional<absl::Duration> {
+          held.Notify();
+          release.WaitForNotification();
+          return std::nullopt;
+        });
+    held.WaitForNotification();
+  }
+
+  FakeClock* clock_ = nullptr;
+};
+
+TEST_F(KeepAliveSchedulerTest, RunsFirstCheckRightAway) {
+  KeepAliveScheduler scheduler;
+  absl::Notification checked;
+  absl::Time start = clock_->Now();
+  absl::Time checked_at;
+  scheduler.AddEndpoint("A", [&](absl::Duration) {
+    if (!checked.HasBeenNotified()) {
+      checked_at = clock_->Now();
+      checked.Notify();
+    }
+    return absl::Hours(1);
+  });
+  checked.WaitForNotification();
+  EXPECT_EQ(checked_at, start);
+}
+
+TEST_F(KeepAliveSchedulerTest, ReschedulesAfterReturnedDelay) {
+  constexpr int kChecks = 5;
+  KeepAliveScheduler scheduler(absl::ZeroDuration());
+  absl::Notification done;
+  std::vector<absl::Time> checked_at;
+  scheduler.AddEndpoint(
+      "A", [&](absl::Duration) -> std::optional<absl::Duration> {
+        checked_at.push_back(clock_->Now());
+        if (checked_at.size() == kChecks) {
+          done.Notify();
+          return std::nullopt;
+        }
+        return absl::Milliseconds(20);
+      });
+  done.WaitForNotification();
+
+  ASSERT_EQ(checked_at.size(), kChecks);
+  for (int i = 1; i < kChecks; ++i) {
+    EXPECT_EQ(checked_at[i] - checked_at[i - 1], absl::Milliseconds(20));
+  }
+}
+
+TEST_F(KeepAliveSchedulerTest, StopsWhenCheckReturnsNullopt) {
+  KeepAliveScheduler scheduler;
+  std::atomic<int> checks = 0;
+  scheduler.AddEndpoint("A",
+                        [&checks](absl::Duration)
+                            -> std::optional<absl::Duration> {
+                          ++checks;
+                          return std::nullopt;
+                        });
+  // By the time "B" is checked an hour later, "A" would have been checked
+  // again had it stayed scheduled.
+  absl::Notification later;
+  scheduler.AddEndpoint("B", [&later, first = true](absl::Duration) mutable {
+    if (first) {
+      first = false;
+      return absl::Hours(1);
+    }
+    if (!later.HasBeenNotified()) later.Notify();
+    return absl::Hours(1);
+  });
+  later.WaitForNotification();
+  EXPECT_EQ(checks, 1);
+}
+
+TEST_F(KeepAliveSchedulerTest, RemoveWaitsForRunningCheck) {
+  KeepAliveScheduler scheduler;
+  absl::Notification started;
+  std::atomic<bool> finished = false;
+  scheduler.AddEndpoint("A", [&](absl::Duration) {
+    started.Notify();
+    SystemClock::Sleep(absl::Milliseconds(100));
+    finished = true;
+    return absl::Hours(1);
+  });
+  started.WaitForNotification();
+  scheduler.RemoveEndpoint("A");
+  EXPECT_TRUE(finished);
+}
+
+TEST_F(KeepAliveSchedulerTest, BatchesChecksDueWithinWindow) {
+  constexpr absl::Duration kWindow = absl::Milliseconds(50);
+  KeepAliveScheduler scheduler(kWindow);
+  absl::Notification release;
+  Hold(scheduler, release);
+  absl::Time start = clock_->Now();
+
+  absl::Mutex mutex;
+  std::vector<absl::Time> second_round;
+  absl::Duration slack_seen;
+  CountDownLatch second_round_done(2);
+  for (int i = 0; i < 2; ++i) {
+    // The two checks fall due 20 ms apart.
+    absl::Duration delay = absl::Milliseconds(100 + 20 * i);
+    scheduler.AddEndpoint(
+        absl::StrCat("E", i), [&, delay, first = true](
+                                  absl::Duration write_slack) mutable {
+          absl::MutexLock lock(&mutex);
+          slack_seen = write_slack;
+          if (first) {
+            first = false;
+            return delay;
+          }
+          second_round.push_back(clock_->Now());
+          second_round_done.CountDown();
+          return absl::Hours(1);
+        });
+  }
+  release.Notify();
+  second_round_done.Await();
+
+  absl::MutexLock lock(&mutex);
+  EXPECT_EQ(second_round,
+            std::vector<absl::Time>(2, start + absl::Milliseconds(100)));
+  EXPECT_EQ(slack_seen, kWindow);
+}
+
+TEST_F(KeepAliveSchedulerTest, ReAddingDuringBatchDoesNotDuplicateChecks) {
+  constexpr int kChecks = 3;
+  constexpr absl::Duration kInterval = absl::Milliseconds(100);
+  KeepAliveScheduler scheduler(absl::ZeroDuration());
+  absl::Notification release;
+  Hold(scheduler, release);
+  absl::Time start = clock_->Now();
+
+  // "A" and "B" fall due together; "B" is added again while "A" runs.
+  absl::Notification a_started;
+  absl::Notification a_release;
+  scheduler.AddEndpoint("A", [&](absl::Duration) {
+    a_started.Notify();
+    a_release.WaitForNotification();
+    return absl::Hours(1);
+  });
+  scheduler.AddEndpoint("B", [](absl::Duration) {
+    ADD_FAILURE() << "Replaced check ran";
+    return absl::Hours(1);
+  });
+  release.Notify();
+  a_started.WaitForNotification();
+
+  absl::Notification done;
+  std::vector<absl::Time> checked_at;
+  scheduler.AddEndpoint(
+      "B", [&](absl::Duration) -> std::optional<absl::Duration> {
+        checked_at.push_back(clock_->Now());
+        if (checked_at.size() == kChecks) {
+          done.Notify();
+          return std::nullopt;
+        }
+        return kInterval;
+      });
+  a_release.Notify();
+  done.WaitForNotification();
+  scheduler.RemoveEndpoint("A");
+  scheduler.RemoveEndpoint("B");
+
+  std::vector<absl::Time> expected;
+  for (int i = 0; i < kChecks; ++i) expected.push_back(start + kInterval * i);
+  EXPECT_EQ(checked_at, expected);
+  // "B"'s checks, plus "A" once and the one that held the scheduler.
+  EXPECT_EQ(scheduler.GetStats().checks, kChecks + 2);
+}
+
+TEST_F(KeepAliveSchedulerTest, ManyEndpointsShareOneThread) {
+  constexpr int kEndpoints = 64;
+  constexpr int kChecks = 4;
+  constexpr absl::Duration kInterval = absl::Milliseconds(100);
+  constexpr absl::Duration kWindow = absl::Milliseconds(20);
+  KeepAliveScheduler scheduler(kWindow);
+  absl::Notification release;
+  Hold(scheduler, release);
+
+  absl::Mutex mutex;
+  absl::flat_hash_set<std::thread::id> threads;
+  CountDownLatch done(kEndpoints);
+  for (int i = 0; i < kEndpoints; ++i) {
+    // Spread the endpoints over the interval, like connections that were
+    // established at different times.
+    absl::Duration phase = kInterval * i / kEndpoints;
+    scheduler.AddEndpoint(
+        absl::StrCat("E", i),
+        [&, phase, checks = 0](
+            absl::Duration) mutable -> std::optional<absl::Duration> {
+          {
+            absl::MutexLock lock(&mutex);
+            threads.insert(std::this_thread::get_id());
+          }
+          if (++checks == kChecks) {
+            done.CountDown();
+            return std::nullopt;
+          }
+          return checks == 1 ? phase : kInterval;
+        });
+  }
+  release.Notify();
+  done.Await();
+  for (int i = 0; i < kEndpoints; ++i) {
+    scheduler.RemoveEndpoint(absl::StrCat("E", i));
+  }
+
+  KeepAliveScheduler::Stats stats = scheduler.GetStats();
+  {
+    absl::MutexLock lock(&mutex);
+    EXPECT_EQ(threads.size(), 1);
+  }
+  // Every endpoint's checks, plus the one that held the scheduler.
+  EXPECT_EQ(stats.checks, kEndpoints * kChecks + 1);
+  // Each wakeup runs every check due within the window, so a wakeup covers at
+  // least a window's worth of the interval. One thread per endpoint would
+  // wake up once per check instead.
+  EXPECT_LE(stats.wakeups, kChecks * (kInterval / kWindow) + 1);
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
@@ -0,0 +1,234 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/implementation/memory_accountant.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/input_stream.h"
+#include "internal/platform/logging.h"
+#include "internal/platform/mutex.h"
+#include "internal/platform/mutex_lock.h"
+#include "internal/platform/output_stream.h"
+#include "internal/platform/pipe.h"
+#include "internal/platform/system_clock.h"
+
+namespace nearby {
+namespace connections {
+
+namespace {
+
+// The data buffered in an accounted pipe, shared by both of its ends.
+class PipeCharge {
+ public:
+  PipeCharge(std::shared_ptr<MemoryAccountant> accountant,
+             std::string endpoint_id)
+      : accountant_(std::move(accountant)),
+        endpoint_id_(std::move(endpoint_id)) {}
+
+  bool Charge(std::int64_t bytes) ABSL_LOCKS_EXCLUDED(mutex_) {
+    MutexLock lock(&mutex_);
+    // Nobody reads what is written after the input is closed.
+    if (input_closed_) return true;
+    if (!accountant_->TryCharge(endpoint_id_, bytes)) return false;
+    buffered_ += bytes;
+    return true;
+  }
+
+  void Release(std::int64_t bytes) ABSL_LOCKS_EXCLUDED(mutex_) {
+    MutexLock lock(&mutex_);
+    bytes = std::min(bytes, buffered_);
+    buffered_ -= bytes;
+    accountant_->Release(endpoint_id_, bytes);
+  }
+
+  void CloseInput() ABSL_LOCKS_EXCLUDED(mutex_) {
+    MutexLock lock(&mutex_);
+    input_closed_ = true;
+    accountant_->Release(endpoint_id_, buffered_);
+    buffered_ = 0;
+  }
+
+ private:
+  const std::shared_ptr<MemoryAccountant> accountant_;
+  const std::string endpoint_id_;
+  Mutex mutex_;
+  std::int64_t buffered_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool input_closed_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+class AccountedInputStream : public InputStream {
+ public:
+  AccountedInputStream(std::unique_ptr<InputStream> input,
+                       std::shared_ptr<PipeCharge> charge)
+      : input_(std::move(input)), charge_(std::move(charge)) {}
+  ~AccountedInputStream() override { charge_->CloseInput(); }
+
+  ExceptionOr<ByteArray> Read(std::int64_t size) override {
+    ExceptionOr<ByteArray> read = input_->Read(size);
+    if (read.ok()) charge_->Release(read.result().size());
+    return read;
+  }
+
+  ExceptionOr<size_t> Skip(size_t offset) override {
+    ExceptionOr<size_t> skipped = input_->Skip(offset);
+    if (skipped.ok()) charge_->Release(skipped.result());
+    return skipped;
+  }
+
+  Exception Close() override {
+    Exception exception = input_->Close();
+    charge_->CloseInput();
+    return exception;
+  }
+
+ private:
+  std::unique_ptr<InputStream> input_;
+  std::shared_ptr<PipeCharge> charge_;
+};
+
+class AccountedOutputStream : public OutputStream {
+ public:
+  AccountedOutputStream(std::unique_ptr<OutputStream> output,
+                        std::shared_ptr<PipeCharge> charge)
+      : output_(std::move(output)), charge_(std::move(charge)) {}
+
+  Exception Write(const ByteArray& data) override {
+    if (!charge_->Charge(data.size())) {
+      return {Exception::kIo};
+    }
+    Exception exception = output_->Write(data);
+    if (exception.Raised()) charge_->Release(data.size());
+    return exception;
+  }
+
+  Exception Flush() override { return output_->Flush(); }
+  Exception Close() override { return output_->Close(); }
+
+ private:
+  std::unique_ptr<OutputStream> output_;
+  std::shared_ptr<PipeCharge> charge_;
+};
+
+}  // namespace
+
+void MemoryAccountant::SetLimits(const Limits& limits) {
+  MutexLock lock(&mutex_);
+  limits_ = limits;
+  // Waiters may be under the new soft limits.
+  released_.Notify();
+}
+
+MemoryAccountant::Limits MemoryAccountant::GetLimits() const {
+  MutexLock lock(&mutex_);
+  return limits_;
+}
+
+bool MemoryAccountant::TryCharge(absl::string_view endpoint_id,
+                                 std::int64_t bytes) {
+  MutexLock lock(&mutex_);
+  std::int64_t& endpoint_usage = endpoint_usage_[endpoint_id];
+  if (endpoint_usage + bytes > limits_.endpoint_hard_limit ||
+      client_usage_ + bytes > limits_.client_hard_limit) {
+    NEARBY_LOGS(WARNING) << "MemoryAccountant: refusing " << bytes
+                         << " bytes from endpoint_id=" << endpoint_id
+                         << ", which holds " << endpoint_usage
+                         << " bytes; the client holds " << client_usage_
+                         << " bytes";
+    return false;
+  }
+  endpoint_usage += bytes;
+  client_usage_ += bytes;
+  return true;
+}
+
+void MemoryAccountant::Release(absl::string_view endpoint_id,
+                               std::int64_t bytes) {
+  if (bytes <= 0) return;
+  MutexLock lock(&mutex_);
+  auto it = endpoint_usage_.find(endpoint_id);
+  if (it == endpoint_usage_.end()) return;
+  bytes = std::min(bytes, it->second);
+  it->second -= bytes;
+  client_usage_ -= bytes;
+  released_.Notify();
+}
+
+bool MemoryAccountant::WaitForCapacity(absl::string_view endpoint_id) {
+  MutexLock lock(&mutex_);
+  if (!IsOverSoftLimit(endpoint_id)) return true;
+  NEARBY_VLOG(1) << "MemoryAccountant: pausing reads from endpoint_id="
+                 << endpoint_id;
+  // Measured on the platform clock that `released_` waits on.
+  absl::Time deadline = SystemClock::ElapsedRealtime() + limits_.max_pause;
+  while (IsOverSoftLimit(endpoint_id)) {
+    absl::Duration remaining = deadline - SystemClock::ElapsedRealtime();
+    if (remaining <= absl::ZeroDuration() ||
+        released_.Wait(remaining).Raised()) {
+      return !IsOverSoftLimit(endpoint_id);
+    }
+  }
+  return true;
+}
+
+void MemoryAccountant::RemoveEndpoint(absl::string_view endpoint_id) {
+  MutexLock lock(&mutex_);
+  auto it = endpoint_usage_.find(endpoint_id);
+  if (it == endpoint_usage_.end()) return;
+  client_usage_ -= it->second;
+  endpoint_usage_.erase(it);
+  released_.Notify();
+}
+
+std::int64_t MemoryAccountant::GetEndpointUsage(
+    absl::string_view endpoint_id) const {
+  MutexLock lock(&mutex_);
+  auto it = endpoint_usage_.find(endpoint_id);
+  return it == endpoint_usage_.end() ? 0 : it->second;
+}
+
+std::int64_t MemoryAccountant::GetClientUsage() const {
+  MutexLock lock(&mutex_);
+  return client_usage_;
+}
+
+bool MemoryAccountant::IsOverSoftLimit(absl::string_view endpoint_id) const {
+  if (client_usage_ > limits_.client_soft_limit) return true;
+  auto it = endpoint_usage_.find(endpoint_id);
+  return it != endpoint_usage_.end() &&
+         it->second > limits_.endpoint_soft_limit;
+}
+
+std::pair<std::unique_ptr<InputStream>, std::unique_ptr<OutputStream>>
+CreateAccountedPipe(std::shared_ptr<MemoryAccountant> accountant,
+                    std::string endpoint_id) {
+  auto [input, output] = CreatePipe();
+  auto charge =
+      std::make_shared<PipeCharge>(std::move(accountant), std::move(endpoint_id));
+  return {std::make_unique<AccountedInputStream>(std::move(input), charge),
+          std::make_unique<AccountedOutputStream>(std::move(output), charge)};
+}
+
+}  // namespace connections
+}  // namespace nearby
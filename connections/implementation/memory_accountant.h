@@ -0,0 +1,106 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_MEMORY_ACCOUNTANT_H_
+#define CORE_INTERNAL_MEMORY_ACCOUNTANT_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "internal/platform/condition_variable.h"
+#include "internal/platform/input_stream.h"
+#include "internal/platform/mutex.h"
+#include "internal/platform/output_stream.h"
+
+namespace nearby {
+namespace connections {
+
+// Accounts for the memory that data received from the endpoints of one client
+// holds until the client takes it over: BYTES payloads until they are
+// delivered, and STREAM payloads until the client reads them.
+//
+// Above a soft limit, of an endpoint or of the whole client, reads from the
+// endpoint pause until the client catches up, so that the remote side is
+// slowed down by the transport. Data that would go over a hard limit is
+// refused, which fails its payload.
+class MemoryAccountant {
+ public:
+  struct Limits {
+    std::int64_t endpoint_soft_limit = 16 * 1024 * 1024;
+    std::int64_t endpoint_hard_limit = 64 * 1024 * 1024;
+    std::int64_t client_soft_limit = 64 * 1024 * 1024;
+    std::int64_t client_hard_limit = 256 * 1024 * 1024;
+    // How long reads pause at most above a soft limit. Pausing longer would
+    // let keep-alives time out.
+    absl::Duration max_pause = absl::Seconds(2);
+  };
+
+  MemoryAccountant() = default;
+  explicit MemoryAccountant(const Limits& limits) : limits_(limits) {}
+
+  void SetLimits(const Limits& limits) ABSL_LOCKS_EXCLUDED(mutex_);
+  Limits GetLimits() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Charges `bytes` to `endpoint_id`. Returns false, and charges nothing, if
+  // that would go over a hard limit.
+  bool TryCharge(absl::string_view endpoint_id, std::int64_t bytes)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  // Releases `bytes` charged to `endpoint_id`. Releases for an endpoint that
+  // was removed are ignored.
+  void Release(absl::string_view endpoint_id, std::int64_t bytes)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Blocks while `endpoint_id` or the client is over its soft limit, for at
+  // most `max_pause`. Returns false if the limit was still exceeded.
+  bool WaitForCapacity(absl::string_view endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Forgets what is charged to a disconnected endpoint.
+  void RemoveEndpoint(absl::string_view endpoint_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  std::int64_t GetEndpointUsage(absl::string_view endpoint_id) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  std::int64_t GetClientUsage() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  bool IsOverSoftLimit(absl::string_view endpoint_id) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable Mutex mutex_;
+  // Signalled when memory is released.
+  ConditionVariable released_{&mutex_};
+  Limits limits_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, std::int64_t> endpoint_usage_
+      ABSL_GUARDED_BY(mutex_);
+  std::int64_t client_usage_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+// Creates a pipe whose buffered data is charged to `endpoint_id`. A write that
+// would go over a hard limit fails with Exception::kIo. Data is released as it
+// is read, and what is left when the input is closed or destroyed.
+std::pair<std::unique_ptr<InputStream>, std::unique_ptr<OutputStream>>
+CreateAccountedPipe(std::shared_ptr<MemoryAccountant> accountant,
+                    std::string endpoint_id);
+
+}  // namespace connections
+}  // namespace nearby
+
+#endif  // CORE_INTERNAL_MEMORY_ACCOUNTANT_H_
@@ -0,0 +1,141 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/implementation/memory_accountant.h"
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/system_clock.h"
+
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr char kEndpointA[] = "ABCD";
+constexpr char kEndpointB[] = "EFGH";
+
+MemoryAccountant::Limits TestLimits() {
+  return {
+      .endpoint_soft_limit = 100,
+      .endpoint_hard_limit = 200,
+      .client_soft_limit = 300,
+      .client_hard_limit = 350,
+      .max_pause = absl::Milliseconds(100),
+  };
+}
+
+TEST(MemoryAccountantTest, ChargesUpToHardLimits) {
+  MemoryAccountant accountant(TestLimits());
+
+  EXPECT_TRUE(accountant.TryCharge(kEndpointA, 150));
+  EXPECT_TRUE(accountant.TryCharge(kEndpointA, 50));
+  EXPECT_FALSE(accountant.TryCharge(kEndpointA, 1));
+  EXPECT_TRUE(accountant.TryCharge(kEndpointB, 150));
+  // Over the client limit, though not over the endpoint limit.
+  EXPECT_FALSE(accountant.TryCharge(kEndpointB, 1));
+
+  EXPECT_EQ(accountant.GetEndpointUsage(kEndpointA), 200);
+  EXPECT_EQ(accountant.GetEndpointUsage(kEndpointB), 150);
+  EXPECT_EQ(accountant.GetClientUsage(), 350);
+}
+
+TEST(MemoryAccountantTest, ReleasesCharges) {
+  MemoryAccountant accountant(TestLimits());
+  ASSERT_TRUE(accountant.TryCharge(kEndpointA, 150));
+
+  accountant.Release(kEndpointA, 100);
+  accountant.Release(kEndpointA, 100);
+  accountant.Release(kEndpointB, 100);
+
+  EXPECT_EQ(accountant.GetEndpointUsage(kEndpointA), 0);
+  EXPECT_EQ(accountant.GetClientUsage(), 0);
+}
+
+TEST(MemoryAccountantTest, RemovingEndpointDropsItsCharges) {
+  MemoryAccountant accountant(TestLimits());
+  ASSERT_TRUE(accountant.TryCharge(kEndpointA, 150));
+  ASSERT_TRUE(accountant.TryCharge(kEndpointB, 50));
+
+  accountant.RemoveEndpoint(kEndpointA);
+  accountant.Release(kEndpointA, 150);
+
+  EXPECT_EQ(accountant.GetEndpointUsage(kEndpointA), 0);
+  EXPECT_EQ(accountant.GetClientUsage(), 50);
+}
+
+TEST(MemoryAccountantTest, WaitsUntilUnderSoftLimit) {
+  MemoryAccountant accountant(TestLimits());
+  ASSERT_TRUE(accountant.TryCharge(kEndpointA, 150));
+  EXPECT_TRUE(accountant.WaitForCapacity(kEndpointB));
+
+  std::thread reader([&accountant]() {
+    absl::SleepFor(absl::Milliseconds(20));
+    accountant.Release(kEndpointA, 100);
+  });
+  EXPECT_TRUE(accountant.WaitForCapacity(kEndpointA));
+  reader.join();
+}
+
+TEST(MemoryAccountantTest, PausesAtMostMaxPause) {
+  MemoryAccountant accountant(TestLimits());
+  ASSERT_TRUE(accountant.TryCharge(kEndpointA, 150));
+
+  absl::Time start = SystemClock::ElapsedRealtime();
+  EXPECT_FALSE(accountant.WaitForCapacity(kEndpointA));
+  EXPECT_GE(SystemClock::ElapsedRealtime() - start, TestLimits().max_pause);
+}
+
+TEST(MemoryAccountantTest, PipeReleasesDataAsItIsRead) {
+  auto accountant = std::make_shared<MemoryAccountant>(TestLimits());
+  auto [input, output] = CreateAccountedPipe(accountant, kEndpointA);
+
+  EXPECT_TRUE(output->Write(ByteArray(std::string(120, 'a'))).Ok());
+  EXPECT_TRUE(output->Write(ByteArray(std::string(80, 'b'))).Ok());
+  EXPECT_TRUE(output->Write(ByteArray("c")).Raised(Exception::kIo));
+  EXPECT_EQ(accountant->GetEndpointUsage(kEndpointA), 200);
+
+  ExceptionOr<ByteArray> read = input->Read(100);
+  ASSERT_TRUE(read.ok());
+  EXPECT_EQ(read.result().size(), 100);
+  EXPECT_EQ(accountant->GetEndpointUsage(kEndpointA), 100);
+  ExceptionOr<size_t> skipped = input->Skip(30);
+  ASSERT_TRUE(skipped.ok());
+  EXPECT_EQ(accountant->GetEndpointUsage(kEndpointA), 70);
+
+  EXPECT_TRUE(input->Close().Ok());
+  EXPECT_EQ(accountant->GetEndpointUsage(kEndpointA), 0);
+  output->Write(ByteArray(std::string(10, 'd')));
+  EXPECT_EQ(accountant->GetEndpointUsage(kEndpointA), 0);
+}
+
+TEST(MemoryAccountantTest, DestroyingPipeInputReleasesData) {
+  auto accountant = std::make_shared<MemoryAccountant>(TestLimits());
+  {
+    auto [input, output] = CreateAccountedPipe(accountant, kEndpointA);
+    EXPECT_TRUE(output->Write(ByteArray(std::string(50, 'a'))).Ok());
+    EXPECT_EQ(accountant->GetClientUsage(), 50);
+  }
+  EXPECT_EQ(accountant->GetClientUsage(), 0);
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
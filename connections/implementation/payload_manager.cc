@@ -30,11 +30,13 @@
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "connections/implementation/analytics/throughput_recorder.h"
+#include "connections/implementation/analytics/trace_recorder.h"
 #include "connections/implementation/client_proxy.h"
 #include "connections/implementation/endpoint_channel_manager.h"
 #include "connections/implementation/endpoint_manager.h"
 #include "connections/implementation/flags/nearby_connections_feature_flags.h"
 #include "connections/implementation/internal_payload_factory.h"
+#include "connections/implementation/memory_accountant.h"
 #include "connections/implementation/proto/offline_wire_formats.pb.h"
 #include "connections/listeners.h"
 #include "connections/payload.h"
@@ -57,6 +59,10 @@ using ::location::nearby::connections::V1Frame;
 using ::location::nearby::proto::connections::PayloadStatus;
 using ::nearby::analytics::PacketMetaData;
 using ::nearby::analytics::ThroughputRecorderContainer;
+using ::nearby::analytics::TraceRecorder;
+using ::nearby::analytics::TraceSpan;
+using ::nearby::analytics::kTracePayloadFirstChunk;
+using ::nearby::analytics::kTracePayloadLastAck;
 using ::nearby::connections::PayloadDirection;
 
 namespace {
@@ -163,6 +169,12 @@ bool PayloadManager::SendPayloadLoop(
       next_chunk_offset - resume_offset, std::move(next_chunk), index));
   const EndpointIds& failed_endpoint_ids = endpoint_manager_->SendPayloadChunk(
       payload_header, payload_chunk, available_endpoint_ids, packet_meta_data);
+  if (index == 0) {
+    for (const auto& endpoint_id : available_endpoint_ids) {
+      TraceRecorder::GetInstance().EndSpan(kTracePayloadFirstChunk,
+                                           endpoint_id, payload_header.id());
+    }
+  }
   // Check whether at least one endpoint failed.
   if (!failed_endpoint_ids.empty()) {
     LOG(INFO) << "Payload xfer: endpoints failed: payload_id="
@@ -457,6 +469,10 @@ void PayloadManager::SendPayload(ClientProxy* client,
     RecordPayloadStartedAnalytics(client, endpoint_ids, payload_id,
                                   payload_type, resume_offset,
                                   internal_payload->GetTotalSize());
+    for (const auto& endpoint_id : endpoint_ids) {
+      TraceRecorder::GetInstance().BeginSpan(kTracePayloadFirstChunk,
+                                             endpoint_id, payload_id);
+    }
 
     PayloadTransferFrame::PayloadHeader payload_header{CreatePayloadHeader(
         *internal_payload, resume_offset, internal_payload->GetParentFolder(),
@@ -743,9 +759,10 @@ PayloadTransferFrame::PayloadChunk PayloadManager::CreatePayloadChunk(
 }
 
 PayloadManager::PendingPayloadHandle PayloadManager::CreateIncomingPayload(
-    const PayloadTransferFrame& frame, const std::string& endpoint_id) {
-  auto internal_payload =
-      CreateIncomingInternalPayload(frame, custom_save_path_);
+    ClientProxy* client, const PayloadTransferFrame& frame,
+    const std::string& endpoint_id) {
+  auto internal_payload = CreateIncomingInternalPayload(
+      frame, custom_save_path_, client->GetMemoryAccountant(), endpoint_id);
   if (!internal_payload) {
     return PendingPayloadHandle();
   }
@@ -897,6 +914,7 @@ bool PayloadManager::WaitForReceivedAck(
   LOG(INFO) << "[safe-to-disconnect] Last Chunk, sender wait for "
                "PAYLOAD_RECEIVED_ACK frame from: "
             << endpoint_id;
+  TraceSpan trace_span(kTracePayloadLastAck, endpoint_id, payload_header.id());
   while (true) {
     PendingPayloadHandle latest_pending_payload =
         GetPayload(payload_header.id());
@@ -1270,6 +1288,22 @@ void PayloadManager::ProcessDataPacket(
   Payload::Id payload_id = payload_header.id();
   PendingPayloadHandle pending_payload;
   if (payload_chunk.offset() == 0) {
+    // A BYTES payload is held whole until the client gets it.
+    std::int64_t held_bytes =
+        payload_header.type() == PayloadTransferFrame::PayloadHeader::BYTES
+            ? payload_chunk.body().size()
+            : 0;
+    std::shared_ptr<MemoryAccountant> memory_accountant =
+        to_client->GetMemoryAccountant();
+    if (!memory_accountant->TryCharge(from_endpoint_id, held_bytes)) {
+      LOG(WARNING) << "PayloadManager refused payload_id="
+                   << payload_header.id() << " from endpoint_id="
+                   << from_endpoint_id << " over the memory limit.";
+      SendControlMessage({from_endpoint_id}, payload_header,
+                         payload_chunk.offset(),
+                         PayloadTransferFrame::ControlMessage::PAYLOAD_ERROR);
+      return;
+    }
     ThroughputRecorderContainer::GetInstance()
         .GetTPRecorder(payload_id, PayloadDirection::INCOMING_PAYLOAD)
         ->Start((PayloadType)payload_header.type(),
@@ -1286,9 +1320,10 @@ void PayloadManager::ProcessDataPacket(
               payload_header.total_size());
         });
 
-    pending_payload =
-        CreateIncomingPayload(payload_transfer_frame, from_endpoint_id);
+    pending_payload = CreateIncomingPayload(to_client, payload_transfer_frame,
+                                            from_endpoint_id);
     if (!pending_payload) {
+      memory_accountant->Release(from_endpoint_id, held_bytes);
       LOG(WARNING) << "PayloadManager failed to create InternalPayload from "
                       "PayloadTransferFrame with payload_id="
                    << payload_header.id() << " and type "
@@ -1302,16 +1337,18 @@ void PayloadManager::ProcessDataPacket(
     // Also, let the client know of this new incoming payload.
     RunOnStatusUpdateThread(
         "process-data-packet",
-        [to_client, from_endpoint_id,
+        [to_client, from_endpoint_id, memory_accountant, held_bytes,
          pending_payload = GetPayload(payload_id)]()
             RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
-              if (!pending_payload) return;
-              LOG(INFO) << "PayloadManager received new payload_id="
-                        << pending_payload->GetInternalPayload()->GetId()
-                        << " from endpoint_id=" << from_endpoint_id;
-              to_client->OnPayload(
-                  from_endpoint_id,
-                  pending_payload->GetInternalPayload()->ReleasePayload());
+              if (pending_payload) {
+                LOG(INFO) << "PayloadManager received new payload_id="
+                          << pending_payload->GetInternalPayload()->GetId()
+                          << " from endpoint_id=" << from_endpoint_id;
+                to_client->OnPayload(
+                    from_endpoint_id,
+                    pending_payload->GetInternalPayload()->ReleasePayload());
+              }
+              memory_accountant->Release(from_endpoint_id, held_bytes);
             });
   } else {
     pending_payload = GetPayload(payload_header.id());
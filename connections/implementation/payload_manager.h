@@ -310,7 +310,8 @@ class PayloadManager : public EndpointManager::FrameProcessor {
              PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0);
   }
 
-  PendingPayloadHandle CreateIncomingPayload(const PayloadTransferFrame& frame,
+  PendingPayloadHandle CreateIncomingPayload(ClientProxy* client,
+                                             const PayloadTransferFrame& frame,
                                              const std::string& endpoint_id)
       ABSL_LOCKS_EXCLUDED(mutex_);
 
@@ -15,14 +15,19 @@
 #include "connections/implementation/payload_manager.h"
 
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "connections/implementation/analytics/packet_meta_data.h"
+#include "connections/implementation/analytics/trace_recorder.h"
 #include "connections/implementation/flags/nearby_connections_feature_flags.h"
+#include "connections/implementation/memory_accountant.h"
 #include "connections/implementation/offline_frames.h"
 #include "connections/implementation/simulation_user.h"
 #include "connections/listeners.h"
@@ -42,6 +47,8 @@ namespace connections {
 namespace {
 using ::location::nearby::connections::OfflineFrame;
 using ::nearby::analytics::PacketMetaData;
+using ::nearby::analytics::TraceEvent;
+using ::nearby::analytics::TraceRecorder;
 using ::location::nearby::proto::connections::Medium;
 
 constexpr size_t kChunkSize = 64 * 1024;
@@ -81,6 +88,22 @@ constexpr BooleanMediumSelector kTestCases[] = {
     },
 };
 
+// Returns the indices of the events that begin or end a span.
+std::vector<int> FindTraceEvents(const std::vector<TraceEvent>& events,
+                                 const char* name, bool begin,
+                                 absl::string_view endpoint_id,
+                                 std::int64_t payload_id = 0) {
+  std::vector<int> indices;
+  for (int i = 0; i < events.size(); ++i) {
+    if (events[i].name == name && events[i].begin == begin &&
+        events[i].endpoint_id == endpoint_id &&
+        events[i].payload_id == payload_id) {
+      indices.push_back(i);
+    }
+  }
+  return indices;
+}
+
 class PayloadSimulationUser : public SimulationUser {
  public:
   explicit PayloadSimulationUser(
@@ -367,6 +390,168 @@ TEST_P(PayloadManagerTest, CanCancelPayloadOnSenderSide) {
   env_.Stop();
 }
 
+TEST_P(PayloadManagerTest, PausesFloodingPeerAtMemorySoftLimit) {
+  constexpr size_t kFloodChunkSize = 4 * 1024;
+  constexpr int kFloodChunks = 64;
+  env_.Start();
+  PayloadSimulationUser user_a(kDeviceA, GetParam());
+  PayloadSimulationUser user_b(kDeviceB, GetParam());
+  ASSERT_TRUE(SetupConnection(user_a, user_b));
+  std::shared_ptr<MemoryAccountant> accountant =
+      user_a.GetClient().GetMemoryAccountant();
+  accountant->SetLimits({
+      .endpoint_soft_limit = 32 * 1024,
+      .endpoint_hard_limit = 1024 * 1024,
+      .max_pause = absl::Seconds(10),
+  });
+  auto [input, tx] = CreatePipe();
+  user_a.ExpectPayload(payload_latch_);
+  const ByteArray message{std::string(kMessage)};
+  tx->Write(message);
+  user_b.SendPayload(Payload(std::move(input)));
+  ASSERT_TRUE(payload_latch_.Await(kDefaultTimeout).result());
+  ASSERT_NE(user_a.GetPayload().AsStream(), nullptr);
+  InputStream& rx = *user_a.GetPayload().AsStream();
+
+  // The receiver doesn't read while the sender floods it.
+  const ByteArray flood{std::string(kFloodChunkSize, 'x')};
+  for (int i = 0; i < kFloodChunks; ++i) {
+    ASSERT_TRUE(tx->Write(flood).Ok());
+  }
+  tx->Close();
+  SystemClock::Sleep(kDefaultTimeout);
+  // Reading stops after the frame that went over the soft limit.
+  EXPECT_LE(accountant->GetEndpointUsage(user_a.GetDiscovered().endpoint_id),
+            32 * 1024 + kFloodChunkSize);
+
+  size_t received = 0;
+  while (true) {
+    ExceptionOr<ByteArray> read = rx.Read(kChunkSize);
+    ASSERT_TRUE(read.ok());
+    if (read.result().Empty()) break;
+    received += read.result().size();
+  }
+  EXPECT_EQ(received, message.size() + kFloodChunks * kFloodChunkSize);
+  EXPECT_TRUE(user_a.WaitForProgress(
+      [](const PayloadProgressInfo& info) {
+        return info.status == PayloadProgressInfo::Status::kSuccess;
+      },
+      kProgressTimeout));
+  EXPECT_EQ(accountant->GetClientUsage(), 0);
+
+  rx.Close();
+  user_a.Stop();
+  user_b.Stop();
+  env_.Stop();
+}
+
+TEST_P(PayloadManagerTest, FailsFloodingPayloadAtMemoryHardLimit) {
+  constexpr size_t kFloodChunkSize = 4 * 1024;
+  constexpr int kFloodChunks = 64;
+  env_.Start();
+  PayloadSimulationUser user_a(kDeviceA, GetParam());
+  PayloadSimulationUser user_b(kDeviceB, GetParam());
+  ASSERT_TRUE(SetupConnection(user_a, user_b));
+  std::shared_ptr<MemoryAccountant> accountant =
+      user_a.GetClient().GetMemoryAccountant();
+  accountant->SetLimits({
+      .endpoint_soft_limit = 16 * 1024,
+      .endpoint_hard_limit = 64 * 1024,
+      .max_pause = absl::Milliseconds(1),
+  });
+  auto [input, tx] = CreatePipe();
+  user_a.ExpectPayload(payload_latch_);
+  tx->Write(ByteArray{std::string(kMessage)});
+  user_b.SendPayload(Payload(std::move(input)));
+  ASSERT_TRUE(payload_latch_.Await(kDefaultTimeout).result());
+  ASSERT_NE(user_a.GetPayload().AsStream(), nullptr);
+  InputStream& rx = *user_a.GetPayload().AsStream();
+
+  const ByteArray flood{std::string(kFloodChunkSize, 'x')};
+  for (int i = 0; i < kFloodChunks; ++i) {
+    tx->Write(flood);
+  }
+  EXPECT_TRUE(user_a.WaitForProgress(
+      [](const PayloadProgressInfo& info) {
+        return info.status == PayloadProgressInfo::Status::kFailure;
+      },
+      absl::Seconds(10)));
+  EXPECT_LE(accountant->GetEndpointUsage(user_a.GetDiscovered().endpoint_id),
+            64 * 1024);
+  rx.Close();
+  EXPECT_EQ(accountant->GetClientUsage(), 0);
+
+  tx->Close();
+  user_a.Stop();
+  user_b.Stop();
+  env_.Stop();
+}
+
+TEST_P(PayloadManagerTest, TracesConnectionAndTransferPhases) {
+  TraceRecorder& recorder = TraceRecorder::GetInstance();
+  recorder.Start();
+  env_.Start();
+  PayloadSimulationUser user_a(kDeviceA, GetParam());
+  PayloadSimulationUser user_b(kDeviceB, GetParam());
+  ASSERT_TRUE(SetupConnection(user_a, user_b));
+  user_a.ExpectPayload(payload_latch_);
+  Payload payload(ByteArray{std::string(kMessage)});
+  Payload::Id payload_id = payload.GetId();
+  user_b.SendPayload(std::move(payload));
+  EXPECT_TRUE(payload_latch_.Await(kDefaultTimeout).result());
+  user_b.StopDiscovery();
+  user_a.Stop();
+  user_b.Stop();
+  env_.Stop();
+  recorder.Stop();
+
+  std::vector<TraceEvent> events = recorder.GetEvents();
+  // The ids that each side knows the other by.
+  std::string endpoint_a = user_b.GetDiscovered().endpoint_id;
+  std::string endpoint_b = user_a.GetDiscovered().endpoint_id;
+  // Returns the indices of the beginning and the end of a span that must have
+  // been recorded once.
+  auto find_span = [&events](const char* name, absl::string_view endpoint_id,
+                             std::int64_t payload_id = 0) {
+    std::vector<int> begins =
+        FindTraceEvents(events, name, true, endpoint_id, payload_id);
+    std::vector<int> ends =
+        FindTraceEvents(events, name, false, endpoint_id, payload_id);
+    EXPECT_EQ(begins.size(), 1) << name << " of " << endpoint_id;
+    EXPECT_EQ(ends.size(), 1) << name << " of " << endpoint_id;
+    if (begins.size() != 1 || ends.size() != 1) return std::make_pair(-1, -1);
+    EXPECT_LT(begins[0], ends[0]) << name << " of " << endpoint_id;
+    return std::make_pair(begins[0], ends[0]);
+  };
+
+  // Discoverer: discovery, then the connection request, which runs the UKEY2
+  // handshake and returns once the connection is initiated.
+  // Discovery is traced for the service, of which only the first 8 characters
+  // are kept.
+  auto discovery =
+      find_span(analytics::kTraceDiscovery, kServiceId.substr(0, 8));
+  auto request = find_span(analytics::kTraceRequestConnection, endpoint_a);
+  auto ukey2_b = find_span(analytics::kTraceUkey2Handshake, endpoint_a);
+  auto accept_b = find_span(analytics::kTraceAcceptConnection, endpoint_a);
+  auto first_chunk =
+      find_span(analytics::kTracePayloadFirstChunk, endpoint_a, payload_id);
+  EXPECT_LT(discovery.first, request.first);
+  EXPECT_LT(request.first, ukey2_b.first);
+  EXPECT_LT(ukey2_b.second, accept_b.first);
+  EXPECT_LT(accept_b.first, request.second);
+  EXPECT_LT(accept_b.second, first_chunk.first);
+  EXPECT_LT(first_chunk.first, discovery.second);
+
+  // Advertiser: the UKEY2 handshake, then accepting the connection.
+  auto ukey2_a = find_span(analytics::kTraceUkey2Handshake, endpoint_b);
+  auto accept_a = find_span(analytics::kTraceAcceptConnection, endpoint_b);
+  EXPECT_LT(ukey2_a.second, accept_a.first);
+  EXPECT_LT(accept_a.second, first_chunk.first);
+  EXPECT_TRUE(FindTraceEvents(events, analytics::kTraceRequestConnection, true,
+                              endpoint_b)
+                  .empty());
+}
+
 TEST_P(PayloadManagerTest, SendPayloadWithSkip_StreamPayload) {
   constexpr size_t kOffset = 3;
   env_.Start();
@@ -0,0 +1,156 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/implementation/write_behind_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+#include "absl/time/time.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/file.h"
+#include "internal/platform/logging.h"
+#include "internal/platform/mutex_lock.h"
+#include "internal/platform/system_clock.h"
+
+namespace nearby {
+namespace connections {
+
+WriteBehindFile::WriteBehindFile(OutputFile file, std::int64_t expected_size,
+                                 Options options)
+    : options_(options),
+      file_(std::move(file)),
+      last_flush_time_(SystemClock::ElapsedRealtime()) {
+  executor_.Execute("write-behind", [this, expected_size]() {
+    if (expected_size > 0 && !file_.Preallocate(expected_size).Ok()) {
+      NEARBY_LOGS(WARNING) << "Failed to reserve " << expected_size
+                           << " bytes for an incoming file";
+      MutexLock lock(&mutex_);
+      failed_ = true;
+    }
+    Loop();
+  });
+}
+
+WriteBehindFile::~WriteBehindFile() {
+  Abort();
+  executor_.Shutdown();
+}
+
+Exception WriteBehindFile::Write(const ByteArray& data) {
+  MutexLock lock(&mutex_);
+  while (queued_bytes_ >= options_.max_queued_bytes && !failed_ && !done_) {
+    has_space_.Wait();
+  }
+  if (failed_ || closing_ || aborted_ || done_) {
+    return {Exception::kIo};
+  }
+  queue_.push_back(data);
+  queued_bytes_ += data.size();
+  has_data_.Notify();
+  return {Exception::kSuccess};
+}
+
+Exception WriteBehindFile::Close() { return Finish(/*abort=*/false); }
+
+void WriteBehindFile::Abort() { Finish(/*abort=*/true); }
+
+Exception WriteBehindFile::Finish(bool abort) {
+  MutexLock lock(&mutex_);
+  if (abort) {
+    aborted_ = true;
+  } else {
+    closing_ = true;
+  }
+  has_data_.Notify();
+  while (!done_) {
+    has_space_.Wait();
+  }
+  return {failed_ || aborted_ ? Exception::kIo : Exception::kSuccess};
+}
+
+Exception WriteBehindFile::FlushFile() {
+  unflushed_bytes_ = 0;
+  last_flush_time_ = SystemClock::ElapsedRealtime();
+  return file_.Flush();
+}
+
+void WriteBehindFile::Loop() {
+  MutexLock lock(&mutex_);
+  while (true) {
+    while (queue_.empty() && !closing_ && !aborted_) {
+      if (unflushed_bytes_ == 0) {
+        has_data_.Wait();
+        continue;
+      }
+      absl::Duration until_flush = last_flush_time_ + options_.flush_interval -
+                                   SystemClock::ElapsedRealtime();
+      if (until_flush <= absl::ZeroDuration()) break;
+      has_data_.Wait(until_flush);
+    }
+    if (aborted_ || failed_) break;
+    if (queue_.empty()) {
+      if (closing_) break;
+      // Nothing new arrived within the flush interval.
+      mutex_.Unlock();
+      Exception result = FlushFile();
+      mutex_.Lock();
+      if (!result.Ok()) failed_ = true;
+      continue;
+    }
+
+    // Write everything queued so far in one go; more data may be queued
+    // meanwhile.
+    std::deque<ByteArray> batch;
+    batch.swap(queue_);
+    std::size_t batch_bytes = queued_bytes_;
+    mutex_.Unlock();
+    Exception result = {Exception::kSuccess};
+    for (const ByteArray& chunk : batch) {
+      result = file_.Write(chunk);
+      if (!result.Ok()) break;
+      unflushed_bytes_ += chunk.size();
+    }
+    if (result.Ok() && unflushed_bytes_ >= options_.flush_bytes) {
+      result = FlushFile();
+    }
+    mutex_.Lock();
+    queued_bytes_ -= batch_bytes;
+    if (!result.Ok()) {
+      NEARBY_LOGS(WARNING) << "Failed to write to an incoming file";
+      failed_ = true;
+    }
+    has_space_.Notify();
+  }
+
+  bool flush = !aborted_ && !failed_;
+  queue_.clear();
+  queued_bytes_ = 0;
+  mutex_.Unlock();
+  Exception result = {Exception::kSuccess};
+  if (flush && unflushed_bytes_ > 0) {
+    result = FlushFile();
+  }
+  file_.Close();
+  mutex_.Lock();
+  if (!result.Ok()) failed_ = true;
+  done_ = true;
+  has_space_.Notify();
+}
+
+}  // namespace connections
+}  // namespace nearby
@@ -0,0 +1,105 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_WRITE_BEHIND_FILE_H_
+#define CORE_INTERNAL_WRITE_BEHIND_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/time/time.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/condition_variable.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/file.h"
+#include "internal/platform/mutex.h"
+#include "internal/platform/single_thread_executor.h"
+
+namespace nearby {
+namespace connections {
+
+// Writes to an OutputFile on a dedicated thread, so that slow storage doesn't
+// stall the thread that receives the data.
+//
+// Write() only queues the data. The queue is bounded: once `max_queued_bytes`
+// are waiting, Write() blocks until the writer thread catches up. The writer
+// flushes the file whenever `flush_bytes` were written since the last flush,
+// when data has been sitting unflushed for `flush_interval`, and on Close().
+class WriteBehindFile {
+ public:
+  struct Options {
+    std::size_t max_queued_bytes = 8 * 1024 * 1024;
+    std::size_t flush_bytes = 1024 * 1024;
+    absl::Duration flush_interval = absl::Milliseconds(500);
+  };
+
+  // If `expected_size` is positive, space for it is reserved before the first
+  // write. A failure to reserve it is reported by the next Write().
+  WriteBehindFile(OutputFile file, std::int64_t expected_size)
+      : WriteBehindFile(std::move(file), expected_size, Options()) {}
+  WriteBehindFile(OutputFile file, std::int64_t expected_size,
+                  Options options);
+  // Aborts if the file wasn't closed.
+  ~WriteBehindFile();
+
+  WriteBehindFile(const WriteBehindFile&) = delete;
+  WriteBehindFile& operator=(const WriteBehindFile&) = delete;
+
+  // Queues `data` to be written. Returns Exception::kIo if an earlier write
+  // failed or the file is closed.
+  Exception Write(const ByteArray& data) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Writes everything queued, flushes and closes the file. Returns
+  // Exception::kIo if any write failed.
+  Exception Close() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Drops whatever is still queued and closes the file. The file keeps only
+  // the data that was already written.
+  void Abort() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  void Loop() ABSL_LOCKS_EXCLUDED(mutex_);
+  // Only called by the writer thread.
+  Exception FlushFile();
+  Exception Finish(bool abort) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const Options options_;
+
+  // Only used by the writer thread.
+  OutputFile file_;
+  std::size_t unflushed_bytes_ = 0;
+  absl::Time last_flush_time_;
+
+  Mutex mutex_;
+  // Signalled when data is queued or the file is being closed.
+  ConditionVariable has_data_{&mutex_};
+  // Signalled when queued data was written, or the writer thread exits.
+  ConditionVariable has_space_{&mutex_};
+  std::deque<ByteArray> queue_ ABSL_GUARDED_BY(mutex_);
+  std::size_t queued_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool closing_ ABSL_GUARDED_BY(mutex_) = false;
+  bool aborted_ ABSL_GUARDED_BY(mutex_) = false;
+  bool failed_ ABSL_GUARDED_BY(mutex_) = false;
+  bool done_ ABSL_GUARDED_BY(mutex_) = false;
+
+  SingleThreadExecutor executor_;
+};
+
+}  // namespace connections
+}  // namespace nearby
+
+#endif  // CORE_INTERNAL_WRITE_BEHIND_FILE_H_
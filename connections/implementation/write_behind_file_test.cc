@@ -0,0 +1,150 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "connections/implementation/write_behind_file.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>  // NOLINT
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/file.h"
+
+namespace nearby {
+namespace connections {
+namespace {
+
+class WriteBehindFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = (std::filesystem::path(testing::TempDir()) /
+             absl::StrCat(
+                 ::testing::UnitTest::GetInstance()->current_test_info()->name(),
+                 ".bin"))
+                .string();
+  }
+
+  void TearDown() override { std::filesystem::remove(path_); }
+
+  std::string ReadFile() const {
+    std::ifstream file(path_, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), {});
+  }
+
+  std::string path_;
+};
+
+TEST_F(WriteBehindFileTest, WritesEverythingOnClose) {
+  WriteBehindFile file(OutputFile(path_), /*expected_size=*/6);
+  EXPECT_TRUE(file.Write(ByteArray("abc")).Ok());
+  EXPECT_TRUE(file.Write(ByteArray("def")).Ok());
+  EXPECT_TRUE(file.Close().Ok());
+  EXPECT_EQ(ReadFile(), "abcdef");
+}
+
+TEST_F(WriteBehindFileTest, KeepsOrderWithSmallQueue) {
+  WriteBehindFile file(OutputFile(path_), /*expected_size=*/0,
+                       {.max_queued_bytes = 4, .flush_bytes = 8});
+  std::string expected;
+  for (int i = 0; i < 1000; ++i) {
+    std::string chunk = absl::StrCat(i, ",");
+    expected += chunk;
+    ASSERT_TRUE(file.Write(ByteArray(chunk)).Ok());
+  }
+  EXPECT_TRUE(file.Close().Ok());
+  EXPECT_EQ(ReadFile(), expected);
+}
+
+TEST_F(WriteBehindFileTest, FlushesAfterInterval) {
+  WriteBehindFile file(OutputFile(path_), /*expected_size=*/0,
+                       {.flush_bytes = 1024 * 1024,
+                        .flush_interval = absl::Milliseconds(50)});
+  EXPECT_TRUE(file.Write(ByteArray("abc")).Ok());
+  absl::SleepFor(absl::Milliseconds(300));
+  EXPECT_EQ(ReadFile(), "abc");
+  EXPECT_TRUE(file.Close().Ok());
+}
+
+TEST_F(WriteBehindFileTest, AbortReleasesPreallocatedSpace) {
+  constexpr std::int64_t kExpectedSize = 4 * 1024 * 1024;
+  WriteBehindFile file(OutputFile(path_), kExpectedSize);
+  EXPECT_TRUE(file.Write(ByteArray("abc")).Ok());
+  file.Abort();
+  EXPECT_LE(std::filesystem::file_size(path_), 3);
+  EXPECT_FALSE(file.Write(ByteArray("def")).Ok());
+  EXPECT_FALSE(file.Close().Ok());
+}
+
+TEST_F(WriteBehindFileTest, WriteFailsAfterClose) {
+  WriteBehindFile file(OutputFile(path_), /*expected_size=*/0);
+  EXPECT_TRUE(file.Close().Ok());
+  EXPECT_FALSE(file.Write(ByteArray("abc")).Ok());
+}
+
+TEST_F(WriteBehindFileTest, WriteFailsForInvalidPath) {
+  WriteBehindFile file(OutputFile("/not/a/valid/path.bin"),
+                       /*expected_size=*/0);
+  file.Write(ByteArray("abc"));
+  EXPECT_FALSE(file.Close().Ok());
+}
+
+// The file is a pipe that is only read once everything was queued, so the
+// writer thread is stuck as soon as the pipe is full. Write() returns all the
+// same.
+TEST_F(WriteBehindFileTest, WriteDoesNotWaitForFile) {
+  constexpr int kChunkSize = 64 * 1024;
+  constexpr int kChunks = 32;
+  ASSERT_EQ(mkfifo(path_.c_str(), 0600), 0);
+  // Opening the read end first lets the file open its write end.
+  int reader = open(path_.c_str(), O_RDONLY | O_NONBLOCK);
+  ASSERT_GE(reader, 0);
+
+  std::string expected;
+  WriteBehindFile file(OutputFile(path_), /*expected_size=*/0);
+  for (int i = 0; i < kChunks; ++i) {
+    std::string chunk(kChunkSize, 'a' + i % 26);
+    expected += chunk;
+    ASSERT_TRUE(file.Write(ByteArray(chunk)).Ok());
+  }
+
+  ASSERT_EQ(fcntl(reader, F_SETFL, 0), 0);
+  std::string contents;
+  std::thread drain([reader, &contents]() {
+    char buffer[4096];
+    ssize_t size;
+    while ((size = read(reader, buffer, sizeof(buffer))) > 0) {
+      contents.append(buffer, size);
+    }
+  });
+  EXPECT_TRUE(file.Close().Ok());
+  drain.join();
+  close(reader);
+  EXPECT_EQ(contents, expected);
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
@@ -28,6 +28,8 @@
 // - callbacks may be initialized with lambdas; lambda definitions are concize.
 
 #include "absl/functional/any_invocable.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "connections/connection_options.h"
 #include "connections/payload.h"
 #include "connections/status.h"
@@ -187,6 +189,24 @@ struct PayloadListener {
                           const PayloadProgressInfo& info)>
       payload_progress_cb =
           [](absl::string_view, const PayloadProgressInfo&) {};
+
+  // When positive, progress updates are collected for this long and reported
+  // together to `payload_progress_batch_cb` instead of `payload_progress_cb`.
+  absl::Duration progress_batch_interval = absl::ZeroDuration();
+
+  // Called with the progress of the payloads that changed since the last call,
+  // when `progress_batch_interval` is positive. Only the latest update of each
+  // payload is reported, so a terminal update is always the last one reported
+  // for its payload.
+  //
+  // endpoint_id - The identifier for the remote endpoint that is sending or
+  //               receiving these payloads.
+  // infos - The latest PayloadProgressInfo of each payload, in the order the
+  //         payloads first reported progress in this batch.
+  absl::AnyInvocable<void(absl::string_view endpoint_id,
+                          absl::Span<const PayloadProgressInfo> infos)>
+      payload_progress_batch_cb =
+          [](absl::string_view, absl::Span<const PayloadProgressInfo>) {};
 };
 
 }  // namespace connections
@@ -807,19 +807,22 @@ static nearby_platform_status OnPasskeyWrite(uint64_t peer_address,
   return kNearbyStatusOK;
 }
 
-static nearby_platform_status SetNonDiscoverableAdvertisement() {
-  uint8_t advertisement[NON_DISCOVERABLE_ADV_SIZE_BYTES];
+// Creates the non-discoverable advertisement in |advertisement|, which is
+// NON_DISCOVERABLE_ADV_SIZE_BYTES long, and stores its length in |length_out|.
+static nearby_platform_status CreateNonDiscoverableAdvertisement(
+    uint8_t* advertisement, size_t* length_out) {
+  const size_t kAdvertisementSize = NON_DISCOVERABLE_ADV_SIZE_BYTES;
   const uint8_t* in_use_key = SelectInUseKey();
   size_t length;
 #if NEARBY_FP_ENABLE_BATTERY_NOTIFICATION
   nearby_platform_BatteryInfo battery_info;
   length = nearby_fp_CreateNondiscoverableAdvertisementWithBattery(
-      advertisement, sizeof(advertisement), ShowPairingIndicator(),
+      advertisement, kAdvertisementSize, ShowPairingIndicator(),
       ShowBatteryIndicator(),
       IncludeBatteryInfo() ? PrepareBatteryInfo(&battery_info) : NULL);
 #else
   length = nearby_fp_CreateNondiscoverableAdvertisement(
-      advertisement, sizeof(advertisement), ShowPairingIndicator());
+      advertisement, kAdvertisementSize, ShowPairingIndicator());
 #endif /* NEARBY_FP_ENABLE_BATTERY_NOTIFICATION */
 #ifdef NEARBY_FP_ENABLE_SASS
   if (IncludeSass() && (nearby_fp_GetAccountKeyCount() > 0)) {
@@ -832,7 +835,7 @@ static nearby_platform_status SetNonDiscoverableAdvertisement() {
     nearby_platform_GetConnectionBitmap(device_bitmap, &device_bitmap_length);
     size_t sass_length = nearby_fp_GenerateSassAdvertisement(
         advertisement + length + RRF_HEADER_SIZE,
-        sizeof(advertisement) - length - RRF_HEADER_SIZE,
+        kAdvertisementSize - length - RRF_HEADER_SIZE,
         nearby_fp_GetSassConnectionState(), GetCustomData(), device_bitmap,
         device_bitmap_length);
     RETURN_IF_ERROR(nearby_fp_EncryptRandomResolvableField(
@@ -846,8 +849,16 @@ static nearby_platform_status SetNonDiscoverableAdvertisement() {
   nearby_fp_SetBloomFilter(advertisement, IncludeSass(), in_use_key);
 
   length += nearby_fp_AppendTxPower(advertisement + length,
-                                    sizeof(advertisement) - length,
+                                    kAdvertisementSize - length,
                                     nearby_platform_GetTxLevel());
+  *length_out = length;
+  return kNearbyStatusOK;
+}
+
+static nearby_platform_status SetNonDiscoverableAdvertisement() {
+  uint8_t advertisement[NON_DISCOVERABLE_ADV_SIZE_BYTES];
+  size_t length;
+  RETURN_IF_ERROR(CreateNonDiscoverableAdvertisement(advertisement, &length));
   return nearby_platform_SetAdvertisement(advertisement, length,
                                           kNoLargerThan250ms);
 }
@@ -1945,6 +1956,26 @@ nearby_platform_status nearby_fp_client_SetAdvertisement(int mode) {
   return UpdateAdvertisements();
 }
 
+nearby_platform_status nearby_fp_client_PrepareNextAdvertisement() {
+  uint8_t advertisement[NON_DISCOVERABLE_ADV_SIZE_BYTES];
+  uint8_t salt[NEARBY_FP_SALT_SIZE];
+  size_t length;
+  if ((advertisement_mode & NEARBY_FP_ADVERTISEMENT_DISCOVERABLE) ||
+      !(advertisement_mode & NEARBY_FP_ADVERTISEMENT_NON_DISCOVERABLE)) {
+    return kNearbyStatusOK;
+  }
+  for (int i = 0; i < NEARBY_FP_SALT_SIZE; i++) {
+    salt[i] = nearby_platform_Rand();
+  }
+  // Building the advertisement leaves its bloom filter in the library cache.
+  // The next advertisement uses the same salt, so it finds the filter there
+  // unless the account keys, battery info or SASS state change in between.
+  nearby_fp_SetNextSalt(salt);
+  RETURN_IF_ERROR(CreateNonDiscoverableAdvertisement(advertisement, &length));
+  nearby_fp_SetNextSalt(salt);
+  return kNearbyStatusOK;
+}
+
 #if NEARBY_FP_MESSAGE_STREAM
 nearby_platform_status nearby_fp_client_GetSeekerInfo(
     nearby_fp_client_SeekerInfo* seeker_info, size_t* seeker_info_length) {
@@ -1980,6 +2011,7 @@ nearby_platform_status nearby_fp_client_Init(
   address_rotation_task = NULL;
   peer_public_address = 0;
   DiscardPendingAccountKey();
+  nearby_fp_SetNextSalt(NULL);
 
   status = nearby_platform_OsInit();
   if (status != kNearbyStatusOK) return status;
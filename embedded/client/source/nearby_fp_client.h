@@ -69,6 +69,12 @@ typedef struct {
 // Sets Fast Pair advertisement type
 nearby_platform_status nearby_fp_client_SetAdvertisement(int mode);
 
+// Prepares the next non-discoverable advertisement, including its account key
+// filter, so that the next address rotation or advertisement update doesn't
+// need to hash the account keys. Optional; meant to be called when the device
+// is idle. Does nothing unless advertising in non-discoverable mode.
+nearby_platform_status nearby_fp_client_PrepareNextAdvertisement();
+
 // Initalizes Fast Pair provider. The |callbacks| are optional - can be NULL.
 nearby_platform_status nearby_fp_client_Init(
     const nearby_fp_client_Callbacks* callbacks);
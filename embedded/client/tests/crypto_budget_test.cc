@@ -0,0 +1,267 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Counts the crypto primitives the provider runs for pairing, advertisement
+// refreshes and SASS, and fails when an operation needs more than its budget.
+// On microcontrollers each SHA-256 block, AES block and ECDH is expensive, so
+// a budget should only be raised on purpose.
+
+#include <cstring>
+#include <vector>
+
+#include "fakes.h"
+#include "gtest/gtest.h"
+#include "nearby.h"
+#include "nearby_fp_client.h"
+#include "nearby_fp_library.h"
+#include "nearby_platform_ble.h"
+
+namespace {
+
+constexpr uint8_t kBobPrivateKey[32] = {
+    0x02, 0xB4, 0x37, 0xB0, 0xED, 0xD6, 0xBB, 0xD4, 0x29, 0x06, 0x4A,
+    0x4E, 0x52, 0x9F, 0xCB, 0xF1, 0xC4, 0x8D, 0x0D, 0x62, 0x49, 0x24,
+    0xD5, 0x92, 0x27, 0x4B, 0x7E, 0xD8, 0x11, 0x93, 0xD7, 0x63};
+constexpr uint8_t kBobPublicKey[64] = {
+    0xF7, 0xD4, 0x96, 0xA6, 0x2E, 0xCA, 0x41, 0x63, 0x51, 0x54, 0x0A,
+    0xA3, 0x43, 0xBC, 0x69, 0x0A, 0x61, 0x09, 0xF5, 0x51, 0x50, 0x06,
+    0x66, 0xB8, 0x3B, 0x12, 0x51, 0xFB, 0x84, 0xFA, 0x28, 0x60, 0x79,
+    0x5E, 0xBD, 0x63, 0xD3, 0xB8, 0x83, 0x6F, 0x44, 0xA9, 0xA3, 0xE2,
+    0x8B, 0xB3, 0x40, 0x17, 0xE0, 0x15, 0xF5, 0x97, 0x93, 0x05, 0xD8,
+    0x49, 0xFD, 0xF8, 0xDE, 0x10, 0x12, 0x3B, 0x61, 0xD2};
+constexpr uint8_t kAlicePublicKey[64] = {
+    0x36, 0xAC, 0x68, 0x2C, 0x50, 0x82, 0x15, 0x66, 0x8F, 0xBE, 0xFE,
+    0x24, 0x7D, 0x01, 0xD5, 0xEB, 0x96, 0xE6, 0x31, 0x8E, 0x85, 0x5B,
+    0x2D, 0x64, 0xB5, 0x19, 0x5D, 0x38, 0xEE, 0x7E, 0x37, 0xBE, 0x18,
+    0x38, 0xC0, 0xB9, 0x48, 0xC3, 0xF7, 0x55, 0x20, 0xE0, 0x7E, 0x70,
+    0xF0, 0x72, 0x91, 0x41, 0x9A, 0xCE, 0x2D, 0x28, 0x14, 0x3C, 0x5A,
+    0xDB, 0x2D, 0xBD, 0x98, 0xEE, 0x3C, 0x8E, 0x4F, 0xBF};
+// AES key derived from the Alice and Bob keys above.
+constexpr uint8_t kExpectedAesKey[16] = {0xB0, 0x7F, 0x1F, 0x17, 0xC2, 0x36,
+                                         0xCB, 0xD3, 0x35, 0x23, 0xC5, 0x15,
+                                         0xF3, 0x50, 0xAE, 0x57};
+
+constexpr uint64_t kRemoteDevice = 0xB0B1B2B3B4B5;
+constexpr uint8_t kSalt = 0xAB;
+constexpr uint8_t kSeekerAccountKey[16] = {0x04, 20, 21, 22, 23, 24, 25, 26,
+                                           27,   28, 29, 30, 31, 32, 33, 34};
+
+// The bloom filter hashes each account key with the salt.
+constexpr size_t kBloomFilterBytesHashed =
+    NEARBY_MAX_ACCOUNT_KEYS * (ACCOUNT_KEY_SIZE_BYTES + NEARBY_FP_SALT_SIZE);
+
+// The maximum number of calls to each primitive for one operation.
+struct CryptoBudget {
+  const char* operation;
+  unsigned sha256_hashes;
+  size_t sha256_bytes;
+  unsigned aes_encryptions;
+  unsigned aes_decryptions;
+  unsigned ecdh_secrets;
+};
+
+// Checks the calls counted since the last check against |budget|.
+void ExpectWithinBudget(const CryptoBudget& budget) {
+  const nearby_test_fakes_CryptoCounters& counters =
+      nearby_test_fakes_GetCryptoCounters();
+  EXPECT_LE(counters.sha256_hashes, budget.sha256_hashes) << budget.operation;
+  EXPECT_LE(counters.sha256_bytes, budget.sha256_bytes) << budget.operation;
+  EXPECT_LE(counters.aes_encryptions, budget.aes_encryptions)
+      << budget.operation;
+  EXPECT_LE(counters.aes_decryptions, budget.aes_decryptions)
+      << budget.operation;
+  EXPECT_LE(counters.ecdh_secrets, budget.ecdh_secrets) << budget.operation;
+  nearby_test_fakes_ResetCryptoCounters();
+}
+
+// Stores NEARBY_MAX_ACCOUNT_KEYS keys, with |kSeekerAccountKey| last, so that
+// the provider tries every key before finding the seeker's.
+void SetFullAccountKeyList() {
+  std::vector<AccountKeyPair> account_keys;
+  for (uint8_t i = 1; i < NEARBY_MAX_ACCOUNT_KEYS; i++) {
+    std::vector<uint8_t> key(ACCOUNT_KEY_SIZE_BYTES, i);
+    key[0] = 0x04;
+    account_keys.emplace_back(kRemoteDevice, key);
+  }
+  account_keys.emplace_back(kRemoteDevice, kSeekerAccountKey);
+  nearby_test_fakes_SetAccountKeys(account_keys);
+  nearby_fp_LoadAccountKeys();
+}
+
+// Returns a key-based pairing request for the provider's address, encrypted
+// with |key|.
+std::vector<uint8_t> EncryptedKeyBasedPairingRequest(const uint8_t key[16]) {
+  const uint8_t request[16] = {0x00, 0x40, 0xA0, 0xA1, 0xA2, 0xA3,
+                               0xA4, 0xA5, 0xB0, 0xB1, 0xB2, 0xB3,
+                               0xB4, 0xB5, 0xCD, 0xEF};
+  std::vector<uint8_t> encrypted(sizeof(request));
+  nearby_test_fakes_Aes128Encrypt(request, encrypted.data(), key);
+  return encrypted;
+}
+
+void SendPasskey(const uint8_t key[16]) {
+  // Passkey 123456 (0x01E240)
+  uint8_t raw_passkey_block[16] = {0x02, 0x01, 0xE2, 0x40};
+  uint8_t encrypted_passkey_block[16];
+  nearby_test_fakes_Aes128Encrypt(raw_passkey_block, encrypted_passkey_block,
+                                  key);
+  nearby_fp_fakes_ReceivePasskey(encrypted_passkey_block,
+                                 sizeof(encrypted_passkey_block));
+}
+
+void WriteAccountKey(const uint8_t key[16]) {
+  uint8_t encrypted_account_key_write_request[16];
+  nearby_test_fakes_Aes128Encrypt(kSeekerAccountKey,
+                                  encrypted_account_key_write_request, key);
+  nearby_fp_fakes_ReceiveAccountKeyWrite(
+      encrypted_account_key_write_request,
+      sizeof(encrypted_account_key_write_request));
+}
+
+class CryptoBudgetTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+#if defined(NEARBY_PLATFORM_USE_MBEDTLS) || !defined(NEARBY_PLATFORM_HAS_SE)
+    GTEST_SKIP() << "Crypto calls are only counted by the OpenSSL and "
+                    "secure element shims";
+#endif
+    ASSERT_EQ(kNearbyStatusOK, nearby_fp_client_Init(NULL));
+    ASSERT_EQ(kNearbyStatusOK, nearby_test_fakes_SetAntiSpoofingKey(
+                                   kBobPrivateKey, kBobPublicKey));
+    nearby_test_fakes_SetRandomNumber(kSalt);
+    nearby_test_fakes_ResetCryptoCounters();
+  }
+};
+
+TEST_F(CryptoBudgetTest, InitialPairing) {
+  ASSERT_EQ(kNearbyStatusOK, nearby_fp_client_SetAdvertisement(
+                                 NEARBY_FP_ADVERTISEMENT_DISCOVERABLE));
+  ExpectWithinBudget({"Discoverable advertisement", 0, 0, 0, 0, 0});
+
+  std::vector<uint8_t> request =
+      EncryptedKeyBasedPairingRequest(kExpectedAesKey);
+  request.insert(request.end(), kAlicePublicKey,
+                 kAlicePublicKey + sizeof(kAlicePublicKey));
+  ASSERT_EQ(kNearbyStatusOK, nearby_fp_fakes_ReceiveKeyBasedPairingRequest(
+                                 request.data(), request.size()));
+  ExpectWithinBudget({"Key-based pairing request with public key", 1, 32, 1,
+                      1, 1});
+
+  SendPasskey(kExpectedAesKey);
+  ExpectWithinBudget({"Passkey", 0, 0, 1, 1, 0});
+
+  WriteAccountKey(kExpectedAesKey);
+  ExpectWithinBudget({"Account key write", 0, 0, 0, 1, 0});
+  ASSERT_EQ(1, nearby_test_fakes_GetAccountKeys().size());
+}
+
+TEST_F(CryptoBudgetTest, SubsequentPairingWithFullAccountKeyList) {
+  SetFullAccountKeyList();
+  ASSERT_EQ(kNearbyStatusOK, nearby_fp_client_SetAdvertisement(
+                                 NEARBY_FP_ADVERTISEMENT_NON_DISCOVERABLE));
+  nearby_test_fakes_ResetCryptoCounters();
+
+  std::vector<uint8_t> request =
+      EncryptedKeyBasedPairingRequest(kSeekerAccountKey);
+  ASSERT_EQ(kNearbyStatusOK, nearby_fp_fakes_ReceiveKeyBasedPairingRequest(
+                                 request.data(), request.size()));
+  ExpectWithinBudget({"Key-based pairing request with account key", 0, 0, 1,
+                      NEARBY_MAX_ACCOUNT_KEYS, 0});
+
+  SendPasskey(kSeekerAccountKey);
+  ExpectWithinBudget({"Passkey", 0, 0, 1, 1, 0});
+}
+
+TEST_F(CryptoBudgetTest, AdvertisementRefreshWithFullAccountKeyList) {
+  SetFullAccountKeyList();
+  nearby_test_fakes_SetInPairingMode(false);
+  nearby_test_fakes_ResetCryptoCounters();
+
+  ASSERT_EQ(kNearbyStatusOK, nearby_fp_client_SetAdvertisement(
+                                 NEARBY_FP_ADVERTISEMENT_NON_DISCOVERABLE));
+  ExpectWithinBudget({"Non-discoverable advertisement", NEARBY_MAX_ACCOUNT_KEYS,
+                      kBloomFilterBytesHashed, 0, 0, 0});
+
+  uint64_t address = nearby_platform_GetBleAddress();
+  nearby_test_fakes_SetRandomNumber(kSalt + 1);
+  nearby_test_fakes_SetCurrentTimeMs(nearby_test_fakes_GetNextTimerMs());
+  ASSERT_NE(address, nearby_platform_GetBleAddress());
+  ExpectWithinBudget({"Advertisement rotation", NEARBY_MAX_ACCOUNT_KEYS,
+                      kBloomFilterBytesHashed, 0, 0, 0});
+}
+
+TEST_F(CryptoBudgetTest, AdvertisementRotationAfterPrepare) {
+  SetFullAccountKeyList();
+  nearby_test_fakes_SetInPairingMode(false);
+  ASSERT_EQ(kNearbyStatusOK, nearby_fp_client_SetAdvertisement(
+                                 NEARBY_FP_ADVERTISEMENT_NON_DISCOVERABLE));
+  nearby_test_fakes_SetRandomNumber(kSalt + 1);
+  nearby_test_fakes_ResetCryptoCounters();
+
+  ASSERT_EQ(kNearbyStatusOK, nearby_fp_client_PrepareNextAdvertisement());
+  ExpectWithinBudget({"Advertisement preparation", NEARBY_MAX_ACCOUNT_KEYS,
+                      kBloomFilterBytesHashed, 0, 0, 0});
+
+  nearby_test_fakes_SetCurrentTimeMs(nearby_test_fakes_GetNextTimerMs());
+  ExpectWithinBudget({"Advertisement rotation after preparation", 0, 0, 0, 0,
+                      0});
+  std::vector<uint8_t> prepared = nearby_test_fakes_GetAdvertisement();
+
+  // Rotate again with the same salt, computing the bloom filter from scratch.
+  nearby_fp_LoadAccountKeys();
+  uint8_t salt[NEARBY_FP_SALT_SIZE];
+  memset(salt, kSalt + 1, sizeof(salt));
+  nearby_fp_SetNextSalt(salt);
+  nearby_test_fakes_SetCurrentTimeMs(nearby_test_fakes_GetNextTimerMs());
+  ExpectWithinBudget({"Advertisement rotation", NEARBY_MAX_ACCOUNT_KEYS,
+                      kBloomFilterBytesHashed, 0, 0, 0});
+  EXPECT_EQ(prepared, nearby_test_fakes_GetAdvertisement());
+}
+
+#ifdef NEARBY_FP_ENABLE_SASS
+// "In use account key" message, authenticated with |kSeekerAccountKey| and a
+// session nonce made of |kSalt|.
+constexpr uint8_t kInUseMessage[] = {0x07, 0x41, 0,    22,   'i',  'n',  '-',
+                                     'u',  's',  'e',  0xC0, 0xC1, 0xC2, 0xC3,
+                                     0xC4, 0xC5, 0xC6, 0xC7, 0x70, 0x69, 0xd6,
+                                     0xc5, 0x06, 0xa4, 0x94, 0x32};
+
+TEST_F(CryptoBudgetTest, SassInUseKeyAndAdvertisement) {
+  constexpr uint64_t kPeerAddress = 0x123456;
+  SetFullAccountKeyList();
+  nearby_test_fakes_SetGetBatteryInfoResult(kNearbyStatusUnsupported);
+  nearby_test_fakes_MessageStreamConnected(kPeerAddress);
+  nearby_test_fakes_ResetCryptoCounters();
+
+  nearby_test_fakes_MessageStreamReceived(kPeerAddress, kInUseMessage,
+                                          sizeof(kInUseMessage));
+  // The message is authenticated with an HMAC-SHA256 per stored key until one
+  // matches, and the seeker's key is the last one.
+  ExpectWithinBudget({"SASS in-use key message", NEARBY_MAX_ACCOUNT_KEYS * 2,
+                      NEARBY_MAX_ACCOUNT_KEYS * 182, 0, 0, 0});
+
+  ASSERT_EQ(kNearbyStatusOK,
+            nearby_fp_client_SetAdvertisement(
+                NEARBY_FP_ADVERTISEMENT_NON_DISCOVERABLE |
+                NEARBY_FP_ADVERTISEMENT_SASS));
+  ExpectWithinBudget({"SASS advertisement", 9, 464, 1, 0, 0});
+}
+#endif /* NEARBY_FP_ENABLE_SASS */
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -51,6 +51,22 @@ nearby_platform_status nearby_test_fakes_Aes128Encrypt(
     uint8_t output[AES_MESSAGE_SIZE_BYTES],
     const uint8_t key[AES_MESSAGE_SIZE_BYTES]);
 
+// Crypto primitive calls made by the provider through the platform shims.
+// Only the OpenSSL shims count SHA-256 and AES calls, and only the secure
+// element shim counts ECDH.
+struct nearby_test_fakes_CryptoCounters {
+  // Number of nearby_platform_Sha256Start() calls.
+  unsigned sha256_hashes = 0;
+  // Number of bytes passed to nearby_platform_Sha256Update().
+  size_t sha256_bytes = 0;
+  unsigned aes_encryptions = 0;
+  unsigned aes_decryptions = 0;
+  unsigned ecdh_secrets = 0;
+};
+
+void nearby_test_fakes_ResetCryptoCounters();
+const nearby_test_fakes_CryptoCounters& nearby_test_fakes_GetCryptoCounters();
+
 std::vector<uint8_t>& nearby_test_fakes_GetAdvertisement();
 
 std::map<nearby_fp_Characteristic, std::vector<uint8_t>>&
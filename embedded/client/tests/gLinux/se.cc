@@ -38,6 +38,8 @@ static uint8_t private_key_store[32];
 static std::unique_ptr<EVP_PKEY, void (*)(EVP_PKEY *)> anti_spoofing_key(
     NULL, EVP_PKEY_free);
 
+static nearby_test_fakes_CryptoCounters crypto_counters;
+
 static std::string ArrayToString(const uint8_t *data, size_t length) {
   std::stringstream output;
   output << "0x" << std::hex << std::setfill('0') << std::setw(2);
@@ -62,12 +64,14 @@ uint8_t nearby_platform_Rand() {
 static SHA256_CTX sha256_context;
 
 nearby_platform_status nearby_platform_Sha256Start() {
+  crypto_counters.sha256_hashes++;
   SHA256_Init(&sha256_context);
   return kNearbyStatusOK;
 }
 
 nearby_platform_status nearby_platform_Sha256Update(const void *data,
                                                     size_t length) {
+  crypto_counters.sha256_bytes += length;
   SHA256_Update(&sha256_context, data, length);
   return kNearbyStatusOK;
 }
@@ -77,10 +81,9 @@ nearby_platform_status nearby_platform_Sha256Finish(uint8_t out[32]) {
   return kNearbyStatusOK;
 }
 
-// Encrypts a data block with AES128 in ECB mode.
-nearby_platform_status nearby_platform_Aes128Encrypt(const uint8_t input[16],
-                                                     uint8_t output[16],
-                                                     const uint8_t key[16]) {
+static nearby_platform_status Aes128Encrypt(const uint8_t input[16],
+                                            uint8_t output[16],
+                                            const uint8_t key[16]) {
   EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
   int input_length = 16;
   int output_length = 16;
@@ -96,10 +99,9 @@ nearby_platform_status nearby_platform_Aes128Encrypt(const uint8_t input[16],
   return kNearbyStatusOK;
 }
 
-// Encrypts a data block with AES128 in ECB mode.
-nearby_platform_status nearby_platform_Aes128Decrypt(const uint8_t input[16],
-                                                     uint8_t output[16],
-                                                     const uint8_t key[16]) {
+static nearby_platform_status Aes128Decrypt(const uint8_t input[16],
+                                            uint8_t output[16],
+                                            const uint8_t key[16]) {
   EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
   int input_length = 16;
   int output_length = 16;
@@ -115,6 +117,22 @@ nearby_platform_status nearby_platform_Aes128Decrypt(const uint8_t input[16],
   EVP_CIPHER_CTX_free(ctx);
   return kNearbyStatusOK;
 }
+
+// Encrypts a data block with AES128 in ECB mode.
+nearby_platform_status nearby_platform_Aes128Encrypt(const uint8_t input[16],
+                                                     uint8_t output[16],
+                                                     const uint8_t key[16]) {
+  crypto_counters.aes_encryptions++;
+  return Aes128Encrypt(input, output, key);
+}
+
+// Decrypts a data block with AES128 in ECB mode.
+nearby_platform_status nearby_platform_Aes128Decrypt(const uint8_t input[16],
+                                                     uint8_t output[16],
+                                                     const uint8_t key[16]) {
+  crypto_counters.aes_decryptions++;
+  return Aes128Decrypt(input, output, key);
+}
 #endif /* NEARBY_PLATFORM_USE_MBEDTLS */
 
 static EC_POINT *load_public_key(const uint8_t public_key[64]) {
@@ -147,9 +165,7 @@ static BIGNUM *load_private_key(const uint8_t private_key[32]) {
 }
 
 #ifdef NEARBY_PLATFORM_HAS_SE
-// Generates a shared sec256p1 secret using remote party public key and this
-// device's private key.
-nearby_platform_status nearby_platform_GenSec256r1Secret(
+static nearby_platform_status GenSec256r1Secret(
     const uint8_t remote_party_public_key[64], uint8_t secret[32]) {
   EVP_PKEY_CTX *ctx;
   EVP_PKEY *peerkey;
@@ -194,6 +210,14 @@ nearby_platform_status nearby_platform_GenSec256r1Secret(
 
   return kNearbyStatusOK;
 }
+
+// Generates a shared sec256p1 secret using remote party public key and this
+// device's private key.
+nearby_platform_status nearby_platform_GenSec256r1Secret(
+    const uint8_t remote_party_public_key[64], uint8_t secret[32]) {
+  crypto_counters.ecdh_secrets++;
+  return GenSec256r1Secret(remote_party_public_key, secret);
+}
 #endif /* NEARBY_PLATFORM_HAS_SE */
 
 void nearby_test_fakes_SetRandomNumber(unsigned int value) {
@@ -231,23 +255,44 @@ nearby_platform_status nearby_test_fakes_SetAntiSpoofingKey(
   return kNearbyStatusOK;
 }
 
+// The seeker side crypto of the tests isn't counted.
 nearby_platform_status nearby_test_fakes_GenSec256r1Secret(
     const uint8_t remote_party_public_key[64], uint8_t secret[32]) {
+#ifdef NEARBY_PLATFORM_HAS_SE
+  return GenSec256r1Secret(remote_party_public_key, secret);
+#else
   return nearby_platform_GenSec256r1Secret(remote_party_public_key, secret);
+#endif /* NEARBY_PLATFORM_HAS_SE */
 }
 
 nearby_platform_status nearby_test_fakes_Aes128Decrypt(
     const uint8_t input[AES_MESSAGE_SIZE_BYTES],
     uint8_t output[AES_MESSAGE_SIZE_BYTES],
     const uint8_t key[AES_MESSAGE_SIZE_BYTES]) {
+#ifndef NEARBY_PLATFORM_USE_MBEDTLS
+  return Aes128Decrypt(input, output, key);
+#else
   return nearby_platform_Aes128Decrypt(input, output, key);
+#endif /* NEARBY_PLATFORM_USE_MBEDTLS */
 }
 
 nearby_platform_status nearby_test_fakes_Aes128Encrypt(
     const uint8_t input[AES_MESSAGE_SIZE_BYTES],
     uint8_t output[AES_MESSAGE_SIZE_BYTES],
     const uint8_t key[AES_MESSAGE_SIZE_BYTES]) {
+#ifndef NEARBY_PLATFORM_USE_MBEDTLS
+  return Aes128Encrypt(input, output, key);
+#else
   return nearby_platform_Aes128Encrypt(input, output, key);
+#endif /* NEARBY_PLATFORM_USE_MBEDTLS */
+}
+
+void nearby_test_fakes_ResetCryptoCounters() {
+  crypto_counters = nearby_test_fakes_CryptoCounters();
+}
+
+const nearby_test_fakes_CryptoCounters &nearby_test_fakes_GetCryptoCounters() {
+  return crypto_counters;
 }
 
 const uint8_t *nearby_platform_GetAntiSpoofingPrivateKey() {
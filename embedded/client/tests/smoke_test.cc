@@ -514,6 +514,48 @@ TEST(NearbyFpClient, AdvertisementNondiscoverable_twoKeys) {
               ElementsAreArray(kExpectedResult, kBufferSize));
 }
 
+TEST(NearbyFpClient, AdvertisementNondiscoverable_addedKeyUpdatesBloomFilter) {
+  uint8_t salt = 0xC7;
+  nearby_platform_AccountKeyInfo account_key1 = {
+      {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0x00, 0xAA, 0xBB,
+       0xCC, 0xDD, 0xEE, 0xFF}};
+  nearby_platform_AccountKeyInfo account_key2 = {
+      {0x11, 0x11, 0x22, 0x22, 0x33, 0x33, 0x44, 0x44, 0x55, 0x55, 0x66, 0x66,
+       0x77, 0x77, 0x88, 0x88}};
+  std::vector<AccountKeyPair> account_keys{
+      AccountKeyPair(kRemoteDevice, account_key1.account_key)};
+  // Same as AdvertisementNondiscoverable_twoKeys
+  const uint8_t kExpectedResult1[] = {12,   0x16, 0x2C, 0xFE,    0x00, 0x52,
+                                      0x2f, 0xba, 0x06, 0x42,    0x00, 0x11,
+                                      salt, 2,    0x0A, kTxPower};
+  const uint8_t kExpectedResult2[] = {13,   0x16, 0x2C, 0xFE, 0x00,    0x52,
+                                      0x4d, 0x08, 0x00, 0x5d, 0x1c,    0x21,
+                                      salt, salt, 2,    0x0A, kTxPower};
+  const uint8_t* kExpectedResult =
+      (NEARBY_FP_SALT_SIZE == 1) ? kExpectedResult1 : kExpectedResult2;
+  const int kBufferSize = (NEARBY_FP_SALT_SIZE == 1) ? sizeof(kExpectedResult1)
+                                                     : sizeof(kExpectedResult2);
+  uint8_t buffer[kBufferSize];
+  nearby_fp_client_Init(NULL);
+  nearby_test_fakes_SetAccountKeys(account_keys);
+  nearby_test_fakes_SetRandomNumber(salt);
+  nearby_fp_LoadAccountKeys();
+  // Computes and keeps the bloom filter of the first key
+  nearby_fp_CreateNondiscoverableAdvertisement(buffer, kBufferSize, false);
+  nearby_fp_SetBloomFilter(buffer, kRegularBloomFormat, kNoInUseKey);
+
+  nearby_fp_AddAccountKey(&account_key2);
+  size_t written =
+      nearby_fp_CreateNondiscoverableAdvertisement(buffer, kBufferSize, false);
+  nearby_fp_SetBloomFilter(buffer, kRegularBloomFormat, kNoInUseKey);
+  written += nearby_fp_AppendTxPower(buffer + written, kBufferSize - written,
+                                     kTxPower);
+
+  ASSERT_EQ(kBufferSize, written);
+  ASSERT_THAT(std::vector<uint8_t>(buffer, buffer + kBufferSize),
+              ElementsAreArray(kExpectedResult, kBufferSize));
+}
+
 TEST(NearbyFpClient,
      AdvertisementNondiscoverable_duplicateKeys_ignoreDuplicates) {
   uint8_t salt = 0xC7;
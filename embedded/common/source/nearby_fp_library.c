@@ -95,8 +95,35 @@ static const uint8_t kSassRrdKey[] = {'S', 'A', 'S', 'S', '-', 'R',
 
 static AccountKeyList account_key_list;
 
+// Incremented whenever the account key list changes
+static uint32_t account_key_list_version;
+
 static uint8_t sha_buffer[32];
 
+#define MAX_BLOOM_FILTER_SIZE ((6 * NEARBY_MAX_ACCOUNT_KEYS + 15) / 5)
+
+// The last bloom filter computed by nearby_fp_SetBloomFilter() and the inputs
+// it was computed from. Every account key is hashed together with the salt,
+// battery info and random resolvable field, so the filter can be reused only
+// when none of the inputs changed.
+static struct {
+  bool valid;
+  uint32_t account_key_list_version;
+  bool use_sass_format;
+  bool has_in_use_key;
+  uint8_t in_use_key[ACCOUNT_KEY_SIZE_BYTES];
+  // Salt, battery info and random resolvable fields, each prefixed with its
+  // length
+  uint8_t inputs[NON_DISCOVERABLE_ADV_SIZE_BYTES + 3];
+  size_t inputs_length;
+  uint8_t filter[MAX_BLOOM_FILTER_SIZE];
+} bloom_filter_cache;
+
+// Salt to use in the next non-discoverable advertisement instead of a random
+// one
+static bool has_next_salt;
+static uint8_t next_salt[NEARBY_FP_SALT_SIZE];
+
 #define RETURN_IF_ERROR(X)                        \
   do {                                            \
     nearby_platform_status status = X;            \
@@ -177,6 +204,7 @@ void nearby_fp_MarkAccountKeyAsActive(unsigned key_number) {
     account_key_list.key[i] = account_key_list.key[i - 1];
   }
   account_key_list.key[0] = tmp;
+  account_key_list_version++;
 }
 
 void nearby_fp_CopyAccountKey(nearby_platform_AccountKeyInfo* dest,
@@ -223,6 +251,7 @@ void nearby_fp_AddAccountKey(const nearby_platform_AccountKeyInfo* key) {
   if (key_count < NEARBY_MAX_ACCOUNT_KEYS) {
     account_key_list.num_keys++;
   }
+  account_key_list_version++;
 }
 size_t nearby_fp_CreateDiscoverableAdvertisement(uint8_t* output,
                                                  size_t length) {
@@ -295,8 +324,13 @@ static size_t CreateNondiscoverableAdvertisement(
   i += FP_SERVICE_UUID_SIZE;
 
   // service data
-  for (int si = 0; si < NEARBY_FP_SALT_SIZE; si++)
-    salt[si] = nearby_platform_Rand();
+  if (has_next_salt) {
+    memcpy(salt, next_salt, NEARBY_FP_SALT_SIZE);
+    has_next_salt = false;
+  } else {
+    for (int si = 0; si < NEARBY_FP_SALT_SIZE; si++)
+      salt[si] = nearby_platform_Rand();
+  }
   size_t n = nearby_fp_GetUniqueAccountKeyCount();
   if (n == 0) {
     const unsigned kMessageSize = 2;
@@ -340,6 +374,13 @@ static size_t CreateNondiscoverableAdvertisement(
   return i;
 }
 
+void nearby_fp_SetNextSalt(const uint8_t* salt) {
+  has_next_salt = salt != NULL;
+  if (has_next_salt) {
+    memcpy(next_salt, salt, NEARBY_FP_SALT_SIZE);
+  }
+}
+
 size_t nearby_fp_CreateNondiscoverableAdvertisement(
     uint8_t* output, size_t length, bool show_pairing_indicator) {
 #if NEARBY_FP_ENABLE_BATTERY_NOTIFICATION
@@ -374,9 +415,21 @@ static const uint8_t* FindBatteryInfoLt(const uint8_t* advertisement) {
   return battery_info;
 }
 
+static size_t AppendBloomFilterInput(uint8_t* output, size_t offset,
+                                     const uint8_t* input, int length) {
+  NEARBY_ASSERT(offset + 1 + length <= sizeof(bloom_filter_cache.inputs));
+  output[offset++] = length;
+  if (length > 0) {
+    memcpy(output + offset, input, length);
+  }
+  return offset + length;
+}
+
 size_t nearby_fp_SetBloomFilter(uint8_t* advertisement, bool use_sass_format,
                                 const uint8_t* in_use_key) {
   unsigned key_offset = 0;
+  uint8_t inputs[sizeof(bloom_filter_cache.inputs)];
+  size_t inputs_length;
   if (advertisement[ACCOUNT_KEY_DATA_OFFSET] == 0) {
     NEARBY_TRACE(INFO, "Empty account key filter");
     return 0;
@@ -404,7 +457,29 @@ size_t nearby_fp_SetBloomFilter(uint8_t* advertisement, bool use_sass_format,
   const size_t n = nearby_fp_GetUniqueAccountKeyCount();
   const size_t s = (6 * n + 15) / 5;
   NEARBY_ASSERT(s == GetLtLength(advertisement[ACCOUNT_KEY_DATA_OFFSET]));
+  NEARBY_ASSERT(s <= MAX_BLOOM_FILTER_SIZE);
   uint8_t* output = advertisement + ACCOUNT_KEY_DATA_OFFSET + LTV_HEADER_SIZE;
+  inputs_length = AppendBloomFilterInput(inputs, 0, salt, salt_length);
+  inputs_length = AppendBloomFilterInput(inputs, inputs_length,
+                                         battery_info_field,
+                                         battery_info_field_length);
+  inputs_length = AppendBloomFilterInput(inputs, inputs_length,
+                                         random_resolvable_field,
+                                         random_resolvable_field_length);
+  if (use_sass_format) {
+    advertisement[HEADER_OFFSET] = SASS_HEADER;
+  }
+  if (bloom_filter_cache.valid &&
+      bloom_filter_cache.account_key_list_version == account_key_list_version &&
+      bloom_filter_cache.use_sass_format == use_sass_format &&
+      bloom_filter_cache.has_in_use_key == (in_use_key != NULL) &&
+      (in_use_key == NULL || !memcmp(bloom_filter_cache.in_use_key, in_use_key,
+                                     ACCOUNT_KEY_SIZE_BYTES)) &&
+      bloom_filter_cache.inputs_length == inputs_length &&
+      !memcmp(bloom_filter_cache.inputs, inputs, inputs_length)) {
+    memcpy(output, bloom_filter_cache.filter, s);
+    return s;
+  }
   memset(output, 0, s);
   for (size_t k = 0; k < n; k++) {
     key_offset = nearby_fp_GetNextUniqueAccountKeyIndex(key_offset);
@@ -437,9 +512,16 @@ size_t nearby_fp_SetBloomFilter(uint8_t* advertisement, bool use_sass_format,
       output[m / 8] |= (1 << (m % 8));
     }
   }
-  if (use_sass_format) {
-    advertisement[HEADER_OFFSET] = SASS_HEADER;
+  bloom_filter_cache.valid = true;
+  bloom_filter_cache.account_key_list_version = account_key_list_version;
+  bloom_filter_cache.use_sass_format = use_sass_format;
+  bloom_filter_cache.has_in_use_key = in_use_key != NULL;
+  if (in_use_key != NULL) {
+    memcpy(bloom_filter_cache.in_use_key, in_use_key, ACCOUNT_KEY_SIZE_BYTES);
   }
+  memcpy(bloom_filter_cache.inputs, inputs, inputs_length);
+  bloom_filter_cache.inputs_length = inputs_length;
+  memcpy(bloom_filter_cache.filter, output, s);
   return s;
 }
 
@@ -461,6 +543,7 @@ size_t nearby_fp_AppendTxPower(uint8_t* advertisement, size_t length,
 nearby_platform_status nearby_fp_LoadAccountKeys() {
   size_t length = sizeof(account_key_list);
   memset(&account_key_list, 0, length);
+  account_key_list_version++;
   return nearby_platform_LoadValue(kStoredKeyAccountKeyList,
                                    (uint8_t*)&account_key_list, &length);
 }
@@ -61,6 +61,11 @@ extern "C" {
 size_t nearby_fp_CreateDiscoverableAdvertisement(uint8_t* output,
                                                  size_t length);
 
+// Sets the salt used by the next nearby_fp_CreateNondiscoverableAdvertisement()
+// call, instead of a random one. The salt applies to one advertisement only.
+// Clears a salt set earlier when |salt| is NULL.
+void nearby_fp_SetNextSalt(const uint8_t* salt);
+
 // Creates advertisement with Account Key Data. Returns the number of bytes
 // written to |output|.
 //
@@ -146,6 +151,9 @@ void nearby_fp_AddAccountKey(const nearby_platform_AccountKeyInfo* key);
 // field and Random Resolvable field are used in the bloom filter calculation if
 // present in the advertisement, When `use_sass_format` is set, the bloom filter
 // defined by SASS will be used.
+//
+// The last bloom filter is kept and copied, without hashing, while the account
+// keys and all the inputs read from `advertisement` stay the same.
 size_t nearby_fp_SetBloomFilter(uint8_t* advertisement, bool use_sass_format,
                                 const uint8_t* in_use_key);
 
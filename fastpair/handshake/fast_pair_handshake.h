@@ -35,7 +35,8 @@ namespace fastpair {
 //
 // The procedure steps are as follows:
 //  1. Create a GATT connection to the device.
-//  2. Create a data encryptor instance with the generated keys.
+//  2. Create a data encryptor instance with the generated keys. This may run
+//  while the GATT connection is being created.
 //  3. Write the Key-Based Pairing Request to the characteristic
 //  (https://developers.google.com/nearby/fast-pair/spec#table1.1)
 //  4. Decrypt the response.
@@ -36,6 +36,11 @@ FastPairHandshakeImpl::FastPairHandshakeImpl(FastPairDevice& device,
                                              OnCompleteCallback on_complete,
                                              SingleThreadExecutor* executor)
     : FastPairHandshake(std::move(on_complete), nullptr, nullptr) {
+  // Creating the GATT connection blocks this thread, so the data encryptor
+  // creation is started first.
+  crypto_executor_.Execute(
+      "create-data-encryptor",
+      [this, &device, executor]() { CreateDataEncryptor(device, executor); });
   fast_pair_gatt_service_client_ =
       FastPairGattServiceClientImpl::Factory::Create(device, mediums, executor);
   fast_pair_gatt_service_client_->InitializeGattConnection(
@@ -44,30 +49,61 @@ FastPairHandshakeImpl::FastPairHandshakeImpl(FastPairDevice& device,
       });
 }
 
+void FastPairHandshakeImpl::CreateDataEncryptor(
+    FastPairDevice& device, SingleThreadExecutor* executor) {
+  auto on_created = [this, &device, executor](
+                        std::unique_ptr<FastPairDataEncryptor> encryptor) {
+    executor->Execute(
+        "data-encryptor-created",
+        [this, &device, encryptor = std::move(encryptor)]() mutable {
+          OnDataEncryptorCreateAsync(device, std::move(encryptor));
+        });
+  };
+  if (cancelled_) {
+    NEARBY_LOGS(INFO) << __func__
+                      << ": GATT connection failed, skipping data encryptor.";
+    on_created(nullptr);
+    return;
+  }
+  FastPairDataEncryptorImpl::Factory::CreateAsync(device,
+                                                  std::move(on_created));
+}
+
 void FastPairHandshakeImpl::OnGattClientInitializedCallback(
     FastPairDevice& device, std::optional<PairFailure> failure) {
+  gatt_initialized_ = true;
   if (failure.has_value()) {
     NEARBY_LOGS(WARNING) << __func__
                          << ": Failed to init gatt client with failure = "
                          << failure.value();
-    std::move(on_complete_callback_)(device, failure.value());
-    return;
+    cancelled_ = true;
+    gatt_failure_ = failure;
+  } else {
+    NEARBY_LOGS(INFO)
+        << __func__
+        << ": Fast Pair GATT service client initialization successful.";
   }
-
-  NEARBY_LOGS(INFO)
-      << __func__
-      << ": Fast Pair GATT service client initialization successful.";
-  FastPairDataEncryptorImpl::Factory::CreateAsync(
-      device,
-      [&](std::unique_ptr<FastPairDataEncryptor> fast_pair_data_encryptor) {
-        OnDataEncryptorCreateAsync(device, std::move(fast_pair_data_encryptor));
-      });
+  OnSetupStepDone(device);
 }
 
 void FastPairHandshakeImpl::OnDataEncryptorCreateAsync(
     FastPairDevice& device,
     std::unique_ptr<FastPairDataEncryptor> fast_pair_data_encryptor) {
-  if (!fast_pair_data_encryptor) {
+  data_encryptor_done_ = true;
+  fast_pair_data_encryptor_ = std::move(fast_pair_data_encryptor);
+  OnSetupStepDone(device);
+}
+
+void FastPairHandshakeImpl::OnSetupStepDone(FastPairDevice& device) {
+  if (!gatt_initialized_ || !data_encryptor_done_) return;
+
+  if (gatt_failure_.has_value()) {
+    fast_pair_data_encryptor_.reset();
+    std::move(on_complete_callback_)(device, *gatt_failure_);
+    return;
+  }
+
+  if (!fast_pair_data_encryptor_) {
     NEARBY_LOGS(WARNING) << __func__
                          << ": Failed to create Fast Pair Data Encryptor.";
     std::move(on_complete_callback_)(device,
@@ -75,7 +111,6 @@ void FastPairHandshakeImpl::OnDataEncryptorCreateAsync(
     return;
   }
 
-  fast_pair_data_encryptor_ = std::move(fast_pair_data_encryptor);
   NEARBY_LOGS(INFO) << __func__ << ": Beginning key-based pairing protocol";
   fast_pair_gatt_service_client_->WriteRequestAsync(
       /*message_type=*/kKeyBasedPairingType,
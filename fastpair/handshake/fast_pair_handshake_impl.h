@@ -15,6 +15,7 @@
 #ifndef THIRD_PARTY_NEARBY_FASTPAIR_HANDSHAKE_FAST_PAIR_HANDSHAKE_IMPL_H_
 #define THIRD_PARTY_NEARBY_FASTPAIR_HANDSHAKE_FAST_PAIR_HANDSHAKE_IMPL_H_
 
+#include <atomic>
 #include <memory>
 #include <optional>
 
@@ -23,10 +24,14 @@
 #include "fastpair/crypto/decrypted_response.h"
 #include "fastpair/handshake/fast_pair_handshake.h"
 #include "fastpair/internal/mediums/mediums.h"
+#include "internal/platform/single_thread_executor.h"
 
 namespace nearby {
 namespace fastpair {
 
+// The data encryptor is created on a background thread while the GATT
+// connection is being created, since both may take hundreds of milliseconds.
+// The Key-Based Pairing Request is written once both are done.
 class FastPairHandshakeImpl : public FastPairHandshake {
  public:
   explicit FastPairHandshakeImpl(FastPairDevice& device, Mediums& mediums,
@@ -36,15 +41,32 @@ class FastPairHandshakeImpl : public FastPairHandshake {
   FastPairHandshakeImpl& operator=(const FastPairHandshakeImpl&) = delete;
 
  private:
+  void CreateDataEncryptor(FastPairDevice& device,
+                           SingleThreadExecutor* executor);
   void OnGattClientInitializedCallback(FastPairDevice& device,
                                        std::optional<PairFailure> failure);
   void OnDataEncryptorCreateAsync(
       FastPairDevice& device,
       std::unique_ptr<FastPairDataEncryptor> fast_pair_data_encryptor);
+  // Starts the key-based pairing protocol, or reports the failure of the
+  // setup, once both the GATT connection and the data encryptor are done.
+  void OnSetupStepDone(FastPairDevice& device);
   void OnWriteResponse(FastPairDevice& device, absl::string_view response,
                        std::optional<PairFailure> failure);
   void OnParseDecryptedResponse(FastPairDevice& device,
                                 std::optional<DecryptedResponse>& response);
+
+  // Accessed on the executor passed to the constructor.
+  bool gatt_initialized_ = false;
+  std::optional<PairFailure> gatt_failure_;
+  bool data_encryptor_done_ = false;
+
+  // Set when the GATT connection failed, so that the data encryptor isn't
+  // created if that hasn't started yet.
+  std::atomic<bool> cancelled_ = false;
+  // Destroyed first, so that the data encryptor isn't being created while the
+  // rest of the handshake is destroyed.
+  SingleThreadExecutor crypto_executor_;
 };
 
 }  // namespace fastpair
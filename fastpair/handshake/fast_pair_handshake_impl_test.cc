@@ -23,6 +23,8 @@
 #include "gtest/gtest.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
 #include "fastpair/common/fast_pair_device.h"
 #include "fastpair/common/pair_failure.h"
 #include "fastpair/common/protocol.h"
@@ -30,6 +32,9 @@
 #include "fastpair/handshake/fake_fast_pair_data_encryptor.h"
 #include "fastpair/handshake/fast_pair_data_encryptor.h"
 #include "fastpair/handshake/fast_pair_data_encryptor_impl.h"
+#include "fastpair/handshake/fast_pair_gatt_service_client.h"
+#include "fastpair/handshake/fast_pair_gatt_service_client_impl.h"
+#include "fastpair/internal/mediums/mediums.h"
 #include "internal/platform/byte_array.h"
 #include "internal/platform/count_down_latch.h"
 #include "internal/platform/medium_environment.h"
@@ -74,6 +79,7 @@ class FastPairFakeDataEncryptorImplFactory
       const FastPairDevice& device,
       absl::AnyInvocable<void(std::unique_ptr<FastPairDataEncryptor>)>
           on_get_instance_callback) override {
+    if (on_key_exchange_) on_key_exchange_();
     if (!successful_retrieval_) {
       std::move(on_get_instance_callback)(nullptr);
       return;
@@ -89,6 +95,12 @@ class FastPairFakeDataEncryptorImplFactory
 
   void SetFailedRetrieval() { successful_retrieval_ = false; }
 
+  // Runs |on_key_exchange| on the thread that creates the data encryptor, in
+  // place of the key exchange.
+  void SetOnKeyExchange(absl::AnyInvocable<void()> on_key_exchange) {
+    on_key_exchange_ = std::move(on_key_exchange);
+  }
+
   void SetResponse(std::optional<DecryptedResponse> response) {
     response_ = std::move(response);
   }
@@ -96,9 +108,97 @@ class FastPairFakeDataEncryptorImplFactory
  private:
   FakeFastPairDataEncryptor* data_encryptor_ = nullptr;
   bool successful_retrieval_ = true;
+  absl::AnyInvocable<void()> on_key_exchange_;
   std::optional<DecryptedResponse> response_;
 };
 
+// Creates GATT service clients that run |before_connect| and |after_connect|
+// around the connection.
+class ObservedGattServiceClientFactory
+    : public FastPairGattServiceClientImpl::Factory {
+ public:
+  ObservedGattServiceClientFactory(const FastPairDevice& device,
+                                   Mediums& mediums,
+                                   SingleThreadExecutor* executor,
+                                   absl::AnyInvocable<void()> before_connect,
+                                   absl::AnyInvocable<void()> after_connect)
+      : device_(device),
+        mediums_(mediums),
+        executor_(executor),
+        before_connect_(std::move(before_connect)),
+        after_connect_(std::move(after_connect)) {
+    FastPairGattServiceClientImpl::Factory::SetFactoryForTesting(this);
+  }
+  ~ObservedGattServiceClientFactory() override {
+    FastPairGattServiceClientImpl::Factory::SetFactoryForTesting(nullptr);
+  }
+
+ protected:
+  std::unique_ptr<FastPairGattServiceClient> CreateInstance() override {
+    return std::make_unique<ObservedGattServiceClient>(
+        std::make_unique<FastPairGattServiceClientImpl>(device_, mediums_,
+                                                        executor_),
+        std::move(before_connect_), std::move(after_connect_));
+  }
+
+ private:
+  class ObservedGattServiceClient : public FastPairGattServiceClient {
+   public:
+    ObservedGattServiceClient(std::unique_ptr<FastPairGattServiceClient> client,
+                              absl::AnyInvocable<void()> before_connect,
+                              absl::AnyInvocable<void()> after_connect)
+        : client_(std::move(client)),
+          before_connect_(std::move(before_connect)),
+          after_connect_(std::move(after_connect)) {}
+
+    void InitializeGattConnection(
+        absl::AnyInvocable<void(std::optional<PairFailure>)>
+            on_gatt_initialized_callback) override {
+      if (before_connect_) before_connect_();
+      client_->InitializeGattConnection(
+          std::move(on_gatt_initialized_callback));
+      if (after_connect_) after_connect_();
+    }
+
+    void WriteRequestAsync(
+        uint8_t message_type, uint8_t flags,
+        absl::string_view provider_address, absl::string_view seekers_address,
+        const FastPairDataEncryptor& fast_pair_data_encryptor,
+        WriteResponseCallback write_response_callback) override {
+      client_->WriteRequestAsync(message_type, flags, provider_address,
+                                 seekers_address, fast_pair_data_encryptor,
+                                 std::move(write_response_callback));
+    }
+
+    void WritePasskeyAsync(
+        uint8_t message_type, uint32_t passkey,
+        const FastPairDataEncryptor& fast_pair_data_encryptor,
+        WriteResponseCallback write_response_callback) override {
+      client_->WritePasskeyAsync(message_type, passkey,
+                                 fast_pair_data_encryptor,
+                                 std::move(write_response_callback));
+    }
+
+    void WriteAccountKey(
+        const FastPairDataEncryptor& fast_pair_data_encryptor,
+        WriteAccountkeyCallback write_accountkey_callback) override {
+      client_->WriteAccountKey(fast_pair_data_encryptor,
+                               std::move(write_accountkey_callback));
+    }
+
+   private:
+    std::unique_ptr<FastPairGattServiceClient> client_;
+    absl::AnyInvocable<void()> before_connect_;
+    absl::AnyInvocable<void()> after_connect_;
+  };
+
+  const FastPairDevice& device_;
+  Mediums& mediums_;
+  SingleThreadExecutor* executor_;
+  absl::AnyInvocable<void()> before_connect_;
+  absl::AnyInvocable<void()> after_connect_;
+};
+
 struct CharacteristicData {
   // Write result returned to the gatt client.
   absl::Status write_result;
@@ -321,5 +421,75 @@ TEST_F(FastPairHandshakeImplTest, ParseResponseError) {
   latch.Await();
   EXPECT_FALSE(handshake_->completed_successfully());
 }
+
+// The key exchange runs during the GATT connection, so the handshake takes
+// about as long as the slower of the two rather than their sum.
+TEST_F(FastPairHandshakeImplTest, KeyExchangeOverlapsGattConnection) {
+  StartGattServer();
+  InsertCorrectGattCharacteristics();
+  SetNotifyResponse(*key_based_characteristic_, kKeyBasedResponse);
+  fast_pair_device_ = std::make_unique<FastPairDevice>(
+      kMetadataId, provider_address_, Protocol::kFastPairInitialPairing);
+  SetDecryptedResponse();
+  absl::Notification key_exchange_started;
+  fake_data_encryptor_factory_.SetOnKeyExchange(
+      [&]() { key_exchange_started.Notify(); });
+  // Times out only if the key exchange waits for the GATT connection.
+  bool started_before_connect = false;
+  ObservedGattServiceClientFactory gatt_factory(
+      *fast_pair_device_, mediums_, &executor_,
+      /*before_connect=*/
+      [&]() {
+        started_before_connect =
+            key_exchange_started.WaitForNotificationWithTimeout(
+                absl::Seconds(10));
+      },
+      /*after_connect=*/nullptr);
+  CountDownLatch latch(1);
+  handshake_ = std::make_unique<FastPairHandshakeImpl>(
+      *fast_pair_device_, mediums_,
+      [&](FastPairDevice& callback_device, std::optional<PairFailure> failure) {
+        EXPECT_FALSE(failure.has_value());
+        latch.CountDown();
+      },
+      &executor_);
+  latch.Await();
+
+  EXPECT_TRUE(started_before_connect);
+  EXPECT_TRUE(handshake_->completed_successfully());
+}
+
+TEST_F(FastPairHandshakeImplTest, GattErrorDuringKeyExchange) {
+  StartGattServer();
+  fast_pair_device_ = std::make_unique<FastPairDevice>(
+      kMetadataId, provider_address_, Protocol::kFastPairInitialPairing);
+  SetDecryptedResponse();
+  // The key exchange is still running when the GATT connection fails.
+  absl::Notification key_exchange_started;
+  absl::Notification gatt_failed;
+  fake_data_encryptor_factory_.SetOnKeyExchange([&]() {
+    key_exchange_started.Notify();
+    gatt_failed.WaitForNotification();
+  });
+  ObservedGattServiceClientFactory gatt_factory(
+      *fast_pair_device_, mediums_, &executor_,
+      /*before_connect=*/
+      [&]() {
+        EXPECT_TRUE(key_exchange_started.WaitForNotificationWithTimeout(
+            absl::Seconds(10)));
+      },
+      /*after_connect=*/[&]() { gatt_failed.Notify(); });
+  CountDownLatch latch(1);
+  handshake_ = std::make_unique<FastPairHandshakeImpl>(
+      *fast_pair_device_, mediums_,
+      [&](FastPairDevice& callback_device, std::optional<PairFailure> failure) {
+        EXPECT_EQ(failure.value(), PairFailure::kCreateGattConnection);
+        latch.CountDown();
+      },
+      &executor_);
+  latch.Await();
+  EXPECT_FALSE(handshake_->completed_successfully());
+  EXPECT_EQ(handshake_->fast_pair_data_encryptor(), nullptr);
+}
 }  // namespace fastpair
 }  // namespace nearby
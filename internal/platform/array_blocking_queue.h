@@ -15,14 +15,19 @@
 #ifndef PLATFORM_PUBLIC_ARRAY_BLOCKING_QUEUE_H_
 #define PLATFORM_PUBLIC_ARRAY_BLOCKING_QUEUE_H_
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <memory>
+#include <new>
 #include <optional>
-#include <queue>
+#include <utility>
 
+#include "absl/time/time.h"
 #include "internal/platform/condition_variable.h"
-#include "internal/platform/logging.h"
 #include "internal/platform/mutex.h"
 #include "internal/platform/mutex_lock.h"
+#include "internal/platform/system_clock.h"
 
 namespace nearby {
 
@@ -31,72 +36,230 @@ namespace nearby {
  * ArrayBlockingQueue before sending to ensure each client has equal chance to
  * send its data. Since C++ doesn't provide ArrayBlockingQueue as Java, we
  * implement one here.
+ *
+ * The queue is a bounded multi-producer multi-consumer ring buffer. Each cell
+ * carries a sequence number that tells producers and consumers whether it is
+ * free or full, so the non-blocking operations are lock-free and nothing is
+ * allocated after construction. Blocking operations retry in a loop, so a
+ * spurious or stolen wakeup never puts the queue over capacity or takes from
+ * an empty queue. The mutex is only used to park and wake blocked threads.
  */
 template <typename T>
 class ArrayBlockingQueue {
  public:
-  explicit ArrayBlockingQueue(size_t capacity) : capacity_(capacity) {}
+  enum class WaitStrategy {
+    // Blocked threads park on a condition variable right away.
+    kPark,
+    // Blocked threads retry for a short while before parking. Useful when the
+    // other side is expected to catch up within microseconds.
+    kSpinThenPark,
+  };
 
-  void Put(const T& value) {
-    MutexLock lock(&queue_mutex_);
-    if (queue_.size() >= capacity_) {
-      has_space_.Wait();
+  // A capacity of zero is treated as one.
+  explicit ArrayBlockingQueue(size_t capacity,
+                              WaitStrategy wait_strategy = WaitStrategy::kPark)
+      : capacity_(std::max<size_t>(capacity, 1)),
+        num_cells_(std::max<size_t>(capacity_, 2)),
+        wait_strategy_(wait_strategy),
+        cells_(new Cell[num_cells_]) {
+    for (size_t i = 0; i < num_cells_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
     }
-    queue_.push(value);
-    NEARBY_LOGS(INFO) << "ArrayBlockingQueue::Put()";
-    has_data_.Notify();
   }
-
-  T Take() {
-    MutexLock lock(&queue_mutex_);
-    if (queue_.empty()) {
-      has_data_.Wait();
+  ~ArrayBlockingQueue() {
+    while (TryTakeInternal().has_value()) {
     }
-    T front = queue_.front();
-    queue_.pop();
-    NEARBY_LOGS(INFO) << "ArrayBlockingQueue::Take()";
-    has_space_.Notify();
-    return front;
   }
 
+  ArrayBlockingQueue(const ArrayBlockingQueue&) = delete;
+  ArrayBlockingQueue& operator=(const ArrayBlockingQueue&) = delete;
+
+  // Blocks until there is space in the queue.
+  void Put(const T& value) { PutUntil(value, absl::InfiniteFuture()); }
+  void Put(T&& value) { PutUntil(std::move(value), absl::InfiniteFuture()); }
+
+  // Blocks until an element is available.
+  T Take() { return *TakeUntil(absl::InfiniteFuture()); }
+
+  // Returns false if the queue is full.
   bool TryPut(const T& value) {
-    MutexLock lock(&queue_mutex_);
-    if (queue_.size() < capacity_) {
-      queue_.push(value);
-      has_data_.Notify();
-      return true;
-    }
-    return false;
+    return PutUntil(value, absl::InfinitePast());
+  }
+  bool TryPut(T&& value) {
+    return PutUntil(std::move(value), absl::InfinitePast());
+  }
+
+  // Returns false if the queue is still full after `timeout`.
+  bool TryPut(const T& value, absl::Duration timeout) {
+    return PutUntil(value, SystemClock::ElapsedRealtime() + timeout);
+  }
+  bool TryPut(T&& value, absl::Duration timeout) {
+    return PutUntil(std::move(value), SystemClock::ElapsedRealtime() + timeout);
   }
 
   // Returns std::nullopt if the queue is empty.
-  std::optional<T> TryTake() {
-    MutexLock lock(&queue_mutex_);
-    if (!queue_.empty()) {
-      T front = queue_.front();
-      queue_.pop();
-      has_space_.Notify();
-      return front;
-    }
-    return std::nullopt;
+  std::optional<T> TryTake() { return TakeUntil(absl::InfinitePast()); }
+
+  // Returns std::nullopt if the queue is still empty after `timeout`.
+  std::optional<T> TryTake(absl::Duration timeout) {
+    return TakeUntil(SystemClock::ElapsedRealtime() + timeout);
   }
 
+  // The size is a snapshot and may be stale by the time it is returned.
   size_t Size() const {
-    MutexLock lock(&queue_mutex_);
-    return queue_.size();
+    size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+    size_t head = dequeue_pos_.load(std::memory_order_acquire);
+    if (head >= tail) return 0;
+    return std::min(tail - head, capacity_);
   }
 
-  bool Empty() const {
-    MutexLock lock(&queue_mutex_);
-    return queue_.empty();
-  }
+  bool Empty() const { return Size() == 0; }
 
  private:
-  std::queue<T> queue_;
-  mutable Mutex queue_mutex_;
-  ConditionVariable has_data_{&queue_mutex_};
-  ConditionVariable has_space_{&queue_mutex_};
+  static constexpr size_t kCacheLineSize = 64;
+  static constexpr int kSpinCount = 128;
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  template <typename U>
+  bool TryPutInternal(U&& value) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      if (num_cells_ != capacity_ &&
+          pos - dequeue_pos_.load(std::memory_order_acquire) >= capacity_) {
+        return false;
+      }
+      cell = &cells_[pos % num_cells_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The cell still holds the element from the previous lap.
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    new (cell->storage) T(std::forward<U>(value));
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::optional<T> TryTakeInternal() {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos % num_cells_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The producer for this cell hasn't published yet.
+        return std::nullopt;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    T* element = std::launder(reinterpret_cast<T*>(cell->storage));
+    std::optional<T> result(std::move(*element));
+    element->~T();
+    cell->sequence.store(pos + num_cells_, std::memory_order_release);
+    return result;
+  }
+
+  // TryPutInternal() only consumes `value` when it succeeds, so it is safe to
+  // forward it on every attempt.
+  template <typename U>
+  bool PutUntil(U&& value, absl::Time deadline) {
+    if (!WaitUntil(putters_waiting_, has_space_, deadline, [&]() {
+          return TryPutInternal(std::forward<U>(value));
+        })) {
+      return false;
+    }
+    WakeUp(takers_waiting_, has_data_);
+    return true;
+  }
+
+  std::optional<T> TakeUntil(absl::Time deadline) {
+    std::optional<T> result;
+    if (WaitUntil(takers_waiting_, has_data_, deadline, [&]() {
+          result = TryTakeInternal();
+          return result.has_value();
+        })) {
+      WakeUp(putters_waiting_, has_space_);
+    }
+    return result;
+  }
+
+  // Runs `attempt` until it succeeds or `deadline` passes. `waiters` counts
+  // the threads parked on `cond`.
+  template <typename Attempt>
+  bool WaitUntil(std::atomic<int>& waiters, ConditionVariable& cond,
+                 absl::Time deadline, Attempt attempt) {
+    if (attempt()) return true;
+    if (deadline == absl::InfinitePast()) return false;
+    if (wait_strategy_ == WaitStrategy::kSpinThenPark) {
+      for (int i = 0; i < kSpinCount; ++i) {
+        if (attempt()) return true;
+      }
+    }
+    MutexLock lock(&mutex_);
+    while (true) {
+      // Registering as a waiter before the final attempt pairs with the fence
+      // in WakeUp(): either the attempt sees the other side's update, or the
+      // other side sees this waiter and notifies under `mutex_`.
+      waiters.fetch_add(1, std::memory_order_seq_cst);
+      bool done = attempt();
+      if (!done) {
+        if (deadline == absl::InfiniteFuture()) {
+          cond.Wait();
+        } else {
+          absl::Duration remaining = deadline - SystemClock::ElapsedRealtime();
+          if (remaining > absl::ZeroDuration()) cond.Wait(remaining);
+        }
+      }
+      waiters.fetch_sub(1, std::memory_order_relaxed);
+      if (done) return true;
+      if (deadline != absl::InfiniteFuture() &&
+          SystemClock::ElapsedRealtime() >= deadline) {
+        return attempt();
+      }
+    }
+  }
+
+  void WakeUp(std::atomic<int>& waiters, ConditionVariable& cond) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) > 0) {
+      MutexLock lock(&mutex_);
+      cond.Notify();
+    }
+  }
+
   const size_t capacity_;
+  // The ring needs at least two cells to tell a full cell from a free one, so
+  // a queue of capacity one checks the occupancy explicitly.
+  const size_t num_cells_;
+  const WaitStrategy wait_strategy_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(kCacheLineSize) std::atomic<size_t> enqueue_pos_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> dequeue_pos_{0};
+  alignas(kCacheLineSize) std::atomic<int> putters_waiting_{0};
+  std::atomic<int> takers_waiting_{0};
+  Mutex mutex_;
+  ConditionVariable has_data_{&mutex_};
+  ConditionVariable has_space_{&mutex_};
 };
 
 }  // namespace nearby
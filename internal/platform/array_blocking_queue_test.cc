@@ -0,0 +1,207 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "internal/platform/array_blocking_queue.h"
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace nearby {
+namespace {
+
+using WaitStrategy = ArrayBlockingQueue<int>::WaitStrategy;
+
+constexpr int kProducers = 4;
+constexpr int kConsumers = 4;
+constexpr int kItemsPerProducer = 25000;
+
+// Moves `kProducers * kItemsPerProducer` items through `queue`. Checks that
+// every item is taken exactly once, and that each consumer sees the items of
+// a given producer in order.
+void RunProducersAndConsumers(ArrayBlockingQueue<int>& queue) {
+  constexpr int kItems = kProducers * kItemsPerProducer;
+  std::atomic<int> taken = 0;
+  std::atomic<bool> in_order = true;
+  std::vector<std::atomic<int>> times_taken(kItems);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; ++p) {
+    threads.emplace_back([&queue, p]() {
+      for (int i = 0; i < kItemsPerProducer; ++i) {
+        queue.Put(p * kItemsPerProducer + i);
+      }
+    });
+  }
+  for (int c = 0; c < kConsumers; ++c) {
+    threads.emplace_back([&]() {
+      std::vector<int> last(kProducers, -1);
+      while (taken.fetch_add(1) < kItems) {
+        int item = queue.Take();
+        ++times_taken[item];
+        int producer = item / kItemsPerProducer;
+        if (item <= last[producer]) in_order = false;
+        last[producer] = item;
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_TRUE(in_order);
+  int missing_or_duplicated = 0;
+  for (const std::atomic<int>& count : times_taken) {
+    if (count != 1) ++missing_or_duplicated;
+  }
+  EXPECT_EQ(missing_or_duplicated, 0);
+}
+
+TEST(ArrayBlockingQueueTest, PutAndTakeInFifoOrder) {
+  ArrayBlockingQueue<int> queue(3);
+  queue.Put(1);
+  queue.Put(2);
+  queue.Put(3);
+  EXPECT_EQ(queue.Size(), 3);
+  EXPECT_EQ(queue.Take(), 1);
+  EXPECT_EQ(queue.Take(), 2);
+  EXPECT_EQ(queue.Take(), 3);
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST(ArrayBlockingQueueTest, TryPutFailsWhenFull) {
+  ArrayBlockingQueue<int> queue(2);
+  EXPECT_TRUE(queue.TryPut(1));
+  EXPECT_TRUE(queue.TryPut(2));
+  EXPECT_FALSE(queue.TryPut(3));
+  EXPECT_EQ(queue.Size(), 2);
+}
+
+TEST(ArrayBlockingQueueTest, TryTakeFailsWhenEmpty) {
+  ArrayBlockingQueue<int> queue(2);
+  EXPECT_EQ(queue.TryTake(), std::nullopt);
+  queue.Put(5);
+  EXPECT_EQ(queue.TryTake(), 5);
+  EXPECT_EQ(queue.TryTake(), std::nullopt);
+}
+
+TEST(ArrayBlockingQueueTest, TimedTryPutTimesOut) {
+  ArrayBlockingQueue<int> queue(1);
+  queue.Put(1);
+  absl::Time start = absl::Now();
+  EXPECT_FALSE(queue.TryPut(2, absl::Milliseconds(100)));
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(100));
+  EXPECT_EQ(queue.Size(), 1);
+}
+
+TEST(ArrayBlockingQueueTest, TimedTryTakeTimesOut) {
+  ArrayBlockingQueue<int> queue(1);
+  absl::Time start = absl::Now();
+  EXPECT_EQ(queue.TryTake(absl::Milliseconds(100)), std::nullopt);
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(100));
+}
+
+TEST(ArrayBlockingQueueTest, TimedTryTakeReturnsLateElement) {
+  ArrayBlockingQueue<int> queue(1);
+  std::thread producer([&queue]() {
+    absl::SleepFor(absl::Milliseconds(50));
+    queue.Put(7);
+  });
+  EXPECT_EQ(queue.TryTake(absl::Seconds(5)), 7);
+  producer.join();
+}
+
+TEST(ArrayBlockingQueueTest, HoldsMoveOnlyElements) {
+  ArrayBlockingQueue<std::unique_ptr<std::string>> queue(2);
+  queue.Put(std::make_unique<std::string>("a"));
+  EXPECT_TRUE(queue.TryPut(std::make_unique<std::string>("b")));
+  EXPECT_EQ(*queue.Take(), "a");
+  EXPECT_EQ(**queue.TryTake(), "b");
+}
+
+TEST(ArrayBlockingQueueTest, DestroysRemainingElements) {
+  auto element = std::make_shared<int>(1);
+  {
+    ArrayBlockingQueue<std::shared_ptr<int>> queue(4);
+    queue.Put(element);
+    queue.Put(element);
+    EXPECT_EQ(element.use_count(), 3);
+  }
+  EXPECT_EQ(element.use_count(), 1);
+}
+
+// Every Take() wakes all blocked producers. Only one of them may succeed; the
+// rest must go back to waiting instead of pushing past the capacity.
+TEST(ArrayBlockingQueueTest, WokenProducersDoNotExceedCapacity) {
+  constexpr int kCapacity = 1;
+  constexpr int kBlockedProducers = 8;
+  ArrayBlockingQueue<int> queue(kCapacity);
+  queue.Put(0);
+  std::vector<std::thread> producers;
+  for (int i = 1; i <= kBlockedProducers; ++i) {
+    producers.emplace_back([&queue, i]() { queue.Put(i); });
+  }
+  absl::SleepFor(absl::Milliseconds(50));
+  for (int i = 0; i <= kBlockedProducers; ++i) {
+    EXPECT_LE(queue.Size(), kCapacity);
+    queue.Take();
+  }
+  for (auto& producer : producers) producer.join();
+  EXPECT_TRUE(queue.Empty());
+}
+
+// Every Put() wakes all blocked consumers. Only one of them may take the
+// element; the others must not return from an empty queue.
+TEST(ArrayBlockingQueueTest, WokenConsumersDoNotTakeFromEmptyQueue) {
+  constexpr int kBlockedConsumers = 8;
+  ArrayBlockingQueue<int> queue(kBlockedConsumers);
+  std::atomic<int> sum = 0;
+  std::vector<std::thread> consumers;
+  for (int i = 0; i < kBlockedConsumers; ++i) {
+    consumers.emplace_back([&queue, &sum]() { sum += queue.Take(); });
+  }
+  absl::SleepFor(absl::Milliseconds(50));
+  for (int i = 1; i <= kBlockedConsumers; ++i) {
+    queue.Put(i);
+    absl::SleepFor(absl::Milliseconds(5));
+  }
+  for (auto& consumer : consumers) consumer.join();
+  EXPECT_EQ(sum, kBlockedConsumers * (kBlockedConsumers + 1) / 2);
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST(ArrayBlockingQueueTest, StressWithSmallCapacity) {
+  for (WaitStrategy strategy :
+       {WaitStrategy::kPark, WaitStrategy::kSpinThenPark}) {
+    ArrayBlockingQueue<int> queue(2, strategy);
+    RunProducersAndConsumers(queue);
+    EXPECT_TRUE(queue.Empty());
+  }
+}
+
+TEST(ArrayBlockingQueueTest, DeliversEveryItemOnceWithLargeCapacity) {
+  for (WaitStrategy strategy :
+       {WaitStrategy::kPark, WaitStrategy::kSpinThenPark}) {
+    ArrayBlockingQueue<int> queue(64, strategy);
+    RunProducersAndConsumers(queue);
+    EXPECT_TRUE(queue.Empty());
+  }
+}
+
+}  // namespace
+}  // namespace nearby
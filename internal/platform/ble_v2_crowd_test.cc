@@ -0,0 +1,191 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "internal/platform/ble_v2.h"
+#include "internal/platform/bluetooth_adapter.h"
+#include "internal/platform/byte_array.h"
+#include "internal/platform/implementation/ble_v2.h"
+#include "internal/platform/logging.h"
+#include "internal/platform/medium_environment.h"
+#include "internal/platform/uuid.h"
+
+namespace nearby {
+namespace {
+
+using ::nearby::api::ble_v2::BleAdvertisementData;
+using ::nearby::api::ble_v2::TxPowerLevel;
+
+// A busy venue: devices stand 4 meters apart on a 25 x 20 grid, and hear the
+// devices within 10 meters.
+constexpr int kDevices = 500;
+constexpr int kColumns = 25;
+constexpr double kSpacing = 4;
+constexpr double kBleRange = 10;
+
+struct Device {
+  explicit Device(int index)
+      : x((index % kColumns) * kSpacing), y((index / kColumns) * kSpacing) {}
+
+  double x;
+  double y;
+  BluetoothAdapter adapter;
+  BleV2Medium ble{adapter};
+  std::unique_ptr<api::ble_v2::BleMedium::ScanningSession> scanning_session;
+  absl::Time scan_start;
+  absl::Time advertise_start;
+};
+
+bool IsInRange(const Device& a, const Device& b) {
+  double dx = a.x - b.x;
+  double dy = a.y - b.y;
+  return dx * dx + dy * dy <= kBleRange * kBleRange;
+}
+
+absl::Duration Percentile(const std::vector<absl::Duration>& sorted,
+                          double percentile) {
+  return sorted[static_cast<std::size_t>(percentile * (sorted.size() - 1))];
+}
+
+TEST(BleV2CrowdTest, DevicesDiscoverTheDevicesInRange) {
+  MediumEnvironment& env = MediumEnvironment::Instance();
+  env.Start({.crowd_simulation = true, .ble_range = kBleRange});
+  Uuid service_uuid(1234, 5678);
+  std::vector<std::unique_ptr<Device>> devices;
+  for (int i = 0; i < kDevices; ++i) {
+    devices.push_back(std::make_unique<Device>(i));
+    env.SetBleV2MediumPosition(*devices[i]->ble.GetImpl(), devices[i]->x,
+                               devices[i]->y);
+  }
+
+  absl::Mutex mutex;
+  // The time each scanner first found each advertiser.
+  std::vector<absl::flat_hash_map<int, absl::Time>> found(kDevices);
+  absl::Time start = absl::Now();
+  // Devices join one after the other, as they would walk in.
+  for (int i = 0; i < kDevices; ++i) {
+    Device& device = *devices[i];
+    device.scan_start = absl::Now();
+    device.scanning_session = device.ble.StartScanning(
+        service_uuid, TxPowerLevel::kHigh,
+        {.advertisement_found_cb =
+             [&mutex, &found, i](api::ble_v2::BlePeripheral&,
+                                 BleAdvertisementData advertisement_data) {
+               absl::Time now = absl::Now();
+               int advertiser = std::stoi(std::string(
+                   advertisement_data.service_data.begin()->second));
+               absl::MutexLock lock(&mutex);
+               found[i].try_emplace(advertiser, now);
+             }});
+    device.advertise_start = absl::Now();
+    device.ble.StartAdvertising(
+        {.is_extended_advertisement = false,
+         .service_data = {{service_uuid, ByteArray(std::to_string(i))}}},
+        {.tx_power_level = TxPowerLevel::kHigh, .is_connectable = true});
+  }
+  env.Sync();
+  absl::Duration elapsed = absl::Now() - start;
+
+  std::vector<absl::Duration> latencies;
+  {
+    absl::MutexLock lock(&mutex);
+    for (int scanner = 0; scanner < kDevices; ++scanner) {
+      for (int advertiser = 0; advertiser < kDevices; ++advertiser) {
+        if (scanner == advertiser) continue;
+        bool in_range = IsInRange(*devices[scanner], *devices[advertiser]);
+        auto it = found[scanner].find(advertiser);
+        ASSERT_EQ(it != found[scanner].end(), in_range)
+            << "scanner=" << scanner << ", advertiser=" << advertiser;
+        if (!in_range) continue;
+        latencies.push_back(it->second -
+                            std::max(devices[scanner]->scan_start,
+                                     devices[advertiser]->advertise_start));
+      }
+    }
+  }
+  ASSERT_FALSE(latencies.empty());
+  std::sort(latencies.begin(), latencies.end());
+  NEARBY_LOGS(INFO) << "BleV2CrowdTest: " << kDevices << " devices made "
+                    << latencies.size() << " discoveries in " << elapsed
+                    << "; latency p50=" << Percentile(latencies, 0.5)
+                    << ", p90=" << Percentile(latencies, 0.9)
+                    << ", p99=" << Percentile(latencies, 0.99)
+                    << ", max=" << latencies.back();
+  RecordProperty("discoveries", latencies.size());
+  RecordProperty("latency_p50_us",
+                 absl::ToInt64Microseconds(Percentile(latencies, 0.5)));
+  RecordProperty("latency_p90_us",
+                 absl::ToInt64Microseconds(Percentile(latencies, 0.9)));
+  RecordProperty("latency_p99_us",
+                 absl::ToInt64Microseconds(Percentile(latencies, 0.99)));
+  env.Stop();
+}
+
+TEST(BleV2CrowdTest, StoppedAdvertisementIsLostInRange) {
+  MediumEnvironment& env = MediumEnvironment::Instance();
+  env.Start({.crowd_simulation = true, .ble_range = kBleRange});
+  Uuid service_uuid(1234, 5678);
+  Device advertiser(0);
+  Device near(1);
+  Device far(kColumns * 4);
+  for (Device* device : {&advertiser, &near, &far}) {
+    env.SetBleV2MediumPosition(*device->ble.GetImpl(), device->x, device->y);
+  }
+
+  absl::Mutex mutex;
+  std::vector<std::string> events;
+  for (Device* device : {&near, &far}) {
+    std::string name = device == &near ? "near" : "far";
+    device->scanning_session = device->ble.StartScanning(
+        service_uuid, TxPowerLevel::kHigh,
+        {.advertisement_found_cb =
+             [&mutex, &events, name](api::ble_v2::BlePeripheral&,
+                                     BleAdvertisementData) {
+               absl::MutexLock lock(&mutex);
+               events.push_back(name + " found");
+             },
+         .advertisement_lost_cb =
+             [&mutex, &events, name](api::ble_v2::BlePeripheral&) {
+               absl::MutexLock lock(&mutex);
+               events.push_back(name + " lost");
+             }});
+  }
+  advertiser.ble.StartAdvertising(
+      {.is_extended_advertisement = false,
+       .service_data = {{service_uuid, ByteArray("0")}}},
+      {.tx_power_level = TxPowerLevel::kHigh, .is_connectable = true});
+  advertiser.ble.StopAdvertising();
+  env.Sync();
+
+  {
+    absl::MutexLock lock(&mutex);
+    EXPECT_EQ(events, (std::vector<std::string>{"near found", "near lost"}));
+  }
+  env.Stop();
+}
+
+}  // namespace
+}  // namespace nearby
@@ -71,6 +71,11 @@ Exception OutputFile::Write(const ByteArray& data) {
 // down to the applicable transport layer.
 Exception OutputFile::Flush() { return impl_->Flush(); }
 
+// Reserves space for `size` bytes where the platform supports it.
+Exception OutputFile::Preallocate(std::int64_t size) {
+  return impl_->Preallocate(size);
+}
+
 // Disallows further writes to the file and frees system resources,
 // associated with it.
 Exception OutputFile::Close() { return impl_->Close(); }
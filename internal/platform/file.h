@@ -85,6 +85,10 @@ class OutputFile final {
   // down to the applicable transport layer.
   Exception Flush();
 
+  // Reserves space for `size` bytes where the platform supports it.
+  // Returns Exception::kIo if the space can't be reserved.
+  Exception Preallocate(std::int64_t size);
+
   // Disallows further writes to the file and frees system resources,
   // associated with it.
   Exception Close();
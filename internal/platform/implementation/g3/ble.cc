@@ -30,6 +30,7 @@
 #include "internal/platform/implementation/ble.h"
 #include "internal/platform/implementation/bluetooth_adapter.h"
 #include "internal/platform/implementation/g3/bluetooth_adapter.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
 #include "internal/platform/implementation/shared/count_down_latch.h"
 #include "internal/platform/logging.h"
 #include "internal/platform/medium_environment.h"
@@ -47,7 +48,7 @@ std::unique_ptr<api::BleSocket> BleServerSocket::Accept(
   absl::MutexLock lock(&mutex_);
   if (closed_) return {};
   while (pending_sockets_.empty()) {
-    cond_.Wait(&mutex_);
+    Wait(&mutex_, &cond_);
     if (closed_) break;
   }
   if (closed_) return {};
@@ -57,7 +58,7 @@ std::unique_ptr<api::BleSocket> BleServerSocket::Accept(
   auto local_socket = std::make_unique<BleSocket>(peripheral);
   local_socket->Connect(*remote_socket);
   remote_socket->Connect(*local_socket);
-  cond_.SignalAll();
+  SignalAll(&cond_);
   return local_socket;
 }
 
@@ -71,9 +72,9 @@ bool BleServerSocket::Connect(BleSocket& socket) {
   }
   // add client socket to the pending list
   pending_sockets_.emplace(&socket);
-  cond_.SignalAll();
+  SignalAll(&cond_);
   while (!socket.IsConnected()) {
-    cond_.Wait(&mutex_);
+    Wait(&mutex_, &cond_);
     if (closed_) return false;
   }
   return true;
@@ -98,7 +99,7 @@ Exception BleServerSocket::DoClose() {
   bool should_notify = !closed_;
   closed_ = true;
   if (should_notify) {
-    cond_.SignalAll();
+    SignalAll(&cond_);
     if (close_notifier_) {
       auto notifier = std::move(close_notifier_);
       mutex_.Unlock();
@@ -38,6 +38,7 @@
 #include "internal/platform/implementation/ble_v2.h"
 #include "internal/platform/implementation/bluetooth_adapter.h"
 #include "internal/platform/implementation/g3/bluetooth_adapter.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
 #include "internal/platform/logging.h"
 #include "internal/platform/medium_environment.h"
 #include "internal/platform/prng.h"
@@ -92,7 +93,7 @@ BleV2Peripheral* BleV2Socket::GetRemotePeripheral() {
 std::unique_ptr<api::ble_v2::BleSocket> BleV2ServerSocket::Accept() {
   absl::MutexLock lock(&mutex_);
   while (!closed_ && pending_sockets_.empty()) {
-    cond_.Wait(&mutex_);
+    Wait(&mutex_, &cond_);
   }
   // whether or not we were running in the wait loop, return early if closed.
   if (closed_) return {};
@@ -103,7 +104,7 @@ std::unique_ptr<api::ble_v2::BleSocket> BleV2ServerSocket::Accept() {
   auto local_socket = std::make_unique<BleV2Socket>(adapter_);
   local_socket->Connect(*remote_socket);
   remote_socket->Connect(*local_socket);
-  cond_.SignalAll();
+  SignalAll(&cond_);
   return local_socket;
 }
 
@@ -117,9 +118,9 @@ bool BleV2ServerSocket::Connect(BleV2Socket& socket) {
   }
   // add client socket to the pending list
   pending_sockets_.insert(&socket);
-  cond_.SignalAll();
+  SignalAll(&cond_);
   while (!socket.IsConnected()) {
-    cond_.Wait(&mutex_);
+    Wait(&mutex_, &cond_);
     if (closed_) return false;
   }
   return true;
@@ -144,7 +145,7 @@ Exception BleV2ServerSocket::DoClose() {
   bool should_notify = !closed_;
   closed_ = true;
   if (should_notify) {
-    cond_.SignalAll();
+    SignalAll(&cond_);
     if (close_notifier_) {
       auto notifier = std::move(close_notifier_);
       mutex_.Unlock();
@@ -29,6 +29,7 @@
 #include "internal/platform/implementation/bluetooth_adapter.h"
 #include "internal/platform/implementation/bluetooth_classic.h"
 #include "internal/platform/implementation/g3/bluetooth_adapter.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
 #include "internal/platform/logging.h"
 #include "internal/platform/medium_environment.h"
 
@@ -47,7 +48,7 @@ BluetoothDevice* BluetoothSocket::GetRemoteDevice() {
 std::unique_ptr<api::BluetoothSocket> BluetoothServerSocket::Accept() {
   absl::MutexLock lock(&mutex_);
   while (!closed_ && pending_sockets_.empty()) {
-    cond_.Wait(&mutex_);
+    Wait(&mutex_, &cond_);
   }
   // whether or not we were running in the wait loop, return early if closed.
   if (closed_) return {};
@@ -57,7 +58,7 @@ std::unique_ptr<api::BluetoothSocket> BluetoothServerSocket::Accept() {
   auto local_socket = std::make_unique<BluetoothSocket>(adapter_);
   local_socket->Connect(*remote_socket);
   remote_socket->Connect(*local_socket);
-  cond_.SignalAll();
+  SignalAll(&cond_);
   return local_socket;
 }
 
@@ -71,9 +72,9 @@ bool BluetoothServerSocket::Connect(BluetoothSocket& socket) {
   }
   // add client socket to the pending list
   pending_sockets_.emplace(&socket);
-  cond_.SignalAll();
+  SignalAll(&cond_);
   while (!socket.IsConnected()) {
-    cond_.Wait(&mutex_);
+    Wait(&mutex_, &cond_);
     if (closed_) return false;
   }
   return true;
@@ -99,7 +100,7 @@ Exception BluetoothServerSocket::DoClose() {
   bool should_notify = !closed_;
   closed_ = true;
   if (should_notify) {
-    cond_.SignalAll();
+    SignalAll(&cond_);
     if (close_notifier_) {
       auto notifier = std::move(close_notifier_);
       mutex_.Unlock();
@@ -19,6 +19,7 @@
 #include "internal/platform/implementation/condition_variable.h"
 #include "internal/platform/exception.h"
 #include "internal/platform/implementation/g3/mutex.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
 
 namespace nearby {
 namespace g3 {
@@ -29,14 +30,14 @@ class ConditionVariable : public api::ConditionVariable {
   ~ConditionVariable() override = default;
 
   Exception Wait() override {
-    cond_var_.Wait(mutex_);
+    g3::Wait(mutex_, &cond_var_);
     return {Exception::kSuccess};
   }
   Exception Wait(absl::Duration timeout) override {
-    cond_var_.WaitWithTimeout(mutex_, timeout);
+    g3::WaitWithTimeout(mutex_, &cond_var_, timeout);
     return {Exception::kSuccess};
   }
-  void Notify() override { cond_var_.SignalAll(); }
+  void Notify() override { g3::SignalAll(&cond_var_); }
 
  private:
   absl::Mutex* mutex_;
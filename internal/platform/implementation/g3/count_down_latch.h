@@ -0,0 +1,72 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_IMPL_G3_COUNT_DOWN_LATCH_H_
+#define PLATFORM_IMPL_G3_COUNT_DOWN_LATCH_H_
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "internal/platform/exception.h"
+#include "internal/platform/implementation/count_down_latch.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
+
+namespace nearby {
+namespace g3 {
+
+// shared::CountDownLatch, with its timeouts measured in virtual time when the
+// medium environment runs one.
+class CountDownLatch final : public api::CountDownLatch {
+ public:
+  explicit CountDownLatch(int count) : count_(count) {}
+  CountDownLatch(const CountDownLatch&) = delete;
+  CountDownLatch& operator=(const CountDownLatch&) = delete;
+  CountDownLatch(CountDownLatch&&) = delete;
+  CountDownLatch& operator=(CountDownLatch&&) = delete;
+
+  ExceptionOr<bool> Await(absl::Duration timeout) override {
+    absl::MutexLock lock(&mutex_);
+    // `cond_` is only signaled once `count_` is zero, so the timeout doesn't
+    // restart.
+    while (count_ > 0) {
+      if (WaitWithTimeout(&mutex_, &cond_, timeout)) {
+        return ExceptionOr<bool>(false);
+      }
+    }
+    return ExceptionOr<bool>(true);
+  }
+  Exception Await() override {
+    absl::MutexLock lock(&mutex_);
+    while (count_ > 0) {
+      Wait(&mutex_, &cond_);
+    }
+    return {Exception::kSuccess};
+  }
+  void CountDown() override {
+    absl::MutexLock lock(&mutex_);
+    if (count_ > 0 && --count_ == 0) {
+      SignalAll(&cond_);
+    }
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::CondVar cond_;
+  int count_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace g3
+}  // namespace nearby
+
+#endif  // PLATFORM_IMPL_G3_COUNT_DOWN_LATCH_H_
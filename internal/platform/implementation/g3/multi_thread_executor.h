@@ -18,6 +18,7 @@
 #include <atomic>
 
 #include "absl/time/clock.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
 #include "internal/platform/implementation/submittable_executor.h"
 #include "internal/platform/implementation/shared/count_down_latch.h"
 #include "nisaba/port/thread_pool.h"
@@ -35,12 +36,12 @@ class MultiThreadExecutor : public api::SubmittableExecutor {
   }
   void Execute(Runnable&& runnable) override {
     if (!shutdown_) {
-      thread_pool_.Schedule(std::move(runnable));
+      thread_pool_.Schedule(TrackTask(std::move(runnable)));
     }
   }
   bool DoSubmit(Runnable&& runnable) override {
     if (shutdown_) return false;
-    thread_pool_.Schedule(std::move(runnable));
+    thread_pool_.Schedule(TrackTask(std::move(runnable)));
     return true;
   }
   void Shutdown() override { DoShutdown(); }
@@ -45,7 +45,6 @@
 #include "internal/platform/implementation/preferences_manager.h"
 #include "internal/platform/implementation/scheduled_executor.h"
 #include "internal/platform/implementation/server_sync.h"
-#include "internal/platform/implementation/shared/count_down_latch.h"
 #include "internal/platform/implementation/submittable_executor.h"
 #include "internal/platform/implementation/timer.h"
 #include "internal/platform/implementation/wifi_direct.h"
@@ -65,6 +64,7 @@
 #include "internal/platform/implementation/g3/bluetooth_adapter.h"
 #include "internal/platform/implementation/g3/bluetooth_classic.h"
 #include "internal/platform/implementation/g3/condition_variable.h"
+#include "internal/platform/implementation/g3/count_down_latch.h"
 #include "internal/platform/implementation/g3/credential_storage_impl.h"
 #include "internal/platform/implementation/g3/device_info.h"
 #include "internal/platform/implementation/g3/multi_thread_executor.h"
@@ -128,7 +128,7 @@ ImplementationPlatform::CreateBluetoothAdapter() {
 
 std::unique_ptr<CountDownLatch> ImplementationPlatform::CreateCountDownLatch(
     std::int32_t count) {
-  return std::make_unique<shared::CountDownLatch>(count);
+  return std::make_unique<g3::CountDownLatch>(count);
 }
 
 std::unique_ptr<AtomicBoolean> ImplementationPlatform::CreateAtomicBoolean(
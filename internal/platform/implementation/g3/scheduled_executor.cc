@@ -23,9 +23,11 @@
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "internal/platform/implementation/cancelable.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
 #include "internal/platform/medium_environment.h"
 #include "internal/platform/runnable.h"
 #include "internal/test/fake_clock.h"
+#include "internal/test/virtual_time.h"
 
 namespace nearby {
 namespace g3 {
@@ -100,9 +102,13 @@ std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(
       MediumEnvironment::Instance().GetSimulatedClock();
   if (fake_clock.has_value()) {
     absl::Time trigger_time = (*fake_clock)->Now() + delay;
-    absl::MutexLock lock(&mutex_);
-    tasks_.insert(std::pair<absl::Time, std::unique_ptr<Runnable>>(
-        trigger_time, std::make_unique<Runnable>(std::move(task))));
+    {
+      absl::MutexLock lock(&mutex_);
+      tasks_.insert(std::pair<absl::Time, std::unique_ptr<Runnable>>(
+          trigger_time, std::make_unique<Runnable>(std::move(task))));
+    }
+    std::shared_ptr<VirtualTime> virtual_time = GetVirtualTime();
+    if (virtual_time != nullptr) virtual_time->AddDeadline(trigger_time);
   } else {
     executor_.ScheduleAfter(delay, std::move(task));
   }
@@ -14,10 +14,14 @@
 
 #include "internal/platform/implementation/system_clock.h"
 
+#include <memory>
+
 #include "absl/time/clock.h"
 #include "internal/platform/exception.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
 #include "internal/platform/medium_environment.h"
 #include "internal/test/fake_clock.h"
+#include "internal/test/virtual_time.h"
 
 namespace nearby {
 
@@ -31,6 +35,11 @@ absl::Time SystemClock::ElapsedRealtime() {
 }
 
 Exception SystemClock::Sleep(absl::Duration duration) {
+  std::shared_ptr<VirtualTime> virtual_time = g3::GetVirtualTime();
+  if (virtual_time != nullptr) {
+    virtual_time->SleepUntil(virtual_time->GetClock().Now() + duration);
+    return {Exception::kSuccess};
+  }
   absl::optional<FakeClock*> fake_clock =
       MediumEnvironment::Instance().GetSimulatedClock();
   if (fake_clock.has_value()) {
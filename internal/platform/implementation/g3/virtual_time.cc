@@ -0,0 +1,67 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "internal/platform/implementation/g3/virtual_time.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "internal/platform/medium_environment.h"
+#include "internal/platform/runnable.h"
+#include "internal/test/virtual_time.h"
+
+namespace nearby {
+namespace g3 {
+
+std::shared_ptr<VirtualTime> GetVirtualTime() {
+  return MediumEnvironment::Instance().GetVirtualTime();
+}
+
+Runnable TrackTask(Runnable&& runnable) {
+  std::shared_ptr<VirtualTime> virtual_time = GetVirtualTime();
+  if (virtual_time == nullptr) return std::move(runnable);
+  virtual_time->TaskQueued();
+  return [virtual_time, runnable = std::move(runnable)]() mutable {
+    VirtualTime::TaskScope scope(*virtual_time);
+    runnable();
+  };
+}
+
+void Wait(absl::Mutex* mutex, absl::CondVar* cond) {
+  std::shared_ptr<VirtualTime> virtual_time = GetVirtualTime();
+  if (virtual_time == nullptr) {
+    cond->Wait(mutex);
+  } else {
+    virtual_time->Wait(mutex, cond);
+  }
+}
+
+bool WaitWithTimeout(absl::Mutex* mutex, absl::CondVar* cond,
+                     absl::Duration timeout) {
+  std::shared_ptr<VirtualTime> virtual_time = GetVirtualTime();
+  if (virtual_time == nullptr) return cond->WaitWithTimeout(mutex, timeout);
+  return virtual_time->WaitWithDeadline(
+      mutex, cond, virtual_time->GetClock().Now() + timeout);
+}
+
+void SignalAll(absl::CondVar* cond) {
+  std::shared_ptr<VirtualTime> virtual_time = GetVirtualTime();
+  if (virtual_time != nullptr) virtual_time->Notify(cond);
+  cond->SignalAll();
+}
+
+}  // namespace g3
+}  // namespace nearby
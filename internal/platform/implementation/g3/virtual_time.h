@@ -0,0 +1,49 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_IMPL_G3_VIRTUAL_TIME_H_
+#define PLATFORM_IMPL_G3_VIRTUAL_TIME_H_
+
+#include <memory>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "internal/platform/runnable.h"
+#include "internal/test/virtual_time.h"
+
+namespace nearby {
+namespace g3 {
+
+// Hooks of the g3 platform into MediumEnvironment's virtual time. Each of them
+// falls back to plain absl behavior unless EnvironmentConfig::use_virtual_time
+// is set.
+
+std::shared_ptr<VirtualTime> GetVirtualTime();
+
+// Returns `runnable` wrapped to keep the clock still from now until it has run.
+// Call it only for a task that is certain to run.
+Runnable TrackTask(Runnable&& runnable);
+
+void Wait(absl::Mutex* mutex, absl::CondVar* cond);
+
+// Returns true if `timeout` passed, on the simulated clock in virtual time.
+bool WaitWithTimeout(absl::Mutex* mutex, absl::CondVar* cond,
+                     absl::Duration timeout);
+
+void SignalAll(absl::CondVar* cond);
+
+}  // namespace g3
+}  // namespace nearby
+
+#endif  // PLATFORM_IMPL_G3_VIRTUAL_TIME_H_
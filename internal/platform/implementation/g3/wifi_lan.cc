@@ -26,6 +26,7 @@
 #include "internal/platform/cancellation_flag.h"
 #include "internal/platform/cancellation_flag_listener.h"
 #include "internal/platform/exception.h"
+#include "internal/platform/implementation/g3/virtual_time.h"
 #include "internal/platform/implementation/wifi_lan.h"
 #include "internal/platform/logging.h"
 #include "internal/platform/medium_environment.h"
@@ -51,7 +52,7 @@ std::string WifiLanServerSocket::GetName(const std::string& ip_address,
 std::unique_ptr<api::WifiLanSocket> WifiLanServerSocket::Accept() {
   absl::MutexLock lock(&mutex_);
   while (!closed_ && pending_sockets_.empty()) {
-    cond_.Wait(&mutex_);
+    Wait(&mutex_, &cond_);
   }
   // whether or not we were running in the wait loop, return early if closed.
   if (closed_) return {};
@@ -62,7 +63,7 @@ std::unique_ptr<api::WifiLanSocket> WifiLanServerSocket::Accept() {
   auto local_socket = std::make_unique<WifiLanSocket>();
   local_socket->Connect(*remote_socket);
   remote_socket->Connect(*local_socket);
-  cond_.SignalAll();
+  SignalAll(&cond_);
   return local_socket;
 }
 
@@ -76,9 +77,9 @@ bool WifiLanServerSocket::Connect(WifiLanSocket& socket) {
   }
   // add client socket to the pending list
   pending_sockets_.insert(&socket);
-  cond_.SignalAll();
+  SignalAll(&cond_);
   while (!socket.IsConnected()) {
-    cond_.Wait(&mutex_);
+    Wait(&mutex_, &cond_);
     if (closed_) return false;
   }
   return true;
@@ -104,7 +105,7 @@ Exception WifiLanServerSocket::DoClose() {
   bool should_notify = !closed_;
   closed_ = true;
   if (should_notify) {
-    cond_.SignalAll();
+    SignalAll(&cond_);
     if (close_notifier_) {
       auto notifier = std::move(close_notifier_);
       mutex_.Unlock();
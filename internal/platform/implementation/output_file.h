@@ -15,6 +15,8 @@
 #ifndef PLATFORM_API_OUTPUT_FILE_H_
 #define PLATFORM_API_OUTPUT_FILE_H_
 
+#include <cstdint>
+
 #include "internal/platform/byte_array.h"
 #include "internal/platform/exception.h"
 #include "internal/platform/output_stream.h"
@@ -26,6 +28,14 @@ namespace api {
 class OutputFile : public OutputStream {
  public:
   ~OutputFile() override = default;
+
+  // Reserves space for a file that is expected to grow to `size` bytes, so
+  // later writes don't fail half-way for lack of space and the file isn't
+  // fragmented. Closing the file releases whatever was reserved but not
+  // written. Platforms that can't reserve space treat this as a no-op.
+  virtual Exception Preallocate(std::int64_t size) {
+    return {Exception::kSuccess};
+  }
 };
 
 }  // namespace api
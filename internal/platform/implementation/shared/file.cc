@@ -14,6 +14,13 @@
 
 #include "internal/platform/implementation/shared/file.h"
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif  // defined(__linux__)
+
 #include <cstddef>
 #include <ios>
 #include <memory>
@@ -76,6 +83,14 @@ ExceptionOr<ByteArray> IOFile::Read(std::int64_t size) {
 Exception IOFile::Close() {
   if (file_.is_open()) {
     file_.close();
+#if defined(__linux__)
+    // A transfer that was cancelled or failed leaves space reserved past the
+    // data; truncating to the written size releases it.
+    if (preallocated_) {
+      ::truncate(path_.c_str(), bytes_written_);
+      preallocated_ = false;
+    }
+#endif  // defined(__linux__)
   }
   return {Exception::kSuccess};
 }
@@ -90,8 +105,11 @@ Exception IOFile::Write(const ByteArray& data) {
   }
 
   file_.write(data.data(), data.size());
-  file_.flush();
-  return {file_.good() ? Exception::kSuccess : Exception::kIo};
+  if (!file_.good()) {
+    return {Exception::kIo};
+  }
+  bytes_written_ += data.size();
+  return {Exception::kSuccess};
 }
 
 Exception IOFile::Flush() {
@@ -99,5 +117,29 @@ Exception IOFile::Flush() {
   return {file_.good() ? Exception::kSuccess : Exception::kIo};
 }
 
+Exception IOFile::Preallocate(std::int64_t size) {
+  if (!file_.is_open()) {
+    return {Exception::kIo};
+  }
+#if defined(__linux__)
+  int fd = ::open(path_.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return {Exception::kIo};
+  }
+  // Keep the visible size unchanged so readers of a file that is still being
+  // received see EOF rather than zeros.
+  int result = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size);
+  int error = errno;
+  ::close(fd);
+  if (result != 0) {
+    // Only a lack of space is worth failing for. Other errors mean the
+    // filesystem can't reserve space, and the writes will work regardless.
+    return {error == ENOSPC ? Exception::kIo : Exception::kSuccess};
+  }
+  preallocated_ = true;
+#endif  // defined(__linux__)
+  return {Exception::kSuccess};
+}
+
 }  // namespace shared
 }  // namespace nearby
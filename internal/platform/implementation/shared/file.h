@@ -17,6 +17,7 @@
 
 #include <cstdint>
 #include <fstream>
+#include <memory>
 #include <string>
 
 #include "absl/strings/string_view.h"
@@ -41,8 +42,10 @@ class IOFile final : public api::InputFile, public api::OutputFile {
   std::int64_t GetTotalSize() const override { return total_size_; }
   Exception Close() override;
 
+  // Writes are buffered by the stream; call Flush() to hand them to the OS.
   Exception Write(const ByteArray& data) override;
   Exception Flush() override;
+  Exception Preallocate(std::int64_t size) override;
 
  private:
   explicit IOFile(const absl::string_view file_path, size_t size);
@@ -51,6 +54,8 @@ class IOFile final : public api::InputFile, public api::OutputFile {
   std::fstream file_;
   std::string path_;
   std::int64_t total_size_;
+  std::int64_t bytes_written_ = 0;
+  bool preallocated_ = false;
 };
 
 }  // namespace shared
@@ -133,11 +133,21 @@ TEST_F(FileTest, IOFile_Write) {
   ByteArray bytes2("bc");
   EXPECT_EQ(io_file_output->Write(bytes1), Exception{Exception::kSuccess});
   EXPECT_EQ(io_file_output->Write(bytes2), Exception{Exception::kSuccess});
+  EXPECT_EQ(io_file_output->Flush(), Exception{Exception::kSuccess});
   auto io_file_input =
       shared::IOFile::CreateInputFile(io_file_output->GetFilePath(), GetSize());
   AssertEquals(io_file_input->Read(kMaxSize), "abc");
 }
 
+TEST_F(FileTest, IOFile_PreallocateKeepsSizeOfWrittenData) {
+  auto io_file = shared::IOFile::CreateOutputFile(path_);
+  EXPECT_EQ(io_file->Preallocate(1024 * 1024), Exception{Exception::kSuccess});
+  EXPECT_EQ(io_file->Write(ByteArray("abc")), Exception{Exception::kSuccess});
+  io_file->Close();
+  std::ifstream input_file(path_, std::ios::binary | std::ios::ate);
+  EXPECT_EQ(input_file.tellg(), 3);
+}
+
 TEST_F(FileTest, IOFile_CloseOutput) {
   auto io_file = shared::IOFile::CreateOutputFile(path_);
   io_file->Close();
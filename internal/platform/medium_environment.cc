@@ -14,13 +14,17 @@
 
 #include "internal/platform/medium_environment.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
@@ -45,12 +49,27 @@
 #include "internal/platform/nsd_service_info.h"
 #include "internal/platform/prng.h"
 #include "internal/platform/runnable.h"
+#include "internal/platform/single_thread_executor.h"
 #include "internal/platform/uuid.h"
 #include "internal/platform/wifi_credential.h"
 #include "internal/test/fake_clock.h"
+#include "internal/test/virtual_time.h"
 
 namespace nearby {
 
+namespace {
+
+template <typename Key, typename Value>
+void EraseFromIndex(absl::flat_hash_map<Key, absl::flat_hash_set<Value>>& index,
+                    const Key& key, const Value& value) {
+  auto it = index.find(key);
+  if (it == index.end()) return;
+  it->second.erase(value);
+  if (it->second.empty()) index.erase(it);
+}
+
+}  // namespace
+
 MediumEnvironment& MediumEnvironment::Instance() {
   static std::aligned_storage_t<sizeof(MediumEnvironment),
                                 alignof(MediumEnvironment)>
@@ -63,9 +82,26 @@ void MediumEnvironment::Start(EnvironmentConfig config) {
   if (!enabled_.exchange(true)) {
     NEARBY_LOGS(INFO) << "MediumEnvironment::Start()";
     config_ = std::move(config);
+    if (config_.use_virtual_time) config_.use_simulated_clock = true;
     if (config_.use_simulated_clock) {
       MutexLock lock(&mutex_);
-      simulated_clock_ = std::make_unique<FakeClock>();
+      simulated_clock_ = std::make_shared<FakeClock>();
+    }
+    if (config_.use_virtual_time) {
+      std::shared_ptr<FakeClock> clock;
+      {
+        MutexLock lock(&mutex_);
+        clock = simulated_clock_;
+      }
+      auto virtual_time = std::make_shared<VirtualTime>(std::move(clock));
+      virtual_time->AttachCurrentThread();
+      MutexLock lock(&virtual_time_mutex_);
+      virtual_time_ = std::move(virtual_time);
+    }
+    if (config_.crowd_simulation) {
+      for (int i = 0; i < std::max(config_.delivery_threads, 1); ++i) {
+        delivery_executors_.push_back(std::make_unique<SingleThreadExecutor>());
+      }
     }
     Reset();
   }
@@ -75,6 +111,18 @@ void MediumEnvironment::Stop() {
   if (enabled_.exchange(false)) {
     NEARBY_LOGS(INFO) << "MediumEnvironment::Stop()";
     Sync(false);
+    delivery_executors_.clear();
+    if (config_.use_virtual_time) {
+      std::shared_ptr<VirtualTime> virtual_time;
+      {
+        MutexLock lock(&virtual_time_mutex_);
+        virtual_time = std::move(virtual_time_);
+      }
+      // Timed waits still pending, e.g. in tasks the test didn't wait for,
+      // time out from here on.
+      virtual_time->DetachCurrentThread();
+      virtual_time->Shutdown();
+    }
     if (config_.use_simulated_clock) {
       MutexLock lock(&mutex_);
       simulated_clock_.reset();
@@ -90,6 +138,15 @@ void MediumEnvironment::Reset() {
     bluetooth_mediums_.clear();
     ble_mediums_.clear();
     ble_v2_mediums_.clear();
+    ble_v2_scanners_.clear();
+    ble_v2_advertisers_.clear();
+    ble_v2_grid_.clear();
+    next_delivery_thread_ = 0;
+    {
+      absl::MutexLock lock(&ble_v2_delivery_mutex_);
+      ble_v2_peripherals_.clear();
+      ble_v2_scan_callbacks_.clear();
+    }
 #ifndef NO_WEBRTC
     webrtc_signaling_message_callback_.clear();
     webrtc_signaling_complete_callback_.clear();
@@ -111,7 +168,7 @@ void MediumEnvironment::Sync(bool enable_notifications) {
   NEARBY_LOGS(INFO) << "MediumEnvironment::sync=" << enable_notifications;
   int count = 0;
   do {
-    CountDownLatch latch(1);
+    CountDownLatch latch(1 + delivery_executors_.size());
     count = job_count_ + 1;
     // We are about to schedule one last job.
     // When it is done, counter must be equal to count.
@@ -119,7 +176,14 @@ void MediumEnvironment::Sync(bool enable_notifications) {
     // it will be pending after us.
     // If we want to ensure we are completely idle, then we have to
     // repeat sync, until this becomes true.
-    RunOnMediumEnvironmentThread([&latch]() { latch.CountDown(); });
+    RunOnMediumEnvironmentThread([this, &latch]() {
+      // Reports queued on the delivery threads by earlier jobs are made
+      // before these.
+      for (auto& executor : delivery_executors_) {
+        executor->Execute([&latch]() { latch.CountDown(); });
+      }
+      latch.CountDown();
+    });
     latch.Await();
   } while (count < job_count_);
   NEARBY_LOGS(INFO) << "MediumEnvironment::Sync(): done [count=" << count
@@ -322,6 +386,37 @@ void MediumEnvironment::OnBleV2PeripheralStateChanged(
     const api::ble_v2::BleAdvertisementData& ble_advertisement_data,
     api::ble_v2::BlePeripheral& peripheral) {
   if (!enabled_) return;
+  if (config_.crowd_simulation) {
+    if (!enable_notifications_) return;
+    std::vector<std::shared_ptr<BleScanCallback>> callbacks;
+    for (auto& element : context.scan_callback_map) {
+      if (element.first.first == service_id) {
+        callbacks.push_back(element.second);
+      }
+    }
+    if (callbacks.empty()) return;
+    RunOnDeliveryThread(
+        context.delivery_thread,
+        [this, enabled, callbacks = std::move(callbacks),
+         advertisement_data = ble_advertisement_data,
+         peripheral = &peripheral]() {
+          if (!enable_notifications_) return;
+          // The mediums may have stopped scanning or been unregistered since
+          // the report was queued.
+          absl::ReaderMutexLock lock(&ble_v2_delivery_mutex_);
+          if (!ble_v2_peripherals_.contains(peripheral)) return;
+          for (auto& callback : callbacks) {
+            if (!ble_v2_scan_callbacks_.contains(callback.get())) continue;
+            if (enabled) {
+              callback->advertisement_found_cb(*peripheral,
+                                               advertisement_data);
+            } else {
+              callback->advertisement_lost_cb(*peripheral);
+            }
+          }
+        });
+    return;
+  }
   NEARBY_LOGS(INFO) << "OnBleServiceStateChanged [peripheral impl="
                     << &peripheral << "]; medium_context=" << &context
                     << "; notify=" << enable_notifications_.load();
@@ -333,10 +428,10 @@ void MediumEnvironment::OnBleV2PeripheralStateChanged(
   for (auto& element : context.scan_callback_map) {
     if (element.first.first == service_id) {
       if (enabled) {
-        element.second.advertisement_found_cb(peripheral,
-                                              ble_advertisement_data);
+        element.second->advertisement_found_cb(peripheral,
+                                               ble_advertisement_data);
       } else {
-        element.second.advertisement_lost_cb(peripheral);
+        element.second->advertisement_lost_cb(peripheral);
       }
     }
   }
@@ -406,6 +501,69 @@ void MediumEnvironment::RunOnMediumEnvironmentThread(Runnable runnable) {
   executor_.Execute(std::move(runnable));
 }
 
+void MediumEnvironment::RunOnDeliveryThread(std::size_t index,
+                                            Runnable runnable) {
+  job_count_++;
+  delivery_executors_[index % delivery_executors_.size()]->Execute(
+      std::move(runnable));
+}
+
+std::vector<api::ble_v2::BleMedium*> MediumEnvironment::GetBleV2MediumsNearby(
+    const BleV2MediumContext& context) const {
+  std::vector<api::ble_v2::BleMedium*> mediums;
+  // A cell is as wide as the radio range, so the mediums in range are in the
+  // cell of the medium or around it.
+  for (std::int64_t dx = -1; dx <= 1; ++dx) {
+    for (std::int64_t dy = -1; dy <= 1; ++dy) {
+      auto it = ble_v2_grid_.find(
+          GridCell{context.cell.first + dx, context.cell.second + dy});
+      if (it == ble_v2_grid_.end()) continue;
+      mediums.insert(mediums.end(), it->second.begin(), it->second.end());
+    }
+  }
+  return mediums;
+}
+
+bool MediumEnvironment::IsInBleRange(const BleV2MediumContext& a,
+                                     const BleV2MediumContext& b) const {
+  if (config_.ble_range <= 0) return true;
+  double dx = a.x - b.x;
+  double dy = a.y - b.y;
+  return dx * dx + dy * dy <= config_.ble_range * config_.ble_range;
+}
+
+MediumEnvironment::GridCell MediumEnvironment::GetGridCell(double x,
+                                                           double y) const {
+  return {static_cast<std::int64_t>(std::floor(x / config_.ble_range)),
+          static_cast<std::int64_t>(std::floor(y / config_.ble_range))};
+}
+
+void MediumEnvironment::IndexBleV2Advertiser(
+    api::ble_v2::BleMedium* medium,
+    const api::ble_v2::BleAdvertisementData& old_data,
+    const BleV2MediumContext& context) {
+  for (const auto& [service_uuid, unused] : old_data.service_data) {
+    EraseFromIndex(ble_v2_advertisers_, service_uuid, medium);
+  }
+  if (!context.advertising) return;
+  for (const auto& [service_uuid, unused] :
+       context.advertisement_data.service_data) {
+    ble_v2_advertisers_[service_uuid].insert(medium);
+  }
+}
+
+void MediumEnvironment::UnindexBleV2Medium(api::ble_v2::BleMedium* medium,
+                                           const BleV2MediumContext& context) {
+  for (const auto& [key, unused] : context.scan_callback_map) {
+    EraseFromIndex(ble_v2_scanners_, key.first, medium);
+  }
+  for (const auto& [service_uuid, unused] :
+       context.advertisement_data.service_data) {
+    EraseFromIndex(ble_v2_advertisers_, service_uuid, medium);
+  }
+  EraseFromIndex(ble_v2_grid_, context.cell, medium);
+}
+
 void MediumEnvironment::RegisterBluetoothMedium(
     api::BluetoothClassicMedium& medium,
     api::BluetoothAdapter& medium_adapter) {
@@ -605,8 +763,19 @@ void MediumEnvironment::RegisterBleV2Medium(
     api::ble_v2::BleMedium& medium, api::ble_v2::BlePeripheral* peripheral) {
   if (!enabled_) return;
   RunOnMediumEnvironmentThread([this, &medium, peripheral]() {
-    ble_v2_mediums_.insert(
-        {&medium, BleV2MediumContext{.ble_peripheral = peripheral}});
+    BleV2MediumContext context{.ble_peripheral = peripheral};
+    if (config_.crowd_simulation) {
+      context.delivery_thread = next_delivery_thread_++;
+      if (config_.ble_range > 0) {
+        context.cell = GetGridCell(context.x, context.y);
+        ble_v2_grid_[context.cell].insert(&medium);
+      }
+    }
+    ble_v2_mediums_.insert({&medium, std::move(context)});
+    if (peripheral != nullptr) {
+      absl::MutexLock lock(&ble_v2_delivery_mutex_);
+      ble_v2_peripherals_.insert(peripheral);
+    }
     NEARBY_LOGS(INFO) << "Registered: BLE V2 medium:" << &medium;
   });
 }
@@ -627,9 +796,16 @@ void MediumEnvironment::UpdateBleV2MediumForAdvertising(
           return;
         }
         auto& context = it->second;
+        if (context.ble_peripheral != &peripheral) {
+          absl::MutexLock lock(&ble_v2_delivery_mutex_);
+          ble_v2_peripherals_.erase(context.ble_peripheral);
+          ble_v2_peripherals_.insert(&peripheral);
+        }
         context.ble_peripheral = &peripheral;
         context.advertising = enabled;
-        context.advertisement_data = advertisement_data;
+        api::ble_v2::BleAdvertisementData old_advertisement_data =
+            std::exchange(context.advertisement_data, advertisement_data);
+        IndexBleV2Advertiser(&medium, old_advertisement_data, context);
 
         NEARBY_LOGS(INFO) << "UpdateBleV2MediumForAdvertising: this=" << this
                           << ", medium=" << &medium
@@ -637,6 +813,43 @@ void MediumEnvironment::UpdateBleV2MediumForAdvertising(
                           << ", peripheral=" << &peripheral
                           << ", enabled=" << enabled;
 
+        if (config_.crowd_simulation) {
+          // A stopped advertisement is lost to the scanners of the services
+          // it had.
+          const auto& service_data =
+              enabled ? context.advertisement_data.service_data
+                      : old_advertisement_data.service_data;
+          if (config_.ble_range > 0) {
+            for (api::ble_v2::BleMedium* remote_medium :
+                 GetBleV2MediumsNearby(context)) {
+              if (remote_medium == &medium) continue;
+              BleV2MediumContext& remote_context =
+                  ble_v2_mediums_.at(remote_medium);
+              if (!remote_context.scanning ||
+                  !IsInBleRange(context, remote_context)) {
+                continue;
+              }
+              for (const auto& [service_uuid, unused] : service_data) {
+                OnBleV2PeripheralStateChanged(
+                    enabled, remote_context, service_uuid,
+                    context.advertisement_data, *context.ble_peripheral);
+              }
+            }
+            return;
+          }
+          for (const auto& [service_uuid, unused] : service_data) {
+            auto scanners = ble_v2_scanners_.find(service_uuid);
+            if (scanners == ble_v2_scanners_.end()) continue;
+            for (api::ble_v2::BleMedium* remote_medium : scanners->second) {
+              if (remote_medium == &medium) continue;
+              OnBleV2PeripheralStateChanged(
+                  enabled, ble_v2_mediums_.at(remote_medium), service_uuid,
+                  context.advertisement_data, *context.ble_peripheral);
+            }
+          }
+          return;
+        }
+
         for (auto& medium_info : ble_v2_mediums_) {
           const api::ble_v2::BleMedium* remote_medium = medium_info.first;
           BleV2MediumContext& remote_context = medium_info.second;
@@ -702,8 +915,42 @@ void MediumEnvironment::UpdateBleV2MediumForScanning(
     if (enabled) {
       context.scanning = true;
       callback.start_scanning_result(absl::OkStatus());
-      context.scan_callback_map[{scanning_service_uuid, internal_session_id}] =
-          std::move(callback);
+      auto scan_callback =
+          std::make_shared<BleScanCallback>(std::move(callback));
+      std::shared_ptr<BleScanCallback> old_scan_callback = std::exchange(
+          context.scan_callback_map[{scanning_service_uuid,
+                                     internal_session_id}],
+          scan_callback);
+      {
+        absl::MutexLock lock(&ble_v2_delivery_mutex_);
+        ble_v2_scan_callbacks_.erase(old_scan_callback.get());
+        ble_v2_scan_callbacks_.insert(scan_callback.get());
+      }
+      ble_v2_scanners_[scanning_service_uuid].insert(&medium);
+      if (config_.crowd_simulation) {
+        std::vector<api::ble_v2::BleMedium*> advertisers;
+        if (config_.ble_range > 0) {
+          advertisers = GetBleV2MediumsNearby(context);
+        } else if (auto it = ble_v2_advertisers_.find(scanning_service_uuid);
+                   it != ble_v2_advertisers_.end()) {
+          advertisers.assign(it->second.begin(), it->second.end());
+        }
+        for (api::ble_v2::BleMedium* remote_medium : advertisers) {
+          if (remote_medium == &medium) continue;
+          const BleV2MediumContext& remote_context =
+              ble_v2_mediums_.at(remote_medium);
+          if (!remote_context.advertising ||
+              !remote_context.advertisement_data.service_data.contains(
+                  scanning_service_uuid) ||
+              !IsInBleRange(context, remote_context)) {
+            continue;
+          }
+          OnBleV2PeripheralStateChanged(enabled, context, scanning_service_uuid,
+                                        remote_context.advertisement_data,
+                                        *remote_context.ble_peripheral);
+        }
+        return;
+      }
       absl::flat_hash_set<Uuid> scanning_service_uuids;
       for (auto& element : context.scan_callback_map) {
         scanning_service_uuids.insert(element.first.first);
@@ -731,11 +978,22 @@ void MediumEnvironment::UpdateBleV2MediumForScanning(
         }
       }
     } else {
-      context.scan_callback_map.erase(
+      auto scan_callback = context.scan_callback_map.extract(
           {scanning_service_uuid, internal_session_id});
+      if (!scan_callback.empty()) {
+        absl::MutexLock lock(&ble_v2_delivery_mutex_);
+        ble_v2_scan_callbacks_.erase(scan_callback.mapped().get());
+      }
       if (context.scan_callback_map.empty()) {
         context.scanning = false;
       }
+      if (std::none_of(context.scan_callback_map.begin(),
+                       context.scan_callback_map.end(),
+                       [&scanning_service_uuid](const auto& element) {
+                         return element.first.first == scanning_service_uuid;
+                       })) {
+        EraseFromIndex(ble_v2_scanners_, scanning_service_uuid, &medium);
+      }
     }
   });
 }
@@ -745,9 +1003,41 @@ void MediumEnvironment::UnregisterBleV2Medium(api::ble_v2::BleMedium& medium) {
   RunOnMediumEnvironmentThread([this, &medium]() {
     auto item = ble_v2_mediums_.extract(&medium);
     if (item.empty()) return;
+    UnindexBleV2Medium(&medium, item.mapped());
+    {
+      absl::MutexLock lock(&ble_v2_delivery_mutex_);
+      ble_v2_peripherals_.erase(item.mapped().ble_peripheral);
+      for (const auto& [unused, scan_callback] :
+           item.mapped().scan_callback_map) {
+        ble_v2_scan_callbacks_.erase(scan_callback.get());
+      }
+    }
     NEARBY_LOGS(INFO) << "Unregistered BLE V2 medium:" << &medium;
   });
 }
+
+void MediumEnvironment::SetBleV2MediumPosition(api::ble_v2::BleMedium& medium,
+                                               double x, double y) {
+  if (!enabled_) return;
+  RunOnMediumEnvironmentThread([this, &medium, x, y]() {
+    auto it = ble_v2_mediums_.find(&medium);
+    if (it == ble_v2_mediums_.end()) {
+      NEARBY_LOGS(INFO) << "SetBleV2MediumPosition failed. There is no medium "
+                           "registered.";
+      return;
+    }
+    BleV2MediumContext& context = it->second;
+    context.x = x;
+    context.y = y;
+    if (!config_.crowd_simulation || config_.ble_range <= 0) return;
+    GridCell cell = GetGridCell(x, y);
+    if (cell == context.cell) return;
+    EraseFromIndex(ble_v2_grid_, context.cell, &medium);
+    context.cell = cell;
+    ble_v2_grid_[cell].insert(&medium);
+  });
+}
+
 std::optional<MediumEnvironment::BleV2MediumStatus>
 MediumEnvironment::GetBleV2MediumStatus(const api::ble_v2::BleMedium& medium) {
   if (!enabled_) return std::nullopt;
@@ -1162,6 +1452,11 @@ std::optional<FakeClock*> MediumEnvironment::GetSimulatedClock() {
   return std::nullopt;
 }
 
+std::shared_ptr<VirtualTime> MediumEnvironment::GetVirtualTime() {
+  MutexLock lock(&virtual_time_mutex_);
+  return virtual_time_;
+}
+
 void MediumEnvironment::RegisterGattServer(
     api::ble_v2::BleMedium& medium, api::ble_v2::BlePeripheral* peripheral,
     Borrowable<api::ble_v2::GattServer*> gatt_server) {
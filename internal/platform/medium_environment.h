@@ -16,15 +16,19 @@
 #define PLATFORM_BASE_MEDIUM_ENVIRONMENT_H_
 
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "absl/types/optional.h"
 #include "internal/base/observer_list.h"
@@ -36,6 +40,7 @@
 #include "internal/platform/runnable.h"
 #include "internal/platform/uuid.h"
 #include "internal/test/fake_clock.h"
+#include "internal/test/virtual_time.h"
 #ifndef NO_WEBRTC
 #include "internal/platform/implementation/webrtc.h"
 #endif
@@ -63,6 +68,30 @@ struct EnvironmentConfig {
   // The simulated clock is automatically picked up by SystemClock, Timer and
   // ScheduledExecutor implementations.
   bool use_simulated_clock = false;
+
+  // Runs the simulated clock in virtual time: whenever every thread of the
+  // platform is idle, the clock jumps to the next timeout or delayed task,
+  // so long timeouts take no real time. Implies `use_simulated_clock`. The
+  // thread calling Start() counts as busy until Stop(), and so keeps the
+  // clock still except while it waits on the platform.
+  bool use_virtual_time = false;
+
+  // Crowd simulation, for scenarios with hundreds of devices. BLE v2
+  // advertisements are matched against an index of scanners instead of every
+  // registered medium, only reach scanners within `ble_range` of the
+  // advertiser, and are reported on `delivery_threads` threads instead of the
+  // environment thread. Reports to one medium are always made in order, on
+  // the same thread. As with a real radio, an advertisement may be reported
+  // shortly after scanning stops; Sync() waits for the reports to be made.
+  bool crowd_simulation = false;
+
+  // The range of a BLE v2 radio in meters, in crowd simulation. Mediums are
+  // placed with SetBleV2MediumPosition(). Zero puts every medium in range.
+  double ble_range = 0;
+
+  // The number of threads reporting BLE v2 advertisements, in crowd
+  // simulation.
+  int delivery_threads = 4;
 };
 
 // MediumEnvironment is a simulated environment which allows multiple instances
@@ -265,6 +294,13 @@ class MediumEnvironment {
   // Removes medium-related info. This should correspond to device power off.
   void UnregisterBleV2Medium(api::ble_v2::BleMedium& mediumum);
 
+  // Places the medium at (x, y), in meters. Only used in crowd simulation,
+  // where it limits which scanners hear the advertisements of the medium, and
+  // which advertisements the medium hears. Applies to advertisements that
+  // start or stop after the medium moved. Mediums start at the origin.
+  void SetBleV2MediumPosition(api::ble_v2::BleMedium& medium, double x,
+                              double y);
+
   // Collects the status for the given BleMedium. Mainly used in unit tests
   // to verify if the BleMedum is in expected status after operations.
   std::optional<BleV2MediumStatus> GetBleV2MediumStatus(
@@ -349,6 +385,10 @@ class MediumEnvironment {
 
   std::optional<FakeClock*> GetSimulatedClock();
 
+  // Returns the virtual time running the simulated clock, or nullptr unless
+  // EnvironmentConfig::use_virtual_time is set.
+  std::shared_ptr<VirtualTime> GetVirtualTime();
+
   api::ble_v2::BleMedium* FindBleV2Medium(absl::string_view address);
   api::ble_v2::BleMedium* FindBleV2Medium(uint64_t id);
 
@@ -413,8 +453,14 @@ class MediumEnvironment {
     bool fast_advertisement = false;
   };
 
+  // A cell of the grid that partitions the environment by radio range.
+  using GridCell = std::pair<std::int64_t, std::int64_t>;
+
   struct BleV2MediumContext {
-    absl::flat_hash_map<std::pair<Uuid, std::uint32_t>, BleScanCallback>
+    // Shared with the reports queued on the delivery threads, in crowd
+    // simulation.
+    absl::flat_hash_map<std::pair<Uuid, std::uint32_t>,
+                        std::shared_ptr<BleScanCallback>>
         scan_callback_map;
     // using the same ble peripheral for different advertisement.
     api::ble_v2::BlePeripheral* ble_peripheral;
@@ -422,6 +468,11 @@ class MediumEnvironment {
     bool advertising = false;
     bool scanning = false;
     std::unique_ptr<Borrowable<api::ble_v2::GattServer*>> gatt_server = nullptr;
+    // Position and delivery thread in crowd simulation.
+    double x = 0;
+    double y = 0;
+    GridCell cell = {0, 0};
+    std::size_t delivery_thread = 0;
   };
 
   struct WifiLanMediumContext {
@@ -480,17 +531,46 @@ class MediumEnvironment {
       const api::ble_v2::BleAdvertisementData& ble_advertisement_data,
       api::ble_v2::BlePeripheral& peripheral);
 
+  // Crowd simulation: returns the registered mediums that may be within radio
+  // range of `context`, including its own.
+  std::vector<api::ble_v2::BleMedium*> GetBleV2MediumsNearby(
+      const BleV2MediumContext& context) const;
+  bool IsInBleRange(const BleV2MediumContext& a,
+                    const BleV2MediumContext& b) const;
+  GridCell GetGridCell(double x, double y) const;
+
+  // Keeps the service UUID indices of `medium` up to date.
+  void IndexBleV2Advertiser(api::ble_v2::BleMedium* medium,
+                            const api::ble_v2::BleAdvertisementData& old_data,
+                            const BleV2MediumContext& context);
+  void UnindexBleV2Medium(api::ble_v2::BleMedium* medium,
+                          const BleV2MediumContext& context);
+
   void OnWifiLanServiceStateChanged(WifiLanMediumContext& info,
                                     const NsdServiceInfo& service_info,
                                     bool enabled);
 
   void RunOnMediumEnvironmentThread(Runnable runnable);
+  void RunOnDeliveryThread(std::size_t index, Runnable runnable);
 
   std::atomic_bool enabled_ = false;
   std::atomic_int job_count_ = 0;
   std::atomic_bool enable_notifications_ = false;
   SingleThreadExecutor executor_;
   EnvironmentConfig config_;
+  // Crowd simulation only. Created by Start() and destroyed by Stop(), while
+  // the environment is idle; otherwise used on the executor_ thread.
+  std::vector<std::unique_ptr<SingleThreadExecutor>> delivery_executors_;
+  std::size_t next_delivery_thread_ = 0;
+  // The BLE v2 peripherals of registered mediums and the active scan
+  // callbacks. Reports on the delivery threads are dropped once their
+  // peripheral or callback is gone; the executor_ thread takes the lock
+  // exclusively to remove them, so none is in use past that point.
+  absl::Mutex ble_v2_delivery_mutex_;
+  absl::flat_hash_set<const api::ble_v2::BlePeripheral*> ble_v2_peripherals_
+      ABSL_GUARDED_BY(ble_v2_delivery_mutex_);
+  absl::flat_hash_set<const BleScanCallback*> ble_v2_scan_callbacks_
+      ABSL_GUARDED_BY(ble_v2_delivery_mutex_);
 
   // The following data members are accessed in the context of a private
   // executor_ thread.
@@ -502,6 +582,14 @@ class MediumEnvironment {
   absl::flat_hash_map<api::BleMedium*, BleMediumContext> ble_mediums_;
   absl::flat_hash_map<api::ble_v2::BleMedium*, BleV2MediumContext>
       ble_v2_mediums_;
+  // BLE v2 mediums by the service UUIDs they scan and advertise.
+  absl::flat_hash_map<Uuid, absl::flat_hash_set<api::ble_v2::BleMedium*>>
+      ble_v2_scanners_;
+  absl::flat_hash_map<Uuid, absl::flat_hash_set<api::ble_v2::BleMedium*>>
+      ble_v2_advertisers_;
+  // BLE v2 mediums by grid cell, when crowd simulation has a radio range.
+  absl::flat_hash_map<GridCell, absl::flat_hash_set<api::ble_v2::BleMedium*>>
+      ble_v2_grid_;
   absl::flat_hash_map<api::BluetoothDevice*, BluetoothPairingContext>
       devices_pairing_contexts_;
 #ifndef NO_WEBRTC
@@ -526,7 +614,12 @@ class MediumEnvironment {
 
   bool use_valid_peer_connection_ = true;
   absl::Duration peer_connection_latency_ = absl::ZeroDuration();
-  std::unique_ptr<FakeClock> simulated_clock_ ABSL_GUARDED_BY(mutex_);
+  std::shared_ptr<FakeClock> simulated_clock_ ABSL_GUARDED_BY(mutex_);
+  // Taken by every wait and task of the platform, so it is separate from
+  // `mutex_`.
+  Mutex virtual_time_mutex_;
+  std::shared_ptr<VirtualTime> virtual_time_
+      ABSL_GUARDED_BY(virtual_time_mutex_);
   ObserverList<api::BluetoothClassicMedium::Observer> observers_;
   bool ble_extended_advertisements_available_ = false;
 };
@@ -14,11 +14,11 @@
 
 #include "internal/platform/monitored_runnable.h"
 
+#include <string>
 #include <utility>
 
 // TODO: Support thread status
 #include "internal/platform/logging.h"
-#include "internal/platform/pending_job_registry.h"
 
 #define SET_THREAD_STATUS(NAME)
 
@@ -29,14 +29,37 @@ absl::Duration kMinReportedTaskDuration = absl::Seconds(10);
 }  // namespace
 
 MonitoredRunnable::MonitoredRunnable(Runnable&& runnable)
-    : runnable_{std::move(runnable)} {}
+    : runnable_{std::move(runnable)},
+      slot_{PendingJobRegistry::kInvalidSlot} {}
 
 MonitoredRunnable::MonitoredRunnable(const std::string& name,
                                      Runnable&& runnable)
-    : name_{name}, runnable_{std::move(runnable)} {
-  PendingJobRegistry::GetInstance().AddPendingJob(name_, post_time_);
+    : name_{name},
+      runnable_{std::move(runnable)},
+      slot_{PendingJobRegistry::GetInstance().AddPendingJob(name_,
+                                                            post_time_)} {}
+
+MonitoredRunnable::MonitoredRunnable(MonitoredRunnable&& other)
+    : name_{std::move(other.name_)},
+      runnable_{std::move(other.runnable_)},
+      post_time_{other.post_time_},
+      slot_{std::exchange(other.slot_, PendingJobRegistry::kInvalidSlot)} {}
+
+MonitoredRunnable& MonitoredRunnable::operator=(MonitoredRunnable&& other) {
+  if (this != &other) {
+    ReleaseSlot();
+    name_ = std::move(other.name_);
+    runnable_ = std::move(other.runnable_);
+    post_time_ = other.post_time_;
+    slot_ = std::exchange(other.slot_, PendingJobRegistry::kInvalidSlot);
+  }
+  return *this;
 }
 
+// A task dropped by its executor (e.g. on shutdown) must not stay in the
+// registry forever.
+MonitoredRunnable::~MonitoredRunnable() { ReleaseSlot(); }
+
 void MonitoredRunnable::operator()() {
   SET_THREAD_STATUS(name_.c_str());
   auto start_time = SystemClock::ElapsedRealtime();
@@ -45,16 +68,26 @@ void MonitoredRunnable::operator()() {
     NEARBY_LOGS(INFO) << "Task: \"" << name_ << "\" started after "
                       << absl::ToInt64Seconds(start_delay) << " seconds";
   }
-  PendingJobRegistry::GetInstance().RemovePendingJob(name_, post_time_);
-  PendingJobRegistry::GetInstance().AddRunningJob(name_, post_time_);
+  bool monitored = slot_ != PendingJobRegistry::kInvalidSlot;
+  if (monitored) {
+    PendingJobRegistry::GetInstance().MarkJobRunning(slot_, start_time);
+  }
   runnable_();
   auto task_duration = SystemClock::ElapsedRealtime() - start_time;
   if (task_duration >= kMinReportedTaskDuration) {
     NEARBY_LOGS(INFO) << "Task: \"" << name_ << "\" finished after "
                       << absl::ToInt64Seconds(task_duration) << " seconds";
   }
-  PendingJobRegistry::GetInstance().RemoveRunningJob(name_, post_time_);
-  PendingJobRegistry::GetInstance().ListJobs();
+  if (monitored) {
+    ReleaseSlot();
+    PendingJobRegistry::GetInstance().ListJobs();
+  }
+}
+
+void MonitoredRunnable::ReleaseSlot() {
+  if (slot_ == PendingJobRegistry::kInvalidSlot) return;
+  PendingJobRegistry::GetInstance().RemoveJob(slot_);
+  slot_ = PendingJobRegistry::kInvalidSlot;
 }
 
 }  // namespace nearby
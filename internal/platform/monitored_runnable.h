@@ -18,6 +18,7 @@
 #include <string>
 
 #include "absl/time/time.h"
+#include "internal/platform/pending_job_registry.h"
 #include "internal/platform/runnable.h"
 #include "internal/platform/system_clock.h"
 
@@ -31,13 +32,21 @@ class MonitoredRunnable {
  public:
   explicit MonitoredRunnable(Runnable&& runnable);
   MonitoredRunnable(const std::string& name, Runnable&& runnable);
+  MonitoredRunnable(MonitoredRunnable&& other);
+  MonitoredRunnable& operator=(MonitoredRunnable&& other);
+  ~MonitoredRunnable();
 
   void operator()();
 
  private:
-  const std::string name_;
+  void ReleaseSlot();
+
+  std::string name_;
   Runnable runnable_;
   absl::Time post_time_ = SystemClock::ElapsedRealtime();
+  // Slot in PendingJobRegistry, or PendingJobRegistry::kInvalidSlot if the
+  // task isn't monitored.
+  int slot_;
 };
 
 }  // namespace nearby
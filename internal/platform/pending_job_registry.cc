@@ -14,9 +14,17 @@
 
 #include "internal/platform/pending_job_registry.h"
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
 #include "internal/platform/logging.h"
 #include "internal/platform/mutex_lock.h"
 #include "internal/platform/system_clock.h"
+#include "internal/platform/timer_impl.h"
 
 namespace nearby {
 
@@ -24,6 +32,21 @@ namespace {
 absl::Duration kMinReportInterval = absl::Seconds(60);
 absl::Duration kReportPendingJobsOlderThan = absl::Seconds(40);
 absl::Duration kReportRunningJobsOlderThan = absl::Seconds(60);
+
+// Names beyond this limit are reported as `kOverflowName`. Task names are
+// expected to come from a small, fixed set.
+constexpr int kMaxInternedNames = 1024;
+const char kOverflowName[] = "<unnamed>";
+
+// Each thread starts probing for a free slot at a different offset so that
+// executors posting concurrently don't fight over the same cache lines.
+int GetSlotHint() {
+  static std::atomic<int> next_hint{0};
+  thread_local int hint =
+      next_hint.fetch_add(37, std::memory_order_relaxed) %
+      PendingJobRegistry::kMaxTrackedJobs;
+  return hint;
+}
 }  // namespace
 
 PendingJobRegistry& PendingJobRegistry::GetInstance() {
@@ -33,73 +56,178 @@ PendingJobRegistry& PendingJobRegistry::GetInstance() {
 
 PendingJobRegistry::PendingJobRegistry() = default;
 
-PendingJobRegistry::~PendingJobRegistry() = default;
+PendingJobRegistry::~PendingJobRegistry() { StopSampler(); }
 
-void PendingJobRegistry::AddPendingJob(const std::string& name,
-                                       absl::Time post_time) {
-  MutexLock lock(&mutex_);
-  pending_jobs_.emplace(CreateKey(name, post_time), post_time);
+int PendingJobRegistry::AddPendingJob(const std::string& name,
+                                      absl::Time post_time) {
+  if (!sampler_requested_.load(std::memory_order_relaxed) &&
+      !sampler_requested_.exchange(true)) {
+    StartSampler(kMinReportInterval);
+  }
+  const std::string* interned_name = InternName(name);
+  int hint = GetSlotHint();
+  for (int i = 0; i < kMaxTrackedJobs; ++i) {
+    int index = (hint + i) % kMaxTrackedJobs;
+    Slot& slot = slots_[index];
+    const std::string* expected = nullptr;
+    if (slot.name.load(std::memory_order_relaxed) == nullptr &&
+        slot.name.compare_exchange_strong(expected, interned_name,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed)) {
+      slot.start_time_nanos.store(0, std::memory_order_relaxed);
+      slot.post_time_nanos.store(absl::ToUnixNanos(post_time),
+                                 std::memory_order_release);
+      return index;
+    }
+  }
+  if (!overflow_logged_.exchange(true, std::memory_order_relaxed)) {
+    NEARBY_LOGS(WARNING) << "All " << kMaxTrackedJobs
+                         << " pending job slots are taken; \"" << name
+                         << "\" and later jobs are not monitored until slots "
+                            "are released.";
+  }
+  return kInvalidSlot;
 }
 
-void PendingJobRegistry::RemovePendingJob(const std::string& name,
-                                          absl::Time post_time) {
-  MutexLock lock(&mutex_);
-  pending_jobs_.erase(CreateKey(name, post_time));
+void PendingJobRegistry::MarkJobRunning(int slot, absl::Time start_time) {
+  if (slot < 0 || slot >= kMaxTrackedJobs) return;
+  slots_[slot].start_time_nanos.store(absl::ToUnixNanos(start_time),
+                                      std::memory_order_release);
 }
 
-void PendingJobRegistry::AddRunningJob(const std::string& name,
-                                       absl::Time post_time) {
-  MutexLock lock(&mutex_);
-  running_jobs_.emplace(CreateKey(name, post_time),
-                        SystemClock::ElapsedRealtime());
+void PendingJobRegistry::RemoveJob(int slot) {
+  if (slot < 0 || slot >= kMaxTrackedJobs) return;
+  Slot& entry = slots_[slot];
+  entry.post_time_nanos.store(0, std::memory_order_relaxed);
+  entry.start_time_nanos.store(0, std::memory_order_relaxed);
+  entry.name.store(nullptr, std::memory_order_release);
 }
 
-void PendingJobRegistry::RemoveRunningJob(const std::string& name,
-                                          absl::Time post_time) {
-  MutexLock lock(&mutex_);
-  running_jobs_.erase(CreateKey(name, post_time));
+void PendingJobRegistry::ListJobs() {
+  auto current_time = SystemClock::ElapsedRealtime();
+  int64_t now_nanos = absl::ToUnixNanos(current_time);
+  int64_t next_report_nanos =
+      next_report_time_nanos_.load(std::memory_order_relaxed);
+  if (now_nanos < next_report_nanos) return;
+  // Only one caller per interval gets to walk the table.
+  if (!next_report_time_nanos_.compare_exchange_strong(
+          next_report_nanos,
+          absl::ToUnixNanos(current_time + kMinReportInterval),
+          std::memory_order_relaxed)) {
+    return;
+  }
+  ReportJobs(current_time, /*all=*/false);
 }
 
-void PendingJobRegistry::ListJobs() {
+void PendingJobRegistry::ListAllJobs() {
   auto current_time = SystemClock::ElapsedRealtime();
-  MutexLock lock(&mutex_);
-  if (current_time - list_jobs_time_ < kMinReportInterval) return;
-  for (auto& job : pending_jobs_) {
-    auto age = current_time - job.second;
-    if (age >= kReportPendingJobsOlderThan) {
-      NEARBY_LOGS(INFO) << "Task \"" << job.first << "\" is waiting for "
-                        << absl::ToInt64Seconds(age) << " s";
+  next_report_time_nanos_.store(
+      absl::ToUnixNanos(current_time + kMinReportInterval),
+      std::memory_order_relaxed);
+  ReportJobs(current_time, /*all=*/true);
+}
+
+void PendingJobRegistry::StartSampler(absl::Duration period) {
+  MutexLock lock(&sampler_mutex_);
+  if (sampler_ != nullptr) return;
+  int period_millis = absl::ToInt64Milliseconds(period);
+  sampler_ = std::make_unique<TimerImpl>();
+  if (!sampler_->Start(period_millis, period_millis,
+                       [this]() { ListJobs(); })) {
+    NEARBY_LOGS(WARNING) << "Failed to start pending job sampler.";
+    sampler_.reset();
+  }
+}
+
+void PendingJobRegistry::StopSampler() {
+  MutexLock lock(&sampler_mutex_);
+  if (sampler_ == nullptr) return;
+  sampler_->Stop();
+  sampler_.reset();
+}
+
+bool PendingJobRegistry::IsSamplerRunning() {
+  MutexLock lock(&sampler_mutex_);
+  return sampler_ != nullptr;
+}
+
+int PendingJobRegistry::GetPendingJobCount() const {
+  int count = 0;
+  for (const Slot& slot : slots_) {
+    if (slot.name.load(std::memory_order_acquire) != nullptr &&
+        slot.start_time_nanos.load(std::memory_order_acquire) == 0) {
+      ++count;
     }
   }
-  for (auto& job : running_jobs_) {
-    auto age = current_time - job.second;
-    if (age >= kReportRunningJobsOlderThan) {
-      NEARBY_LOGS(INFO) << "Task \"" << job.first << "\" is running for "
-                        << absl::ToInt64Seconds(age) << " s";
+  return count;
+}
+
+int PendingJobRegistry::GetRunningJobCount() const {
+  int count = 0;
+  for (const Slot& slot : slots_) {
+    if (slot.name.load(std::memory_order_acquire) != nullptr &&
+        slot.start_time_nanos.load(std::memory_order_acquire) != 0) {
+      ++count;
     }
   }
-  list_jobs_time_ = current_time;
+  return count;
 }
 
-void PendingJobRegistry::ListAllJobs() {
-  MutexLock lock(&mutex_);
-  auto current_time = SystemClock::ElapsedRealtime();
-  for (auto& job : pending_jobs_) {
-    auto age = current_time - job.second;
-    NEARBY_LOGS(INFO) << "Task \"" << job.first << "\" is waiting for "
-                      << absl::ToInt64Seconds(age) << " s";
+int64_t PendingJobRegistry::GetLockedNameLookupCount() const {
+  return locked_name_lookups_.load(std::memory_order_relaxed);
+}
+
+const std::string* PendingJobRegistry::InternName(const std::string& name) {
+  // Interned names are never freed, so the per-thread cache can hand out
+  // pointers without taking `mutex_`.
+  thread_local absl::flat_hash_map<std::string, const std::string*> cache;
+  auto it = cache.find(name);
+  if (it != cache.end()) return it->second;
+
+  const std::string* interned_name;
+  locked_name_lookups_.fetch_add(1, std::memory_order_relaxed);
+  {
+    MutexLock lock(&mutex_);
+    auto interned = interned_names_.find(name);
+    if (interned != interned_names_.end()) {
+      interned_name = &*interned;
+    } else if (interned_names_.size() < kMaxInternedNames) {
+      interned_name = &*interned_names_.insert(name).first;
+    } else {
+      interned_name = &*interned_names_.insert(kOverflowName).first;
+    }
   }
-  for (auto& job : running_jobs_) {
-    auto age = current_time - job.second;
-    NEARBY_LOGS(INFO) << "Task \"" << job.first << "\" is running for "
-                      << absl::ToInt64Seconds(age) << " s";
+  if (cache.size() < kMaxInternedNames) {
+    cache.emplace(name, interned_name);
   }
-  list_jobs_time_ = current_time;
+  return interned_name;
 }
 
-std::string PendingJobRegistry::CreateKey(const std::string& name,
-                                          absl::Time post_time) {
-  return name + "." + std::to_string(absl::ToUnixNanos(post_time));
+void PendingJobRegistry::ReportJobs(absl::Time current_time, bool all) {
+  for (const Slot& slot : slots_) {
+    const std::string* name = slot.name.load(std::memory_order_acquire);
+    if (name == nullptr) continue;
+    int64_t post_time_nanos =
+        slot.post_time_nanos.load(std::memory_order_acquire);
+    int64_t start_time_nanos =
+        slot.start_time_nanos.load(std::memory_order_acquire);
+    // The slot is being claimed or released.
+    if (post_time_nanos == 0) continue;
+
+    if (start_time_nanos == 0) {
+      auto age = current_time - absl::FromUnixNanos(post_time_nanos);
+      if (all || age >= kReportPendingJobsOlderThan) {
+        NEARBY_LOGS(INFO) << "Task \"" << *name << "\" is waiting for "
+                          << absl::ToInt64Seconds(age) << " s";
+      }
+    } else {
+      auto age = current_time - absl::FromUnixNanos(start_time_nanos);
+      if (all || age >= kReportRunningJobsOlderThan) {
+        NEARBY_LOGS(INFO) << "Task \"" << *name << "\" is running for "
+                          << absl::ToInt64Seconds(age) << " s";
+      }
+    }
+  }
 }
 
 }  // namespace nearby
@@ -15,38 +15,94 @@
 #ifndef PLATFORM_PUBLIC_PENDING_JOB_REGISTRY_H_
 #define PLATFORM_PUBLIC_PENDING_JOB_REGISTRY_H_
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
 #include "absl/base/thread_annotations.h"
+#include "absl/container/node_hash_set.h"
 #include "absl/time/time.h"
 #include "internal/platform/mutex.h"
+#include "internal/platform/timer.h"
 
 namespace nearby {
 
 // A global registry of running tasks. The goal is to help us monitor
-// tasks that are either waiting too long for their turn or they never finish
+// tasks that are either waiting too long for their turn or they never finish.
+//
+// Jobs are tracked in a fixed table of slots. Claiming, updating and releasing
+// a slot are lock-free, so executors never contend on a shared lock when they
+// post or run a task. Task names are interned once and slots only hold a
+// pointer to the interned name. The table is sampled either after a task
+// completes (at most once per report interval) or by a background sampler,
+// which the first AddPendingJob() starts and the registry owns.
 class PendingJobRegistry {
  public:
+  // Returned by AddPendingJob() when all slots are taken. The job is then
+  // simply not monitored.
+  static constexpr int kInvalidSlot = -1;
+  static constexpr int kMaxTrackedJobs = 512;
+
   static PendingJobRegistry& GetInstance();
 
   ~PendingJobRegistry();
 
-  void AddPendingJob(const std::string& name, absl::Time post_time);
-  void RemovePendingJob(const std::string& name, absl::Time post_time);
-  void AddRunningJob(const std::string& name, absl::Time post_time);
-  void RemoveRunningJob(const std::string& name, absl::Time post_time);
+  // Claims a slot for a job posted at `post_time` and returns its index. Starts
+  // the background sampler on first use.
+  int AddPendingJob(const std::string& name, absl::Time post_time);
+  // Marks the job in `slot` as started at `start_time`.
+  void MarkJobRunning(int slot, absl::Time start_time);
+  // Releases `slot`. Must be called exactly once for every valid slot.
+  void RemoveJob(int slot);
+
+  // Logs jobs pending or running for too long. Rate limited.
   void ListJobs();
   void ListAllJobs();
 
+  // Starts a background sampler that calls ListJobs() every `period`, so stuck
+  // jobs are reported even if no other task completes. No-op if it is
+  // already running.
+  void StartSampler(absl::Duration period) ABSL_LOCKS_EXCLUDED(sampler_mutex_);
+  void StopSampler() ABSL_LOCKS_EXCLUDED(sampler_mutex_);
+  bool IsSamplerRunning() ABSL_LOCKS_EXCLUDED(sampler_mutex_);
+
+  int GetPendingJobCount() const;
+  int GetRunningJobCount() const;
+
+  // Number of times a task name was looked up under the shared lock, rather
+  // than in the calling thread's cache.
+  int64_t GetLockedNameLookupCount() const;
+
  private:
+  struct alignas(64) Slot {
+    std::atomic<const std::string*> name{nullptr};
+    // Zero while the slot is being claimed or released.
+    std::atomic<int64_t> post_time_nanos{0};
+    // Zero while the job is pending.
+    std::atomic<int64_t> start_time_nanos{0};
+  };
+
   PendingJobRegistry();
 
-  std::string CreateKey(const std::string& name, absl::Time post_time);
+  const std::string* InternName(const std::string& name)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void ReportJobs(absl::Time current_time, bool all);
+
+  std::array<Slot, kMaxTrackedJobs> slots_;
+  std::atomic<int64_t> next_report_time_nanos_{0};
+  std::atomic<bool> sampler_requested_{false};
+  std::atomic<bool> overflow_logged_{false};
+  std::atomic<int64_t> locked_name_lookups_{0};
+
+  mutable Mutex mutex_;
+  absl::node_hash_set<std::string> interned_names_ ABSL_GUARDED_BY(mutex_);
 
-  Mutex mutex_;
-  absl::flat_hash_map<std::string, absl::Time> pending_jobs_
-      ABSL_GUARDED_BY(mutex_);
-  absl::flat_hash_map<std::string, absl::Time> running_jobs_
-      ABSL_GUARDED_BY(mutex_);
-  absl::Time list_jobs_time_ ABSL_GUARDED_BY(mutex_) = absl::UnixEpoch();
+  // Separate from `mutex_`, since starting the timer may post monitored
+  // tasks, which intern their names.
+  Mutex sampler_mutex_;
+  std::unique_ptr<Timer> sampler_ ABSL_GUARDED_BY(sampler_mutex_);
 };
 
 }  // namespace nearby
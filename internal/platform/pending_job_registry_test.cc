@@ -0,0 +1,178 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "internal/platform/pending_job_registry.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "internal/platform/monitored_runnable.h"
+
+namespace nearby {
+namespace {
+
+constexpr int kThreads = 8;
+
+void RunOnThreads(absl::AnyInvocable<void(int)> job) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&job, i]() { job(i); });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+TEST(PendingJobRegistryTest, TracksPendingAndRunningJobs) {
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  int pending = registry.GetPendingJobCount();
+  int running = registry.GetRunningJobCount();
+
+  int slot = registry.AddPendingJob("job", absl::Now());
+  ASSERT_NE(slot, PendingJobRegistry::kInvalidSlot);
+  EXPECT_EQ(registry.GetPendingJobCount(), pending + 1);
+
+  registry.MarkJobRunning(slot, absl::Now());
+  EXPECT_EQ(registry.GetPendingJobCount(), pending);
+  EXPECT_EQ(registry.GetRunningJobCount(), running + 1);
+
+  registry.RemoveJob(slot);
+  EXPECT_EQ(registry.GetRunningJobCount(), running);
+}
+
+TEST(PendingJobRegistryTest, FirstJobStartsSampler) {
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  registry.RemoveJob(registry.AddPendingJob("job", absl::Now()));
+  EXPECT_TRUE(registry.IsSamplerRunning());
+
+  registry.StopSampler();
+  EXPECT_FALSE(registry.IsSamplerRunning());
+  registry.StartSampler(absl::Seconds(60));
+  registry.StartSampler(absl::Seconds(60));
+  EXPECT_TRUE(registry.IsSamplerRunning());
+}
+
+TEST(PendingJobRegistryTest, FullTableLeavesJobsUnmonitored) {
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  std::vector<int> slots;
+  while (true) {
+    int slot = registry.AddPendingJob("filler", absl::Now());
+    if (slot == PendingJobRegistry::kInvalidSlot) break;
+    slots.push_back(slot);
+  }
+  EXPECT_LE(static_cast<int>(slots.size()),
+            PendingJobRegistry::kMaxTrackedJobs);
+
+  // Tasks still run when they can't be tracked.
+  bool done = false;
+  MonitoredRunnable runnable("untracked", [&done]() { done = true; });
+  runnable();
+  EXPECT_TRUE(done);
+
+  for (int slot : slots) registry.RemoveJob(slot);
+}
+
+TEST(PendingJobRegistryTest, DroppedRunnableReleasesSlot) {
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  int pending = registry.GetPendingJobCount();
+  {
+    MonitoredRunnable runnable("dropped", []() {});
+    MonitoredRunnable moved = std::move(runnable);
+    EXPECT_EQ(registry.GetPendingJobCount(), pending + 1);
+  }
+  EXPECT_EQ(registry.GetPendingJobCount(), pending);
+}
+
+TEST(PendingJobRegistryTest, RunnableIsRemovedAfterRun) {
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  int pending = registry.GetPendingJobCount();
+  int running = registry.GetRunningJobCount();
+  int running_during_task = 0;
+  MonitoredRunnable runnable("task", [&]() {
+    running_during_task = registry.GetRunningJobCount();
+  });
+  runnable();
+  EXPECT_EQ(running_during_task, running + 1);
+  EXPECT_EQ(registry.GetPendingJobCount(), pending);
+  EXPECT_EQ(registry.GetRunningJobCount(), running);
+}
+
+TEST(PendingJobRegistryTest, ConcurrentJobsClaimDistinctSlots) {
+  constexpr int kJobsPerThread = PendingJobRegistry::kMaxTrackedJobs / 2 /
+                                 kThreads;
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  int pending = registry.GetPendingJobCount();
+  std::vector<std::vector<int>> slots(kThreads);
+
+  RunOnThreads([&](int thread) {
+    for (int i = 0; i < kJobsPerThread; ++i) {
+      slots[thread].push_back(registry.AddPendingJob("job", absl::Now()));
+    }
+  });
+
+  absl::flat_hash_set<int> claimed;
+  for (const std::vector<int>& thread_slots : slots) {
+    for (int slot : thread_slots) {
+      EXPECT_NE(slot, PendingJobRegistry::kInvalidSlot);
+      EXPECT_TRUE(claimed.insert(slot).second);
+    }
+  }
+  EXPECT_EQ(registry.GetPendingJobCount(), pending + kThreads * kJobsPerThread);
+  for (int slot : claimed) registry.RemoveJob(slot);
+  EXPECT_EQ(registry.GetPendingJobCount(), pending);
+}
+
+TEST(PendingJobRegistryTest, ConcurrentRunnablesReleaseTheirSlots) {
+  constexpr int kJobsPerThread = 10000;
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  int pending = registry.GetPendingJobCount();
+  int running = registry.GetRunningJobCount();
+
+  RunOnThreads([](int) {
+    for (int i = 0; i < kJobsPerThread; ++i) {
+      MonitoredRunnable runnable("task", []() {});
+      runnable();
+    }
+  });
+
+  EXPECT_EQ(registry.GetPendingJobCount(), pending);
+  EXPECT_EQ(registry.GetRunningJobCount(), running);
+}
+
+// Measures how often contended jobs fall back to the shared lock. Every thread
+// looks a name up under the lock at most once; all other jobs only touch their
+// own slot.
+TEST(PendingJobRegistryTest, ContendedJobsTakeSharedLockOncePerThread) {
+  constexpr int kJobsPerThread = 10000;
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  int64_t locked_lookups = registry.GetLockedNameLookupCount();
+
+  RunOnThreads([](int) {
+    for (int i = 0; i < kJobsPerThread; ++i) {
+      MonitoredRunnable runnable("contended task", []() {});
+      runnable();
+    }
+  });
+
+  EXPECT_LE(registry.GetLockedNameLookupCount() - locked_lookups, kThreads);
+}
+
+}  // namespace
+}  // namespace nearby
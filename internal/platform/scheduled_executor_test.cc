@@ -15,6 +15,7 @@
 #include "internal/platform/scheduled_executor.h"
 
 #include <atomic>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "absl/base/thread_annotations.h"
@@ -282,6 +283,40 @@ TEST_F(ScheduledExecutorTest,
   MediumEnvironment::Instance().Stop();
 }
 
+TEST_F(ScheduledExecutorTest, VirtualTimeRunsLongDelaysAtOnce) {
+  MediumEnvironment::Instance().Start({.use_virtual_time = true});
+  FakeClock* fake_clock =
+      MediumEnvironment::Instance().GetSimulatedClock().value();
+  absl::Time start = fake_clock->Now();
+  absl::Time real_start = absl::Now();
+  ScheduledExecutor executor;
+  absl::Mutex mutex;
+  std::vector<absl::Duration> run_at;
+  CountDownLatch latch(2);
+  for (absl::Duration delay : {absl::Minutes(30), absl::Minutes(10)}) {
+    executor.Schedule(
+        [&]() {
+          absl::MutexLock lock(&mutex);
+          run_at.push_back(fake_clock->Now() - start);
+          latch.CountDown();
+        },
+        delay);
+  }
+
+  // The clock jumps from task to task while this thread waits, and stops once
+  // the latch is released.
+  EXPECT_TRUE(latch.Await(absl::Hours(1)).result());
+  EXPECT_EQ(fake_clock->Now() - start, absl::Minutes(30));
+  {
+    absl::MutexLock lock(&mutex);
+    EXPECT_EQ(run_at, (std::vector<absl::Duration>{absl::Minutes(10),
+                                                   absl::Minutes(30)}));
+  }
+  EXPECT_LT(absl::Now() - real_start, absl::Minutes(1));
+  executor.Shutdown();
+  MediumEnvironment::Instance().Stop();
+}
+
 struct ScheduledThreadCheckTestClass {
   ScheduledExecutor executor;
   int value ABSL_GUARDED_BY(executor) = 0;
@@ -0,0 +1,202 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "internal/test/virtual_time.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "internal/test/fake_clock.h"
+
+namespace nearby {
+
+namespace {
+
+// How often a waiter with a deadline looks at the clock. The clock jumps
+// without signaling the waiters' condition variables, whose mutexes belong to
+// the callers.
+constexpr absl::Duration kPollInterval = absl::Milliseconds(1);
+
+// How long every thread has to stay idle before the clock jumps. A thread
+// woken other than through Notify() needs a moment to become busy again.
+constexpr absl::Duration kSettleTime = absl::Milliseconds(1);
+
+thread_local VirtualTime* participant = nullptr;
+
+}  // namespace
+
+VirtualTime::VirtualTime(std::shared_ptr<FakeClock> clock)
+    : clock_(std::move(clock)), thread_([this]() { Run(); }) {}
+
+VirtualTime::~VirtualTime() { Shutdown(); }
+
+void VirtualTime::Shutdown() {
+  {
+    absl::MutexLock lock(&mutex_);
+    shutdown_ = true;
+  }
+  if (thread_.joinable()) thread_.join();
+}
+
+void VirtualTime::AttachCurrentThread() {
+  if (participant == this) return;
+  participant = this;
+  absl::MutexLock lock(&mutex_);
+  ++busy_;
+  ++activity_;
+}
+
+void VirtualTime::DetachCurrentThread() {
+  if (participant != this) return;
+  participant = nullptr;
+  absl::MutexLock lock(&mutex_);
+  --busy_;
+  ++activity_;
+}
+
+void VirtualTime::TaskQueued() {
+  absl::MutexLock lock(&mutex_);
+  ++busy_;
+  ++activity_;
+}
+
+VirtualTime::TaskScope::TaskScope(VirtualTime& virtual_time)
+    : virtual_time_(virtual_time), previous_(participant) {
+  participant = &virtual_time_;
+}
+
+VirtualTime::TaskScope::~TaskScope() {
+  participant = previous_;
+  absl::MutexLock lock(&virtual_time_.mutex_);
+  --virtual_time_.busy_;
+  ++virtual_time_.activity_;
+}
+
+void VirtualTime::AddDeadline(absl::Time deadline) {
+  absl::MutexLock lock(&mutex_);
+  deadlines_.insert(deadline);
+}
+
+bool VirtualTime::WaitWithDeadline(absl::Mutex* mutex, absl::CondVar* cond,
+                                   absl::Time deadline) {
+  const bool timed = deadline != absl::InfiniteFuture();
+  Waiter waiter{
+      .cond = cond, .deadline = deadline, .participating = IsParticipating()};
+  {
+    absl::MutexLock lock(&mutex_);
+    if ((timed && shutdown_) || clock_->Now() >= deadline) return true;
+    waiters_.push_back(&waiter);
+    if (waiter.participating) --busy_;
+    ++activity_;
+  }
+  bool timed_out = false;
+  while (true) {
+    bool signaled = true;
+    if (timed) {
+      signaled = !cond->WaitWithTimeout(mutex, kPollInterval);
+    } else {
+      cond->Wait(mutex);
+    }
+    absl::MutexLock lock(&mutex_);
+    // A Notify() racing the end of a poll counts as a wakeup even though the
+    // poll missed the signal; the caller must recheck its condition.
+    if (waiter.notified) signaled = true;
+    if (!signaled && !shutdown_ && clock_->Now() < deadline) continue;
+    timed_out = !signaled;
+    waiters_.erase(std::find(waiters_.begin(), waiters_.end(), &waiter));
+    if (waiter.participating && !waiter.busy) ++busy_;
+    ++activity_;
+    break;
+  }
+  return timed_out;
+}
+
+void VirtualTime::Wait(absl::Mutex* mutex, absl::CondVar* cond) {
+  WaitWithDeadline(mutex, cond, absl::InfiniteFuture());
+}
+
+void VirtualTime::SleepUntil(absl::Time deadline) {
+  absl::Mutex mutex;
+  absl::CondVar cond;
+  absl::MutexLock lock(&mutex);
+  while (!WaitWithDeadline(&mutex, &cond, deadline)) {
+  }
+}
+
+void VirtualTime::Notify(absl::CondVar* cond) {
+  absl::MutexLock lock(&mutex_);
+  for (Waiter* waiter : waiters_) {
+    if (waiter->cond == cond && !waiter->busy) {
+      waiter->notified = true;
+      WakeLocked(*waiter);
+    }
+  }
+}
+
+bool VirtualTime::IsParticipating() const { return participant == this; }
+
+bool VirtualTime::ShouldAdvance() const {
+  if (shutdown_) return true;
+  if (busy_ > 0) return false;
+  if (!deadlines_.empty()) return true;
+  return std::any_of(waiters_.begin(), waiters_.end(), [](const Waiter* w) {
+    return !w->busy && w->deadline != absl::InfiniteFuture();
+  });
+}
+
+void VirtualTime::WakeLocked(Waiter& waiter) {
+  waiter.busy = true;
+  if (waiter.participating) ++busy_;
+  ++activity_;
+}
+
+void VirtualTime::Run() {
+  absl::MutexLock lock(&mutex_);
+  while (true) {
+    mutex_.Await(absl::Condition(this, &VirtualTime::ShouldAdvance));
+    if (shutdown_) return;
+    std::uint64_t activity = activity_;
+    mutex_.Unlock();
+    absl::SleepFor(kSettleTime);
+    mutex_.Lock();
+    if (activity_ != activity || !ShouldAdvance()) continue;
+    if (shutdown_) return;
+
+    absl::Time now = clock_->Now();
+    absl::Time target = absl::InfiniteFuture();
+    if (!deadlines_.empty()) target = *deadlines_.begin();
+    for (const Waiter* waiter : waiters_) {
+      if (!waiter->busy) target = std::min(target, waiter->deadline);
+    }
+    target = std::max(target, now);
+    // The observers of the clock queue the tasks that are due; the jump counts
+    // as busy until they are queued.
+    ++busy_;
+    mutex_.Unlock();
+    clock_->FastForward(target - now);
+    mutex_.Lock();
+    --busy_;
+    deadlines_.erase(deadlines_.begin(), deadlines_.upper_bound(target));
+    for (Waiter* waiter : waiters_) {
+      if (!waiter->busy && waiter->deadline <= target) WakeLocked(*waiter);
+    }
+    ++activity_;
+  }
+}
+
+}  // namespace nearby
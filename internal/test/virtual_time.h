@@ -0,0 +1,117 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_NEARBY_INTERNAL_TEST_VIRTUAL_TIME_H_
+#define THIRD_PARTY_NEARBY_INTERNAL_TEST_VIRTUAL_TIME_H_
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "internal/test/fake_clock.h"
+
+namespace nearby {
+
+// Runs a FakeClock as discrete-event time. Timed waits and delayed tasks wait
+// for the clock, and when every participating thread is idle, the clock jumps
+// to the earliest pending deadline. A test of a 30 second timeout then takes
+// as long as the work around it.
+//
+// A thread participates while it runs a task queued with TaskQueued(), or
+// after AttachCurrentThread(). It is busy, and keeps the clock still, unless
+// it waits in Wait() or WaitWithDeadline(). Threads that don't participate
+// never keep the clock still, though their timed waits are still measured
+// against it.
+class VirtualTime {
+ public:
+  explicit VirtualTime(std::shared_ptr<FakeClock> clock);
+  VirtualTime(const VirtualTime&) = delete;
+  VirtualTime& operator=(const VirtualTime&) = delete;
+  ~VirtualTime();
+
+  FakeClock& GetClock() const { return *clock_; }
+
+  // Stops moving the clock. Waits with a deadline time out at once from then
+  // on, so that threads still waiting can finish.
+  void Shutdown() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  void AttachCurrentThread() ABSL_LOCKS_EXCLUDED(mutex_);
+  void DetachCurrentThread() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // A queued task counts as busy from TaskQueued() until its TaskScope ends.
+  // The task must run in a TaskScope, which makes its thread participate.
+  void TaskQueued() ABSL_LOCKS_EXCLUDED(mutex_);
+  class TaskScope {
+   public:
+    explicit TaskScope(VirtualTime& virtual_time);
+    TaskScope(const TaskScope&) = delete;
+    TaskScope& operator=(const TaskScope&) = delete;
+    ~TaskScope();
+
+   private:
+    VirtualTime& virtual_time_;
+    VirtualTime* const previous_;
+  };
+
+  // Adds a deadline that the clock stops at, for a delayed task.
+  void AddDeadline(absl::Time deadline) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Waits on `cond`, with `mutex` held, until it is signaled or the clock
+  // reaches `deadline`. Returns true if the deadline passed.
+  bool WaitWithDeadline(absl::Mutex* mutex, absl::CondVar* cond,
+                        absl::Time deadline) ABSL_LOCKS_EXCLUDED(mutex_);
+  void Wait(absl::Mutex* mutex, absl::CondVar* cond)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void SleepUntil(absl::Time deadline) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Must be called before `cond` is signaled, so that the threads it wakes
+  // count as busy at once.
+  void Notify(absl::CondVar* cond) ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Waiter {
+    absl::CondVar* cond;
+    absl::Time deadline;
+    bool participating;
+    // Set once the waiter was counted busy by whoever woke it.
+    bool busy = false;
+    // Set when Notify() woke the waiter, whether or not it saw the signal.
+    bool notified = false;
+  };
+
+  bool IsParticipating() const;
+  bool ShouldAdvance() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void WakeLocked(Waiter& waiter) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Run() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const std::shared_ptr<FakeClock> clock_;
+  mutable absl::Mutex mutex_;
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+  // Queued tasks and participating threads that don't wait.
+  std::int64_t busy_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Changes whenever a thread becomes busy or idle.
+  std::uint64_t activity_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::multiset<absl::Time> deadlines_ ABSL_GUARDED_BY(mutex_);
+  std::vector<Waiter*> waiters_ ABSL_GUARDED_BY(mutex_);
+  std::thread thread_;
+};
+
+}  // namespace nearby
+
+#endif  // THIRD_PARTY_NEARBY_INTERNAL_TEST_VIRTUAL_TIME_H_
@@ -0,0 +1,166 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "internal/test/virtual_time.h"
+
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "internal/test/fake_clock.h"
+
+namespace nearby {
+namespace {
+
+// Far longer than any test here takes in real time.
+constexpr absl::Duration kLongTimeout = absl::Hours(1);
+
+class VirtualTimeTest : public testing::Test {
+ protected:
+  VirtualTimeTest() { virtual_time_.AttachCurrentThread(); }
+  ~VirtualTimeTest() override {
+    virtual_time_.DetachCurrentThread();
+    virtual_time_.Shutdown();
+  }
+
+  std::shared_ptr<FakeClock> clock_ = std::make_shared<FakeClock>();
+  VirtualTime virtual_time_{clock_};
+};
+
+TEST_F(VirtualTimeTest, TimedWaitTimesOutWhenIdle) {
+  absl::Mutex mutex;
+  absl::CondVar cond;
+  absl::Time start = clock_->Now();
+  absl::Time real_start = absl::Now();
+
+  absl::MutexLock lock(&mutex);
+  EXPECT_TRUE(virtual_time_.WaitWithDeadline(&mutex, &cond,
+                                             start + kLongTimeout));
+
+  EXPECT_EQ(clock_->Now(), start + kLongTimeout);
+  EXPECT_LT(absl::Now() - real_start, absl::Minutes(1));
+}
+
+TEST_F(VirtualTimeTest, ClockStopsAtEachDeadline) {
+  absl::Time start = clock_->Now();
+  absl::Mutex mutex;
+  std::vector<absl::Duration> jumps;
+  clock_->AddObserver("test", [&]() {
+    absl::MutexLock lock(&mutex);
+    jumps.push_back(clock_->Now() - start);
+  });
+  virtual_time_.AddDeadline(start + absl::Seconds(20));
+  virtual_time_.AddDeadline(start + absl::Seconds(10));
+
+  virtual_time_.SleepUntil(start + absl::Seconds(30));
+
+  absl::MutexLock lock(&mutex);
+  EXPECT_EQ(jumps, (std::vector<absl::Duration>{
+                       absl::Seconds(10), absl::Seconds(20), absl::Seconds(30)}));
+  clock_->RemoveObserver("test");
+}
+
+TEST_F(VirtualTimeTest, QueuedTaskKeepsClockStill) {
+  absl::Time start = clock_->Now();
+  virtual_time_.TaskQueued();
+  std::thread task([this]() {
+    VirtualTime::TaskScope scope(virtual_time_);
+    absl::SleepFor(absl::Milliseconds(50));
+  });
+  // The clock can only move once the task is done.
+  virtual_time_.SleepUntil(start + kLongTimeout);
+  task.join();
+
+  EXPECT_EQ(clock_->Now(), start + kLongTimeout);
+}
+
+TEST_F(VirtualTimeTest, NotifiedWaiterWakesBeforeDeadline) {
+  absl::Time start = clock_->Now();
+  absl::Mutex mutex;
+  absl::CondVar cond;
+  bool waiting = false;
+  bool done = false;
+  bool timed_out = true;
+  virtual_time_.TaskQueued();
+  std::thread task([&]() {
+    VirtualTime::TaskScope scope(virtual_time_);
+    absl::MutexLock lock(&mutex);
+    waiting = true;
+    while (!done) {
+      timed_out =
+          virtual_time_.WaitWithDeadline(&mutex, &cond, start + kLongTimeout);
+      if (timed_out) break;
+    }
+  });
+  {
+    absl::MutexLock lock(&mutex);
+    mutex.Await(absl::Condition(&waiting));
+    done = true;
+    virtual_time_.Notify(&cond);
+    cond.SignalAll();
+  }
+  task.join();
+
+  EXPECT_FALSE(timed_out);
+  // This thread never waited, so the clock never moved.
+  EXPECT_EQ(clock_->Now(), start);
+}
+
+TEST_F(VirtualTimeTest, NotifyRacingPollTimeoutWakesWaiter) {
+  absl::Time start = clock_->Now();
+  absl::Mutex mutex;
+  absl::CondVar cond;
+  bool waiting = false;
+  bool done = false;
+  bool timed_out = true;
+  virtual_time_.TaskQueued();
+  std::thread task([&]() {
+    VirtualTime::TaskScope scope(virtual_time_);
+    absl::MutexLock lock(&mutex);
+    waiting = true;
+    while (!done) {
+      timed_out =
+          virtual_time_.WaitWithDeadline(&mutex, &cond, start + kLongTimeout);
+      if (timed_out) break;
+    }
+  });
+  {
+    absl::MutexLock lock(&mutex);
+    mutex.Await(absl::Condition(&waiting));
+    done = true;
+    // The signal is never seen, as when it lands just before a poll times out.
+    virtual_time_.Notify(&cond);
+  }
+  task.join();
+
+  EXPECT_FALSE(timed_out);
+  EXPECT_EQ(clock_->Now(), start);
+}
+
+TEST_F(VirtualTimeTest, ShutdownTimesOutWaits) {
+  virtual_time_.Shutdown();
+  absl::Mutex mutex;
+  absl::CondVar cond;
+
+  absl::MutexLock lock(&mutex);
+  EXPECT_TRUE(virtual_time_.WaitWithDeadline(&mutex, &cond,
+                                             clock_->Now() + kLongTimeout));
+}
+
+}  // namespace
+}  // namespace nearby
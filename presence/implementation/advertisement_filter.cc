@@ -14,9 +14,14 @@
 
 #include "presence/implementation/advertisement_filter.h"
 
-#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
 #include <vector>
 
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/variant.h"
 #include "internal/platform/logging.h"
 #include "presence/data_element.h"
@@ -25,96 +30,137 @@
 
 namespace nearby {
 namespace presence {
+namespace {
+
+constexpr size_t kBitsPerWord = 64;
 
-bool Contains(const std::vector<DataElement>& data_elements,
-              const DataElement& data_element) {
-  return std::find(data_elements.begin(), data_elements.end(), data_element) !=
-         data_elements.end();
+// The extended properties of a scan filter, and its actions if it has any.
+struct FilterTerms {
+  const std::vector<DataElement>& extended_properties;
+  const std::vector<int>* actions;
+};
+
+FilterTerms GetTerms(
+    const absl::variant<PresenceScanFilter, LegacyPresenceScanFilter>&
+        filter) {
+  // NOLINT is used to suppress google3-legacy-absl-backport lints because the
+  // the suggestion is not compatible with Chrome
+  if (absl::holds_alternative<PresenceScanFilter>(filter)) {  // NOLINT
+    return {absl::get<PresenceScanFilter>(filter).extended_properties,  // NOLINT
+            nullptr};
+  }
+  const auto& legacy_filter =
+      absl::get<LegacyPresenceScanFilter>(filter);  // NOLINT
+  return {legacy_filter.extended_properties, &legacy_filter.actions};
 }
 
-bool ContainsAll(const std::vector<DataElement>& data_elements,
-                 const std::vector<DataElement>& extended_properties) {
-  for (const auto& filter_element : extended_properties) {
-    if (!Contains(data_elements, filter_element)) {
-      return false;
-    }
+// Returns the action carried by `data_element`, the way
+// `DataElement(ActionBit)` encodes it, or -1 if it isn't an action.
+int GetAction(const DataElement& data_element) {
+  if (data_element.GetType() != DataElement::kActionFieldType ||
+      data_element.GetValue().size() != 1) {
+    return -1;
   }
-  return true;
+  return static_cast<uint8_t>(data_element.GetValue()[0]);
 }
 
-bool ContainsAny(const std::vector<DataElement>& data_elements,
-                 const std::vector<int>& actions) {
-  if (actions.empty()) {
-    return true;
+}  // namespace
+
+AdvertisementFilter::AdvertisementFilter(const ScanRequest& scan_request)
+    : identity_types_(scan_request.identity_types.begin(),
+                      scan_request.identity_types.end()),
+      matches_all_(scan_request.scan_filters.empty()) {
+  // Number the distinct extended properties first, so that every filter gets
+  // a set of the same size.
+  size_t property_count = 0;
+  for (const auto& filter : scan_request.scan_filters) {
+    for (const DataElement& property : GetTerms(filter).extended_properties) {
+      auto [it, inserted] = property_ids_[property.GetType()].try_emplace(
+          std::string(property.GetValue()), property_count);
+      if (inserted) ++property_count;
+    }
   }
-  for (int action : actions) {
-    if (Contains(data_elements, DataElement(ActionBit(action)))) {
-      return true;
+  property_words_ = (property_count + kBitsPerWord - 1) / kBitsPerWord;
+
+  filters_.reserve(scan_request.scan_filters.size());
+  for (const auto& filter : scan_request.scan_filters) {
+    FilterTerms terms = GetTerms(filter);
+    CompiledFilter& compiled = filters_.emplace_back();
+    compiled.required_properties.resize(property_words_);
+    for (const DataElement& property : terms.extended_properties) {
+      size_t id = property_ids_[property.GetType()].find(property.GetValue())
+                      ->second;
+      compiled.required_properties[id / kBitsPerWord] |=
+          uint64_t{1} << (id % kBitsPerWord);
+    }
+    // A filter without actions matches advertisements with any action.
+    if (terms.actions != nullptr && !terms.actions->empty()) {
+      compiled.requires_action = true;
+      any_filter_requires_action_ = true;
+      for (int action : *terms.actions) {
+        compiled.actions.set(static_cast<uint8_t>(action));
+      }
+    } else if (terms.extended_properties.empty()) {
+      matches_all_ = true;
     }
   }
-  return false;
 }
 
 bool AdvertisementFilter::MatchesScanFilter(
-    const Advertisement& advertisement) {
+    const Advertisement& advertisement) const {
   // Verify the identity is one requested in the scan_request.
   // Per the Public API of scan_request, if identity_types provided in the
   // scan_request is empty then decode advertisements of every identity type
-  auto requested_identity_types = scan_request_.identity_types;
-  if (!requested_identity_types.empty() &&
-      !(std::find(
-            requested_identity_types.begin(), requested_identity_types.end(),
-            advertisement.identity_type) != requested_identity_types.end())) {
-    NEARBY_LOGS(INFO)
-        << "Skipping advertisement with identity type: "
-        << advertisement.identity_type
-        << " because that identity type was not requested in the scan "
-           "request";
+  if (!identity_types_.empty() &&
+      !identity_types_.contains(advertisement.identity_type)) {
+    NEARBY_VLOG(1) << "Skipping advertisement with identity type: "
+                   << advertisement.identity_type
+                   << " because that identity type was not requested in the "
+                      "scan request";
     return false;
   }
 
   // The advertisement matches the scan request when it matches at least
   // one of the filters in the request.
-  if (scan_request_.scan_filters.empty()) {
+  if (matches_all_) {
     return true;
   }
 
-  // NOLINT is used to suppress google3-legacy-absl-backport lints because the
-  // the suggestion is not compatible with Chrome
-  for (const auto& filter : scan_request_.scan_filters) {
-    if (absl::holds_alternative<PresenceScanFilter>(filter)) {  // NOLINT
-      if (MatchesScanFilter(advertisement.data_elements,
-                            absl::get<PresenceScanFilter>(filter))) {  // NOLINT
-        return true;
-      }
-    } else if (absl::holds_alternative<LegacyPresenceScanFilter>(  // NOLINT
-                   filter)) {
-      if (MatchesScanFilter(
-              advertisement.data_elements,
-              absl::get<LegacyPresenceScanFilter>(filter))) {  // NOLINT
-        return true;
+  ActionMask actions;
+  absl::InlinedVector<uint64_t, 2> properties(property_words_);
+  for (const DataElement& data_element : advertisement.data_elements) {
+    if (any_filter_requires_action_) {
+      int action = GetAction(data_element);
+      if (action >= 0) actions.set(action);
+    }
+    auto type_it = property_ids_.find(data_element.GetType());
+    if (type_it == property_ids_.end()) continue;
+    auto it = type_it->second.find(data_element.GetValue());
+    if (it == type_it->second.end()) continue;
+    properties[it->second / kBitsPerWord] |= uint64_t{1}
+                                             << (it->second % kBitsPerWord);
+  }
+
+  for (const CompiledFilter& filter : filters_) {
+    // The advertisement must:
+    // * contain any Action from the filter,
+    // * contain all Data Elements in the filter.
+    if (filter.requires_action && (filter.actions & actions).none()) {
+      continue;
+    }
+    bool has_all_properties = true;
+    for (size_t i = 0; i < property_words_; ++i) {
+      if ((filter.required_properties[i] & ~properties[i]) != 0) {
+        has_all_properties = false;
+        break;
       }
     }
+    if (has_all_properties) {
+      return true;
+    }
   }
   return false;
 }
 
-bool AdvertisementFilter::MatchesScanFilter(
-    const std::vector<DataElement>& data_elements,
-    const PresenceScanFilter& filter) {
-  // The advertisement must contain all Data Elements in scan request.
-  return ContainsAll(data_elements, filter.extended_properties);
-}
-
-bool AdvertisementFilter::MatchesScanFilter(
-    const std::vector<DataElement>& data_elements,
-    const LegacyPresenceScanFilter& filter) {
-  // The advertisement must:
-  // * contain any Action from scan request,
-  // * contain all Data Elements in scan request.
-  return ContainsAny(data_elements, filter.actions) &&
-         ContainsAll(data_elements, filter.extended_properties);
-}
-
 }  // namespace presence
 }  // namespace nearby
@@ -15,29 +15,60 @@
 #ifndef THIRD_PARTY_NEARBY_PRESENCE_IMPLEMENTATION_ADVERTISEMENT_FILTER_H_
 #define THIRD_PARTY_NEARBY_PRESENCE_IMPLEMENTATION_ADVERTISEMENT_FILTER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bitset>
+#include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "internal/proto/credential.pb.h"
 #include "presence/data_element.h"
 #include "presence/implementation/advertisement_decoder.h"
 #include "presence/scan_request.h"
 
 namespace nearby {
 namespace presence {
+
+// Matches decoded advertisements against the filters of a scan request.
+//
+// The scan request is compiled once, when the filter is created: the actions
+// of each filter are folded into a bitmask, and every distinct extended
+// property gets a bit in a set of required properties. Matching an
+// advertisement then takes one hash lookup per data element, plus a few word
+// operations per filter.
 class AdvertisementFilter {
  public:
-  explicit AdvertisementFilter(ScanRequest scan_request)
-      : scan_request_(scan_request) {}
+  explicit AdvertisementFilter(const ScanRequest& scan_request);
 
   // Returns true if the decoded advertisement in `data_elements` matches the
   // filters in `scan_request`.
-  bool MatchesScanFilter(const Advertisement& adv);
+  bool MatchesScanFilter(const Advertisement& adv) const;
 
  private:
-  bool MatchesScanFilter(const std::vector<DataElement>& data_elements,
-                         const PresenceScanFilter& filter);
-  bool MatchesScanFilter(const std::vector<DataElement>& data_elements,
-                         const LegacyPresenceScanFilter& filter);
-  ScanRequest scan_request_;
+  // Action data elements carry a single byte.
+  using ActionMask = std::bitset<256>;
+
+  struct CompiledFilter {
+    // Whether the advertisement must contain one of `actions`.
+    bool requires_action = false;
+    ActionMask actions;
+    // One bit per property in `property_ids_`.
+    std::vector<uint64_t> required_properties;
+  };
+
+  absl::flat_hash_set<internal::IdentityType> identity_types_;
+  // Whether the request has no filter, or one that matches every
+  // advertisement.
+  bool matches_all_ = false;
+  bool any_filter_requires_action_ = false;
+  // Bit of each extended property by data element type and value.
+  absl::flat_hash_map<uint16_t, absl::flat_hash_map<std::string, size_t>>
+      property_ids_;
+  size_t property_words_ = 0;
+  std::vector<CompiledFilter> filters_;
 };
 
 }  // namespace presence
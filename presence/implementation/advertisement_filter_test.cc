@@ -14,7 +14,9 @@
 
 #include "presence/implementation/advertisement_filter.h"
 
+#include <algorithm>
 #include <array>
+#include <random>
 #include <string>
 #include <vector>
 
@@ -24,6 +26,7 @@
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/variant.h"
 #include "internal/platform/byte_array.h"
 #include "internal/proto/credential.pb.h"
 #include "presence/data_element.h"
@@ -35,6 +38,150 @@ namespace nearby {
 namespace presence {
 namespace {
 
+// The matcher that scanned the filters for every advertisement, kept as a
+// reference for the compiled one.
+bool Contains(const std::vector<DataElement>& data_elements,
+              const DataElement& data_element) {
+  return std::find(data_elements.begin(), data_elements.end(), data_element) !=
+         data_elements.end();
+}
+
+bool ContainsAll(const std::vector<DataElement>& data_elements,
+                 const std::vector<DataElement>& extended_properties) {
+  for (const auto& filter_element : extended_properties) {
+    if (!Contains(data_elements, filter_element)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ContainsAny(const std::vector<DataElement>& data_elements,
+                 const std::vector<int>& actions) {
+  if (actions.empty()) {
+    return true;
+  }
+  for (int action : actions) {
+    if (Contains(data_elements, DataElement(ActionBit(action)))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReferenceMatchesScanFilter(const ScanRequest& scan_request,
+                                const Advertisement& advertisement) {
+  const auto& identity_types = scan_request.identity_types;
+  if (!identity_types.empty() &&
+      std::find(identity_types.begin(), identity_types.end(),
+                advertisement.identity_type) == identity_types.end()) {
+    return false;
+  }
+  if (scan_request.scan_filters.empty()) {
+    return true;
+  }
+  for (const auto& filter : scan_request.scan_filters) {
+    if (absl::holds_alternative<PresenceScanFilter>(filter)) {  // NOLINT
+      if (ContainsAll(advertisement.data_elements,
+                      absl::get<PresenceScanFilter>(filter)  // NOLINT
+                          .extended_properties)) {
+        return true;
+      }
+    } else {
+      const auto& legacy_filter =
+          absl::get<LegacyPresenceScanFilter>(filter);  // NOLINT
+      if (ContainsAny(advertisement.data_elements, legacy_filter.actions) &&
+          ContainsAll(advertisement.data_elements,
+                      legacy_filter.extended_properties)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Generates scan requests and advertisements from a small set of data
+// elements, so that random advertisements often match random filters.
+class RandomScanGenerator {
+ public:
+  explicit RandomScanGenerator(unsigned seed) : random_(seed) {}
+
+  DataElement NextDataElement() {
+    switch (Uniform(3)) {
+      case 0:
+        return DataElement(ActionBit(NextAction()));
+      case 1:
+        return DataElement(DataElement::kActionFieldType,
+                           std::string(Uniform(3), 'a' + Uniform(2)));
+      default:
+        return DataElement(
+            kPropertyTypes[Uniform(std::size(kPropertyTypes))],
+            std::string(1 + Uniform(2), 'a' + Uniform(3)));
+    }
+  }
+
+  std::vector<DataElement> NextDataElements(int max_count) {
+    std::vector<DataElement> data_elements;
+    for (int i = Uniform(max_count + 1); i > 0; --i) {
+      data_elements.push_back(NextDataElement());
+    }
+    return data_elements;
+  }
+
+  ScanRequest NextScanRequest(int max_filters, int max_properties) {
+    ScanRequest scan_request;
+    for (int i = Uniform(3); i > 0; --i) {
+      scan_request.identity_types.push_back(NextIdentityType());
+    }
+    for (int i = Uniform(max_filters + 1); i > 0; --i) {
+      scan_request.scan_filters.push_back(NextScanFilter(max_properties));
+    }
+    return scan_request;
+  }
+
+  absl::variant<PresenceScanFilter, LegacyPresenceScanFilter> NextScanFilter(
+      int max_properties) {
+    if (Uniform(2) == 0) {
+      return PresenceScanFilter{
+          .extended_properties = NextDataElements(max_properties)};
+    }
+    LegacyPresenceScanFilter filter = {
+        .extended_properties = NextDataElements(max_properties)};
+    for (int i = Uniform(4); i > 0; --i) {
+      filter.actions.push_back(NextAction());
+    }
+    return filter;
+  }
+
+  Advertisement NextAdvertisement(int max_data_elements) {
+    return {.data_elements = NextDataElements(max_data_elements),
+            .identity_type = NextIdentityType()};
+  }
+
+ private:
+  static constexpr uint16_t kPropertyTypes[] = {
+      DataElement::kSaltFieldType, DataElement::kModelIdFieldType,
+      DataElement::kContextTimestampFieldType};
+
+  int Uniform(int n) {
+    return std::uniform_int_distribution<>(0, n - 1)(random_);
+  }
+
+  // Mostly reserved actions, and some that only match after truncation to a
+  // byte.
+  int NextAction() {
+    int action = 4 + Uniform(12);
+    return Uniform(8) == 0 ? action + 256 * (Uniform(3) - 1) : action;
+  }
+
+  internal::IdentityType NextIdentityType() {
+    return static_cast<internal::IdentityType>(Uniform(4));
+  }
+
+  std::mt19937 random_;
+};
+
+
 TEST(AdvertisementFilter, MatchesScanFilterNoFilterPasses) {
   std::vector<DataElement> adv = {
       DataElement(DataElement::kPrivateGroupIdentityFieldType, "payload")};
@@ -169,6 +316,76 @@ TEST(AdvertisementFilter, MatchesMultipleFilters) {
   EXPECT_FALSE(adv_filter.MatchesScanFilter({.data_elements = {ttt_action}}));
 }
 
+TEST(AdvertisementFilter, MatchesLikeReferenceMatcher) {
+  RandomScanGenerator generator(/*seed=*/1234);
+  int matches = 0;
+  for (int i = 0; i < 500; ++i) {
+    ScanRequest scan_request =
+        generator.NextScanRequest(/*max_filters=*/4, /*max_properties=*/3);
+    AdvertisementFilter adv_filter(scan_request);
+    for (int j = 0; j < 40; ++j) {
+      Advertisement advertisement =
+          generator.NextAdvertisement(/*max_data_elements=*/8);
+      bool expected = ReferenceMatchesScanFilter(scan_request, advertisement);
+      ASSERT_EQ(adv_filter.MatchesScanFilter(advertisement), expected)
+          << "scan request " << i << ", advertisement " << j;
+      if (expected) ++matches;
+    }
+  }
+  // Both outcomes are covered.
+  EXPECT_GT(matches, 1000);
+  EXPECT_LT(matches, 19000);
+}
+
+// A scan request that looks for many devices, where most advertisements
+// around belong to other devices, matches like the reference.
+TEST(AdvertisementFilter, ManyFiltersMatchLikeReference) {
+  constexpr int kNumFilters = 64;
+  constexpr int kNumAdvertisements = 1000;
+  ScanRequest scan_request;
+  for (int i = 0; i < kNumFilters; ++i) {
+    std::vector<DataElement> extended_properties = {
+        DataElement(DataElement::kModelIdFieldType, absl::StrCat("model ", i)),
+        DataElement(DataElement::kContextTimestampFieldType,
+                    std::string(1, '0' + i % 4))};
+    if (i % 2 == 0) {
+      scan_request.scan_filters.push_back(
+          PresenceScanFilter{.extended_properties = extended_properties});
+    } else {
+      scan_request.scan_filters.push_back(LegacyPresenceScanFilter{
+          .actions = {static_cast<int>(ActionBit::kActiveUnlockAction),
+                      static_cast<int>(ActionBit::kPhoneHubAction)},
+          .extended_properties = extended_properties});
+    }
+  }
+  std::vector<Advertisement> advertisements;
+  for (int i = 0; i < kNumAdvertisements; ++i) {
+    advertisements.push_back({.data_elements = {
+                                  DataElement(DataElement::kSaltFieldType,
+                                              absl::StrCat("salt ", i)),
+                                  DataElement(ActionBit::kNearbyShareAction),
+                                  DataElement(ActionBit::kPhoneHubAction),
+                                  DataElement(DataElement::kTxPowerFieldType,
+                                              std::string(1, '\x10')),
+                                  DataElement(DataElement::kModelIdFieldType,
+                                              absl::StrCat("model ", i % 256)),
+                                  DataElement(
+                                      DataElement::kContextTimestampFieldType,
+                                      std::string(1, '0' + i % 3)),
+                              }});
+  }
+  AdvertisementFilter adv_filter(scan_request);
+
+  int matches = 0;
+  for (int i = 0; i < kNumAdvertisements; ++i) {
+    bool expected = ReferenceMatchesScanFilter(scan_request, advertisements[i]);
+    ASSERT_EQ(adv_filter.MatchesScanFilter(advertisements[i]), expected)
+        << "advertisement " << i;
+    if (expected) ++matches;
+  }
+  EXPECT_GT(matches, 0);
+}
+
 }  // namespace
 }  // namespace presence
 }  // namespace nearby
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
 #include <utility>
@@ -35,6 +36,7 @@
 #include "presence/implementation/advertisement_factory.h"
 #include "presence/implementation/base_broadcast_request.h"
 #include "presence/implementation/mediums/advertisement_data.h"
+#include "presence/implementation/salt_bitmap.h"
 
 namespace nearby {
 namespace presence {
@@ -59,27 +61,20 @@ std::string SaltFromInt(uint16_t x) {
   return salt;
 }
 
-// Selects a salt that has not been used yet. The salt is added to
-// `credential.consumed_salts`.
-// We may fail to find an unused salt. In this unlikely event, an already
-// consumed salt is returned.
+// Selects a salt that has not been used yet. The salt is added to the
+// consumed salts of `credential`.
+// If every salt was consumed already, `preferred_salt` is returned.
 std::string SelectSalt(LocalCredential& credential,
                        absl::string_view preferred_salt) {
-  // NP certificate guidelines say that we should try to get an unused salt 128
-  // times.
-  constexpr int kMaxSaltSelectRetries = 128;
-
-  uint16_t s = SaltToInt(preferred_salt);
-  for (int i = 0; i < kMaxSaltSelectRetries; i++) {
-    if (!credential.consumed_salts().contains(s)) {
-      break;
-    }
-    s = nearby::RandData<uint16_t>();
-  }
-  credential.mutable_consumed_salts()->insert({s, true});
+  SaltBitmap consumed_salts = SaltBitmap::FromCredential(credential);
+  uint16_t s = consumed_salts.SelectUnused(SaltToInt(preferred_salt));
+  consumed_salts.Consume(s);
+  consumed_salts.WriteTo(credential);
   return SaltFromInt(s);
 }
 
+std::string RandomSalt() { return SaltFromInt(nearby::RandData<uint16_t>()); }
+
 }  // namespace
 
 absl::StatusOr<BroadcastSessionId> BroadcastManager::StartBroadcast(
@@ -139,16 +134,7 @@ void BroadcastManager::FetchCredentials(
                           absl::optional<LocalCredential> credential =
                               Advertise(id, broadcast_request, credentials);
                           if (credential) {
-                            credential_manager_->UpdateLocalCredential(
-                                selector, std::move(*credential),
-                                {[](absl::Status status) {
-                                  if (!status.ok()) {
-                                    NEARBY_LOGS(WARNING)
-                                        << "Failed to update private "
-                                           "credential, status: "
-                                        << status;
-                                  }
-                                }});
+                            SaveCredential(selector, std::move(*credential));
                           }
                         });
               }});
@@ -169,6 +155,7 @@ absl::optional<LocalCredential> BroadcastManager::SelectCredential(  // NOLINT
     NEARBY_LOGS(WARNING) << "No active credentials";
     return absl::optional<LocalCredential>();  // NOLINT
   }
+  MergeConsumedSalts(*credential);
   std::string salt = SelectSalt(*credential, broadcast_request.salt);
   if (salt != broadcast_request.salt) {
     NEARBY_VLOG(1) << "Changed salt";
@@ -195,20 +182,171 @@ absl::optional<LocalCredential> BroadcastManager::Advertise(  // NOLINT
     NotifyStartCallbackStatus(id, advertisement.status());
     return absl::optional<LocalCredential>();  // NOLINT
   }
-  std::unique_ptr<AdvertisingSession> session =
+  if (!StartAdvertising(id, it->second, *advertisement)) {
+    return absl::optional<LocalCredential>();  // NOLINT
+  }
+  it->second.SetBroadcast(std::move(broadcast_request), std::move(credential));
+  ScheduleRotation(id, it->second);
+  PrecomputeAdvertisements(id, it->second);
+  return it->second.GetCredential();
+}
+
+bool BroadcastManager::StartAdvertising(
+    BroadcastSessionId id, BroadcastSessionState& session,
+    const AdvertisementData& advertisement) {
+  session.StopAdvertising();
+  std::unique_ptr<AdvertisingSession> advertising_session =
       mediums_->GetBle().StartAdvertising(
-          *advertisement, it->second.GetPowerMode(),
+          advertisement, session.GetPowerMode(),
           AdvertisingCallback{
               .start_advertising_result = [this, id](absl::Status status) {
                 NotifyStartCallbackStatus(id, status);
               }});
-  if (!session) {
+  if (!advertising_session) {
     NotifyStartCallbackStatus(id,
                               absl::InternalError("Can't start advertising"));
-    return absl::optional<LocalCredential>();  // NOLINT
+    return false;
   }
-  it->second.SetAdvertisingSession(std::move(session));
-  return credential;
+  session.SetAdvertisingSession(std::move(advertising_session));
+  return true;
+}
+
+void BroadcastManager::RotateBroadcast(BroadcastSessionId id) {
+  RunOnServiceControllerThread(
+      "rotate-broadcast",
+      [this, id]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(executor_) {
+        auto it = sessions_.find(id);
+        if (it == sessions_.end() || !it->second.GetRequest()) {
+          NEARBY_VLOG(1) << absl::StrFormat(
+              "BroadcastSession(0x%x) not advertising", id);
+          return;
+        }
+        BroadcastSessionState& session = it->second;
+        std::deque<AdvertisementData>& precomputed =
+            session.GetPrecomputedAdvertisements();
+        absl::StatusOr<AdvertisementData> advertisement;
+        if (!precomputed.empty()) {
+          advertisement = std::move(precomputed.front());
+          precomputed.pop_front();
+        } else {
+          BaseBroadcastRequest request = *session.GetRequest();
+          absl::optional<LocalCredential>& credential =  // NOLINT
+              session.GetCredential();
+          if (credential) {
+            MergeConsumedSalts(*credential);
+            request.salt = SelectSalt(*credential, RandomSalt());
+          } else {
+            request.salt = RandomSalt();
+          }
+          advertisement =
+              AdvertisementFactory().CreateAdvertisement(request, credential);
+        }
+        if (!advertisement.ok()) {
+          NEARBY_LOGS(WARNING) << "Can't create advertisement, reason: "
+                               << advertisement.status();
+          return;
+        }
+        if (!StartAdvertising(id, session, *advertisement)) {
+          return;
+        }
+        ScheduleRotation(id, session);
+        PrecomputeAdvertisements(id, session);
+        if (session.GetCredential()) {
+          absl::StatusOr<CredentialSelector> selector =
+              AdvertisementFactory::GetCredentialSelector(
+                  *session.GetRequest());
+          if (selector.ok()) {
+            SaveCredential(*selector, *session.GetCredential());
+          }
+        }
+      });
+}
+
+void BroadcastManager::ScheduleRotation(BroadcastSessionId id,
+                                        BroadcastSessionState& session) {
+  if (!rotation_executor_) {
+    return;
+  }
+  session.CancelRotation();
+  session.SetRotation(rotation_executor_->Schedule(
+      [this, id]() { RotateBroadcast(id); }, rotation_interval_));
+}
+
+void BroadcastManager::PrecomputeAdvertisements(
+    BroadcastSessionId id, BroadcastSessionState& session) {
+  std::deque<AdvertisementData>& precomputed =
+      session.GetPrecomputedAdvertisements();
+  absl::optional<LocalCredential>& credential =  // NOLINT
+      session.GetCredential();
+  // Public advertisements aren't encrypted, so there is nothing to save.
+  if (!precompute_executor_ || !credential || session.IsPrecomputing() ||
+      precomputed.size() >= precomputed_advertisements_) {
+    return;
+  }
+  // The salts are consumed now, so that they can't be picked again while the
+  // advertisements are encrypted.
+  MergeConsumedSalts(*credential);
+  SaltBitmap consumed_salts = SaltBitmap::FromCredential(*credential);
+  std::vector<BaseBroadcastRequest> requests;
+  for (size_t i = precomputed.size(); i < precomputed_advertisements_; ++i) {
+    BaseBroadcastRequest& request =
+        requests.emplace_back(*session.GetRequest());
+    uint16_t salt = consumed_salts.SelectUnused(nearby::RandData<uint16_t>());
+    consumed_salts.Consume(salt);
+    request.salt = SaltFromInt(salt);
+  }
+  consumed_salts.WriteTo(*credential);
+  session.SetPrecomputing(true);
+  precompute_executor_->Execute(
+      "precompute-advertisements",
+      [this, id, requests = std::move(requests),
+       credential = *credential]() mutable {
+        std::vector<AdvertisementData> advertisements;
+        for (const BaseBroadcastRequest& request : requests) {
+          absl::StatusOr<AdvertisementData> advertisement =
+              AdvertisementFactory().CreateAdvertisement(request, credential);
+          if (!advertisement.ok()) {
+            NEARBY_LOGS(WARNING) << "Can't precompute advertisement, reason: "
+                                 << advertisement.status();
+            continue;
+          }
+          advertisements.push_back(std::move(*advertisement));
+        }
+        RunOnServiceControllerThread(
+            "precomputed-advertisements",
+            [this, id, advertisements = std::move(advertisements)]()
+                ABSL_EXCLUSIVE_LOCKS_REQUIRED(executor_) mutable {
+                  auto it = sessions_.find(id);
+                  if (it == sessions_.end()) {
+                    return;
+                  }
+                  it->second.SetPrecomputing(false);
+                  for (AdvertisementData& advertisement : advertisements) {
+                    it->second.GetPrecomputedAdvertisements().push_back(
+                        std::move(advertisement));
+                  }
+                });
+      });
+}
+
+void BroadcastManager::MergeConsumedSalts(LocalCredential& credential) {
+  SaltBitmap& consumed_salts = consumed_salts_[credential.id()];
+  consumed_salts.Merge(SaltBitmap::FromCredential(credential));
+  consumed_salts.WriteTo(credential);
+}
+
+void BroadcastManager::SaveCredential(const CredentialSelector& selector,
+                                      LocalCredential credential) {
+  // The credential of the session may miss salts consumed by other sessions
+  // since it was fetched. Don't overwrite them.
+  MergeConsumedSalts(credential);
+  credential_manager_->UpdateLocalCredential(
+      selector, std::move(credential), {[](absl::Status status) {
+        if (!status.ok()) {
+          NEARBY_LOGS(WARNING)
+              << "Failed to update private credential, status: " << status;
+        }
+      }});
 }
 
 void BroadcastManager::NotifyStartCallbackStatus(BroadcastSessionId id,
@@ -223,6 +361,7 @@ void BroadcastManager::NotifyStartCallbackStatus(BroadcastSessionId id,
                                      it->second.CallStartedCallback(status);
                                      if (!status.ok()) {
                                        // Delete failed session.
+                                       it->second.CancelRotation();
                                        sessions_.erase(it);
                                      }
                                    });
@@ -237,6 +376,7 @@ void BroadcastManager::StopBroadcast(BroadcastSessionId id) {
                                             id);
           return;
         }
+        it->second.CancelRotation();
         it->second.StopAdvertising();
         sessions_.erase(it);
       });
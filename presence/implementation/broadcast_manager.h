@@ -15,6 +15,10 @@
 #ifndef THIRD_PARTY_NEARBY_PRESENCE_IMPLEMENTATION_BROADCAST_MANAGER_H_
 #define THIRD_PARTY_NEARBY_PRESENCE_IMPLEMENTATION_BROADCAST_MANAGER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
 #include <memory>
 #include <string>
 #include <utility>
@@ -25,15 +29,20 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
+#include "internal/platform/cancelable.h"
 #include "internal/platform/implementation/ble_v2.h"
 #include "internal/platform/runnable.h"
+#include "internal/platform/scheduled_executor.h"
 #include "internal/platform/single_thread_executor.h"
 #include "presence/broadcast_request.h"
 #include "presence/data_types.h"
 #include "presence/implementation/base_broadcast_request.h"
 #include "presence/implementation/credential_manager.h"
+#include "presence/implementation/mediums/advertisement_data.h"
 #include "presence/implementation/mediums/mediums.h"
+#include "presence/implementation/salt_bitmap.h"
 #include "presence/power_mode.h"
 
 namespace nearby {
@@ -49,20 +58,39 @@ class BroadcastManager {
       ::nearby::api::ble_v2::BleMedium::AdvertisingSession;
   using Runnable = ::nearby::Runnable;
   using LocalCredential = internal::LocalCredential;
+  // When `rotation_interval` is finite, every broadcast rotates its salt that
+  // often.
+  // When `precomputed_advertisements` is positive, that many advertisements
+  // with fresh salts are encrypted ahead of time for every broadcast that
+  // uses a credential, so that rotating its salt doesn't wait for encryption.
   BroadcastManager(Mediums& mediums, CredentialManager& credential_manager,
-                   SingleThreadExecutor& executor) {
+                   SingleThreadExecutor& executor,
+                   size_t precomputed_advertisements = 0,
+                   absl::Duration rotation_interval = absl::InfiniteDuration()) {
     mediums_ = &mediums, credential_manager_ = &credential_manager,
     executor_ = &executor;
+    precomputed_advertisements_ = precomputed_advertisements;
+    rotation_interval_ = rotation_interval;
+    if (precomputed_advertisements_ > 0) {
+      precompute_executor_ = std::make_unique<SingleThreadExecutor>();
+    }
+    if (rotation_interval_ != absl::InfiniteDuration()) {
+      rotation_executor_ = std::make_unique<ScheduledExecutor>();
+    }
   }
   ~BroadcastManager() = default;
   absl::StatusOr<BroadcastSessionId> StartBroadcast(
       BroadcastRequest broadcast_request, BroadcastCallback callback);
   void StopBroadcast(BroadcastSessionId);
+  // Restarts the broadcast with a new salt.
+  void RotateBroadcast(BroadcastSessionId id);
 
  private:
   Mediums* mediums_;
   CredentialManager* credential_manager_;
   SingleThreadExecutor* executor_;
+  size_t precomputed_advertisements_;
+  absl::Duration rotation_interval_;
   class BroadcastSessionState {
    public:
     explicit BroadcastSessionState(BroadcastCallback broadcast_callback,
@@ -73,13 +101,42 @@ class BroadcastManager {
     void SetAdvertisingSession(std::unique_ptr<AdvertisingSession> session);
     void CallStartedCallback(absl::Status status);
     void StopAdvertising();
+    void SetRotation(Cancelable rotation) { rotation_ = std::move(rotation); }
+    void CancelRotation() { rotation_.Cancel(); }
 
     PowerMode GetPowerMode() { return power_mode_; }
 
+    // The request and credential of the current advertisement, for rotations.
+    // The credential, if any, has all the salts used by this session.
+    void SetBroadcast(BaseBroadcastRequest request,
+                      absl::optional<LocalCredential> credential) {  // NOLINT
+      request_ = std::move(request);
+      credential_ = std::move(credential);
+    }
+    absl::optional<BaseBroadcastRequest>& GetRequest() {  // NOLINT
+      return request_;
+    }
+    absl::optional<LocalCredential>& GetCredential() {  // NOLINT
+      return credential_;
+    }
+
+    std::deque<AdvertisementData>& GetPrecomputedAdvertisements() {
+      return precomputed_advertisements_;
+    }
+    bool IsPrecomputing() const { return is_precomputing_; }
+    void SetPrecomputing(bool is_precomputing) {
+      is_precomputing_ = is_precomputing;
+    }
+
    private:
     BroadcastCallback broadcast_callback_;
     PowerMode power_mode_;
     std::unique_ptr<AdvertisingSession> advertising_session_;
+    absl::optional<BaseBroadcastRequest> request_;  // NOLINT
+    absl::optional<LocalCredential> credential_;    // NOLINT
+    std::deque<AdvertisementData> precomputed_advertisements_;
+    bool is_precomputing_ = false;
+    Cancelable rotation_;
   };
   BroadcastSessionId GenerateBroadcastSessionId();
   void NotifyStartCallbackStatus(BroadcastSessionId id, absl::Status status);
@@ -91,7 +148,8 @@ class BroadcastManager {
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(*executor_);
   absl::optional<LocalCredential> SelectCredential( //NOLINT
       BaseBroadcastRequest& broadcast_request,
-      std::vector<LocalCredential> credentials);
+      std::vector<LocalCredential> credentials)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(*executor_);
 
   // Returns the private credential, if any, selected to generate the
   // advertisement. A salt used in the advertisement is added to the returned
@@ -100,8 +158,37 @@ class BroadcastManager {
       BroadcastSessionId id, BaseBroadcastRequest broadcast_request,
       std::vector<LocalCredential> credentials)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(*executor_);
+  // Starts advertising `advertisement` in place of the current advertisement
+  // of the session, if any.
+  bool StartAdvertising(BroadcastSessionId id, BroadcastSessionState& session,
+                        const AdvertisementData& advertisement)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(*executor_);
+  // Schedules the next salt rotation of the session, if rotations are enabled.
+  void ScheduleRotation(BroadcastSessionId id, BroadcastSessionState& session)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(*executor_);
+  // Reserves salts for the missing precomputed advertisements of the session,
+  // and encrypts the advertisements on `precompute_executor_`.
+  void PrecomputeAdvertisements(BroadcastSessionId id,
+                                BroadcastSessionState& session)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(*executor_);
+  // Merges the salts consumed by `credential` with the salts consumed by every
+  // session using the same credential, and stores the union in both. Sessions
+  // keep their own copy of the credential, so this keeps them from selecting
+  // or overwriting each other's salts.
+  void MergeConsumedSalts(LocalCredential& credential)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(*executor_);
+  void SaveCredential(const CredentialSelector& selector,
+                      LocalCredential credential)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(*executor_);
   absl::flat_hash_map<BroadcastSessionId, BroadcastSessionState> sessions_
       ABSL_GUARDED_BY(*executor_);
+  // The salts consumed by this manager, by credential id.
+  absl::flat_hash_map<int64_t, SaltBitmap> consumed_salts_
+      ABSL_GUARDED_BY(*executor_);
+  // Declared last, so that pending precomputations and rotations finish before
+  // the sessions are destroyed.
+  std::unique_ptr<SingleThreadExecutor> precompute_executor_;
+  std::unique_ptr<ScheduledExecutor> rotation_executor_;
 };
 
 }  // namespace presence
@@ -16,17 +16,23 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "protobuf-matchers/protocol-buffer-matchers.h"
 #include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "internal/platform/count_down_latch.h"
 #include "internal/platform/feature_flags.h"
 #include "internal/platform/future.h"
+#include "internal/platform/logging.h"
 #include "internal/platform/medium_environment.h"
 #include "internal/proto/credential.pb.h"
+#include "internal/proto/local_credential.pb.h"
 #include "presence/implementation/credential_manager_impl.h"
 #include "presence/implementation/mediums/mediums.h"
+#include "presence/implementation/salt_bitmap.h"
 
 namespace nearby {
 namespace presence {
@@ -34,6 +40,7 @@ namespace {
 
 using FeatureFlags = ::nearby::FeatureFlags::Flags;
 using internal::IdentityType;
+using internal::LocalCredential;
 using ::nearby::CountDownLatch;
 using ::nearby::MediumEnvironment;
 using ::testing::status::StatusIs;
@@ -43,20 +50,35 @@ constexpr FeatureFlags kTestCases[] = {
 };
 
 constexpr absl::string_view kAccountName = "Test account";
+constexpr absl::string_view kManagerAppId = "TEST_MANAGER_APP";
 constexpr int8_t kTxPower = 30;
+constexpr int kNumCredentials = 6;
 
-BroadcastRequest CreateBroadcastRequest(IdentityType identity) {
+BroadcastRequest CreateBroadcastRequest(IdentityType identity,
+                                        absl::string_view account_name) {
   PresenceBroadcast::BroadcastSection section = {
       .identity = identity,
       .extended_properties = {DataElement(
           DataElement(ActionBit::kActiveUnlockAction))},
-      .account_name = std::string(kAccountName)};
+      .account_name = std::string(account_name),
+      .manager_app_id = std::string(kManagerAppId)};
   PresenceBroadcast presence_request = {.sections = {section}};
   BroadcastRequest request = {.tx_power = kTxPower,
                               .variant = presence_request};
   return request;
 }
 
+BroadcastRequest CreateBroadcastRequest(IdentityType identity) {
+  return CreateBroadcastRequest(identity, kAccountName);
+}
+
+// Matches the credentials generated by `GenerateLocalCredentials()`, which
+// have no account name.
+CredentialSelector GetLocalCredentialSelector() {
+  return {.manager_app_id = std::string(kManagerAppId),
+          .identity_type = internal::IDENTITY_TYPE_PRIVATE_GROUP};
+}
+
 class MediumEnvironmentStarter {
  public:
   MediumEnvironmentStarter() { MediumEnvironment::Instance().Start(); }
@@ -89,6 +111,83 @@ class BroadcastManagerTest : public testing::TestWithParam<FeatureFlags> {
     latch.Await();
   }
 
+  void GenerateLocalCredentials() {
+    internal::DeviceIdentityMetaData device_identity_metadata;
+    device_identity_metadata.set_device_name("NP test device");
+    CountDownLatch latch(1);
+    credential_manager_.GenerateCredentials(
+        device_identity_metadata, kManagerAppId,
+        {internal::IDENTITY_TYPE_PRIVATE_GROUP},
+        /*credential_life_cycle_days=*/5,
+        /*contiguous_copy_of_credentials=*/kNumCredentials,
+        {.credentials_generated_cb =
+             [&](absl::StatusOr<std::vector<internal::SharedCredential>>
+                     credentials) {
+               EXPECT_OK(credentials);
+               latch.CountDown();
+             }});
+    ASSERT_TRUE(latch.Await().Ok());
+  }
+
+  std::vector<LocalCredential> GetLocalCredentials() {
+    auto credentials = credential_manager_.GetLocalCredentialsSync(
+        GetLocalCredentialSelector(), absl::Seconds(1));
+    EXPECT_TRUE(credentials.ok());
+    return credentials.GetResult();
+  }
+
+  // Marks salts 0 to `count` - 1 as consumed in every local credential.
+  void ConsumeSalts(int count) {
+    SaltBitmap consumed_salts;
+    for (int salt = 0; salt < count; ++salt) {
+      consumed_salts.Consume(salt);
+    }
+    for (LocalCredential& credential : GetLocalCredentials()) {
+      consumed_salts.WriteTo(credential);
+      credential_manager_.UpdateLocalCredential(
+          GetLocalCredentialSelector(), credential,
+          {[](absl::Status status) { EXPECT_OK(status); }});
+    }
+    WaitForServiceControllerTasks();
+  }
+
+  int CountConsumedSalts() {
+    WaitForServiceControllerTasks();
+    int count = 0;
+    for (const LocalCredential& credential : GetLocalCredentials()) {
+      count += SaltBitmap::FromCredential(credential).consumed_count();
+    }
+    return count;
+  }
+
+  // Waits until the local credentials have at least `count` consumed salts.
+  bool WaitForConsumedSalts(int count) {
+    absl::Time deadline = absl::Now() + absl::Seconds(10);
+    while (CountConsumedSalts() < count) {
+      if (absl::Now() > deadline) return false;
+      absl::SleepFor(absl::Milliseconds(1));
+    }
+    return true;
+  }
+
+  // Starts a private broadcast, and waits until it is advertising.
+  absl::StatusOr<BroadcastSessionId> StartPrivateBroadcast(
+      BroadcastManager& broadcast_manager) {
+    nearby::Future<absl::Status> started;
+    absl::StatusOr<BroadcastSessionId> session =
+        broadcast_manager.StartBroadcast(
+            CreateBroadcastRequest(internal::IDENTITY_TYPE_PRIVATE_GROUP,
+                                   /*account_name=*/""),
+            {.start_broadcast_cb = [started](absl::Status status) mutable {
+              started.Set(status);
+            }});
+    if (session.ok()) {
+      EXPECT_TRUE(started.Get().ok());
+      EXPECT_OK(started.Get().GetResult());
+    }
+    return session;
+  }
+
   // The medium environment must be initialized (started) before the service
   // controller.
   MediumEnvironmentStarter env_;
@@ -101,6 +200,13 @@ class BroadcastManagerTest : public testing::TestWithParam<FeatureFlags> {
   SingleThreadExecutor executor_;
   CredentialManagerImpl credential_manager_{&executor_};
   BroadcastManager broadcast_manager_{mediums_, credential_manager_, executor_};
+  BroadcastManager precomputing_broadcast_manager_{
+      mediums_, credential_manager_, executor_,
+      /*precomputed_advertisements=*/3};
+  BroadcastManager rotating_broadcast_manager_{
+      mediums_, credential_manager_, executor_,
+      /*precomputed_advertisements=*/0,
+      /*rotation_interval=*/absl::Milliseconds(10)};
 };
 
 INSTANTIATE_TEST_SUITE_P(ParametrisedBroadcastManagerTest, BroadcastManagerTest,
@@ -172,6 +278,120 @@ TEST_P(BroadcastManagerTest, StartBroadcastPrivateIdentityFails) {
   EXPECT_FALSE(IsAdvertising());
 }
 
+TEST_P(BroadcastManagerTest, RotateBroadcastConsumesNewSalt) {
+  GenerateLocalCredentials();
+  absl::StatusOr<BroadcastSessionId> session =
+      broadcast_manager_.StartBroadcast(
+          CreateBroadcastRequest(internal::IDENTITY_TYPE_PRIVATE_GROUP,
+                                 /*account_name=*/""),
+          CreateBroadcastCallback());
+  ASSERT_OK(session);
+  EXPECT_OK(start_broadcast_status_.Get().GetResult());
+  EXPECT_EQ(CountConsumedSalts(), 1);
+
+  broadcast_manager_.RotateBroadcast(*session);
+  broadcast_manager_.RotateBroadcast(*session);
+
+  EXPECT_TRUE(IsAdvertising());
+  EXPECT_EQ(CountConsumedSalts(), 3);
+}
+
+TEST_P(BroadcastManagerTest, RotateBroadcastPublicIdentity) {
+  absl::StatusOr<BroadcastSessionId> session =
+      broadcast_manager_.StartBroadcast(
+          CreateBroadcastRequest(internal::IDENTITY_TYPE_PUBLIC),
+          CreateBroadcastCallback());
+  ASSERT_OK(session);
+
+  broadcast_manager_.RotateBroadcast(*session);
+
+  EXPECT_TRUE(IsAdvertising());
+}
+
+TEST_P(BroadcastManagerTest, PrecomputedAdvertisementsConsumeSalts) {
+  GenerateLocalCredentials();
+  absl::StatusOr<BroadcastSessionId> session =
+      precomputing_broadcast_manager_.StartBroadcast(
+          CreateBroadcastRequest(internal::IDENTITY_TYPE_PRIVATE_GROUP,
+                                 /*account_name=*/""),
+          CreateBroadcastCallback());
+  ASSERT_OK(session);
+  EXPECT_OK(start_broadcast_status_.Get().GetResult());
+
+  // The advertised salt, and the salts of 3 precomputed advertisements.
+  EXPECT_EQ(CountConsumedSalts(), 4);
+}
+
+TEST_P(BroadcastManagerTest, ConcurrentBroadcastsKeepEachOthersSalts) {
+  GenerateLocalCredentials();
+  absl::StatusOr<BroadcastSessionId> first =
+      StartPrivateBroadcast(broadcast_manager_);
+  absl::StatusOr<BroadcastSessionId> second =
+      StartPrivateBroadcast(broadcast_manager_);
+  ASSERT_OK(first);
+  ASSERT_OK(second);
+  EXPECT_TRUE(IsAdvertising());
+
+  // Both sessions use the same credential. Each one saves its own copy of it.
+  broadcast_manager_.RotateBroadcast(*first);
+  broadcast_manager_.RotateBroadcast(*second);
+  broadcast_manager_.RotateBroadcast(*first);
+
+  EXPECT_EQ(CountConsumedSalts(), 5);
+}
+
+TEST_P(BroadcastManagerTest, BroadcastRotatesPeriodically) {
+  GenerateLocalCredentials();
+  absl::StatusOr<BroadcastSessionId> session =
+      StartPrivateBroadcast(rotating_broadcast_manager_);
+  ASSERT_OK(session);
+
+  // The initial salt, and the salts of two rotations.
+  EXPECT_TRUE(WaitForConsumedSalts(3));
+  EXPECT_TRUE(IsAdvertising());
+  rotating_broadcast_manager_.StopBroadcast(*session);
+  EXPECT_FALSE(IsAdvertising());
+}
+
+// Rotations keep finding unused salts when most salts of the credential are
+// consumed, with and without precomputed advertisements.
+TEST_P(BroadcastManagerTest, RotationWithManyConsumedSaltsUsesNewSalts) {
+  constexpr int kNumUnused = 1000;
+  constexpr int kNumRotations = 20;
+  GenerateLocalCredentials();
+  ConsumeSalts(SaltBitmap::kNumSalts - kNumUnused);
+  int initial_count = CountConsumedSalts();
+
+  absl::StatusOr<BroadcastSessionId> session =
+      StartPrivateBroadcast(broadcast_manager_);
+  ASSERT_OK(session);
+  for (int i = 0; i < kNumRotations; ++i) {
+    broadcast_manager_.RotateBroadcast(*session);
+  }
+  EXPECT_TRUE(IsAdvertising());
+  broadcast_manager_.StopBroadcast(*session);
+  // Every rotation consumed a salt that wasn't used before.
+  EXPECT_EQ(CountConsumedSalts(), initial_count + 1 + kNumRotations);
+
+  initial_count = CountConsumedSalts();
+  session = StartPrivateBroadcast(precomputing_broadcast_manager_);
+  ASSERT_OK(session);
+  for (int i = 0; i < kNumRotations; ++i) {
+    precomputing_broadcast_manager_.RotateBroadcast(*session);
+  }
+  EXPECT_TRUE(IsAdvertising());
+  precomputing_broadcast_manager_.StopBroadcast(*session);
+  // Up to 3 more salts are reserved for precomputed advertisements.
+  int count = CountConsumedSalts();
+  EXPECT_GE(count, initial_count + 1 + kNumRotations);
+  EXPECT_LE(count, initial_count + 1 + kNumRotations + 3);
+
+  for (const LocalCredential& credential : GetLocalCredentials()) {
+    EXPECT_LT(SaltBitmap::FromCredential(credential).consumed_count(),
+              SaltBitmap::kNumSalts);
+  }
+}
+
 }  // namespace
 }  // namespace presence
 }  // namespace nearby
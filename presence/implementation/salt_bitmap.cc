@@ -0,0 +1,137 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "presence/implementation/salt_bitmap.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+
+#include "absl/numeric/bits.h"
+#include "internal/platform/implementation/crypto.h"
+#include "internal/platform/logging.h"
+#include "internal/proto/local_credential.pb.h"
+
+namespace nearby {
+namespace presence {
+
+using ::nearby::internal::LocalCredential;
+
+SaltBitmap::SaltBitmap() : words_(kNumWords) {}
+
+SaltBitmap SaltBitmap::FromCredential(const LocalCredential& credential) {
+  SaltBitmap bitmap;
+  const std::string& bytes = credential.consumed_salts_bitmap();
+  if (bytes.size() > kNumSalts / 8) {
+    NEARBY_LOGS(WARNING) << "Ignoring " << bytes.size() - kNumSalts / 8
+                         << " extra bytes in consumed salts bitmap";
+  }
+  for (size_t i = 0; i < bytes.size() && i < kNumSalts / 8; ++i) {
+    bitmap.words_[i / 8] |= uint64_t{static_cast<uint8_t>(bytes[i])}
+                            << (i % 8 * 8);
+  }
+  bitmap.Recount();
+  for (const auto& [salt, consumed] : credential.consumed_salts()) {
+    if (salt < kNumSalts) bitmap.Consume(salt);
+  }
+  return bitmap;
+}
+
+void SaltBitmap::WriteTo(LocalCredential& credential) const {
+  std::string bytes(kNumSalts / 8, 0);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<char>(words_[i / 8] >> (i % 8 * 8));
+  }
+  size_t size = bytes.find_last_not_of('\0');
+  bytes.resize(size == std::string::npos ? 0 : size + 1);
+  credential.set_consumed_salts_bitmap(std::move(bytes));
+  auto& legacy = *credential.mutable_consumed_salts();
+  legacy.clear();
+  for (size_t i = 0; i < kNumWords; ++i) {
+    for (uint64_t word = words_[i]; word != 0; word &= word - 1) {
+      legacy.insert(
+          {static_cast<uint32_t>(i * kBitsPerWord + absl::countr_zero(word)),
+           true});
+    }
+  }
+}
+
+void SaltBitmap::Merge(const SaltBitmap& other) {
+  for (size_t i = 0; i < kNumWords; ++i) {
+    words_[i] |= other.words_[i];
+  }
+  Recount();
+}
+
+bool SaltBitmap::IsConsumed(uint16_t salt) const {
+  return (words_[salt / kBitsPerWord] >> (salt % kBitsPerWord)) & 1;
+}
+
+void SaltBitmap::Consume(uint16_t salt) {
+  uint64_t& word = words_[salt / kBitsPerWord];
+  uint64_t bit = uint64_t{1} << (salt % kBitsPerWord);
+  if (word & bit) return;
+  word |= bit;
+  ++consumed_count_;
+  if (word == ~uint64_t{0}) {
+    size_t index = salt / kBitsPerWord;
+    full_words_[index / kBitsPerWord] |= uint64_t{1} << (index % kBitsPerWord);
+  }
+}
+
+uint16_t SaltBitmap::SelectUnused(uint16_t preferred_salt) const {
+  if (!IsConsumed(preferred_salt) || consumed_count_ == kNumSalts) {
+    return preferred_salt;
+  }
+  return FindUnused(nearby::RandData<uint16_t>());
+}
+
+void SaltBitmap::Recount() {
+  consumed_count_ = 0;
+  full_words_ = {};
+  for (size_t i = 0; i < kNumWords; ++i) {
+    consumed_count_ += absl::popcount(words_[i]);
+    if (words_[i] == ~uint64_t{0}) {
+      full_words_[i / kBitsPerWord] |= uint64_t{1} << (i % kBitsPerWord);
+    }
+  }
+}
+
+uint16_t SaltBitmap::FindUnused(uint16_t start) const {
+  size_t word = start / kBitsPerWord;
+  uint64_t unused = ~words_[word] & (~uint64_t{0} << (start % kBitsPerWord));
+  if (unused != 0) {
+    return word * kBitsPerWord + absl::countr_zero(unused);
+  }
+  // Look for the next word that isn't full. The last iteration looks at the
+  // start of the first summary word again, which covers the salts of the
+  // start word that come before `start`.
+  size_t next = (word + 1) % kNumWords;
+  for (size_t i = 0; i <= kNumSummaryWords; ++i) {
+    size_t summary_index = (next / kBitsPerWord + i) % kNumSummaryWords;
+    uint64_t not_full = ~full_words_[summary_index];
+    if (i == 0) not_full &= ~uint64_t{0} << (next % kBitsPerWord);
+    if (not_full != 0) {
+      size_t index =
+          summary_index * kBitsPerWord + absl::countr_zero(not_full);
+      return index * kBitsPerWord + absl::countr_zero(~words_[index]);
+    }
+  }
+  return start;
+}
+
+}  // namespace presence
+}  // namespace nearby
@@ -0,0 +1,81 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_NEARBY_PRESENCE_IMPLEMENTATION_SALT_BITMAP_H_
+#define THIRD_PARTY_NEARBY_PRESENCE_IMPLEMENTATION_SALT_BITMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <vector>
+
+#include "internal/proto/local_credential.pb.h"
+
+namespace nearby {
+namespace presence {
+
+// The set of 2-byte salts consumed by a local credential.
+//
+// Every salt has a bit, and every 64-bit word of the bitmap has a bit in a
+// summary of full words, so an unused salt is found by looking at a few words,
+// however many salts are consumed.
+class SaltBitmap {
+ public:
+  static constexpr size_t kNumSalts = 1 << 16;
+
+  SaltBitmap();
+
+  // Reads the salts consumed by `credential`, from either storage format.
+  static SaltBitmap FromCredential(
+      const ::nearby::internal::LocalCredential& credential);
+
+  // Stores the consumed salts in `credential.consumed_salts_bitmap`, and in
+  // the legacy `credential.consumed_salts` map for readers that predate the
+  // bitmap.
+  void WriteTo(::nearby::internal::LocalCredential& credential) const;
+
+  // Consumes every salt consumed by `other`.
+  void Merge(const SaltBitmap& other);
+
+  bool IsConsumed(uint16_t salt) const;
+  void Consume(uint16_t salt);
+  size_t consumed_count() const { return consumed_count_; }
+
+  // Returns `preferred_salt` if it is unused, and a random unused salt
+  // otherwise. Returns `preferred_salt` if all salts are consumed. The returned
+  // salt isn't consumed.
+  uint16_t SelectUnused(uint16_t preferred_salt) const;
+
+ private:
+  static constexpr size_t kBitsPerWord = 64;
+  static constexpr size_t kNumWords = kNumSalts / kBitsPerWord;
+  static constexpr size_t kNumSummaryWords = kNumWords / kBitsPerWord;
+
+  // Recomputes `consumed_count_` and `full_words_` from `words_`.
+  void Recount();
+
+  // Returns an unused salt at or after `start`, wrapping around.
+  uint16_t FindUnused(uint16_t start) const;
+
+  std::vector<uint64_t> words_;
+  // Bit i is set when `words_[i]` is full.
+  std::array<uint64_t, kNumSummaryWords> full_words_ = {};
+  size_t consumed_count_ = 0;
+};
+
+}  // namespace presence
+}  // namespace nearby
+
+#endif  // THIRD_PARTY_NEARBY_PRESENCE_IMPLEMENTATION_SALT_BITMAP_H_
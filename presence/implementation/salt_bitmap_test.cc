@@ -0,0 +1,151 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "presence/implementation/salt_bitmap.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+#include "internal/platform/implementation/crypto.h"
+#include "internal/proto/local_credential.pb.h"
+
+namespace nearby {
+namespace presence {
+namespace {
+
+using ::nearby::internal::LocalCredential;
+
+TEST(SaltBitmap, ConsumesSalts) {
+  SaltBitmap bitmap;
+  EXPECT_FALSE(bitmap.IsConsumed(1000));
+
+  bitmap.Consume(1000);
+  bitmap.Consume(1000);
+  bitmap.Consume(0xFFFF);
+
+  EXPECT_TRUE(bitmap.IsConsumed(1000));
+  EXPECT_TRUE(bitmap.IsConsumed(0xFFFF));
+  EXPECT_FALSE(bitmap.IsConsumed(1001));
+  EXPECT_EQ(bitmap.consumed_count(), 2);
+}
+
+TEST(SaltBitmap, RoundTripsThroughCredential) {
+  SaltBitmap bitmap;
+  bitmap.Consume(0);
+  bitmap.Consume(9);
+  bitmap.Consume(4321);
+  LocalCredential credential;
+
+  bitmap.WriteTo(credential);
+
+  // Trailing zero bytes are omitted.
+  EXPECT_EQ(credential.consumed_salts_bitmap().size(), 4321 / 8 + 1);
+  SaltBitmap read = SaltBitmap::FromCredential(credential);
+  EXPECT_EQ(read.consumed_count(), 3);
+  EXPECT_TRUE(read.IsConsumed(0));
+  EXPECT_TRUE(read.IsConsumed(9));
+  EXPECT_TRUE(read.IsConsumed(4321));
+}
+
+TEST(SaltBitmap, EmptyBitmapIsNotStored) {
+  LocalCredential credential;
+  SaltBitmap().WriteTo(credential);
+  EXPECT_TRUE(credential.consumed_salts_bitmap().empty());
+}
+
+TEST(SaltBitmap, KeepsLegacyConsumedSaltsInSync) {
+  LocalCredential credential;
+  credential.mutable_consumed_salts()->insert({1234, true});
+  SaltBitmap bitmap;
+  bitmap.Consume(42);
+  bitmap.WriteTo(credential);
+  credential.mutable_consumed_salts()->insert({5678, true});
+
+  SaltBitmap read = SaltBitmap::FromCredential(credential);
+  read.WriteTo(credential);
+
+  EXPECT_EQ(read.consumed_count(), 2);
+  EXPECT_TRUE(read.IsConsumed(42));
+  EXPECT_TRUE(read.IsConsumed(5678));
+  EXPECT_EQ(credential.consumed_salts().size(), 2);
+  EXPECT_TRUE(credential.consumed_salts().contains(42));
+  EXPECT_TRUE(credential.consumed_salts().contains(5678));
+}
+
+TEST(SaltBitmap, SelectsPreferredSaltIfUnused) {
+  SaltBitmap bitmap;
+  bitmap.Consume(7);
+  EXPECT_EQ(bitmap.SelectUnused(8), 8);
+  EXPECT_FALSE(bitmap.IsConsumed(bitmap.SelectUnused(7)));
+}
+
+TEST(SaltBitmap, FindsLastUnusedSalt) {
+  constexpr uint16_t kUnusedSalt = 12345;
+  SaltBitmap bitmap;
+  for (uint32_t salt = 0; salt < SaltBitmap::kNumSalts; ++salt) {
+    if (salt != kUnusedSalt) bitmap.Consume(salt);
+  }
+
+  // Whatever the random starting point is.
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(bitmap.SelectUnused(0), kUnusedSalt);
+  }
+  bitmap.Consume(kUnusedSalt);
+  EXPECT_EQ(bitmap.consumed_count(), SaltBitmap::kNumSalts);
+  EXPECT_EQ(bitmap.SelectUnused(0), 0);
+}
+
+TEST(SaltBitmap, MergesConsumedSalts) {
+  SaltBitmap bitmap;
+  bitmap.Consume(1);
+  bitmap.Consume(2);
+  SaltBitmap other;
+  other.Consume(2);
+  for (uint32_t salt = 64; salt < 128; ++salt) {
+    other.Consume(salt);
+  }
+
+  bitmap.Merge(other);
+
+  EXPECT_EQ(bitmap.consumed_count(), 66);
+  EXPECT_TRUE(bitmap.IsConsumed(1));
+  EXPECT_TRUE(bitmap.IsConsumed(2));
+  EXPECT_TRUE(bitmap.IsConsumed(100));
+  EXPECT_FALSE(bitmap.IsConsumed(3));
+  // The merged full word is skipped when looking for an unused salt.
+  EXPECT_FALSE(bitmap.IsConsumed(bitmap.SelectUnused(64)));
+}
+
+// Salts are never selected again while any salt is unused, however many are
+// consumed.
+TEST(SaltBitmap, SelectsUnusedSaltsUntilAllAreConsumed) {
+  constexpr uint32_t kNumUnused = 2000;
+  SaltBitmap bitmap;
+  for (uint32_t salt = 0; salt < SaltBitmap::kNumSalts - kNumUnused; ++salt) {
+    bitmap.Consume(salt);
+  }
+
+  for (uint32_t i = 0; i < kNumUnused; ++i) {
+    uint16_t salt = bitmap.SelectUnused(nearby::RandData<uint16_t>());
+    ASSERT_FALSE(bitmap.IsConsumed(salt));
+    bitmap.Consume(salt);
+  }
+
+  EXPECT_EQ(bitmap.consumed_count(), SaltBitmap::kNumSalts);
+}
+
+}  // namespace
+}  // namespace presence
+}  // namespace nearby
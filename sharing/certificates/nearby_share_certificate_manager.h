@@ -109,6 +109,7 @@ class NearbyShareCertificateManager {
   // Returns in |callback| the public certificate that is able to be decrypted
   // using |encrypted_metadata_key|, and returns absl::nullopt if no such public
   // certificate exists.
+  // |callback| may run on another thread.
   virtual void GetDecryptedPublicCertificate(
       NearbyShareEncryptedMetadataKey encrypted_metadata_key,
       CertDecryptedCallback callback) = 0;
@@ -51,6 +51,8 @@
 #include "sharing/certificates/nearby_share_decrypted_public_certificate.h"
 #include "sharing/certificates/nearby_share_encrypted_metadata_key.h"
 #include "sharing/certificates/nearby_share_private_certificate.h"
+#include "sharing/certificates/private_certificate_key_pool.h"
+#include "sharing/certificates/public_certificate_index.h"
 #include "sharing/common/nearby_share_prefs.h"
 #include "sharing/contacts/nearby_share_contact_manager.h"
 #include "sharing/flags/generated/nearby_sharing_feature_flags.h"
@@ -232,6 +234,7 @@ NearbyShareCertificateManagerImpl::NearbyShareCertificateManagerImpl(
       nearby_identity_client_(client_factory->CreateIdentityInstance()),
       certificate_storage_(NearbyShareCertificateStorageImpl::Factory::Create(
           preference_manager, std::move(public_certificate_database))),
+      public_certificate_index_(std::make_shared<PublicCertificateIndex>()),
       private_certificate_expiration_scheduler_(
           NearbyShareSchedulerFactory::CreateExpirationScheduler(
               context, preference_manager,
@@ -279,7 +282,12 @@ NearbyShareCertificateManagerImpl::NearbyShareCertificateManagerImpl(
                     << ": Download public certificates scheduler is called.";
                 DownloadPublicCertificates();
               })),
-      executor_(context->CreateSequencedTaskRunner()) {
+      private_certificate_key_pool_(std::make_unique<PrivateCertificateKeyPool>(
+          context->CreateSequencedTaskRunner(),
+          /*capacity=*/NumExpectedPrivateCertificates())),
+      executor_(context->CreateSequencedTaskRunner()),
+      decryption_task_runner_(
+          context->CreateConcurrentTaskRunner(kDecryptionConcurrency)) {
   local_device_data_manager_->AddObserver(this);
   contact_manager_->AddObserver(this);
 }
@@ -399,6 +407,9 @@ void NearbyShareCertificateManagerImpl::OnPublicCertificatesDownloadSuccess(
     return;
   }
 
+  public_certificate_index_->AddCertificates(
+      absl::MakeSpan(certificates.data(), certificates.size()));
+
   // Succeeded to download public certificates.
   NotifyPublicCertificatesDownloaded();
 
@@ -515,8 +526,7 @@ void NearbyShareCertificateManagerImpl::UploadLocalDeviceCertificates() {
       LOG(INFO) << __func__
                 << ": [Call Identity API] Another call to PublishDevice after "
                    "regenerating all Private certificates: ";
-      certificate_storage_->ClearPrivateCertificates();
-      private_certificate_expiration_scheduler_->MakeImmediateRequest();
+      RecreatePrivateCertificates();
     }
   });
 }
@@ -530,23 +540,61 @@ NearbyShareCertificateManagerImpl::GetPrivateCertificatesAsPublicCertificates(
 void NearbyShareCertificateManagerImpl::GetDecryptedPublicCertificate(
     NearbyShareEncryptedMetadataKey encrypted_metadata_key,
     CertDecryptedCallback callback) {
+  // Decryption tries the key against every certificate, so it runs on
+  // |decryption_task_runner_| to keep the caller's thread free.
+  if (public_certificate_index_->is_warm()) {
+    decryption_task_runner_->PostTask(
+        [index = public_certificate_index_,
+         encrypted_metadata_key = std::move(encrypted_metadata_key),
+         callback = std::move(callback)]() {
+          std::optional<NearbyShareDecryptedPublicCertificate> decrypted =
+              index->GetDecryptedCertificate(encrypted_metadata_key);
+          if (decrypted) {
+            VLOG(1) << "Found public certificate with ID "
+                    << nearby::utils::HexEncode(decrypted->id())
+                    << " in index.";
+          } else {
+            VLOG(1)
+                << "Metadata key could not decrypt any public certificates.";
+          }
+          callback(std::move(decrypted));
+        });
+    return;
+  }
+
+  // Not all certificates are indexed yet. The storage is not thread-safe, so
+  // it is read from the caller's thread, and only the decryption moves.
   certificate_storage_->GetPublicCertificates(
-      [encrypted_metadata_key = std::move(encrypted_metadata_key),
+      [decryption_task_runner = decryption_task_runner_,
+       encrypted_metadata_key = std::move(encrypted_metadata_key),
        callback = std::move(callback)](
           bool success,
-          std::unique_ptr<std::vector<PublicCertificate>> result) {
-        TryDecryptPublicCertificates(encrypted_metadata_key,
-                                     std::move(callback), success,
-                                     std::move(result));
+          std::unique_ptr<std::vector<PublicCertificate>> result) mutable {
+        decryption_task_runner->PostTask(
+            [encrypted_metadata_key = std::move(encrypted_metadata_key),
+             callback = std::move(callback), success,
+             result = std::move(result)]() mutable {
+              TryDecryptPublicCertificates(encrypted_metadata_key,
+                                           std::move(callback), success,
+                                           std::move(result));
+            });
       });
 }
 
 void NearbyShareCertificateManagerImpl::ClearPublicCertificates(
     std::function<void(bool)> callback) {
-  certificate_storage_->ClearPublicCertificates(std::move(callback));
+  certificate_storage_->ClearPublicCertificates(
+      [index = public_certificate_index_,
+       callback = std::move(callback)](bool success) {
+        if (success) {
+          index->Clear();
+        }
+        callback(success);
+      });
 }
 
 void NearbyShareCertificateManagerImpl::OnStart() {
+  PrefetchPublicCertificates();
   private_certificate_expiration_scheduler_->Start();
   public_certificate_expiration_scheduler_->Start();
   upload_local_device_certificates_scheduler_->Start();
@@ -618,8 +666,7 @@ void NearbyShareCertificateManagerImpl::OnContactsUploaded(
     // would only recreate selected-contacts visibility certificates when
     // contacts are removed from the allowlist, but our information is not that
     // granular.
-    certificate_storage_->ClearPrivateCertificates();
-    private_certificate_expiration_scheduler_->MakeImmediateRequest();
+    RecreatePrivateCertificates();
   });
 }
 
@@ -633,8 +680,7 @@ void NearbyShareCertificateManagerImpl::OnLocalDeviceDataChanged(
       return;
 
     // Recreate all private certificates to ensure up-to-date metadata.
-    certificate_storage_->ClearPrivateCertificates();
-    private_certificate_expiration_scheduler_->MakeImmediateRequest();
+    RecreatePrivateCertificates();
   });
 }
 
@@ -655,8 +701,7 @@ void NearbyShareCertificateManagerImpl::SetVendorId(int32_t vendor_id) {
     }
   }
   // Recreate all private certificates to ensure up-to-date metadata.
-  certificate_storage_->ClearPrivateCertificates();
-  private_certificate_expiration_scheduler_->MakeImmediateRequest();
+  RecreatePrivateCertificates();
 }
 
 std::string NearbyShareCertificateManagerImpl::Dump() const {
@@ -716,8 +761,8 @@ void NearbyShareCertificateManagerImpl::OnPrivateCertificateExpiration() {
 void NearbyShareCertificateManagerImpl::FinishPrivateCertificateRefresh() {
   executor_->PostTask([&]() {
     LOG(INFO) << "Refreshed private certificates.";
-    absl::Time now = context_->GetClock()->Now();
-    certificate_storage_->RemoveExpiredPrivateCertificates(now);
+    certificate_storage_->RemoveExpiredPrivateCertificates(
+        context_->GetClock()->Now());
 
     std::vector<NearbySharePrivateCertificate> certs =
         *certificate_storage_->GetPrivateCertificates();
@@ -727,82 +772,98 @@ void NearbyShareCertificateManagerImpl::FinishPrivateCertificateRefresh() {
       return;
     }
 
-    // Determine how many private certificates of each visibility need to be
-    // created, and determine the validity period for the new certificates.
-    absl::flat_hash_map<DeviceVisibility, size_t> num_valid_certs;
-    absl::flat_hash_map<DeviceVisibility, absl::Time> latest_not_after;
-    for (DeviceVisibility visibility : kVisibilities) {
-      num_valid_certs[visibility] = 0;
-      latest_not_after[visibility] = now;
-    }
-    for (const NearbySharePrivateCertificate& cert : certs) {
-      ++num_valid_certs[cert.visibility()];
-      latest_not_after[cert.visibility()] =
-          std::max(latest_not_after[cert.visibility()], cert.not_after());
-    }
+    private_certificate_expiration_scheduler_->HandleResult(
+        StorePrivateCertificates(std::move(certs)));
+  });
+}
 
-    std::optional<AccountManager::Account> account =
-        account_manager_.GetCurrentAccount();
-    std::optional<std::string> email =
-        account.has_value()
-            ? account->email
-            : static_cast<std::optional<std::string>>(std::nullopt);
-
-    std::optional<std::string> icon_url =
-        account.has_value()
-            ? (account->picture_url.empty()
-                   ? static_cast<std::optional<std::string>>(std::nullopt)
-                   : account->picture_url)
-            : static_cast<std::optional<std::string>>(std::nullopt);
-
-    std::optional<std::string> full_name =
-        account.has_value()
-            ? (account->display_name.empty()
-                   ? static_cast<std::optional<std::string>>(std::nullopt)
-                   : account->display_name)
-            : static_cast<std::optional<std::string>>(std::nullopt);
-
-    std::optional<EncryptedMetadata> metadata =
-        BuildMetadata(local_device_data_manager_->GetDeviceName(), full_name,
-                      icon_url, email, vendor_id_, context_);
-
-    if (!metadata.has_value()) {
-      LOG(WARNING)
-          << "Failed to create private certificates; cannot create metadata";
-      private_certificate_expiration_scheduler_->HandleResult(
-          /*success=*/false);
-      return;
-    }
+void NearbyShareCertificateManagerImpl::RecreatePrivateCertificates() {
+  if (StorePrivateCertificates({})) {
+    private_certificate_expiration_scheduler_->Reschedule();
+    return;
+  }
 
-    // Add new certificates if necessary. Each visibility should have
-    // kNearbyShareNumPrivateCertificates.
-    LOG(INFO)
-        << "Creating "
-        << kNearbyShareNumPrivateCertificates -
-               num_valid_certs[DeviceVisibility::DEVICE_VISIBILITY_ALL_CONTACTS]
-        << " all-contacts visibility and "
-        << kNearbyShareNumPrivateCertificates -
-               num_valid_certs
-                   [DeviceVisibility::DEVICE_VISIBILITY_SELECTED_CONTACTS]
-        << " selected-contacts visibility private certificates.";
-
-    for (DeviceVisibility visibility : kVisibilities) {
-      while (num_valid_certs[visibility] < kNearbyShareNumPrivateCertificates) {
-        certs.emplace_back(visibility,
-                           /*not_before=*/latest_not_after[visibility],
-                           *metadata);
-        ++num_valid_certs[visibility];
-        latest_not_after[visibility] = certs.back().not_after();
-      }
+  // Never keep using certificates that should have been revoked.
+  certificate_storage_->ClearPrivateCertificates();
+  private_certificate_expiration_scheduler_->MakeImmediateRequest();
+}
+
+bool NearbyShareCertificateManagerImpl::StorePrivateCertificates(
+    std::vector<NearbySharePrivateCertificate> certs) {
+  absl::Time now = context_->GetClock()->Now();
+
+  // Determine how many private certificates of each visibility need to be
+  // created, and determine the validity period for the new certificates.
+  absl::flat_hash_map<DeviceVisibility, size_t> num_valid_certs;
+  absl::flat_hash_map<DeviceVisibility, absl::Time> latest_not_after;
+  for (DeviceVisibility visibility : kVisibilities) {
+    num_valid_certs[visibility] = 0;
+    latest_not_after[visibility] = now;
+  }
+  for (const NearbySharePrivateCertificate& cert : certs) {
+    ++num_valid_certs[cert.visibility()];
+    latest_not_after[cert.visibility()] =
+        std::max(latest_not_after[cert.visibility()], cert.not_after());
+  }
+
+  std::optional<AccountManager::Account> account =
+      account_manager_.GetCurrentAccount();
+  std::optional<std::string> email =
+      account.has_value()
+          ? account->email
+          : static_cast<std::optional<std::string>>(std::nullopt);
+
+  std::optional<std::string> icon_url =
+      account.has_value()
+          ? (account->picture_url.empty()
+                 ? static_cast<std::optional<std::string>>(std::nullopt)
+                 : account->picture_url)
+          : static_cast<std::optional<std::string>>(std::nullopt);
+
+  std::optional<std::string> full_name =
+      account.has_value()
+          ? (account->display_name.empty()
+                 ? static_cast<std::optional<std::string>>(std::nullopt)
+                 : account->display_name)
+          : static_cast<std::optional<std::string>>(std::nullopt);
+
+  std::optional<EncryptedMetadata> metadata =
+      BuildMetadata(local_device_data_manager_->GetDeviceName(), full_name,
+                    icon_url, email, vendor_id_, context_);
+
+  if (!metadata.has_value()) {
+    LOG(WARNING)
+        << "Failed to create private certificates; cannot create metadata";
+    return false;
+  }
+
+  // Add new certificates if necessary. Each visibility should have
+  // kNearbyShareNumPrivateCertificates.
+  LOG(INFO)
+      << "Creating "
+      << kNearbyShareNumPrivateCertificates -
+             num_valid_certs[DeviceVisibility::DEVICE_VISIBILITY_ALL_CONTACTS]
+      << " all-contacts visibility and "
+      << kNearbyShareNumPrivateCertificates -
+             num_valid_certs
+                 [DeviceVisibility::DEVICE_VISIBILITY_SELECTED_CONTACTS]
+      << " selected-contacts visibility private certificates.";
+
+  for (DeviceVisibility visibility : kVisibilities) {
+    while (num_valid_certs[visibility] < kNearbyShareNumPrivateCertificates) {
+      certs.push_back(private_certificate_key_pool_->CreateCertificate(
+          visibility, /*not_before=*/latest_not_after[visibility], *metadata));
+      ++num_valid_certs[visibility];
+      latest_not_after[visibility] = certs.back().not_after();
     }
+  }
 
-    certificate_storage_->ReplacePrivateCertificates(
-        absl::MakeSpan(certs.data(), certs.size()));
-    NotifyPrivateCertificatesChanged();
-    private_certificate_expiration_scheduler_->HandleResult(/*success=*/true);
+  certificate_storage_->ReplacePrivateCertificates(
+      absl::MakeSpan(certs.data(), certs.size()));
+  NotifyPrivateCertificatesChanged();
 
-    upload_local_device_certificates_scheduler_->MakeImmediateRequest();
-  });
+  upload_local_device_certificates_scheduler_->MakeImmediateRequest();
+  return true;
 }
 
 std::optional<absl::Time>
@@ -825,18 +886,37 @@ void NearbyShareCertificateManagerImpl::OnPublicCertificateExpiration() {
     LOG(INFO) << "Removing expired public certificates.";
     absl::Notification notification;
     bool result = false;
+    absl::Time now = context_->GetClock()->Now();
     certificate_storage_->RemoveExpiredPublicCertificates(
-        context_->GetClock()->Now(), [&](bool success) {
+        now, [&](bool success) {
           result = success;
           notification.Notify();
         });
     notification.WaitForNotification();
-    if (!result) {
+    if (result) {
+      public_certificate_index_->RemoveExpiredCertificates(now);
+    } else {
       LOG(ERROR) << "Failed to remove expired public certificates.";
     }
     public_certificate_expiration_scheduler_->HandleResult(result);
   });
 }
 
+void NearbyShareCertificateManagerImpl::PrefetchPublicCertificates() {
+  if (public_certificate_index_->is_warm()) return;
+
+  uint64_t generation = public_certificate_index_->StartLoad();
+  certificate_storage_->GetPublicCertificates(
+      [index = public_certificate_index_, generation](
+          bool success,
+          std::unique_ptr<std::vector<PublicCertificate>> certificates) {
+        if (!success || !certificates) {
+          LOG(WARNING) << "Failed to read public certificates for the index.";
+          return;
+        }
+        index->Load(generation, std::move(*certificates));
+      });
+}
+
 }  // namespace sharing
 }  // namespace nearby
@@ -33,6 +33,8 @@
 #include "sharing/certificates/nearby_share_certificate_storage.h"
 #include "sharing/certificates/nearby_share_encrypted_metadata_key.h"
 #include "sharing/certificates/nearby_share_private_certificate.h"
+#include "sharing/certificates/private_certificate_key_pool.h"
+#include "sharing/certificates/public_certificate_index.h"
 #include "sharing/contacts/nearby_share_contact_manager.h"
 #include "sharing/internal/api/preference_manager.h"
 #include "sharing/internal/api/public_certificate_database.h"
@@ -87,6 +89,10 @@ class NearbyShareCertificateManagerImpl
     static Factory* test_factory_;
   };
 
+  // The number of threads that try advertised metadata keys against the public
+  // certificates.
+  static constexpr uint32_t kDecryptionConcurrency = 2u;
+
   ~NearbyShareCertificateManagerImpl() override;
 
   void SetVendorId(int32_t vendor_id) override;
@@ -193,6 +199,18 @@ class NearbyShareCertificateManagerImpl
   void OnPrivateCertificateExpiration();
   void FinishPrivateCertificateRefresh();
 
+  // Replaces every private certificate with a new set in a single storage
+  // write, so a valid certificate stays available for each visibility. Falls
+  // back to clearing the certificates and requesting a refresh if the new set
+  // cannot be created.
+  void RecreatePrivateCertificates();
+
+  // Tops |certs| up to kNearbyShareNumPrivateCertificates per visibility and
+  // stores the result. Returns false, leaving storage untouched, if metadata
+  // cannot be built.
+  bool StorePrivateCertificates(
+      std::vector<NearbySharePrivateCertificate> certs);
+
   // Invoked by the public certificate expiration scheduler when an expired
   // public certificate needs to be removed from storage.
   void OnPublicCertificateExpiration();
@@ -204,6 +222,10 @@ class NearbyShareCertificateManagerImpl
           certificates);
   void OnPublicCertificatesDownloadFailure();
 
+  // Reads the stored public certificates into |public_certificate_index_|,
+  // unless it is already warm.
+  void PrefetchPublicCertificates();
+
   Context* const context_;
   AccountManager& account_manager_;
   NearbyShareLocalDeviceDataManager* const local_device_data_manager_;
@@ -214,6 +236,8 @@ class NearbyShareCertificateManagerImpl
       nearby_identity_client_;
 
   std::shared_ptr<NearbyShareCertificateStorage> certificate_storage_;
+  // Shared with storage callbacks, which may run after the manager is gone.
+  std::shared_ptr<PublicCertificateIndex> public_certificate_index_;
   std::unique_ptr<NearbyShareScheduler>
       private_certificate_expiration_scheduler_;
   std::unique_ptr<NearbyShareScheduler>
@@ -222,7 +246,12 @@ class NearbyShareCertificateManagerImpl
       upload_local_device_certificates_scheduler_;
   std::unique_ptr<NearbyShareScheduler> download_public_certificates_scheduler_;
 
+  // Keeps the keys for the next full set of private certificates ready.
+  std::unique_ptr<PrivateCertificateKeyPool> private_certificate_key_pool_;
   std::unique_ptr<TaskRunner> executor_;
+  // Runs certificate decryption. Shared with storage callbacks, which may run
+  // after the manager is gone.
+  std::shared_ptr<TaskRunner> decryption_task_runner_;
   // Whether we need to regenerate the certificates and make another
   // PublishDevice call. At every PublishDevice call, we check
   // PublishDeviceResponse to see if contacts are removed. In which case, we
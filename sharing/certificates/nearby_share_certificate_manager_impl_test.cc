@@ -29,10 +29,12 @@
 #include "protobuf-matchers/protocol-buffer-matchers.h"
 #include "gtest/gtest.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "internal/flags/nearby_flags.h"
@@ -84,10 +86,40 @@ constexpr char kDefaultDeviceName[] = "Josh's Chromebook";
 
 constexpr absl::string_view kPublicCertificateIds[3] = {"id1", "id2", "id3"};
 
+// Decryption calls back from a worker thread, and notifies |done| once |dest|
+// is set.
 void CaptureDecryptedPublicCertificateCallback(
     std::optional<NearbyShareDecryptedPublicCertificate>* dest,
-    std::optional<NearbyShareDecryptedPublicCertificate> src) {
+    std::optional<NearbyShareDecryptedPublicCertificate> src,
+    absl::Notification* done) {
   *dest = std::move(src);
+  done->Notify();
+}
+
+constexpr absl::Duration kDecryptionTimeout = absl::Seconds(1);
+
+constexpr DeviceVisibility kVisibilities[] = {
+    DeviceVisibility::DEVICE_VISIBILITY_ALL_CONTACTS,
+    DeviceVisibility::DEVICE_VISIBILITY_SELECTED_CONTACTS,
+    DeviceVisibility::DEVICE_VISIBILITY_SELF_SHARE,
+};
+
+absl::flat_hash_set<std::vector<uint8_t>> GetIds(
+    const std::vector<NearbySharePrivateCertificate>& certs) {
+  absl::flat_hash_set<std::vector<uint8_t>> ids;
+  for (const NearbySharePrivateCertificate& cert : certs) {
+    ids.insert(cert.id());
+  }
+  return ids;
+}
+
+// Expects that none of |certs| is one of |old_certs|.
+void ExpectNoneOf(const std::vector<NearbySharePrivateCertificate>& certs,
+                  const std::vector<NearbySharePrivateCertificate>& old_certs) {
+  absl::flat_hash_set<std::vector<uint8_t>> old_ids = GetIds(old_certs);
+  for (const NearbySharePrivateCertificate& cert : certs) {
+    EXPECT_FALSE(old_ids.contains(cert.id()));
+  }
 }
 
 }  // namespace
@@ -713,13 +745,16 @@ TEST_F(NearbyShareCertificateManagerImplTest,
 TEST_F(NearbyShareCertificateManagerImplTest,
        GetDecryptedPublicCertificateSuccess) {
   std::optional<NearbyShareDecryptedPublicCertificate> decrypted_pub_cert;
+  absl::Notification decrypted;
   cert_manager_->GetDecryptedPublicCertificate(
       metadata_encryption_keys_[0],
       [&](std::optional<NearbyShareDecryptedPublicCertificate> cert) {
-        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert);
+        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert,
+                                                  &decrypted);
       });
   GetPublicCertificatesCallback(true, public_certificates_);
 
+  ASSERT_TRUE(decrypted.WaitForNotificationWithTimeout(kDecryptionTimeout));
   ASSERT_TRUE(decrypted_pub_cert);
   std::vector<uint8_t> id(public_certificates_[0].secret_id().begin(),
                           public_certificates_[0].secret_id().end());
@@ -737,28 +772,111 @@ TEST_F(NearbyShareCertificateManagerImplTest,
   ASSERT_TRUE(metadata_key);
 
   std::optional<NearbyShareDecryptedPublicCertificate> decrypted_pub_cert;
+  absl::Notification decrypted;
   cert_manager_->GetDecryptedPublicCertificate(
       *metadata_key,
       [&](std::optional<NearbyShareDecryptedPublicCertificate> cert) {
-        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert);
+        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert,
+                                                  &decrypted);
       });
 
   GetPublicCertificatesCallback(true, public_certificates_);
 
+  ASSERT_TRUE(decrypted.WaitForNotificationWithTimeout(kDecryptionTimeout));
   EXPECT_FALSE(decrypted_pub_cert);
 }
 
 TEST_F(NearbyShareCertificateManagerImplTest,
        GetDecryptedPublicCertificateGetPublicCertificatesFailure) {
   std::optional<NearbyShareDecryptedPublicCertificate> decrypted_pub_cert;
+  absl::Notification decrypted;
   cert_manager_->GetDecryptedPublicCertificate(
       metadata_encryption_keys_[0],
       [&](std::optional<NearbyShareDecryptedPublicCertificate> cert) {
-        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert);
+        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert,
+                                                  &decrypted);
       });
 
   GetPublicCertificatesCallback(false, {});
 
+  ASSERT_TRUE(decrypted.WaitForNotificationWithTimeout(kDecryptionTimeout));
+  EXPECT_FALSE(decrypted_pub_cert);
+}
+
+TEST_F(NearbyShareCertificateManagerImplTest,
+       GetDecryptedPublicCertificateFromPrefetchedIndex) {
+  // Complete the read of stored certificates started by Start().
+  GetPublicCertificatesCallback(true, public_certificates_);
+
+  std::optional<NearbyShareDecryptedPublicCertificate> decrypted_pub_cert;
+  absl::Notification decrypted;
+  cert_manager_->GetDecryptedPublicCertificate(
+      metadata_encryption_keys_[1],
+      [&](std::optional<NearbyShareDecryptedPublicCertificate> cert) {
+        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert,
+                                                  &decrypted);
+      });
+
+  // Resolved without reading storage again.
+  EXPECT_THAT(cert_store_->get_public_certificates_callbacks(),
+              ::testing::IsEmpty());
+  ASSERT_TRUE(decrypted.WaitForNotificationWithTimeout(kDecryptionTimeout));
+  ASSERT_TRUE(decrypted_pub_cert);
+  std::vector<uint8_t> id(public_certificates_[1].secret_id().begin(),
+                          public_certificates_[1].secret_id().end());
+  EXPECT_EQ(decrypted_pub_cert->id(), id);
+}
+
+TEST_F(NearbyShareCertificateManagerImplTest,
+       GetDecryptedPublicCertificateReturnsBeforeDecryption) {
+  GetPublicCertificatesCallback(true, public_certificates_);
+  // Occupy every decryption thread.
+  absl::Notification release_workers;
+  for (uint32_t i = 0;
+       i < NearbyShareCertificateManagerImpl::kDecryptionConcurrency; ++i) {
+    fake_context_.last_concurrent_task_runner()->PostTask(
+        [&]() { release_workers.WaitForNotification(); });
+  }
+
+  std::optional<NearbyShareDecryptedPublicCertificate> decrypted_pub_cert;
+  absl::Notification decrypted;
+  cert_manager_->GetDecryptedPublicCertificate(
+      metadata_encryption_keys_[1],
+      [&](std::optional<NearbyShareDecryptedPublicCertificate> cert) {
+        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert,
+                                                  &decrypted);
+      });
+
+  // The call returned, freeing the caller's thread, while the decryption
+  // still waits for a worker.
+  EXPECT_FALSE(decrypted.HasBeenNotified());
+
+  release_workers.Notify();
+  ASSERT_TRUE(decrypted.WaitForNotificationWithTimeout(kDecryptionTimeout));
+  ASSERT_TRUE(decrypted_pub_cert);
+  std::vector<uint8_t> id(public_certificates_[1].secret_id().begin(),
+                          public_certificates_[1].secret_id().end());
+  EXPECT_EQ(decrypted_pub_cert->id(), id);
+}
+
+TEST_F(NearbyShareCertificateManagerImplTest,
+       ClearPublicCertificatesClearsIndex) {
+  GetPublicCertificatesCallback(true, public_certificates_);
+  cert_manager_->ClearPublicCertificates([&](bool result) {});
+  std::move(cert_store_->clear_public_certificates_callbacks().back())(true);
+
+  std::optional<NearbyShareDecryptedPublicCertificate> decrypted_pub_cert;
+  absl::Notification decrypted;
+  cert_manager_->GetDecryptedPublicCertificate(
+      metadata_encryption_keys_[0],
+      [&](std::optional<NearbyShareDecryptedPublicCertificate> cert) {
+        CaptureDecryptedPublicCertificateCallback(&decrypted_pub_cert, cert,
+                                                  &decrypted);
+      });
+
+  EXPECT_THAT(cert_store_->get_public_certificates_callbacks(),
+              ::testing::IsEmpty());
+  ASSERT_TRUE(decrypted.WaitForNotificationWithTimeout(kDecryptionTimeout));
   EXPECT_FALSE(decrypted_pub_cert);
 }
 
@@ -847,10 +965,10 @@ TEST_F(NearbyShareCertificateManagerImplTest,
 
 TEST_F(NearbyShareCertificateManagerImplTest,
        RevokePrivateCertificates_OnContactsUploaded) {
-  // Destroy and recreate private certificates if contact data has changed since
-  // the last successful upload.
+  // Replace private certificates if contact data has changed since the last
+  // successful upload.
   cert_manager_->Stop();
-  size_t num_expected_calls = 0;
+  size_t num_expected_replacements = 0;
   for (bool did_contacts_change_since_last_upload : {true, false}) {
     cert_store_->ReplacePrivateCertificates(private_certificates_);
     contact_manager_->NotifyContactsUploaded(
@@ -859,16 +977,18 @@ TEST_F(NearbyShareCertificateManagerImplTest,
     Sync();
     std::vector<NearbySharePrivateCertificate> certs =
         *cert_store_->GetPrivateCertificates();
+    EXPECT_EQ(certs.size(), 9u);
 
     if (did_contacts_change_since_last_upload) {
-      ++num_expected_calls;
-      EXPECT_TRUE(certs.empty());
+      ++num_expected_replacements;
+      ExpectNoneOf(certs, private_certificates_);
     } else {
-      EXPECT_EQ(certs.size(), 9u);
+      EXPECT_EQ(GetIds(certs), GetIds(private_certificates_));
     }
 
-    EXPECT_EQ(num_expected_calls,
-              private_cert_exp_scheduler_->num_immediate_requests());
+    EXPECT_EQ(num_expected_replacements,
+              num_private_certs_changed_notifications_);
+    EXPECT_EQ(0u, private_cert_exp_scheduler_->num_immediate_requests());
   }
 }
 
@@ -876,35 +996,74 @@ TEST_F(NearbyShareCertificateManagerImplTest,
        RefreshPrivateCertificates_OnLocalDeviceMetadataChanged) {
   cert_manager_->Start();
 
-  // Destroy and recreate private certificates if any metadata fields change.
-  size_t num_expected_calls = 0;
+  // Replace private certificates if any metadata fields change.
+  size_t num_expected_replacements = 0;
   for (bool did_device_name_change : {true, false}) {
     for (bool did_full_name_change : {true, false}) {
       for (bool did_icon_change : {true, false}) {
+        std::vector<NearbySharePrivateCertificate> old_certs =
+            *cert_store_->GetPrivateCertificates();
         local_device_data_manager_->NotifyLocalDeviceDataChanged(
             did_device_name_change, did_full_name_change, did_icon_change);
         Sync();
+        std::vector<NearbySharePrivateCertificate> certs =
+            *cert_store_->GetPrivateCertificates();
+        EXPECT_EQ(certs.size(), 9u);
 
         if (did_device_name_change || did_full_name_change || did_icon_change) {
-          ++num_expected_calls;
-          EXPECT_TRUE(cert_store_->GetPrivateCertificates()->empty());
+          ++num_expected_replacements;
+          ExpectNoneOf(certs, old_certs);
+        } else {
+          EXPECT_EQ(GetIds(certs), GetIds(old_certs));
         }
 
-        EXPECT_EQ(num_expected_calls,
-                  private_cert_exp_scheduler_->num_immediate_requests());
+        EXPECT_EQ(num_expected_replacements,
+                  num_private_certs_changed_notifications_);
+        EXPECT_EQ(0u, private_cert_exp_scheduler_->num_immediate_requests());
       }
     }
   }
 }
 
+TEST_F(NearbyShareCertificateManagerImplTest,
+       RecreatedPrivateCertificatesAreAvailableForAdvertising) {
+  cert_store_->ReplacePrivateCertificates(private_certificates_);
+  cert_manager_->Start();
+
+  local_device_data_manager_->NotifyLocalDeviceDataChanged(
+      /*did_device_name_change=*/true, /*did_full_name_change=*/false,
+      /*did_icon_change=*/false);
+  Sync();
+
+  // Advertising can start without waiting for a private certificate refresh.
+  std::vector<NearbySharePrivateCertificate> certs =
+      *cert_store_->GetPrivateCertificates();
+  ExpectNoneOf(certs, private_certificates_);
+  absl::Time now = fake_context_.GetClock()->Now();
+  for (DeviceVisibility visibility : kVisibilities) {
+    EXPECT_TRUE(std::any_of(
+        certs.begin(), certs.end(),
+        [&](const NearbySharePrivateCertificate& cert) {
+          return cert.visibility() == visibility && cert.not_before() <= now &&
+                 now < cert.not_after();
+        }));
+  }
+  EXPECT_EQ(0u, private_cert_exp_scheduler_->num_immediate_requests());
+  EXPECT_EQ(1u, private_cert_exp_scheduler_->num_reschedule_calls());
+  EXPECT_EQ(1u, upload_scheduler_->num_immediate_requests());
+  RunUpload(/*success=*/true);
+  VerifyPrivateCertificates(/*expected_metadata=*/GetNearbyShareTestMetadata());
+}
+
 TEST_F(NearbyShareCertificateManagerImplTest,
        RefreshPrivateCertificates_OnVendorIdChanged) {
   cert_store_->ReplacePrivateCertificates({});
   cert_manager_->Start();
 
   cert_manager_->SetVendorId(12345);
-  HandlePrivateCertificateRefresh(/*expect_private_cert_refresh=*/true,
-                                  /*expected_success=*/true);
+  EXPECT_EQ(0u, private_cert_exp_scheduler_->num_immediate_requests());
+  EXPECT_EQ(1u, num_private_certs_changed_notifications_);
+  EXPECT_EQ(1u, upload_scheduler_->num_immediate_requests());
   RunUpload(/*success=*/true);
   auto metadata = GetNearbyShareTestMetadata();
   metadata.set_vendor_id(12345);
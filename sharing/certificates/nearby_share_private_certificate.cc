@@ -145,18 +145,35 @@ std::set<std::vector<uint8_t>> StringToSalts(absl::string_view str) {
 
 }  // namespace
 
+// static
+NearbySharePrivateCertificate::Keys
+NearbySharePrivateCertificate::GenerateKeys() {
+  return {
+      .key_pair = crypto::ECPrivateKey::Create(),
+      .secret_key = crypto::SymmetricKey::GenerateRandomKey(
+          crypto::SymmetricKey::Algorithm::AES,
+          /*key_size_in_bits=*/8 * kNearbyShareNumBytesSecretKey),
+      .metadata_encryption_key =
+          GenerateRandomBytes(kNearbyShareNumBytesMetadataEncryptionKey),
+  };
+}
+
 NearbySharePrivateCertificate::NearbySharePrivateCertificate(
     DeviceVisibility visibility, absl::Time not_before,
     nearby::sharing::proto::EncryptedMetadata unencrypted_metadata)
+    : NearbySharePrivateCertificate(visibility, not_before,
+                                    std::move(unencrypted_metadata),
+                                    GenerateKeys()) {}
+
+NearbySharePrivateCertificate::NearbySharePrivateCertificate(
+    DeviceVisibility visibility, absl::Time not_before,
+    nearby::sharing::proto::EncryptedMetadata unencrypted_metadata, Keys keys)
     : visibility_(visibility),
       not_before_(not_before),
       not_after_(not_before_ + kNearbyShareCertificateValidityPeriod),
-      key_pair_(crypto::ECPrivateKey::Create()),
-      secret_key_(crypto::SymmetricKey::GenerateRandomKey(
-          crypto::SymmetricKey::Algorithm::AES,
-          /*key_size_in_bits=*/8 * kNearbyShareNumBytesSecretKey)),
-      metadata_encryption_key_(
-          GenerateRandomBytes(kNearbyShareNumBytesMetadataEncryptionKey)),
+      key_pair_(std::move(keys.key_pair)),
+      secret_key_(std::move(keys.secret_key)),
+      metadata_encryption_key_(std::move(keys.metadata_encryption_key)),
       id_(CreateCertificateIdFromSecretKey(*secret_key_)),
       unencrypted_metadata_(std::move(unencrypted_metadata)) {
   NL_DCHECK_NE(
@@ -54,6 +54,18 @@ namespace sharing {
 // metadata encryption key, which can then be advertised.
 class NearbySharePrivateCertificate {
  public:
+  // The key material of a certificate. It doesn't depend on the visibility,
+  // validity period or metadata, so it can be generated ahead of time.
+  struct Keys {
+    std::unique_ptr<crypto::ECPrivateKey> key_pair;
+    std::unique_ptr<crypto::SymmetricKey> secret_key;
+    std::vector<uint8_t> metadata_encryption_key;
+  };
+
+  // Generates a random EC key pair, secret key, and metadata encryption key.
+  // This is the expensive part of creating a certificate.
+  static Keys GenerateKeys();
+
   // Inverse operation of ToCertificateData(). Returns absl::nullopt if the
   // conversion is not successful
   static std::optional<NearbySharePrivateCertificate> FromCertificateData(
@@ -67,6 +79,12 @@ class NearbySharePrivateCertificate {
       proto::DeviceVisibility visibility, absl::Time not_before,
       nearby::sharing::proto::EncryptedMetadata unencrypted_metadata);
 
+  // Same as above, but with |keys| generated by GenerateKeys().
+  NearbySharePrivateCertificate(
+      proto::DeviceVisibility visibility, absl::Time not_before,
+      nearby::sharing::proto::EncryptedMetadata unencrypted_metadata,
+      Keys keys);
+
   NearbySharePrivateCertificate(
       proto::DeviceVisibility visibility, absl::Time not_before,
       absl::Time not_after, std::unique_ptr<crypto::ECPrivateKey> key_pair,
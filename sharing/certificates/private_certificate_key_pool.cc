@@ -0,0 +1,108 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sharing/certificates/private_certificate_key_pool.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "internal/platform/task_runner.h"
+#include "sharing/certificates/nearby_share_private_certificate.h"
+#include "sharing/internal/public/logging.h"
+#include "sharing/proto/encrypted_metadata.pb.h"
+#include "sharing/proto/enums.pb.h"
+
+namespace nearby {
+namespace sharing {
+
+PrivateCertificateKeyPool::PrivateCertificateKeyPool(
+    std::unique_ptr<TaskRunner> task_runner, size_t capacity)
+    : capacity_(capacity), task_runner_(std::move(task_runner)) {
+  absl::MutexLock lock(&mutex_);
+  MaybeStartGenerating();
+}
+
+PrivateCertificateKeyPool::~PrivateCertificateKeyPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    is_shut_down_ = true;
+  }
+  task_runner_->Shutdown();
+}
+
+NearbySharePrivateCertificate PrivateCertificateKeyPool::CreateCertificate(
+    proto::DeviceVisibility visibility, absl::Time not_before,
+    nearby::sharing::proto::EncryptedMetadata unencrypted_metadata) {
+  std::optional<NearbySharePrivateCertificate::Keys> keys;
+  {
+    absl::MutexLock lock(&mutex_);
+    if (!ready_keys_.empty()) {
+      keys = std::move(ready_keys_.front());
+      ready_keys_.pop_front();
+    } else {
+      ++in_place_count_;
+    }
+    MaybeStartGenerating();
+  }
+  if (!keys.has_value()) {
+    VLOG(1) << __func__ << ": No private certificate keys ready.";
+    return NearbySharePrivateCertificate(visibility, not_before,
+                                         std::move(unencrypted_metadata));
+  }
+  return NearbySharePrivateCertificate(visibility, not_before,
+                                       std::move(unencrypted_metadata),
+                                       *std::move(keys));
+}
+
+size_t PrivateCertificateKeyPool::ready_count() const {
+  absl::MutexLock lock(&mutex_);
+  return ready_keys_.size();
+}
+
+size_t PrivateCertificateKeyPool::in_place_count() const {
+  absl::MutexLock lock(&mutex_);
+  return in_place_count_;
+}
+
+void PrivateCertificateKeyPool::MaybeStartGenerating() {
+  if (is_generating_ || is_shut_down_ || ready_keys_.size() >= capacity_) {
+    return;
+  }
+  is_generating_ = true;
+  task_runner_->PostTask([this]() { GenerateKeys(); });
+}
+
+void PrivateCertificateKeyPool::GenerateKeys() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (is_shut_down_ || ready_keys_.size() >= capacity_) {
+        is_generating_ = false;
+        return;
+      }
+    }
+    NearbySharePrivateCertificate::Keys keys =
+        NearbySharePrivateCertificate::GenerateKeys();
+    absl::MutexLock lock(&mutex_);
+    ready_keys_.push_back(std::move(keys));
+  }
+}
+
+}  // namespace sharing
+}  // namespace nearby
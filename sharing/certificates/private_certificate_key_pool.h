@@ -0,0 +1,88 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_NEARBY_SHARING_CERTIFICATES_PRIVATE_CERTIFICATE_KEY_POOL_H_
+#define THIRD_PARTY_NEARBY_SHARING_CERTIFICATES_PRIVATE_CERTIFICATE_KEY_POOL_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <memory>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "internal/platform/task_runner.h"
+#include "sharing/certificates/nearby_share_private_certificate.h"
+#include "sharing/proto/encrypted_metadata.pb.h"
+#include "sharing/proto/enums.pb.h"
+
+namespace nearby {
+namespace sharing {
+
+// Generates the keys of private certificates in the background, ahead of
+// need, so that a new set of private certificates can be created without
+// waiting for EC key generation.
+//
+// The pool keeps up to |capacity| sets of keys ready. Keys only live in
+// memory; they are persisted as part of the certificate that eventually uses
+// them.
+class PrivateCertificateKeyPool {
+ public:
+  // Starts filling the pool on |task_runner| right away.
+  PrivateCertificateKeyPool(std::unique_ptr<TaskRunner> task_runner,
+                            size_t capacity);
+  // Waits for keys being generated.
+  ~PrivateCertificateKeyPool();
+
+  PrivateCertificateKeyPool(const PrivateCertificateKeyPool&) = delete;
+  PrivateCertificateKeyPool& operator=(const PrivateCertificateKeyPool&) =
+      delete;
+
+  // Creates a private certificate with keys from the pool, and starts
+  // generating keys to replace them. Generates the keys in place if none are
+  // ready.
+  NearbySharePrivateCertificate CreateCertificate(
+      proto::DeviceVisibility visibility, absl::Time not_before,
+      nearby::sharing::proto::EncryptedMetadata unencrypted_metadata)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Number of sets of keys ready to use.
+  size_t ready_count() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Number of certificates created with keys generated in place because the
+  // pool was empty.
+  size_t in_place_count() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  void MaybeStartGenerating() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void GenerateKeys() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const size_t capacity_;
+
+  mutable absl::Mutex mutex_;
+  std::deque<NearbySharePrivateCertificate::Keys> ready_keys_
+      ABSL_GUARDED_BY(mutex_);
+  // Whether a task generating keys is posted or running.
+  bool is_generating_ ABSL_GUARDED_BY(mutex_) = false;
+  bool is_shut_down_ ABSL_GUARDED_BY(mutex_) = false;
+  size_t in_place_count_ ABSL_GUARDED_BY(mutex_) = 0;
+
+  std::unique_ptr<TaskRunner> task_runner_;
+};
+
+}  // namespace sharing
+}  // namespace nearby
+
+#endif  // THIRD_PARTY_NEARBY_SHARING_CERTIFICATES_PRIVATE_CERTIFICATE_KEY_POOL_H_
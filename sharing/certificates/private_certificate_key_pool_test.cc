@@ -0,0 +1,131 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sharing/certificates/private_certificate_key_pool.h"
+
+#include <stddef.h>
+
+#include <iterator>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "internal/test/fake_task_runner.h"
+#include "sharing/certificates/constants.h"
+#include "sharing/certificates/nearby_share_private_certificate.h"
+#include "sharing/certificates/test_util.h"
+#include "sharing/internal/test/fake_context.h"
+#include "sharing/proto/enums.pb.h"
+
+namespace nearby {
+namespace sharing {
+namespace {
+
+using ::nearby::sharing::proto::DeviceVisibility;
+
+constexpr DeviceVisibility kVisibilities[] = {
+    DeviceVisibility::DEVICE_VISIBILITY_ALL_CONTACTS,
+    DeviceVisibility::DEVICE_VISIBILITY_SELECTED_CONTACTS,
+    DeviceVisibility::DEVICE_VISIBILITY_SELF_SHARE,
+};
+
+constexpr size_t kFullSetSize =
+    std::size(kVisibilities) * kNearbyShareNumPrivateCertificates;
+
+constexpr absl::Duration kGenerationTimeout = absl::Seconds(10);
+
+// Creates a full set of private certificates, the way the certificate manager
+// does when it recreates all of them.
+std::vector<NearbySharePrivateCertificate> CreateFullSet(
+    PrivateCertificateKeyPool& pool) {
+  std::vector<NearbySharePrivateCertificate> certificates;
+  for (DeviceVisibility visibility : kVisibilities) {
+    absl::Time not_before = GetNearbyShareTestNotBefore();
+    for (size_t i = 0; i < kNearbyShareNumPrivateCertificates; ++i) {
+      certificates.push_back(pool.CreateCertificate(
+          visibility, not_before, GetNearbyShareTestMetadata()));
+      not_before = certificates.back().not_after();
+    }
+  }
+  return certificates;
+}
+
+TEST(PrivateCertificateKeyPoolTest, FillsUpToCapacity) {
+  FakeContext context;
+  PrivateCertificateKeyPool pool(context.CreateSequencedTaskRunner(),
+                                 /*capacity=*/3);
+  ASSERT_TRUE(context.last_sequenced_task_runner()->SyncWithTimeout(
+      kGenerationTimeout));
+  EXPECT_EQ(pool.ready_count(), 3);
+}
+
+TEST(PrivateCertificateKeyPoolTest, CreatesCertificatesFromPooledKeys) {
+  FakeContext context;
+  PrivateCertificateKeyPool pool(context.CreateSequencedTaskRunner(),
+                                 /*capacity=*/2);
+  FakeTaskRunner* task_runner = context.last_sequenced_task_runner();
+  ASSERT_TRUE(task_runner->SyncWithTimeout(kGenerationTimeout));
+
+  NearbySharePrivateCertificate first = pool.CreateCertificate(
+      DeviceVisibility::DEVICE_VISIBILITY_ALL_CONTACTS,
+      GetNearbyShareTestNotBefore(), GetNearbyShareTestMetadata());
+  NearbySharePrivateCertificate second = pool.CreateCertificate(
+      DeviceVisibility::DEVICE_VISIBILITY_SELF_SHARE,
+      GetNearbyShareTestNotBefore(), GetNearbyShareTestMetadata());
+
+  EXPECT_NE(first.id(), second.id());
+  EXPECT_EQ(second.visibility(),
+            DeviceVisibility::DEVICE_VISIBILITY_SELF_SHARE);
+  EXPECT_EQ(first.not_after() - first.not_before(),
+            kNearbyShareCertificateValidityPeriod);
+  EXPECT_TRUE(first.ToPublicCertificate().has_value());
+  EXPECT_TRUE(first.EncryptMetadataKey().has_value());
+  EXPECT_TRUE(first.Sign(GetNearbyShareTestPayloadToSign()).has_value());
+  EXPECT_EQ(pool.in_place_count(), 0);
+
+  // The used keys are replaced.
+  ASSERT_TRUE(task_runner->SyncWithTimeout(kGenerationTimeout));
+  EXPECT_EQ(pool.ready_count(), 2);
+}
+
+TEST(PrivateCertificateKeyPoolTest, GeneratesKeysInPlaceWhenEmpty) {
+  FakeContext context;
+  PrivateCertificateKeyPool pool(context.CreateSequencedTaskRunner(),
+                                 /*capacity=*/0);
+  NearbySharePrivateCertificate certificate = pool.CreateCertificate(
+      DeviceVisibility::DEVICE_VISIBILITY_ALL_CONTACTS,
+      GetNearbyShareTestNotBefore(), GetNearbyShareTestMetadata());
+  EXPECT_TRUE(certificate.ToPublicCertificate().has_value());
+  EXPECT_EQ(pool.ready_count(), 0);
+  EXPECT_EQ(pool.in_place_count(), 1);
+}
+
+// Recreating the certificates, for example because the contacts or the device
+// name changed, must not wait for key generation before advertising.
+TEST(PrivateCertificateKeyPoolTest, CreatesFullSetWithoutGeneratingKeys) {
+  FakeContext context;
+  PrivateCertificateKeyPool pool(context.CreateSequencedTaskRunner(),
+                                 kFullSetSize);
+  ASSERT_TRUE(context.last_sequenced_task_runner()->SyncWithTimeout(
+      kGenerationTimeout));
+
+  std::vector<NearbySharePrivateCertificate> certificates = CreateFullSet(pool);
+
+  EXPECT_EQ(certificates.size(), kFullSetSize);
+  EXPECT_EQ(pool.in_place_count(), 0);
+}
+
+}  // namespace
+}  // namespace sharing
+}  // namespace nearby
@@ -0,0 +1,259 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sharing/certificates/public_certificate_index.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "sharing/certificates/common.h"
+#include "sharing/certificates/nearby_share_decrypted_public_certificate.h"
+#include "sharing/certificates/nearby_share_encrypted_metadata_key.h"
+#include "sharing/internal/public/logging.h"
+#include "sharing/proto/rpc_resources.pb.h"
+
+namespace nearby {
+namespace sharing {
+namespace {
+
+using ::nearby::sharing::proto::PublicCertificate;
+
+std::string LookupKey(
+    const NearbyShareEncryptedMetadataKey& encrypted_metadata_key) {
+  std::string key(encrypted_metadata_key.salt().begin(),
+                  encrypted_metadata_key.salt().end());
+  key.append(encrypted_metadata_key.encrypted_key().begin(),
+             encrypted_metadata_key.encrypted_key().end());
+  return key;
+}
+
+bool IsExpired(const PublicCertificate& certificate, absl::Time now) {
+  return IsNearbyShareCertificateExpired(
+      now,
+      /*not_after=*/absl::FromUnixSeconds(certificate.end_time().seconds()) +
+          absl::Nanoseconds(certificate.end_time().nanos()),
+      /*use_public_certificate_tolerance=*/true);
+}
+
+}  // namespace
+
+PublicCertificateIndex::PublicCertificateIndex(size_t max_cached_lookups)
+    : max_cached_lookups_(max_cached_lookups),
+      certificates_(std::make_shared<const CertificateList>()) {}
+
+PublicCertificateIndex::~PublicCertificateIndex() = default;
+
+bool PublicCertificateIndex::is_warm() const {
+  absl::MutexLock lock(&mutex_);
+  return is_warm_;
+}
+
+uint64_t PublicCertificateIndex::StartLoad() {
+  absl::MutexLock lock(&mutex_);
+  return ++load_generation_;
+}
+
+void PublicCertificateIndex::Load(uint64_t generation,
+                                  CertificateList certificates) {
+  absl::MutexLock lock(&mutex_);
+  if (generation != load_generation_) {
+    VLOG(1) << __func__ << ": Ignoring outdated public certificates.";
+    return;
+  }
+  SetCertificatesLocked(std::move(certificates));
+  is_warm_ = true;
+  AddCertificatesLocked(pending_additions_);
+  if (pending_expiration_.has_value()) {
+    RemoveExpiredCertificatesLocked(*pending_expiration_);
+  }
+  pending_additions_.clear();
+  pending_expiration_.reset();
+  VLOG(1) << __func__ << ": Indexed " << certificates_->size()
+          << " public certificates.";
+}
+
+void PublicCertificateIndex::AddCertificates(
+    absl::Span<const PublicCertificate> certificates) {
+  absl::MutexLock lock(&mutex_);
+  if (!is_warm_) {
+    pending_additions_.insert(pending_additions_.end(), certificates.begin(),
+                              certificates.end());
+    return;
+  }
+  AddCertificatesLocked(certificates);
+}
+
+void PublicCertificateIndex::RemoveExpiredCertificates(absl::Time now) {
+  absl::MutexLock lock(&mutex_);
+  if (!is_warm_) {
+    pending_expiration_ = std::max(pending_expiration_.value_or(now), now);
+    return;
+  }
+  RemoveExpiredCertificatesLocked(now);
+}
+
+void PublicCertificateIndex::Clear() {
+  absl::MutexLock lock(&mutex_);
+  ++load_generation_;
+  pending_additions_.clear();
+  pending_expiration_.reset();
+  SetCertificatesLocked({});
+  is_warm_ = true;
+}
+
+std::optional<NearbyShareDecryptedPublicCertificate>
+PublicCertificateIndex::GetDecryptedCertificate(
+    const NearbyShareEncryptedMetadataKey& encrypted_metadata_key) {
+  std::string key = LookupKey(encrypted_metadata_key);
+  std::shared_ptr<const CertificateList> certificates;
+  uint64_t version;
+  {
+    absl::MutexLock lock(&mutex_);
+    NL_DCHECK(is_warm_);
+    auto it = lookups_.find(key);
+    if (it != lookups_.end()) {
+      ++cache_hits_;
+      return it->second;
+    }
+    certificates = certificates_;
+    version = certificates_version_;
+  }
+
+  std::optional<NearbyShareDecryptedPublicCertificate> decrypted;
+  for (const PublicCertificate& certificate : *certificates) {
+    decrypted = NearbyShareDecryptedPublicCertificate::DecryptPublicCertificate(
+        certificate, encrypted_metadata_key);
+    if (decrypted.has_value()) break;
+  }
+
+  absl::MutexLock lock(&mutex_);
+  if (version == certificates_version_ && !lookups_.contains(key)) {
+    if (lookup_order_.size() >= max_cached_lookups_ && !lookup_order_.empty()) {
+      lookups_.erase(lookup_order_.front());
+      lookup_order_.pop_front();
+    }
+    lookups_.emplace(key, decrypted);
+    lookup_order_.push_back(std::move(key));
+  }
+  return decrypted;
+}
+
+int64_t PublicCertificateIndex::cache_hits() const {
+  absl::MutexLock lock(&mutex_);
+  return cache_hits_;
+}
+
+void PublicCertificateIndex::AddCertificatesLocked(
+    absl::Span<const PublicCertificate> certificates) {
+  if (certificates.empty()) return;
+
+  // Later certificates win over earlier ones with the same secret_id, like
+  // they do in storage.
+  absl::flat_hash_map<std::string, const PublicCertificate*> added;
+  for (const PublicCertificate& certificate : certificates) {
+    added[certificate.secret_id()] = &certificate;
+  }
+  CertificateList updated;
+  updated.reserve(certificates_->size() + added.size());
+  for (const PublicCertificate& certificate : *certificates_) {
+    if (!added.contains(certificate.secret_id())) {
+      updated.push_back(certificate);
+    }
+  }
+  for (const auto& [id, certificate] : added) {
+    updated.push_back(*certificate);
+  }
+  certificates_ = std::make_shared<const CertificateList>(std::move(updated));
+  ++certificates_version_;
+  // Unmatched advertisements may match one of the new certificates.
+  DropLookupsLocked(
+      [&added](const std::optional<NearbyShareDecryptedPublicCertificate>&
+                   decrypted) {
+        return !decrypted.has_value() ||
+               added.contains(std::string(decrypted->id().begin(),
+                                          decrypted->id().end()));
+      });
+}
+
+void PublicCertificateIndex::RemoveExpiredCertificatesLocked(absl::Time now) {
+  CertificateList updated;
+  absl::flat_hash_set<std::string> removed_ids;
+  for (const PublicCertificate& certificate : *certificates_) {
+    if (IsExpired(certificate, now)) {
+      removed_ids.insert(certificate.secret_id());
+    } else {
+      updated.push_back(certificate);
+    }
+  }
+  if (removed_ids.empty()) return;
+
+  certificates_ = std::make_shared<const CertificateList>(std::move(updated));
+  ++certificates_version_;
+  // Removing certificates can't make an unmatched advertisement match, so
+  // only the matches for the removed certificates are dropped.
+  DropLookupsLocked(
+      [&removed_ids](
+          const std::optional<NearbyShareDecryptedPublicCertificate>&
+              decrypted) {
+        return decrypted.has_value() &&
+               removed_ids.contains(std::string(decrypted->id().begin(),
+                                                decrypted->id().end()));
+      });
+}
+
+void PublicCertificateIndex::SetCertificatesLocked(
+    CertificateList certificates) {
+  certificates_ =
+      std::make_shared<const CertificateList>(std::move(certificates));
+  ++certificates_version_;
+  lookups_.clear();
+  lookup_order_.clear();
+}
+
+void PublicCertificateIndex::DropLookupsLocked(
+    absl::FunctionRef<
+        bool(const std::optional<NearbyShareDecryptedPublicCertificate>&)>
+        should_drop) {
+  for (auto it = lookups_.begin(); it != lookups_.end();) {
+    if (should_drop(it->second)) {
+      lookups_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  lookup_order_.erase(
+      std::remove_if(lookup_order_.begin(), lookup_order_.end(),
+                     [this](const std::string& key)
+                         ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+                           return !lookups_.contains(key);
+                         }),
+      lookup_order_.end());
+}
+
+}  // namespace sharing
+}  // namespace nearby
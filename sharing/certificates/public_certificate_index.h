@@ -0,0 +1,150 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_NEARBY_SHARING_CERTIFICATES_PUBLIC_CERTIFICATE_INDEX_H_
+#define THIRD_PARTY_NEARBY_SHARING_CERTIFICATES_PUBLIC_CERTIFICATE_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "sharing/certificates/nearby_share_decrypted_public_certificate.h"
+#include "sharing/certificates/nearby_share_encrypted_metadata_key.h"
+#include "sharing/proto/rpc_resources.pb.h"
+
+namespace nearby {
+namespace sharing {
+
+// An in-memory copy of the stored public certificates, so that advertisements
+// can be matched against them without reading the certificate database.
+//
+// The salt is picked by the advertising device and the metadata key is never
+// disclosed, so the certificate behind an encrypted metadata key can only be
+// found by trying to decrypt it with every certificate. The index remembers
+// the outcome of each attempt, keyed by the salt and encrypted key of the
+// advertisement, so an advertisement that is seen again (rediscovery, another
+// medium, an incoming connection after discovery) is resolved by a single
+// hash lookup. Unmatched advertisements are remembered too, until certificates
+// are added. At most |max_cached_lookups| outcomes are kept; the oldest are
+// dropped first.
+//
+// The index starts cold. It becomes warm once Load() hands it the content of
+// the certificate storage, and is kept up to date incrementally after that.
+// Changes made while a load is in flight are applied on top of the loaded
+// certificates. All methods are thread-safe.
+class PublicCertificateIndex {
+ public:
+  static constexpr size_t kDefaultMaxCachedLookups = 1024;
+
+  explicit PublicCertificateIndex(
+      size_t max_cached_lookups = kDefaultMaxCachedLookups);
+  ~PublicCertificateIndex();
+
+  PublicCertificateIndex(const PublicCertificateIndex&) = delete;
+  PublicCertificateIndex& operator=(const PublicCertificateIndex&) = delete;
+
+  // Whether the index holds every stored certificate. Once warm, it stays
+  // warm.
+  bool is_warm() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the generation to pass to Load() for a read of the certificate
+  // storage that starts now. A load that is already in flight is ignored when
+  // it completes.
+  uint64_t StartLoad() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Replaces the indexed certificates with |certificates| read from storage,
+  // unless another load was started or the index was cleared since
+  // StartLoad() returned |generation|.
+  void Load(uint64_t generation,
+            std::vector<nearby::sharing::proto::PublicCertificate>
+                certificates) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Adds |certificates|, or replaces existing certificates by secret_id.
+  void AddCertificates(
+      absl::Span<const nearby::sharing::proto::PublicCertificate> certificates)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Removes the certificates that are expired at |now|, with the same clock
+  // skew tolerance as the certificate storage.
+  void RemoveExpiredCertificates(absl::Time now) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Removes all certificates. The index is warm afterwards.
+  void Clear() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the certificate that decrypts |encrypted_metadata_key|, or
+  // std::nullopt if there is none. Must only be called on a warm index.
+  std::optional<NearbyShareDecryptedPublicCertificate> GetDecryptedCertificate(
+      const NearbyShareEncryptedMetadataKey& encrypted_metadata_key)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Number of lookups resolved without trying any certificate.
+  int64_t cache_hits() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  using CertificateList =
+      std::vector<nearby::sharing::proto::PublicCertificate>;
+
+  void AddCertificatesLocked(
+      absl::Span<const nearby::sharing::proto::PublicCertificate> certificates)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void RemoveExpiredCertificatesLocked(absl::Time now)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void SetCertificatesLocked(CertificateList certificates)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void DropLookupsLocked(
+      absl::FunctionRef<
+          bool(const std::optional<NearbyShareDecryptedPublicCertificate>&)>
+          should_drop) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const size_t max_cached_lookups_;
+
+  mutable absl::Mutex mutex_;
+  bool is_warm_ ABSL_GUARDED_BY(mutex_) = false;
+  uint64_t load_generation_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Changes that arrived while the index was cold.
+  CertificateList pending_additions_ ABSL_GUARDED_BY(mutex_);
+  std::optional<absl::Time> pending_expiration_ ABSL_GUARDED_BY(mutex_);
+
+  // Replaced rather than modified, so lookups can try the certificates
+  // without holding |mutex_|.
+  std::shared_ptr<const CertificateList> certificates_ ABSL_GUARDED_BY(mutex_);
+  // Bumped whenever |certificates_| changes, so that the outcome of a lookup
+  // that raced with the change isn't cached.
+  uint64_t certificates_version_ ABSL_GUARDED_BY(mutex_) = 0;
+
+  // Outcome of earlier lookups by salt and encrypted key; std::nullopt if no
+  // certificate matched.
+  absl::flat_hash_map<std::string,
+                      std::optional<NearbyShareDecryptedPublicCertificate>>
+      lookups_ ABSL_GUARDED_BY(mutex_);
+  // Keys of |lookups_|, oldest first.
+  std::deque<std::string> lookup_order_ ABSL_GUARDED_BY(mutex_);
+  int64_t cache_hits_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace sharing
+}  // namespace nearby
+
+#endif  // THIRD_PARTY_NEARBY_SHARING_CERTIFICATES_PUBLIC_CERTIFICATE_INDEX_H_
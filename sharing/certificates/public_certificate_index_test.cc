@@ -0,0 +1,194 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sharing/certificates/public_certificate_index.h"
+
+#include <stdint.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "sharing/certificates/constants.h"
+#include "sharing/certificates/nearby_share_decrypted_public_certificate.h"
+#include "sharing/certificates/nearby_share_encrypted_metadata_key.h"
+#include "sharing/certificates/nearby_share_private_certificate.h"
+#include "sharing/certificates/test_util.h"
+#include "sharing/proto/encrypted_metadata.pb.h"
+#include "sharing/proto/enums.pb.h"
+#include "sharing/proto/rpc_resources.pb.h"
+
+namespace nearby {
+namespace sharing {
+namespace {
+
+using ::nearby::sharing::proto::DeviceVisibility;
+using ::nearby::sharing::proto::PublicCertificate;
+
+const absl::Time t0 = absl::UnixEpoch() + absl::Hours(365 * 50 * 24);
+
+// A public certificate of a remote device, along with an encrypted metadata
+// key that the device could advertise.
+struct RemoteDevice {
+  PublicCertificate certificate;
+  NearbyShareEncryptedMetadataKey encrypted_metadata_key;
+};
+
+RemoteDevice CreateRemoteDevice(int index, absl::Time not_before = t0) {
+  nearby::sharing::proto::EncryptedMetadata metadata =
+      GetNearbyShareTestMetadata();
+  metadata.set_device_name(absl::StrCat("device_", index));
+  NearbySharePrivateCertificate private_certificate(
+      DeviceVisibility::DEVICE_VISIBILITY_ALL_CONTACTS, not_before, metadata);
+  return {*private_certificate.ToPublicCertificate(),
+          *private_certificate.EncryptMetadataKey()};
+}
+
+std::vector<RemoteDevice> CreateRemoteDevices(int count) {
+  std::vector<RemoteDevice> devices;
+  devices.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    devices.push_back(CreateRemoteDevice(i));
+  }
+  return devices;
+}
+
+std::vector<PublicCertificate> Certificates(
+    const std::vector<RemoteDevice>& devices) {
+  std::vector<PublicCertificate> certificates;
+  for (const RemoteDevice& device : devices) {
+    certificates.push_back(device.certificate);
+  }
+  return certificates;
+}
+
+std::optional<std::string> FindDeviceName(PublicCertificateIndex& index,
+                                          const RemoteDevice& device) {
+  std::optional<NearbyShareDecryptedPublicCertificate> decrypted =
+      index.GetDecryptedCertificate(device.encrypted_metadata_key);
+  if (!decrypted.has_value()) return std::nullopt;
+  return decrypted->unencrypted_metadata().device_name();
+}
+
+TEST(PublicCertificateIndexTest, FindsLoadedCertificates) {
+  std::vector<RemoteDevice> devices = CreateRemoteDevices(3);
+  PublicCertificateIndex index;
+  EXPECT_FALSE(index.is_warm());
+
+  index.Load(index.StartLoad(), Certificates(devices));
+
+  EXPECT_TRUE(index.is_warm());
+  EXPECT_EQ(FindDeviceName(index, devices[2]), "device_2");
+  EXPECT_EQ(FindDeviceName(index, devices[0]), "device_0");
+  EXPECT_EQ(index.cache_hits(), 0);
+  EXPECT_EQ(FindDeviceName(index, devices[2]), "device_2");
+  EXPECT_EQ(index.cache_hits(), 1);
+}
+
+TEST(PublicCertificateIndexTest, UnmatchedKeyMatchesAfterCertificateAdded) {
+  std::vector<RemoteDevice> devices = CreateRemoteDevices(2);
+  PublicCertificateIndex index;
+  index.Load(index.StartLoad(), {devices[0].certificate});
+
+  EXPECT_EQ(FindDeviceName(index, devices[1]), std::nullopt);
+  EXPECT_EQ(FindDeviceName(index, devices[1]), std::nullopt);
+  EXPECT_EQ(index.cache_hits(), 1);
+
+  index.AddCertificates({devices[1].certificate});
+  EXPECT_EQ(FindDeviceName(index, devices[1]), "device_1");
+  EXPECT_EQ(FindDeviceName(index, devices[0]), "device_0");
+}
+
+TEST(PublicCertificateIndexTest, RemovesExpiredCertificates) {
+  RemoteDevice old_device = CreateRemoteDevice(0);
+  RemoteDevice new_device =
+      CreateRemoteDevice(1, t0 + kNearbyShareCertificateValidityPeriod);
+  PublicCertificateIndex index;
+  index.Load(index.StartLoad(),
+             {old_device.certificate, new_device.certificate});
+  EXPECT_EQ(FindDeviceName(index, old_device), "device_0");
+
+  index.RemoveExpiredCertificates(
+      t0 + kNearbyShareCertificateValidityPeriod +
+      kNearbyShareMaxPrivateCertificateValidityBoundOffset +
+      kNearbySharePublicCertificateValidityBoundOffsetTolerance);
+
+  EXPECT_EQ(FindDeviceName(index, old_device), std::nullopt);
+  EXPECT_EQ(FindDeviceName(index, new_device), "device_1");
+}
+
+TEST(PublicCertificateIndexTest, AppliesChangesMadeWhileLoading) {
+  std::vector<RemoteDevice> devices = CreateRemoteDevices(2);
+  PublicCertificateIndex index;
+  uint64_t generation = index.StartLoad();
+  index.AddCertificates({devices[1].certificate});
+  // The read of storage didn't see the added certificate.
+  index.Load(generation, {devices[0].certificate});
+
+  EXPECT_EQ(FindDeviceName(index, devices[0]), "device_0");
+  EXPECT_EQ(FindDeviceName(index, devices[1]), "device_1");
+}
+
+TEST(PublicCertificateIndexTest, IgnoresLoadStartedBeforeClear) {
+  std::vector<RemoteDevice> devices = CreateRemoteDevices(1);
+  PublicCertificateIndex index;
+  uint64_t generation = index.StartLoad();
+  index.Clear();
+  index.Load(generation, Certificates(devices));
+
+  EXPECT_TRUE(index.is_warm());
+  EXPECT_EQ(FindDeviceName(index, devices[0]), std::nullopt);
+}
+
+TEST(PublicCertificateIndexTest, KeepsAtMostMaxCachedLookups) {
+  std::vector<RemoteDevice> devices = CreateRemoteDevices(3);
+  PublicCertificateIndex index(/*max_cached_lookups=*/2);
+  index.Load(index.StartLoad(), Certificates(devices));
+
+  for (const RemoteDevice& device : devices) {
+    FindDeviceName(index, device);
+  }
+  // The oldest lookup was dropped.
+  EXPECT_EQ(FindDeviceName(index, devices[0]), "device_0");
+  EXPECT_EQ(index.cache_hits(), 0);
+  EXPECT_EQ(FindDeviceName(index, devices[2]), "device_2");
+  EXPECT_EQ(index.cache_hits(), 1);
+}
+
+// With many stored certificates, a device that is discovered again is
+// resolved from the index's cache instead of by trying every certificate.
+TEST(PublicCertificateIndexTest, RediscoveryIsResolvedFromCache) {
+  constexpr int kNumCertificates = 100;
+  std::vector<RemoteDevice> devices = CreateRemoteDevices(kNumCertificates);
+  PublicCertificateIndex index;
+  index.Load(index.StartLoad(), Certificates(devices));
+
+  for (int i = 0; i < kNumCertificates; ++i) {
+    EXPECT_EQ(FindDeviceName(index, devices[i]), absl::StrCat("device_", i));
+  }
+  EXPECT_EQ(index.cache_hits(), 0);
+
+  // Every device seen again is resolved without trying any certificate.
+  for (int i = kNumCertificates - 1; i >= 0; --i) {
+    EXPECT_EQ(FindDeviceName(index, devices[i]), absl::StrCat("device_", i));
+  }
+  EXPECT_EQ(index.cache_hits(), kNumCertificates);
+}
+
+}  // namespace
+}  // namespace sharing
+}  // namespace nearby
@@ -16,7 +16,7 @@
 
 #include <stdint.h>
 
-#include <algorithm>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -24,6 +24,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
@@ -95,7 +96,7 @@ void IncomingFramesReader::ProcessReadRequest(
     cached_frame = PopCachedFrame(frame_type);
   }
   if (cached_frame) {
-    callback(*cached_frame);
+    callback(std::move(*cached_frame));
     return;
   }
   {
@@ -166,7 +167,7 @@ void IncomingFramesReader::OnDataReadFromConnection(
       NL_LOG(WARNING) << __func__ << ": Failed to read frame of type "
                       << *frame_info.frame_type << ", but got frame of type "
                       << frame_type << ". Cached for later.";
-      cached_frames_.push_back(std::move(frame));
+      CacheFrame(std::move(frame));
       cached_frame = true;
     }
   }
@@ -198,7 +199,7 @@ void IncomingFramesReader::Done(std::unique_ptr<V1Frame> frame) {
     read_frame_info = std::move(read_frame_info_queue_.front());
     read_frame_info_queue_.pop();
   }
-  read_frame_info.callback(*frame);
+  read_frame_info.callback(std::move(*frame));
 
   {
     absl::MutexLock lock(&mutex_);
@@ -217,29 +218,41 @@ void IncomingFramesReader::Done(std::unique_ptr<V1Frame> frame) {
   }
 }
 
+void IncomingFramesReader::CacheFrame(std::unique_ptr<V1Frame> frame) {
+  FrameType frame_type = frame->type();
+  cached_frames_[frame_type].push_back(
+      {.sequence_number = next_sequence_number_++, .frame = std::move(frame)});
+}
+
 std::unique_ptr<V1Frame> IncomingFramesReader::PopCachedFrame(
     std::optional<V1Frame::FrameType> frame_type) {
   NL_VLOG(1) << __func__ << ": Fetching cached frame";
   if (cached_frames_.empty()) {
     return nullptr;
   }
-  if (!frame_type.has_value()) {
-    std::unique_ptr<V1Frame> frame = std::move(cached_frames_.front());
-    cached_frames_.pop_front();
-    return frame;
-  }
-  NL_VLOG(1) << __func__ << ": Requested frame type - " << *frame_type;
 
-  auto iter =
-      std::find_if(cached_frames_.begin(), cached_frames_.end(),
-                   [frame_type = *frame_type](std::unique_ptr<V1Frame>& frame) {
-                     return frame->type() == frame_type;
-                   });
+  auto queue = cached_frames_.end();
+  if (frame_type.has_value()) {
+    NL_VLOG(1) << __func__ << ": Requested frame type - " << *frame_type;
+    queue = cached_frames_.find(*frame_type);
+    if (queue == cached_frames_.end()) return nullptr;
+  } else {
+    // The oldest frame is at the front of one of the queues.
+    for (auto it = cached_frames_.begin(); it != cached_frames_.end(); ++it) {
+      if (queue == cached_frames_.end() ||
+          it->second.front().sequence_number <
+              queue->second.front().sequence_number) {
+        queue = it;
+      }
+    }
+  }
 
-  if (iter == cached_frames_.end()) return nullptr;
   NL_VLOG(1) << __func__ << ": Successfully read cached frame";
-  std::unique_ptr<V1Frame> frame = std::move(*iter);
-  cached_frames_.erase(iter);
+  std::unique_ptr<V1Frame> frame = std::move(queue->second.front().frame);
+  queue->second.pop_front();
+  if (queue->second.empty()) {
+    cached_frames_.erase(queue);
+  }
   return frame;
 }
 
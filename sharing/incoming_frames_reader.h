@@ -17,14 +17,15 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <functional>
-#include <list>
 #include <memory>
 #include <optional>
 #include <queue>
 #include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/time/time.h"
 #include "absl/synchronization/mutex.h"
 #include "internal/platform/task_runner.h"
@@ -74,6 +75,12 @@ class IncomingFramesReader
   }
 
  private:
+  struct CachedFrame {
+    // Arrival order across all frame types.
+    uint64_t sequence_number;
+    std::unique_ptr<nearby::sharing::service::proto::V1Frame> frame;
+  };
+
   struct ReadFrameInfo {
     std::optional<nearby::sharing::service::proto::V1Frame::FrameType>
         frame_type = std::nullopt;
@@ -93,6 +100,8 @@ class IncomingFramesReader
   void ReadNextFrame() ABSL_LOCKS_EXCLUDED(mutex_);
   void OnDataReadFromConnection(const std::vector<uint8_t>& bytes)
       ABSL_LOCKS_EXCLUDED(mutex_);
+  void CacheFrame(std::unique_ptr<nearby::sharing::service::proto::V1Frame>
+                      frame) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void OnTimeout();
   void Done(std::unique_ptr<nearby::sharing::service::proto::V1Frame> frame)
       ABSL_LOCKS_EXCLUDED(mutex_);
@@ -106,9 +115,13 @@ class IncomingFramesReader
   absl::Mutex mutex_;
   std::queue<ReadFrameInfo> read_frame_info_queue_ ABSL_GUARDED_BY(mutex_);
 
-  // Caches frames read from NearbyConnection which are not used immediately.
-  std::list<std::unique_ptr<nearby::sharing::service::proto::V1Frame>>
+  // Caches frames read from NearbyConnection which are not used immediately,
+  // queued by frame type. Queues are removed once empty, so finding the oldest
+  // frame of any type only looks at the types that are waiting.
+  absl::flat_hash_map<nearby::sharing::service::proto::V1Frame::FrameType,
+                      std::deque<CachedFrame>>
       cached_frames_ ABSL_GUARDED_BY(mutex_);
+  uint64_t next_sequence_number_ ABSL_GUARDED_BY(mutex_) = 0;
 
   std::unique_ptr<ThreadTimer> timeout_timer_ ABSL_GUARDED_BY(mutex_);
 };
@@ -368,6 +368,104 @@ TEST_F(IncomingFramesReaderTest, SkipInvalidFrame) {
   ReleaseFrameReader();
 }
 
+TEST_F(IncomingFramesReaderTest, TypedReadsFromCacheInAnyOrder) {
+  connection().WriteMessage(*GetCancelFrame());
+  connection().WriteMessage(*GetResponseFrame());
+  connection().WriteMessage(*GetIntroductionFrame());
+
+  absl::Notification introduction_notification;
+  frames_reader()->ReadFrame(
+      service::proto::V1Frame::INTRODUCTION,
+      [&](std::optional<V1Frame> frame) {
+        ASSERT_NE(frame, std::nullopt);
+        EXPECT_EQ(frame->type(), service::proto::V1Frame::INTRODUCTION);
+        introduction_notification.Notify();
+      },
+      kTimeout);
+  EXPECT_TRUE(
+      introduction_notification.WaitForNotificationWithTimeout(kTimeout));
+
+  // Both remaining frames are cached; read them in reverse arrival order.
+  absl::Notification response_notification;
+  frames_reader()->ReadFrame(
+      service::proto::V1Frame::RESPONSE,
+      [&](std::optional<V1Frame> frame) {
+        ASSERT_NE(frame, std::nullopt);
+        EXPECT_EQ(frame->type(), service::proto::V1Frame::RESPONSE);
+        EXPECT_EQ(frame->connection_response().status(),
+                  ConnectionResponseFrame::ACCEPT);
+        response_notification.Notify();
+      },
+      kTimeout);
+  EXPECT_TRUE(response_notification.WaitForNotificationWithTimeout(kTimeout));
+  absl::Notification cancel_notification;
+  frames_reader()->ReadFrame(
+      service::proto::V1Frame::CANCEL,
+      [&](std::optional<V1Frame> frame) {
+        ASSERT_NE(frame, std::nullopt);
+        EXPECT_EQ(frame->type(), service::proto::V1Frame::CANCEL);
+        cancel_notification.Notify();
+      },
+      kTimeout);
+  EXPECT_TRUE(cancel_notification.WaitForNotificationWithTimeout(kTimeout));
+}
+
+TEST_F(IncomingFramesReaderTest, ReadAnyFrameFromCacheKeepsArrivalOrder) {
+  connection().WriteMessage(*GetResponseFrame());
+  connection().WriteMessage(*GetCancelFrame());
+  connection().WriteMessage(*GetResponseFrame());
+  connection().WriteMessage(*GetIntroductionFrame());
+
+  absl::Notification introduction_notification;
+  frames_reader()->ReadFrame(
+      service::proto::V1Frame::INTRODUCTION,
+      [&](std::optional<V1Frame> frame) {
+        introduction_notification.Notify();
+      },
+      kTimeout);
+  EXPECT_TRUE(
+      introduction_notification.WaitForNotificationWithTimeout(kTimeout));
+
+  for (V1Frame::FrameType expected_type :
+       {service::proto::V1Frame::RESPONSE, service::proto::V1Frame::CANCEL,
+        service::proto::V1Frame::RESPONSE}) {
+    absl::Notification notification;
+    frames_reader()->ReadFrame([&](std::optional<V1Frame> frame) {
+      ASSERT_NE(frame, std::nullopt);
+      EXPECT_EQ(frame->type(), expected_type);
+      notification.Notify();
+    });
+    EXPECT_TRUE(notification.WaitForNotificationWithTimeout(kTimeout));
+  }
+}
+
+TEST_F(IncomingFramesReaderTest, TypedReadTimesOutAndKeepsOtherFramesCached) {
+  connection().WriteMessage(*GetCancelFrame());
+
+  absl::Notification timeout_notification;
+  frames_reader()->ReadFrame(
+      service::proto::V1Frame::INTRODUCTION,
+      [&](std::optional<V1Frame> frame) {
+        EXPECT_EQ(frame, std::nullopt);
+        timeout_notification.Notify();
+      },
+      kTimeout);
+  Sync();
+  FastForward(kTimeout);
+  EXPECT_TRUE(timeout_notification.WaitForNotificationWithTimeout(kTimeout));
+
+  absl::Notification cancel_notification;
+  frames_reader()->ReadFrame(
+      service::proto::V1Frame::CANCEL,
+      [&](std::optional<V1Frame> frame) {
+        ASSERT_NE(frame, std::nullopt);
+        EXPECT_EQ(frame->type(), service::proto::V1Frame::CANCEL);
+        cancel_notification.Notify();
+      },
+      kTimeout);
+  EXPECT_TRUE(cancel_notification.WaitForNotificationWithTimeout(kTimeout));
+}
+
 }  // namespace
 }  // namespace sharing
 }  // namespace nearby
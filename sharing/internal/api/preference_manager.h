@@ -19,7 +19,9 @@
 #include <functional>
 #include <optional>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "absl/strings/string_view.h"
@@ -78,6 +80,30 @@ class PreferenceManager {
                                         std::string value) = 0;
   virtual void RemoveDictionaryItem(absl::string_view key,
                                     absl::string_view dictionary_item) = 0;
+  // Sets several items of the dictionary in key as one write, so that they
+  // are never persisted apart. Implementations backed by storage should
+  // override this; the default sets the items one at a time.
+  using DictionaryValue = std::variant<bool, int, int64_t, std::string>;
+  virtual void SetDictionaryValues(
+      absl::string_view key,
+      absl::Span<const std::pair<std::string, DictionaryValue>> values) {
+    for (const auto& [dictionary_item, value] : values) {
+      std::visit(
+          [&](const auto& item_value) {
+            using T = std::decay_t<decltype(item_value)>;
+            if constexpr (std::is_same_v<T, bool>) {
+              SetDictionaryBooleanValue(key, dictionary_item, item_value);
+            } else if constexpr (std::is_same_v<T, int>) {
+              SetDictionaryIntegerValue(key, dictionary_item, item_value);
+            } else if constexpr (std::is_same_v<T, int64_t>) {
+              SetDictionaryInt64Value(key, dictionary_item, item_value);
+            } else {
+              SetDictionaryStringValue(key, dictionary_item, item_value);
+            }
+          },
+          value);
+    }
+  }
   // Gets values
   virtual bool GetBoolean(absl::string_view key, bool default_value) const = 0;
   virtual int GetInteger(absl::string_view key, int default_value) const = 0;
@@ -74,8 +74,9 @@ std::unique_ptr<TaskRunner> FakeContext::CreateSequencedTaskRunner() const {
 
 std::unique_ptr<TaskRunner> FakeContext::CreateConcurrentTaskRunner(
     uint32_t concurrent_count) const {
-  std::unique_ptr<TaskRunner> task_runner =
+  auto task_runner =
       std::make_unique<FakeTaskRunner>(fake_clock_.get(), concurrent_count);
+  last_concurrent_task_runner_ = task_runner.get();
   return task_runner;
 }
 
@@ -72,6 +72,9 @@ class FakeContext : public Context {
   FakeTaskRunner* last_sequenced_task_runner() const {
     return last_sequenced_task_runner_;
   }
+  FakeTaskRunner* last_concurrent_task_runner() const {
+    return last_concurrent_task_runner_;
+  }
 
  private:
   std::unique_ptr<FakeClock> fake_clock_;
@@ -81,6 +84,7 @@ class FakeContext : public Context {
   std::unique_ptr<FakeFastInitiationManager> fake_fast_initiation_manager_;
   std::unique_ptr<FakeTaskRunner> executor_;
   mutable FakeTaskRunner* last_sequenced_task_runner_ = nullptr;
+  mutable FakeTaskRunner* last_concurrent_task_runner_ = nullptr;
 };
 
 }  // namespace nearby
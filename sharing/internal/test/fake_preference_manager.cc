@@ -235,6 +235,28 @@ void FakePreferenceManager::RemoveDictionaryItem(
   NotifyPreferenceChanged(key);
 }
 
+void FakePreferenceManager::SetDictionaryValues(
+    absl::string_view key,
+    absl::Span<const std::pair<std::string, DictionaryValue>> values) {
+  {
+    absl::MutexLock lock(&mutex_);
+    auto& dictionary = dictionaries_[key];
+    bool changed = false;
+    for (const auto& [dictionary_item, value] : values) {
+      auto it = dictionary.find(dictionary_item);
+      if (it != dictionary.end() && it->second == value) {
+        continue;
+      }
+      dictionary.insert_or_assign(dictionary_item, value);
+      changed = true;
+    }
+    if (!changed) {
+      return;
+    }
+  }
+  NotifyPreferenceChanged(key);
+}
+
 
 bool FakePreferenceManager::GetBoolean(absl::string_view key,
                                        bool default_value) const {
@@ -73,6 +73,10 @@ class FakePreferenceManager : public nearby::sharing::api::PreferenceManager {
                                 std::string value) override;
   void RemoveDictionaryItem(absl::string_view key,
                             absl::string_view dictionary_item) override;
+  void SetDictionaryValues(
+      absl::string_view key,
+      absl::Span<const std::pair<std::string, DictionaryValue>> values)
+      override;
 
   bool GetBoolean(absl::string_view key, bool default_value) const override;
   int GetInteger(absl::string_view key, int default_value) const override;
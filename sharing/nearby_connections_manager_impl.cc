@@ -902,8 +902,18 @@ void NearbyConnectionsManagerImpl::OnPayloadTransferUpdate(
   NearbyConnectionImpl* connection = GetConnectionForId(endpoint_id);
   if (connection == nullptr) return;
 
+  // The frame is only consumed by the NearbyConnection, so hand its bytes
+  // over instead of copying them, and stop tracking the payload.
+  std::vector<uint8_t> bytes;
+  {
+    MutexLock lock(&mutex_);
+    auto it = incoming_payloads_.find(update.payload_id);
+    if (it == incoming_payloads_.end()) return;
+    bytes = std::move(it->second.content.bytes_payload.bytes);
+    incoming_payloads_.erase(it);
+  }
   LOG(INFO) << "Writing incoming byte message to NearbyConnection.";
-  connection->WriteMessage(payload->content.bytes_payload.bytes);
+  connection->WriteMessage(std::move(bytes));
 }
 
 void NearbyConnectionsManagerImpl::Reset() {
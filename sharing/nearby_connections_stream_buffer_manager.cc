@@ -20,6 +20,7 @@
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/meta/type_traits.h"
@@ -27,10 +28,66 @@
 
 namespace nearby {
 namespace sharing {
+namespace {
+
+// The total size is announced by the sender, so don't allocate more than this
+// up front. Larger payloads are buffered in segments as they arrive.
+constexpr int64_t kMaxPreallocatedSize = 64 * 1024 * 1024;
+
+}  // namespace
 
 NearbyConnectionsStreamBufferManager::PayloadWithBuffer::PayloadWithBuffer(
-    NcPayload payload)
-    : buffer_payload(std::move(payload)) {}
+    NcPayload payload, int64_t total_size)
+    : buffer_payload(std::move(payload)),
+      contiguous_(total_size > 0 && total_size <= kMaxPreallocatedSize) {
+  if (contiguous_) {
+    buffer_.reserve(total_size);
+  }
+}
+
+void NearbyConnectionsStreamBufferManager::PayloadWithBuffer::Append(
+    NcByteArray bytes) {
+  size_ += bytes.size();
+  if (!contiguous_) {
+    segments_.push_back(static_cast<std::string>(std::move(bytes)));
+    return;
+  }
+  if (buffer_.empty() && bytes.size() >= buffer_.capacity()) {
+    // The whole payload arrived in one read.
+    buffer_ = static_cast<std::string>(std::move(bytes));
+    return;
+  }
+  buffer_.append(bytes.data(), bytes.size());
+}
+
+size_t NearbyConnectionsStreamBufferManager::PayloadWithBuffer::capacity()
+    const {
+  size_t capacity = buffer_.capacity();
+  for (const std::string& segment : segments_) {
+    capacity += segment.capacity();
+  }
+  return capacity;
+}
+
+NcByteArray NearbyConnectionsStreamBufferManager::PayloadWithBuffer::Release() {
+  size_t size = size_;
+  size_ = 0;
+  if (contiguous_) {
+    return NcByteArray(std::move(buffer_));
+  }
+  if (segments_.size() == 1) {
+    NcByteArray bytes(std::move(segments_.front()));
+    segments_.clear();
+    return bytes;
+  }
+  std::string joined;
+  joined.reserve(size);
+  for (const std::string& segment : segments_) {
+    joined.append(segment);
+  }
+  segments_.clear();
+  return NcByteArray(std::move(joined));
+}
 
 NearbyConnectionsStreamBufferManager::NearbyConnectionsStreamBufferManager() =
     default;
@@ -39,12 +96,12 @@ NearbyConnectionsStreamBufferManager::~NearbyConnectionsStreamBufferManager() =
     default;
 
 void NearbyConnectionsStreamBufferManager::StartTrackingPayload(
-    NcPayload payload) {
+    NcPayload payload, int64_t total_size) {
   int64_t payload_id = payload.GetId();
   NL_LOG(INFO) << "Starting to track stream payload with ID " << payload_id;
 
   id_to_payload_with_buffer_map_[payload_id] =
-      std::make_unique<PayloadWithBuffer>(std::move(payload));
+      std::make_unique<PayloadWithBuffer>(std::move(payload), total_size);
 }
 
 bool NearbyConnectionsStreamBufferManager::IsTrackingPayload(
@@ -73,7 +130,7 @@ void NearbyConnectionsStreamBufferManager::HandleBytesTransferred(
   // We only need to read the new bytes which have not already been inserted
   // into the buffer.
   size_t bytes_to_read =
-      cumulative_bytes_transferred_so_far - payload_with_buffer->buffer.size();
+      cumulative_bytes_transferred_so_far - payload_with_buffer->size();
 
   NcInputStream* stream = payload_with_buffer->buffer_payload.AsStream();
   if (!stream) {
@@ -95,7 +152,7 @@ void NearbyConnectionsStreamBufferManager::HandleBytesTransferred(
   // condition.
   NL_DCHECK(!bytes.result().Empty());
 
-  payload_with_buffer->buffer += static_cast<std::string>(bytes.result());
+  payload_with_buffer->Append(std::move(bytes).result());
 }
 
 NcByteArray
@@ -108,7 +165,7 @@ NearbyConnectionsStreamBufferManager::GetCompletePayloadAndStopTracking(
     return NcByteArray();
   }
 
-  NcByteArray complete_payload(it->second->buffer);
+  NcByteArray complete_payload = it->second->Release();
 
   // Close stream and erase internal state before returning payload.
   it->second->buffer_payload.AsStream()->Close();
@@ -117,5 +174,14 @@ NearbyConnectionsStreamBufferManager::GetCompletePayloadAndStopTracking(
   return complete_payload;
 }
 
+size_t NearbyConnectionsStreamBufferManager::GetBufferCapacity(
+    int64_t payload_id) const {
+  auto it = id_to_payload_with_buffer_map_.find(payload_id);
+  if (it == id_to_payload_with_buffer_map_.end()) {
+    return 0;
+  }
+  return it->second->capacity();
+}
+
 }  // namespace sharing
 }  // namespace nearby
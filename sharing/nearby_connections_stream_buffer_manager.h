@@ -17,8 +17,10 @@
 
 #include <stdint.h>
 
+#include <cstddef>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "connections/core.h"
@@ -55,8 +57,9 @@ class NearbyConnectionsStreamBufferManager {
   NearbyConnectionsStreamBufferManager();
   ~NearbyConnectionsStreamBufferManager();
 
-  // Starts tracking the given payload.
-  void StartTrackingPayload(NcPayload payload);
+  // Starts tracking the given payload. If `total_size` is known, the buffer
+  // for the complete payload is allocated up front.
+  void StartTrackingPayload(NcPayload payload, int64_t total_size = 0);
 
   // Returns whether a payload with the provided ID is being tracked.
   bool IsTrackingPayload(int64_t payload_id) const;
@@ -69,18 +72,41 @@ class NearbyConnectionsStreamBufferManager {
   void HandleBytesTransferred(int64_t payload_id,
                               int64_t cumulative_bytes_transferred_so_far);
 
-  // Returns the completed buffer and deletes internal buffers.
+  // Returns the completed buffer and deletes internal buffers. The buffer is
+  // handed over without copying it if the total size was known.
   NcByteArray GetCompletePayloadAndStopTracking(int64_t payload_id);
 
+  // Returns the number of bytes allocated to buffer the payload with the
+  // provided ID, or 0 if it isn't being tracked.
+  size_t GetBufferCapacity(int64_t payload_id) const;
+
  private:
-  struct PayloadWithBuffer {
-    explicit PayloadWithBuffer(NcPayload payload);
+  class PayloadWithBuffer {
+   public:
+    PayloadWithBuffer(NcPayload payload, int64_t total_size);
+
+    // Adds bytes read from the stream.
+    void Append(NcByteArray bytes);
+
+    // Returns all bytes read so far as one array and empties the buffer.
+    NcByteArray Release();
+
+    size_t size() const { return size_; }
+
+    // Number of bytes allocated for the bytes read so far.
+    size_t capacity() const;
 
     NcPayload buffer_payload;
 
-    // Partially-complete buffer which contains the bytes which have been read
-    // up to this point.
-    std::string buffer;
+   private:
+    // Number of bytes read up to this point.
+    size_t size_ = 0;
+    // With the total size known, reads are appended to `buffer_`, which is
+    // allocated for the whole payload up front. Otherwise each read is kept
+    // in `segments_` as it came, and they are joined once at the end.
+    bool contiguous_ = false;
+    std::string buffer_;
+    std::vector<std::string> segments_;
   };
 
   absl::flat_hash_map<int64_t, std::unique_ptr<PayloadWithBuffer>>
@@ -39,7 +39,11 @@ class FakeStream : public NcInputStream {
     if (should_throw_exception_) {
       return NcException::kIo;
     }
-    return NcExceptionOr<NcByteArray>(NcByteArray(std::string(size, '\0')));
+    std::string bytes(size, '\0');
+    for (char& byte : bytes) {
+      byte = static_cast<char>(next_byte_++);
+    }
+    return NcExceptionOr<NcByteArray>(NcByteArray(std::move(bytes)));
   }
 
   NcExceptionOr<size_t> Skip(size_t offset) override {
@@ -57,8 +61,20 @@ class FakeStream : public NcInputStream {
   }
 
   bool should_throw_exception_ = false;
+
+ private:
+  uint8_t next_byte_ = 0;
 };
 
+// The stream contents FakeStream produces.
+std::string ExpectedBytes(size_t size) {
+  std::string bytes(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<char>(static_cast<uint8_t>(i));
+  }
+  return bytes;
+}
+
 }  // namespace
 
 struct CreatePayloadStreamResult {
@@ -172,5 +188,90 @@ TEST_F(NearbyConnectionsStreamBufferManagerTest, SingleStreamCheckException) {
   EXPECT_FALSE(buffer_manager_.IsTrackingPayload(/*payload_id=*/1));
 }
 
+TEST_F(NearbyConnectionsStreamBufferManagerTest,
+       ReassemblesBytesInOrderWithAndWithoutTotalSize) {
+  for (int64_t total_size : {int64_t{0}, int64_t{2500}}) {
+    CreatePayloadStreamResult payload_and_stream =
+        CreatePayload(/*payload_id=*/1);
+    buffer_manager_.StartTrackingPayload(std::move(payload_and_stream.payload),
+                                         total_size);
+    buffer_manager_.HandleBytesTransferred(
+        /*payload_id=*/1, /*cumulative_bytes_transferred_so_far=*/1000);
+    buffer_manager_.HandleBytesTransferred(
+        /*payload_id=*/1, /*cumulative_bytes_transferred_so_far=*/1980);
+    buffer_manager_.HandleBytesTransferred(
+        /*payload_id=*/1, /*cumulative_bytes_transferred_so_far=*/2500);
+
+    NcByteArray array =
+        buffer_manager_.GetCompletePayloadAndStopTracking(/*payload_id=*/1);
+    EXPECT_EQ(std::string(array), ExpectedBytes(2500));
+  }
+}
+
+TEST_F(NearbyConnectionsStreamBufferManagerTest,
+       SingleReadWithTotalSizeIsHandedOver) {
+  CreatePayloadStreamResult payload_and_stream =
+      CreatePayload(/*payload_id=*/1);
+  buffer_manager_.StartTrackingPayload(std::move(payload_and_stream.payload),
+                                       /*total_size=*/3000);
+  buffer_manager_.HandleBytesTransferred(
+      /*payload_id=*/1, /*cumulative_bytes_transferred_so_far=*/3000);
+
+  NcByteArray array =
+      buffer_manager_.GetCompletePayloadAndStopTracking(/*payload_id=*/1);
+  EXPECT_EQ(std::string(array), ExpectedBytes(3000));
+}
+
+// Reassembles a multi-megabyte stream read in 64 KB pieces. Each read is
+// allocated once by the stream, and the complete payload once by the buffer
+// manager; growing a std::string by appending would allocate several times
+// the payload size.
+TEST_F(NearbyConnectionsStreamBufferManagerTest,
+       LargeStreamBufferIsAllocatedUpFrontWithTotalSize) {
+  static constexpr int64_t kReadSize = 64 * 1024;
+  static constexpr int64_t kTotalSize = 4 * 1024 * 1024;
+  CreatePayloadStreamResult payload_and_stream =
+      CreatePayload(/*payload_id=*/1);
+  buffer_manager_.StartTrackingPayload(std::move(payload_and_stream.payload),
+                                       kTotalSize);
+  size_t capacity = buffer_manager_.GetBufferCapacity(/*payload_id=*/1);
+  EXPECT_GE(capacity, kTotalSize);
+
+  for (int64_t transferred = kReadSize; transferred <= kTotalSize;
+       transferred += kReadSize) {
+    buffer_manager_.HandleBytesTransferred(/*payload_id=*/1, transferred);
+    ASSERT_EQ(buffer_manager_.GetBufferCapacity(/*payload_id=*/1), capacity)
+        << "after " << transferred << " bytes";
+  }
+  NcByteArray complete_payload =
+      buffer_manager_.GetCompletePayloadAndStopTracking(/*payload_id=*/1);
+
+  EXPECT_EQ(static_cast<std::string>(complete_payload),
+            ExpectedBytes(kTotalSize));
+}
+
+TEST_F(NearbyConnectionsStreamBufferManagerTest,
+       LargeStreamBufferGrowsWithReadsWithoutTotalSize) {
+  static constexpr int64_t kReadSize = 64 * 1024;
+  static constexpr int64_t kTotalSize = 4 * 1024 * 1024;
+  CreatePayloadStreamResult payload_and_stream =
+      CreatePayload(/*payload_id=*/1);
+  buffer_manager_.StartTrackingPayload(std::move(payload_and_stream.payload));
+
+  for (int64_t transferred = kReadSize; transferred <= kTotalSize;
+       transferred += kReadSize) {
+    buffer_manager_.HandleBytesTransferred(/*payload_id=*/1, transferred);
+    // Reads are kept as they came, rather than in a buffer that is regrown.
+    ASSERT_LE(buffer_manager_.GetBufferCapacity(/*payload_id=*/1),
+              transferred + transferred / 8)
+        << "after " << transferred << " bytes";
+  }
+  NcByteArray complete_payload =
+      buffer_manager_.GetCompletePayloadAndStopTracking(/*payload_id=*/1);
+
+  EXPECT_EQ(static_cast<std::string>(complete_payload),
+            ExpectedBytes(kTotalSize));
+}
+
 }  // namespace sharing
 }  // namespace nearby
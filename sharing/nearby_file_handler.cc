@@ -15,6 +15,8 @@
 #include "sharing/nearby_file_handler.h"
 
 #include <stdint.h>
+
+#include <cstddef>
 #include <filesystem>  // NOLINT(build/c++17)
 #include <functional>
 #include <memory>
@@ -22,10 +24,11 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
-#include "absl/types/span.h"
 #include "internal/base/files.h"
 #include "internal/platform/task_runner_impl.h"
 #include "sharing/common/compatible_u8_string.h"
@@ -38,20 +41,56 @@ namespace {
 
 using ::nearby::sharing::api::SharingPlatform;
 
-// Called on the FileTaskRunner to actually open the files passed.
-std::vector<NearbyFileHandler::FileInfo> DoOpenFiles(
-    absl::Span<const std::filesystem::path> file_paths) {
-  std::vector<NearbyFileHandler::FileInfo> files;
-  for (const auto& file_path : file_paths) {
-    std::optional<uintmax_t> size = GetFileSize(file_path);
+// The number of files opened at the same time. Opening is I/O bound, so a few
+// threads hide the latency of slow or network-backed storage.
+constexpr uint32_t kOpenFilesConcurrency = 4;
+
+// The files of one OpenFiles() call, kept in the order they were requested.
+struct OpenFilesState {
+  OpenFilesState(size_t count, NearbyFileHandler::OpenFilesCallback callback)
+      : callback(std::move(callback)), files(count), remaining(count) {}
+
+  const NearbyFileHandler::OpenFilesCallback callback;
+  absl::Mutex mutex;
+  std::vector<NearbyFileHandler::FileInfo> files ABSL_GUARDED_BY(mutex);
+  size_t remaining ABSL_GUARDED_BY(mutex);
+  bool failed ABSL_GUARDED_BY(mutex) = false;
+};
+
+// Called on the file task runner to open the file at |index|. The last file to
+// be opened runs the callback.
+void DoOpenFile(OpenFilesState& state, size_t index,
+                const std::filesystem::path& file_path) {
+  bool failed;
+  {
+    absl::MutexLock lock(&state.mutex);
+    failed = state.failed;
+  }
+  std::optional<uintmax_t> size;
+  if (!failed) {
+    size = GetFileSize(file_path);
     if (!size.has_value()) {
       NL_LOG(ERROR) << __func__ << ": Failed to open file. File="
                     << GetCompatibleU8String(file_path.u8string());
-      return {};
     }
-    files.push_back({*size, file_path});
   }
-  return files;
+
+  std::vector<NearbyFileHandler::FileInfo> files;
+  {
+    absl::MutexLock lock(&state.mutex);
+    if (size.has_value()) {
+      state.files[index] = {*size, file_path};
+    } else {
+      state.failed = true;
+    }
+    if (--state.remaining > 0) {
+      return;
+    }
+    if (!state.failed) {
+      files = std::move(state.files);
+    }
+  }
+  state.callback(std::move(files));
 }
 
 }  // namespace
@@ -59,17 +98,26 @@ std::vector<NearbyFileHandler::FileInfo> DoOpenFiles(
 NearbyFileHandler::NearbyFileHandler(SharingPlatform& platform)
     : platform_(platform) {
   sequenced_task_runner_ = std::make_unique<TaskRunnerImpl>(1);
+  file_task_runner_ = std::make_unique<TaskRunnerImpl>(kOpenFilesConcurrency);
 }
 
 NearbyFileHandler::~NearbyFileHandler() = default;
 
 void NearbyFileHandler::OpenFiles(std::vector<std::filesystem::path> file_paths,
                                   OpenFilesCallback callback) {
-  sequenced_task_runner_->PostTask(
-      [callback = std::move(callback), file_paths = std::move(file_paths)]() {
-        auto opened_files = DoOpenFiles(file_paths);
-        callback(opened_files);
-      });
+  if (file_paths.empty()) {
+    file_task_runner_->PostTask(
+        [callback = std::move(callback)]() { callback({}); });
+    return;
+  }
+  auto state =
+      std::make_shared<OpenFilesState>(file_paths.size(), std::move(callback));
+  for (size_t i = 0; i < file_paths.size(); ++i) {
+    file_task_runner_->PostTask(
+        [state, i, file_path = std::move(file_paths[i])]() {
+          DoOpenFile(*state, i, file_path);
+        });
+  }
 }
 
 void NearbyFileHandler::DeleteFilesFromDisk(
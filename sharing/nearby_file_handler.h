@@ -45,7 +45,9 @@ class NearbyFileHandler {
   ~NearbyFileHandler();
 
   // Open the files given in |file_paths| and return the opened files sizes via
-  // |callback|. If any file fails to open, return an empty list.
+  // |callback|, in the order of |file_paths|. If any file fails to open, return
+  // an empty list. Files are opened in parallel, and |callback| runs on the
+  // thread that opened the last one.
   void OpenFiles(std::vector<std::filesystem::path> file_paths,
                  OpenFilesCallback callback);
 
@@ -61,6 +63,9 @@ class NearbyFileHandler {
  private:
   nearby::sharing::api::SharingPlatform& platform_;
   std::unique_ptr<TaskRunner> sequenced_task_runner_;
+  // Opens files, separately from the slow deletions on
+  // |sequenced_task_runner_|.
+  std::unique_ptr<TaskRunner> file_task_runner_;
 };
 
 }  // namespace sharing
@@ -15,8 +15,10 @@
 #include "sharing/nearby_file_handler.h"
 
 #include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <filesystem>  // NOLINT(build/c++17)
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -61,6 +63,70 @@ TEST(NearbyFileHandler, OpenFiles) {
   ASSERT_TRUE(RemoveFile(test_file));
 }
 
+TEST(NearbyFileHandler, OpenManyFilesInOrder) {
+  constexpr int kFileCount = 500;
+  MockSharingPlatform mock_platform;
+  NearbyFileHandler nearby_file_handler(mock_platform);
+  std::filesystem::path test_dir =
+      std::filesystem::temp_directory_path() / "nearby_nfh_test_many";
+  std::filesystem::create_directories(test_dir);
+  // Small files, each with its own size so that the order can be checked.
+  std::vector<std::filesystem::path> file_paths;
+  for (int i = 0; i < kFileCount; ++i) {
+    std::filesystem::path file_path =
+        test_dir / ("photo_" + std::to_string(i) + ".jpg");
+    std::FILE* file = std::fopen(file_path.string().c_str(), "w+");
+    ASSERT_NE(file, nullptr);
+    std::fputs(std::string(i, 'x').c_str(), file);
+    std::fclose(file);
+    file_paths.push_back(file_path);
+  }
+  absl::Notification notification;
+  std::vector<NearbyFileHandler::FileInfo> result;
+
+  absl::Time start = absl::Now();
+  nearby_file_handler.OpenFiles(
+      file_paths, [&result, &notification](
+                      std::vector<NearbyFileHandler::FileInfo> file_infos) {
+        result = file_infos;
+        notification.Notify();
+      });
+  ASSERT_TRUE(notification.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  RecordProperty("open_files_us",
+                 absl::ToInt64Microseconds(absl::Now() - start));
+
+  ASSERT_EQ(result.size(), kFileCount);
+  for (int i = 0; i < kFileCount; ++i) {
+    EXPECT_EQ(result[i].file_path, file_paths[i]);
+    EXPECT_EQ(result[i].size, static_cast<uint64_t>(i));
+  }
+  std::filesystem::remove_all(test_dir);
+}
+
+TEST(NearbyFileHandler, OpenFilesFailsIfAnyFileIsMissing) {
+  MockSharingPlatform mock_platform;
+  NearbyFileHandler nearby_file_handler(mock_platform);
+  absl::Notification notification;
+  std::vector<NearbyFileHandler::FileInfo> result;
+  std::filesystem::path test_file =
+      std::filesystem::temp_directory_path() / "nearby_nfh_test_abc.jpg";
+  std::filesystem::path missing_file =
+      std::filesystem::temp_directory_path() / "nearby_nfh_test_missing.jpg";
+
+  ASSERT_TRUE(CreateFile(test_file));
+  nearby_file_handler.OpenFiles(
+      {test_file, missing_file, test_file},
+      [&result, &notification](
+          std::vector<NearbyFileHandler::FileInfo> file_infos) {
+        result = file_infos;
+        notification.Notify();
+      });
+
+  ASSERT_TRUE(notification.WaitForNotificationWithTimeout(absl::Seconds(1)));
+  EXPECT_TRUE(result.empty());
+  ASSERT_TRUE(RemoveFile(test_file));
+}
+
 TEST(NearbyFileHandler, DeleteAFileFromDisk) {
   MockSharingPlatform mock_platform;
   NearbyFileHandler nearby_file_handler(mock_platform);
@@ -2535,15 +2535,16 @@ void NearbySharingServiceImpl::OnIncomingAdvertisementDecoded(
   // data to lambda.
   GetCertificateManager()->GetDecryptedPublicCertificate(
       std::move(encrypted_metadata_key),
-      [this, endpoint_id, advertisement_copy = *advertisement,
-       placeholder_share_target_id](
+      // The callback may run after the caller returns, so capture endpoint_id
+      // string_view as a std::string to ensure the data does not go out of
+      // scope.
+      [this, endpoint_id = std::string(endpoint_id),
+       advertisement_copy = *advertisement, placeholder_share_target_id](
           std::optional<NearbyShareDecryptedPublicCertificate>
               decrypted_public_certificate) {
         RunOnNearbySharingServiceThread(
             "incoming_decrypted_certificate",
-            // capture endpoint_id string_view as a std::string to ensure the
-            // data does not go out of scope.
-            [this, endpoint_id = std::string(endpoint_id), advertisement_copy,
+            [this, endpoint_id, advertisement_copy,
              placeholder_share_target_id,
              decrypted_public_certificate =
                  std::move(decrypted_public_certificate)]() {
@@ -3799,6 +3799,45 @@ TEST_F(NearbySharingServiceImplTest, CancelReceiverNoninitiator) {
   EXPECT_TRUE(connection_->IsClosed());
 }
 
+TEST_F(NearbySharingServiceImplTest, CancelIsNotBlockedByPendingDecryptions) {
+  constexpr int kDiscoveredEndpoints = 50;
+  MockTransferUpdateCallback transfer_callback;
+  MockShareTargetDiscoveredCallback discovery_callback;
+  SetConnectionType(ConnectionType::kWifi);
+  EXPECT_EQ(RegisterSendSurface(&transfer_callback, &discovery_callback,
+                                SendSurfaceState::kForeground),
+            NearbySharingService::StatusCodes::kOk);
+
+  // The fake certificate manager never answers, like a decryption pool that
+  // is stuck behind a discovery storm.
+  for (int i = 0; i < kDiscoveredEndpoints; ++i) {
+    fake_nearby_connections_manager_->OnEndpointFound(
+        absl::StrCat(kEndpointId, i),
+        std::make_unique<DiscoveredEndpointInfo>(CreateTestEndpointInfo(),
+                                                 kServiceId));
+  }
+  EXPECT_TRUE(sharing_service_task_runner_->SyncWithTimeout(kTaskWaitTimeout));
+  // Discovery events are handled one at a time; the first is waiting for its
+  // certificate.
+  ASSERT_EQ(
+      certificate_manager()->get_decrypted_public_certificate_calls().size(),
+      1u);
+
+  absl::Notification cancelled;
+  service_->Cancel(/*share_target_id=*/1234,
+                   [&cancelled](NearbySharingService::StatusCodes status_code) {
+                     EXPECT_EQ(status_code,
+                               NearbySharingService::StatusCodes::
+                                   kInvalidArgument);
+                     cancelled.Notify();
+                   });
+  EXPECT_TRUE(cancelled.WaitForNotificationWithTimeout(kTaskWaitTimeout));
+  EXPECT_EQ(
+      certificate_manager()->get_decrypted_public_certificate_calls().size(),
+      1u);
+  UnregisterSendSurface(&transfer_callback);
+}
+
 TEST_F(NearbySharingServiceImplTest,
        RegisterForegroundReceiveSurfaceEntersHighVisibility) {
   TestObserver observer(service_.get());
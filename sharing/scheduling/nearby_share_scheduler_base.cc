@@ -23,7 +23,9 @@
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "absl/functional/function_ref.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
 #include "absl/time/time.h"
@@ -62,6 +64,7 @@ NearbyShareSchedulerBase::NearbyShareSchedulerBase(
   connection_listener_name_ = absl::Substitute(
       "scheduler-$0-$1", pref_name_, absl::ToUnixNanos(absl::UnixEpoch()));
 
+  LoadState();
   InitializePersistedRequest();
   is_initialized_ = true;
 
@@ -84,25 +87,27 @@ NearbyShareSchedulerBase::~NearbyShareSchedulerBase() {
 
 void NearbyShareSchedulerBase::MakeImmediateRequest() {
   timer_->Stop();
-  SetHasPendingImmediateRequest(true);
+  UpdateState(
+      [](State& state) { state.has_pending_immediate_request = true; });
   Reschedule();
 }
 
 void NearbyShareSchedulerBase::HandleResult(bool success) {
   absl::Time now = clock_->Now();
-  SetLastAttemptTime(now);
 
   NL_LOG(INFO) << "Nearby Share scheduler \"" << pref_name_
                << "\" latest attempt " << (success ? "succeeded" : "failed");
 
-  if (success) {
-    SetLastSuccessTime(now);
-    SetNumConsecutiveFailures(0);
-  } else {
-    SetNumConsecutiveFailures(GetNumConsecutiveFailures() + 1);
-  }
-
-  SetIsWaitingForResult(false);
+  UpdateState([&](State& state) {
+    state.last_attempt_time = now;
+    if (success) {
+      state.last_success_time = now;
+      state.num_consecutive_failures = 0;
+    } else {
+      ++state.num_consecutive_failures;
+    }
+    state.is_waiting_for_result = false;
+  });
   Reschedule();
   PrintSchedulerState();
 }
@@ -122,13 +127,7 @@ void NearbyShareSchedulerBase::Reschedule() {
 }
 
 std::optional<absl::Time> NearbyShareSchedulerBase::GetLastSuccessTime() const {
-  std::optional<int64_t> pref_value =
-      preference_manager_.GetDictionaryInt64Value(
-          pref_name_, SchedulerFields::kLastSuccessTimeKeyName);
-  if (!pref_value.has_value()) {
-    return std::nullopt;
-  }
-  return absl::FromUnixNanos(pref_value.value());
+  return state_.last_success_time;
 }
 
 std::optional<absl::Duration>
@@ -148,16 +147,7 @@ NearbyShareSchedulerBase::GetTimeUntilNextRequest() const {
 }
 
 bool NearbyShareSchedulerBase::IsWaitingForResult() const {
-  std::optional<bool> pref_value =
-      preference_manager_.GetDictionaryBooleanValue(
-          pref_name_, SchedulerFields::kIsWaitingForResultKeyName);
-
-  bool is_waiting = false;
-  if (pref_value.has_value()) {
-    is_waiting = pref_value.value();
-  }
-
-  if (is_waiting) {
+  if (state_.is_waiting_for_result) {
     return true;
   }
 
@@ -175,17 +165,11 @@ bool NearbyShareSchedulerBase::IsWaitingForResult() const {
 }
 
 size_t NearbyShareSchedulerBase::GetNumConsecutiveFailures() const {
-  std::optional<int64_t> pref_value =
-      preference_manager_.GetDictionaryInt64Value(
-          pref_name_, SchedulerFields::kNumConsecutiveFailuresKeyName);
-
-  if (!pref_value.has_value()) {
-    return 0;
-  }
-  return pref_value.value();
+  return state_.num_consecutive_failures;
 }
 
 void NearbyShareSchedulerBase::OnStart() {
+  LoadState();
   Reschedule();
   NL_LOG(INFO) << "Starting Nearby Share scheduler \"" << pref_name_ << "\"";
   PrintSchedulerState();
@@ -202,63 +186,73 @@ void NearbyShareSchedulerBase::OnConnectionChanged(
 }
 
 std::optional<absl::Time> NearbyShareSchedulerBase::GetLastAttemptTime() const {
-  std::optional<int64_t> pref_value =
-      preference_manager_.GetDictionaryInt64Value(
-          pref_name_, SchedulerFields::kLastAttemptTimeKeyName);
-  if (!pref_value.has_value()) {
-    return std::nullopt;
-  }
-  return absl::FromUnixNanos(pref_value.value());
+  return state_.last_attempt_time;
 }
 
 bool NearbyShareSchedulerBase::HasPendingImmediateRequest() const {
-  std::optional<bool> pref_value =
-      preference_manager_.GetDictionaryBooleanValue(
-          pref_name_, SchedulerFields::kHasPendingImmediateRequestKeyName);
-  if (!pref_value.has_value()) {
-    return false;
-  }
-  return pref_value.value();
-}
-
-void NearbyShareSchedulerBase::SetLastAttemptTime(
-    absl::Time last_attempt_time) {
-  preference_manager_.SetDictionaryInt64Value(
-      pref_name_, SchedulerFields::kLastAttemptTimeKeyName,
-      absl::ToUnixNanos(last_attempt_time));
+  return state_.has_pending_immediate_request;
 }
 
-void NearbyShareSchedulerBase::SetLastSuccessTime(
-    absl::Time last_success_time) {
-  preference_manager_.SetDictionaryInt64Value(
-      pref_name_, SchedulerFields::kLastSuccessTimeKeyName,
-      absl::ToUnixNanos(last_success_time));
-}
-
-void NearbyShareSchedulerBase::SetNumConsecutiveFailures(size_t num_failures) {
-  preference_manager_.SetDictionaryInt64Value(
-      pref_name_, SchedulerFields::kNumConsecutiveFailuresKeyName,
-      num_failures);
+void NearbyShareSchedulerBase::LoadState() {
+  state_ = State();
+  std::optional<int64_t> last_attempt_time =
+      preference_manager_.GetDictionaryInt64Value(
+          pref_name_, SchedulerFields::kLastAttemptTimeKeyName);
+  if (last_attempt_time.has_value()) {
+    state_.last_attempt_time = absl::FromUnixNanos(*last_attempt_time);
+  }
+  std::optional<int64_t> last_success_time =
+      preference_manager_.GetDictionaryInt64Value(
+          pref_name_, SchedulerFields::kLastSuccessTimeKeyName);
+  if (last_success_time.has_value()) {
+    state_.last_success_time = absl::FromUnixNanos(*last_success_time);
+  }
+  state_.num_consecutive_failures =
+      preference_manager_
+          .GetDictionaryInt64Value(
+              pref_name_, SchedulerFields::kNumConsecutiveFailuresKeyName)
+          .value_or(0);
+  state_.has_pending_immediate_request =
+      preference_manager_
+          .GetDictionaryBooleanValue(
+              pref_name_, SchedulerFields::kHasPendingImmediateRequestKeyName)
+          .value_or(false);
+  state_.is_waiting_for_result =
+      preference_manager_
+          .GetDictionaryBooleanValue(
+              pref_name_, SchedulerFields::kIsWaitingForResultKeyName)
+          .value_or(false);
 }
 
-void NearbyShareSchedulerBase::SetHasPendingImmediateRequest(
-    bool has_pending_immediate_request) {
-  preference_manager_.SetDictionaryBooleanValue(
-      pref_name_, SchedulerFields::kHasPendingImmediateRequestKeyName,
-      has_pending_immediate_request);
-}
+void NearbyShareSchedulerBase::UpdateState(
+    absl::FunctionRef<void(State&)> update) {
+  update(state_);
 
-void NearbyShareSchedulerBase::SetIsWaitingForResult(
-    bool is_waiting_for_result) {
-  preference_manager_.SetDictionaryBooleanValue(
-      pref_name_, SchedulerFields::kIsWaitingForResultKeyName,
-      is_waiting_for_result);
+  std::vector<std::pair<std::string, PreferenceManager::DictionaryValue>>
+      values;
+  if (state_.last_attempt_time.has_value()) {
+    values.emplace_back(SchedulerFields::kLastAttemptTimeKeyName,
+                        absl::ToUnixNanos(*state_.last_attempt_time));
+  }
+  if (state_.last_success_time.has_value()) {
+    values.emplace_back(SchedulerFields::kLastSuccessTimeKeyName,
+                        absl::ToUnixNanos(*state_.last_success_time));
+  }
+  values.emplace_back(SchedulerFields::kNumConsecutiveFailuresKeyName,
+                      static_cast<int64_t>(state_.num_consecutive_failures));
+  values.emplace_back(SchedulerFields::kHasPendingImmediateRequestKeyName,
+                      state_.has_pending_immediate_request);
+  values.emplace_back(SchedulerFields::kIsWaitingForResultKeyName,
+                      state_.is_waiting_for_result);
+  preference_manager_.SetDictionaryValues(pref_name_, values);
 }
 
 void NearbyShareSchedulerBase::InitializePersistedRequest() {
   if (IsWaitingForResult()) {
-    SetHasPendingImmediateRequest(true);
-    SetIsWaitingForResult(false);
+    UpdateState([](State& state) {
+      state.has_pending_immediate_request = true;
+      state.is_waiting_for_result = false;
+    });
   }
 }
 
@@ -290,8 +284,10 @@ void NearbyShareSchedulerBase::OnTimerFired() {
     return;
   }
 
-  SetIsWaitingForResult(true);
-  SetHasPendingImmediateRequest(false);
+  UpdateState([](State& state) {
+    state.is_waiting_for_result = true;
+    state.has_pending_immediate_request = false;
+  });
   NotifyOfRequest();
 }
 
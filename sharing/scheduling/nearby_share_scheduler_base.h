@@ -21,6 +21,7 @@
 #include <optional>
 #include <string>
 
+#include "absl/functional/function_ref.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "sharing/internal/api/preference_manager.h"
@@ -86,13 +87,6 @@ class NearbyShareSchedulerBase : public NearbyShareScheduler {
   std::optional<absl::Time> GetLastAttemptTime() const;
   bool HasPendingImmediateRequest() const;
 
-  // Set and persist scheduling data in prefs.
-  void SetLastAttemptTime(absl::Time last_attempt_time);
-  void SetLastSuccessTime(absl::Time last_success_time);
-  void SetNumConsecutiveFailures(size_t num_failures);
-  void SetHasPendingImmediateRequest(bool has_pending_immediate_request);
-  void SetIsWaitingForResult(bool is_waiting_for_result);
-
   // On startup, set a pending immediate request if the pref service indicates
   // that there was an in-progress request or a pending immediate request at the
   // time of shutdown.
@@ -111,6 +105,24 @@ class NearbyShareSchedulerBase : public NearbyShareScheduler {
   void PrintSchedulerState() const;
 
  private:
+  // The scheduling data. It is kept in memory and mirrored in the |pref_name_|
+  // dictionary pref.
+  struct State {
+    std::optional<absl::Time> last_attempt_time;
+    std::optional<absl::Time> last_success_time;
+    size_t num_consecutive_failures = 0;
+    bool has_pending_immediate_request = false;
+    bool is_waiting_for_result = false;
+  };
+
+  // Reads the scheduling data from prefs, which may have been reset while the
+  // scheduler was stopped.
+  void LoadState();
+
+  // Applies |update| to the scheduling data and persists the result with a
+  // single pref write, so that prefs never hold part of a state transition.
+  void UpdateState(absl::FunctionRef<void(State&)> update);
+
   nearby::ConnectivityManager* const connectivity_manager_;
   nearby::sharing::api::PreferenceManager& preference_manager_;
   const nearby::Clock* const clock_;
@@ -120,6 +132,7 @@ class NearbyShareSchedulerBase : public NearbyShareScheduler {
   const std::string pref_name_;
   bool is_initialized_ = false;
   std::string connection_listener_name_;
+  State state_;
 
   std::unique_ptr<nearby::Timer> timer_;
 };
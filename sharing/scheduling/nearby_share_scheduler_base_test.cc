@@ -15,11 +15,14 @@
 #include "sharing/scheduling/nearby_share_scheduler_base.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <algorithm>
 #include <memory>
 #include <optional>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "absl/strings/string_view.h"
@@ -28,6 +31,7 @@
 #include "sharing/internal/test/fake_context.h"
 #include "sharing/internal/test/fake_preference_manager.h"
 #include "sharing/scheduling/nearby_share_scheduler.h"
+#include "sharing/scheduling/nearby_share_scheduler_fields.h"
 
 namespace nearby {
 namespace sharing {
@@ -132,6 +136,9 @@ class NearbyShareSchedulerBaseTest : public ::testing::Test {
 
   size_t on_request_call_count() const { return on_request_call_count_; }
   NearbyShareScheduler* scheduler() { return scheduler_.get(); }
+  nearby::FakePreferenceManager& preference_manager() {
+    return preference_manager_;
+  }
 
  private:
   nearby::FakePreferenceManager preference_manager_;
@@ -404,6 +411,77 @@ TEST_F(NearbyShareSchedulerBaseTest, RestoreSchedulingData) {
   EXPECT_EQ(scheduler()->GetNumConsecutiveFailures(), 1u);
 }
 
+TEST_F(NearbyShareSchedulerBaseTest, PersistsEachTransitionInOneWrite) {
+  CreateScheduler(/*retry_failures=*/true, /*require_connectivity=*/true);
+  StartScheduling();
+  int write_count = 0;
+  preference_manager().AddObserver("test", [&](absl::string_view pref_name) {
+    if (pref_name == kTestPrefName) ++write_count;
+  });
+
+  scheduler()->MakeImmediateRequest();
+  EXPECT_EQ(write_count, 1);
+  ASSERT_NO_FATAL_FAILURE(RunPendingRequest());
+  EXPECT_EQ(write_count, 2);
+  FinishPendingRequest(/*success=*/false);
+  EXPECT_EQ(write_count, 3);
+  // Reading the state doesn't touch prefs.
+  scheduler()->GetTimeUntilNextRequest();
+  EXPECT_EQ(write_count, 3);
+  preference_manager().RemoveObserver("test");
+}
+
+TEST_F(NearbyShareSchedulerBaseTest, PersistsOnlyCompleteTransitions) {
+  // Last attempt time, number of failures, pending immediate request and
+  // waiting for result, as persisted.
+  using PersistedState =
+      std::tuple<std::optional<int64_t>, std::optional<int64_t>,
+                 std::optional<bool>, std::optional<bool>>;
+  std::vector<PersistedState> persisted_states;
+  preference_manager().AddObserver("test", [&](absl::string_view pref_name) {
+    if (pref_name != kTestPrefName) return;
+    // A crash at any point leaves the prefs in one of these states.
+    persisted_states.emplace_back(
+        preference_manager().GetDictionaryInt64Value(
+            kTestPrefName, SchedulerFields::kLastAttemptTimeKeyName),
+        preference_manager().GetDictionaryInt64Value(
+            kTestPrefName, SchedulerFields::kNumConsecutiveFailuresKeyName),
+        preference_manager().GetDictionaryBooleanValue(
+            kTestPrefName, SchedulerFields::kHasPendingImmediateRequestKeyName),
+        preference_manager().GetDictionaryBooleanValue(
+            kTestPrefName, SchedulerFields::kIsWaitingForResultKeyName));
+  });
+  CreateScheduler(/*retry_failures=*/true, /*require_connectivity=*/true);
+  StartScheduling();
+
+  scheduler()->MakeImmediateRequest();
+  ASSERT_NO_FATAL_FAILURE(RunPendingRequest());
+  FinishPendingRequest(/*success=*/false);
+  preference_manager().RemoveObserver("test");
+
+  EXPECT_EQ(persisted_states,
+            (std::vector<PersistedState>{
+                {std::nullopt, 0, true, false},
+                {std::nullopt, 0, false, true},
+                {absl::ToUnixNanos(Now()), 1, false, false},
+            }));
+}
+
+TEST_F(NearbyShareSchedulerBaseTest, ReloadsPrefsResetWhileStopped) {
+  CreateScheduler(/*retry_failures=*/true, /*require_connectivity=*/true);
+  StartScheduling();
+  scheduler()->MakeImmediateRequest();
+  ASSERT_NO_FATAL_FAILURE(RunPendingRequest());
+  FinishPendingRequest(/*success=*/false);
+  StopScheduling();
+
+  preference_manager().Remove(kTestPrefName);
+  StartScheduling();
+  EXPECT_EQ(scheduler()->GetNumConsecutiveFailures(), 0u);
+  EXPECT_EQ(scheduler()->GetTimeUntilNextRequest(),
+            kTestTimeUntilRecurringRequest);
+}
+
 }  // namespace
 }  // namespace sharing
 }  // namespace nearby